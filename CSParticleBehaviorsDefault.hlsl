@@ -11,6 +11,37 @@
 
 *******************************************************************************/
 
+//-----------------------------------------------------------------------------
+//Feature permutations, the engine compiles one variant per feature set so
+//emitters only pay for what they use. Must match KernelFeature on the CPU.
+//Building without defines gives the variant with every feature enabled.
+//Spawning, and with it the shape texture, lives in CSParticleSpawn.hlsl.
+#ifndef FEATURE_COLOR_GRADIENT
+#define FEATURE_COLOR_GRADIENT 1 //More than one color in the color ramp
+#endif
+
+#ifndef FEATURE_PHYSICS
+#define FEATURE_PHYSICS 1 //Acceleration or friction is used
+#endif
+
+#ifndef IN_PLACE
+#define IN_PLACE 0 //Reads and writes a single particle buffer instead of ping ponging
+#endif
+
+#ifndef WRITE_INSTANCES
+#define WRITE_INSTANCES 0 //Appends a render ready record for every particle still alive
+#endif
+
+#ifndef NEIGHBOR_SEPARATION
+#define NEIGHBOR_SEPARATION 0 //Pushes particles apart using the neighbor grid
+#endif
+
+#include "ParticleInstance.hlsli"
+
+#if NEIGHBOR_SEPARATION
+#include "ParticleGrid.hlsli"
+#endif
+
 /// <summary>
 /// Parameters that are given to every emitter 
 /// </summary>
@@ -32,6 +63,15 @@ cbuffer EmitterParams : register(b1)
     float4 epPosition; //Emitter position xyzw
     float2 epScale;    //[0] x scale of the emitter [1] y scale of the emitter
     float2 colorData;  //[0] # of colors [1]nothing
+    uint2  epAffectors;//[0] first index into AffectorIndices [1] # of affectors
+    uint   epSubEmit;  //Sub emitter triggers 1 death
+    uint   epTransform;//Slot in EmitterTransforms plus one, zero does not follow
+    uint   epAtlasPage;//Atlas page of the particle texture, copied into instances
+    float  epSeparation;//Neighbor push strength, reaches one grid cell
+    uint   epDirectionRotation;//Instances rotate with the velocity, not the spawn direction
+    uint   epPad;
+    float4 epCollisionField; //[0,1] field origin [2] 1 / cell size [3] cell size
+    float4 epCollision;      //[0] response, zero does not collide [1] restitution [2] friction [3] radius
 
 };
 
@@ -51,11 +91,20 @@ struct BehaviorData
     float4  seed;           // [0] random seed  [1] random seed
 };
 
+#if IN_PLACE
+//Every thread only touches its own particle so one buffer is enough.
+//The particle is copied before any writes so reads see last frames data.
+RWStructuredBuffer<BehaviorData> BehavorDataNew: register(u0);//Data IN and Out
+static BehaviorData ParticleOld;
+#define OLD(index) ParticleOld
+//Neighbors may already be updated this frame, close enough for a soft push
+#define NEIGHBOR_POS(index) BehavorDataNew[index].pos
+#else
 StructuredBuffer<BehaviorData>   BehavorDataOld: register(t23);//Data IN
 RWStructuredBuffer<BehaviorData> BehavorDataNew;//Data Out
-
-SamplerState sam; // Sampler
-Texture2D tex;    // Texture used to determine spawn location
+#define OLD(index) BehavorDataOld[index]
+#define NEIGHBOR_POS(index) BehavorDataOld[index].pos
+#endif
 
 //Color gradient used to set tha particle color later in the pixel shader
 struct Color
@@ -66,6 +115,65 @@ struct Color
 
 StructuredBuffer<Color>   ColorGradient: register(t24); //Color Gradient in
 
+//World placed force fields, matches Affector on the CPU
+struct Affector
+{
+    float3 position;
+    uint   type;        //0 attractor 1 vortex 2 wind 3 drag
+    float3 direction;   //Wind direction or vortex axis
+    float  strength;
+    float  radius;      //Zero is global
+    float3 pad;
+};
+
+StructuredBuffer<Affector> Affectors      : register(t28); //Every affector in the scene
+StructuredBuffer<uint>     AffectorIndices: register(t29); //Affectors culled per emitter
+
+//Deaths that child emitters spawn from, births are recorded by CSParticleSpawn.hlsl
+struct SpawnRecord
+{
+    float4 pos; //xyz position w trigger 1 death 2 birth
+    float4 vel;
+};
+
+AppendStructuredBuffer<SpawnRecord> SubEmitRecords: register(u1); //Only bound when epSubEmit is set
+
+//World transforms of emitters that follow their game object, matches EmitterTransform on the CPU
+struct EmitterTransform
+{
+    float4 current;  //xyz position w rotation radians
+    float4 previous; //Last frame
+    float  follow;   //How much of the motion particles take
+    float3 pad;
+};
+
+StructuredBuffer<EmitterTransform> EmitterTransforms: register(t30);
+
+//Static level colliders baked on the CPU, xyz is signed distance and the normal away from the surface
+Texture2D<float4> CollisionField: register(t31);
+
+#if WRITE_INSTANCES
+AppendStructuredBuffer<ParticleInstance> Instances: register(u2); //Drawn by the vertex stage in place of the particles
+#endif
+
+#define SUB_EMIT_DEATH 1
+#define SUB_EMIT_BIRTH 2
+
+#define COLLISION_BOUNCE 1
+#define COLLISION_SLIDE  2
+#define COLLISION_KILL   3
+
+void AppendSpawnRecord(float4 pos, float4 vel, uint trigger)
+{
+    if (epSubEmit & trigger)
+    {
+        SpawnRecord record;
+        record.pos = float4(pos.xyz, trigger);
+        record.vel = vel;
+        SubEmitRecords.Append(record);
+    }
+}
+
 //-----------------------------------------------------------------------------
 //Random Functions
 
@@ -113,106 +221,166 @@ float4 PositionFormula(float4 oldPos, float4 velocity, float4 accel, float dt)
     //Position function x = x0 + (d * t) + (.5f * a * t^2) 
     out_position = oldPos;
     out_position += (velocity * dt);
+#if FEATURE_PHYSICS
     out_position += (.5 * accel * (dt * dt));
+#endif
 
     return out_position;
 }
 
-//-----------------------------------------------------------------------------
-//forward reference
-void Init(uint3 Gid, uint3 id, uint3 GTid, uint GI);
+//Returns the new velocity after acceleration and friction
+float4 VelocityFormula(uint index, float dt)
+{
+#if FEATURE_PHYSICS
+    //vel function v = v0 + (a * t)
+    float4 vel = OLD(index).vel + (OLD(index).accel * dt);
 
-//forward reference
-void Update(uint3 Gid, uint3 id, uint3 GTid, uint GI);
+    //Applies friction to the velocity
+    return vel * (1.0f - OLD(index).physicsPieces[2] * dt);
+#else
+    return OLD(index).vel;
+#endif
+}
 
-//-----------------------------------------------------------------------------
-//State Functions (Main Init Update)
-[numthreads(100, 1, 1)]
-void main( uint3 Gid : SV_GroupID, uint3 id : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex )
+//Applies the affectors culled to this emitter to a velocity
+float4 ApplyAffectors(float4 pos, float4 vel, float dt)
 {
-    //On the off chance the particle is not alive skip calculations
-    if( BehavorDataOld[id.x].lifetime.x < BehavorDataOld[id.x].lifetime.y)
+    for (uint i = 0; i < epAffectors.y; ++i)
     {
+        Affector a = Affectors[AffectorIndices[epAffectors.x + i]];
+
+        float3 toCenter = a.position - pos.xyz;
+        float dist = length(toCenter);
+        float influence = a.radius > 0.f ? 1.f - dist / a.radius : 1.f;
+
+        if (influence <= 0.f)
+            continue;
+
+        float amount = a.strength * influence * dt;
 
-        //if the time alive is less that zero
-        if (BehavorDataOld[id.x].lifetime.x < 0.f)
+        if (a.type == 0)
         {
-            //Enters here when initilizing a particle
-            Init( Gid, id, GTid, GI);
+            vel.xyz += toCenter / max(dist, 1e-4f) * amount;
         }
-        else
+        else if (a.type == 1)
         {
-            //Enters Here When Updating a particle
-            Update(Gid, id, GTid, GI);
+            float3 tangent = cross(a.direction, -toCenter);
+            float tangentLength = length(tangent);
+            if (tangentLength > 1e-4f)
+                vel.xyz += tangent / tangentLength * amount;
+        }
+        else if (a.type == 2)
+        {
+            vel.xyz += a.direction * amount;
+        }
+        else if (a.type == 3)
+        {
+            vel.xyz *= max(0.f, 1.f - amount);
         }
-
     }
+
+    return vel;
 }
 
-void Init(uint3 Gid, uint3 id, uint3 GTid, uint GI)
+//Carries a particle along with the motion of its emitter since the last frame
+void FollowTransform(inout float4 pos, inout float4 vel)
 {
+    EmitterTransform t = EmitterTransforms[epTransform - 1];
 
-    float4 out_Position = 0;
-    float out_TimeAlive = 0;
-    float alpha = 0;
+    float angle = (t.current.w - t.previous.w) * t.follow;
+    float c = cos(angle);
+    float s = sin(angle);
+
+    //Rotates around the old emitter position then moves to the new one
+    float2 local = pos.xy - t.previous.xy;
+    float3 followed = float3(t.current.xy + float2(local.x * c - local.y * s, local.x * s + local.y * c),
+        pos.z + t.current.z - t.previous.z);
+
+    pos.xyz = lerp(pos.xyz, followed, t.follow);
+    vel.xy = float2(vel.x * c - vel.y * s, vel.x * s + vel.y * c);
+}
 
-    //Complete particle Initization steps
-    out_TimeAlive = g_paramf[0];
+#if NEIGHBOR_SEPARATION
+//Pushes a particle away from the particles within one grid cell of it.
+//The grid was built over last frames particles so its indices match the in buffer.
+float4 Separate(uint index, float4 pos, float4 vel, float dt)
+{
+    float3 push = 0;
 
-    if (epScale.x > 0.1f && epScale.x > 0.1f)
+    GRID_FOR_EACH_NEIGHBOR(pos.xyz, neighbor)
     {
+        float3 away = pos.xyz - NEIGHBOR_POS(neighbor).xyz;
+        float dist = length(away);
 
-        //Declare sample location for fiting int scale range
-        float2 sampleLocation = 0;
+        //Skips itself and particles on top of it, there is no direction to push
+        if (neighbor != index && dist > 1e-4f && dist < gpCellSize)
+            push += away / dist * (1.f - dist / gpCellSize);
+    }
+    GRID_END_FOR_EACH
 
-        //declare seed for altering during loop
-        float2 seed = BehavorDataOld[id.x].seed.xy;
+    vel.xyz += push * epSeparation * dt;
+    return vel;
+}
+#endif
 
-        while (alpha < .7f)
-        {
-            //zero to one is uv coords
-            sampleLocation.x = RandomRange(0.f, 1.f, seed.x);
-            sampleLocation.y = RandomRange(0.f, 1.f, seed.y);
+//Pushes a particle out of the static colliders, same as Kernels::Collide on the CPU.
+//One texel is loaded and its distance is carried from the texel center along the normal.
+void Collide(inout float4 pos, inout float4 vel, inout float timeAlive, float maxLife)
+{
+    uint width, height;
+    CollisionField.GetDimensions(width, height);
 
-            alpha = tex.SampleLevel(sam, sampleLocation, 0).a;
+    //Nothing collides outside the baked area
+    float2 cell = (pos.xy - epCollisionField.xy) * epCollisionField.z;
+    if (any(cell < 0) || cell.x >= width || cell.y >= height)
+        return;
 
-            //alters the seed so I dont get dupes
-            //when looping
-            seed.x++;
-            seed.y++;
-        }
+    uint2 texel = (uint2)cell;
+    float4 field = CollisionField.Load(int3(texel, 0));
+    float2 normal = field.yz;
+    float2 center = epCollisionField.xy + (texel + .5f) * epCollisionField.w;
+    float distance = field.x + dot(normal, pos.xy - center);
 
-        //Fit from old range of uv coords to new range half scale
-        out_Position.x = Fit(sampleLocation.x, 0.0f, 1.0f, -epScale.x / 2.f, epScale.x / 2.f);
-        out_Position.y = Fit(sampleLocation.y, 1.0f, 0.0f, -epScale.y / 2.f, epScale.y / 2.f);
+    if (distance >= epCollision.w)
+        return;
 
-    }
-    else
+    if (epCollision.x == COLLISION_KILL)
     {
-        //if scale x or y is 0 then just random position by box
-        out_Position.xy = RandPositionByBox(epScale, BehavorDataOld[id.x].seed.xy);
+        timeAlive = maxLife;
+        return;
     }
 
-    //Use position formula to move particle correctly
-    out_Position = PositionFormula(epPosition + out_Position, BehavorDataOld[id.x].vel
-        , BehavorDataOld[id.x].accel, g_paramf[0]);
+    pos.xy += normal * (epCollision.w - distance);
 
-    //-----------------------------------------------------------------------------------
-    //Sets All New Output data
+    //Only velocity into the surface is changed
+    float intoSurface = dot(vel.xy, normal);
+    if (intoSurface >= 0)
+        return;
 
-    //vel function v = v0 + (a * t)
-    BehavorDataNew[id.x].vel = BehavorDataOld[id.x].vel + (BehavorDataOld[id.x].accel * g_paramf[0]);
+    float bounce = epCollision.x == COLLISION_BOUNCE ? epCollision.y : 0;
+    float2 tangent = (vel.xy - normal * intoSurface) * saturate(1 - epCollision.z);
+    vel.xy = tangent - normal * intoSurface * bounce;
+}
 
-    //Applies friction to the velocity
-    BehavorDataNew[id.x].vel *= (1.0f - BehavorDataOld[id.x].physicsPieces[2] * g_paramf[0]);
-    BehavorDataNew[id.x].seed = BehavorDataOld[id.x].seed;
+//-----------------------------------------------------------------------------
+//forward reference
+void Update(uint3 Gid, uint3 id, uint3 GTid, uint GI);
 
-    //Sets Data
-    BehavorDataNew[id.x].pos = out_Position;
-    BehavorDataNew[id.x].lifetime.x = out_TimeAlive;
-    
-    BehavorDataNew[id.x].color = ColorGradient[0].color;
+//-----------------------------------------------------------------------------
+//State Functions (Main Init Update)
+[numthreads(100, 1, 1)]
+void main( uint3 Gid : SV_GroupID, uint3 id : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex )
+{
+#if IN_PLACE
+    ParticleOld = BehavorDataNew[id.x];
+#endif
 
+    //On the off chance the particle is not alive skip calculations.
+    //New particles were already placed by the spawn pass so every thread takes the same path.
+    if( OLD(id.x).lifetime.x < OLD(id.x).lifetime.y)
+    {
+        Update(Gid, id, GTid, GI);
+    }
 }
 
 void Update(uint3 Gid, uint3 id, uint3 GTid, uint GI)
@@ -222,32 +390,48 @@ void Update(uint3 Gid, uint3 id, uint3 GTid, uint GI)
     float alpha = 0;
 
     //Adjust time alive 
-    out_TimeAlive = BehavorDataOld[id.x].lifetime.x + g_paramf[0];
+    out_TimeAlive = OLD(id.x).lifetime.x + g_paramf[0];
 
     //Calculate Position
-    out_Position = PositionFormula(BehavorDataOld[id.x].pos, BehavorDataOld[id.x].vel
-        , BehavorDataOld[id.x].accel, g_paramf[0]);
+    out_Position = PositionFormula(OLD(id.x).pos, OLD(id.x).vel
+        , OLD(id.x).accel, g_paramf[0]);
 
     //-------------------------------------------------------------------------
     //Sets All New Output data
 
-    //vel function v = v0 + (a * t)
-    BehavorDataNew[id.x].vel = BehavorDataOld[id.x].vel + (BehavorDataOld[id.x].accel * g_paramf[0]);
+    float4 out_Velocity = ApplyAffectors(out_Position, VelocityFormula(id.x, g_paramf[0]), g_paramf[0]);
 
-    //Applies friction to the velocity
-    BehavorDataNew[id.x].vel *= (1.0f - BehavorDataOld[id.x].physicsPieces[2] * g_paramf[0]);
-    BehavorDataNew[id.x].seed = BehavorDataOld[id.x].seed;
+#if NEIGHBOR_SEPARATION
+    out_Velocity = Separate(id.x, OLD(id.x).pos, out_Velocity, g_paramf[0]);
+#endif
+
+    //Emitters attached to a moving object carry their particles with them
+    if (epTransform > 0)
+        FollowTransform(out_Position, out_Velocity);
+
+    //Static colliders, killed particles die at the end of this update
+    if (epCollision.x > 0)
+        Collide(out_Position, out_Velocity, out_TimeAlive, OLD(id.x).lifetime.y);
+
+    BehavorDataNew[id.x].vel = out_Velocity;
+    BehavorDataNew[id.x].seed = OLD(id.x).seed;
 
     //Sets Data
     BehavorDataNew[id.x].pos = out_Position;
     BehavorDataNew[id.x].lifetime.x = out_TimeAlive;
 
+    //Dies at the end of this update
+    if (out_TimeAlive >= OLD(id.x).lifetime.y)
+        AppendSpawnRecord(out_Position, BehavorDataNew[id.x].vel, SUB_EMIT_DEATH);
+
 
     //Finds color for this time
+    float4 out_Color = OLD(id.x).color;
+#if FEATURE_COLOR_GRADIENT
     if (colorData.x > 1)
     {
         //Finds the percentage of life passed
-        float lifePercentage = BehavorDataOld[id.x].lifetime.x / BehavorDataOld[id.x].lifetime.y;
+        float lifePercentage = OLD(id.x).lifetime.x / OLD(id.x).lifetime.y;
 
         //Finds the next color
         if (ColorGradient[0].location < lifePercentage)
@@ -263,12 +447,31 @@ void Update(uint3 Gid, uint3 id, uint3 GTid, uint GI)
             }
 
             //Calculates the amount to lerp a color by.
-            float lerpAmount = g_paramf[0] / (ColorGradient[i].location * BehavorDataOld[id.x].lifetime.y - ColorGradient[i - 1].location * BehavorDataOld[id.x].lifetime.y);
+            float lerpAmount = g_paramf[0] / (ColorGradient[i].location * OLD(id.x).lifetime.y - ColorGradient[i - 1].location * OLD(id.x).lifetime.y);
 
             //Sets output for Color;
-            BehavorDataNew[id.x].color = lerp(BehavorDataOld[id.x].color, ColorGradient[i].color, lerpAmount);
+            out_Color = lerp(OLD(id.x).color, ColorGradient[i].color, lerpAmount);
+            BehavorDataNew[id.x].color = out_Color;
         }
     }
+#endif
 
+#if WRITE_INSTANCES
+    //Everything the billboard needs, so the renderer never reads this particle
+    if (out_TimeAlive < OLD(id.x).lifetime.y)
+    {
+        ParticleInstance instance;
+        instance.position = out_Position.xyz;
+        //The spawn folded its direction into the rotation, swap it for the current heading
+        float rotation = OLD(id.x).imageRotation.x;
+        if (epDirectionRotation && dot(out_Velocity.xy, out_Velocity.xy) > 0.f)
+            rotation += atan2(out_Velocity.y, out_Velocity.x) - OLD(id.x).physicsPieces.w;
+
+        instance.orientationScale = PackOrientationScale(rotation, OLD(id.x).scale.x);
+        instance.color = PackColor(out_Color);
+        instance.atlasPage = epAtlasPage;
+        Instances.Append(instance);
+    }
+#endif
 
 }
@@ -0,0 +1,79 @@
+/*******************************************************************************
+
+    @file       CSParticleCompact.hlsl
+
+    @date       01/09/2021
+
+    @authors    West Foulks (WestFoulks@gmail.com)
+
+    @brief      Packs the alive particles of an in place emitter to the front
+                of its single buffer.
+                AppendAlive - appends every alive particle to a scratch buffer
+                CopyBack    - copies the survivors over the front of the pool
+                              and marks every slot behind them dead
+
+*******************************************************************************/
+
+/// <summary>
+/// Must match BehaviorData in CSParticleBehaviorsDefault.hlsl
+/// </summary>
+struct BehaviorData
+{
+    float4 pos;
+    float4 vel;
+    float4 accel;
+    float4 physicsPieces;
+    float4 color;
+    float2 imageRotation;
+    float2 lifetime;        // [0] timeAlive    [1] max life
+    float2 scale;
+    float4 seed;
+};
+
+/// <summary>
+/// Must match cbCompactParams on the CPU
+/// </summary>
+cbuffer CompactParams : register(b3)
+{
+    uint cpCount; //Slots scanned, everything past it is already dead
+};
+
+/// <summary>
+/// Number of survivors, copied in with CopyStructureCount
+/// </summary>
+cbuffer CompactCount : register(b4)
+{
+    uint cpSurvivors;
+};
+
+RWStructuredBuffer<BehaviorData>     Particles: register(u0);
+AppendStructuredBuffer<BehaviorData> Survivors: register(u1);
+StructuredBuffer<BehaviorData>       Compacted: register(t0);
+
+[numthreads(256, 1, 1)]
+void AppendAlive(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= cpCount)
+        return;
+
+    BehaviorData p = Particles[id.x];
+    if (p.lifetime.x < p.lifetime.y)
+        Survivors.Append(p);
+}
+
+[numthreads(256, 1, 1)]
+void CopyBack(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= cpCount)
+        return;
+
+    if (id.x < cpSurvivors)
+    {
+        Particles[id.x] = Compacted[id.x];
+    }
+    else
+    {
+        //Its survivor was copied to the front, this slot is free for spawns
+        Particles[id.x].lifetime.x = Particles[id.x].lifetime.y;
+    }
+}
@@ -0,0 +1,180 @@
+/*******************************************************************************
+
+    @file       CSParticleGrid.hlsl
+
+    @date       01/09/2021
+
+    @authors    West Foulks (WestFoulks@gmail.com)
+
+    @brief      Builds a uniform grid over the particles of an emitter with a
+                counting sort so behavior kernels can find neighbors without
+                testing every particle. Entry points run in this order:
+
+                ClearCounts - zeroes the bucket counts
+                CountCells  - hashes every particle and counts its bucket
+                ScanBlocks  - exclusive prefix sum inside blocks of buckets
+                ScanSums    - exclusive prefix sum of the block totals
+                AddOffsets  - adds block offsets, bucket starts are final
+                Scatter     - writes particle indices into their buckets
+
+*******************************************************************************/
+#define PARTICLE_GRID_BUILD
+#include "ParticleGrid.hlsli"
+
+#define SCAN_THREADS 512
+#define SCAN_BLOCK   1024
+
+/// <summary>
+/// Only the position of a particle is read, the rest of the layout must
+/// match BehaviorData in CSParticleBehaviorsDefault.hlsl
+/// </summary>
+struct BehaviorData
+{
+    float4 pos;
+    float4 vel;
+    float4 accel;
+    float4 physicsPieces;
+    float4 color;
+    float2 imageRotation;
+    float2 lifetime;
+    float2 scale;
+    float4 seed;
+};
+
+StructuredBuffer<BehaviorData> Particles : register(t0);
+
+RWStructuredBuffer<uint> CellStart    : register(u0);
+RWStructuredBuffer<uint> CellCount    : register(u1);
+RWStructuredBuffer<uint> SortedIndex  : register(u2);
+RWStructuredBuffer<uint> ParticleCell : register(u3); //Bucket of every particle
+RWStructuredBuffer<uint> BlockSums    : register(u4); //Total of every scan block
+RWStructuredBuffer<uint> CellCursor   : register(u5); //Next free slot of every bucket while scattering
+
+groupshared uint sharedScan[SCAN_BLOCK];
+
+[numthreads(256, 1, 1)]
+void ClearCounts(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x < gpTableSize)
+        CellCount[id.x] = 0;
+}
+
+[numthreads(256, 1, 1)]
+void CountCells(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= gpCount)
+        return;
+
+    uint bucket = GridHash(GridCell(Particles[id.x].pos.xyz));
+    ParticleCell[id.x] = bucket;
+
+    InterlockedAdd(CellCount[bucket], 1);
+}
+
+//Exclusive scan of sharedScan in place, returns the block total
+uint ScanShared(uint GI)
+{
+    //Up sweep
+    uint offset = 1;
+    for (uint d = SCAN_BLOCK >> 1; d > 0; d >>= 1)
+    {
+        GroupMemoryBarrierWithGroupSync();
+        if (GI < d)
+        {
+            uint a = offset * (2 * GI + 1) - 1;
+            uint b = offset * (2 * GI + 2) - 1;
+            sharedScan[b] += sharedScan[a];
+        }
+        offset <<= 1;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+    uint total = sharedScan[SCAN_BLOCK - 1];
+    GroupMemoryBarrierWithGroupSync();
+
+    if (GI == 0)
+        sharedScan[SCAN_BLOCK - 1] = 0;
+
+    //Down sweep
+    for (uint d2 = 1; d2 < SCAN_BLOCK; d2 <<= 1)
+    {
+        offset >>= 1;
+        GroupMemoryBarrierWithGroupSync();
+        if (GI < d2)
+        {
+            uint a = offset * (2 * GI + 1) - 1;
+            uint b = offset * (2 * GI + 2) - 1;
+            uint t = sharedScan[a];
+            sharedScan[a] = sharedScan[b];
+            sharedScan[b] += t;
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+    return total;
+}
+
+[numthreads(SCAN_THREADS, 1, 1)]
+void ScanBlocks(uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex)
+{
+    uint base = Gid.x * SCAN_BLOCK;
+    uint a = base + GI;
+    uint b = base + GI + SCAN_THREADS;
+
+    sharedScan[GI]                = a < gpTableSize ? CellCount[a] : 0;
+    sharedScan[GI + SCAN_THREADS] = b < gpTableSize ? CellCount[b] : 0;
+
+    uint total = ScanShared(GI);
+
+    if (a < gpTableSize) CellStart[a] = sharedScan[GI];
+    if (b < gpTableSize) CellStart[b] = sharedScan[GI + SCAN_THREADS];
+
+    if (GI == 0)
+        BlockSums[Gid.x] = total;
+}
+
+//A single group, loops over the block totals carrying the running sum
+[numthreads(SCAN_THREADS, 1, 1)]
+void ScanSums(uint GI : SV_GroupIndex)
+{
+    uint carry = 0;
+
+    for (uint base = 0; base < gpBlockCount; base += SCAN_BLOCK)
+    {
+        uint a = base + GI;
+        uint b = base + GI + SCAN_THREADS;
+
+        sharedScan[GI]                = a < gpBlockCount ? BlockSums[a] : 0;
+        sharedScan[GI + SCAN_THREADS] = b < gpBlockCount ? BlockSums[b] : 0;
+
+        uint total = ScanShared(GI);
+
+        if (a < gpBlockCount) BlockSums[a] = sharedScan[GI] + carry;
+        if (b < gpBlockCount) BlockSums[b] = sharedScan[GI + SCAN_THREADS] + carry;
+
+        carry += total;
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+[numthreads(256, 1, 1)]
+void AddOffsets(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= gpTableSize)
+        return;
+
+    uint start = CellStart[id.x] + BlockSums[id.x / SCAN_BLOCK];
+    CellStart[id.x] = start;
+    CellCursor[id.x] = start;
+}
+
+[numthreads(256, 1, 1)]
+void Scatter(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= gpCount)
+        return;
+
+    uint slot;
+    InterlockedAdd(CellCursor[ParticleCell[id.x]], 1, slot);
+    SortedIndex[slot] = id.x;
+}
@@ -0,0 +1,206 @@
+/*******************************************************************************
+
+    @file       CSParticleSort.hlsl
+
+    @date       01/09/2021
+
+    @authors    West Foulks (WestFoulks@gmail.com)
+
+    @brief      Compute shaders that sort the particles of an emitter back to
+                front by camera depth. A bitonic sort over 32 bit keys with
+                particle indices. Entry points:
+
+                BuildKeys   - writes a depth key for every slot in the sort
+                SortLocal   - sorts blocks of SORT_BLOCK elements in shared memory
+                MergeLocal  - finishes a bitonic merge step once j fits a block
+                MergeGlobal - a single bitonic merge step in device memory
+
+*******************************************************************************/
+
+#define SORT_THREADS 512
+#define SORT_BLOCK   1024
+
+//Group size of the kernels with one thread per key or compare, SortThreads on the CPU
+#define GLOBAL_THREADS 256
+
+//Keys for dead and padding slots, always sorted behind alive particles
+#define DEAD_KEY 0xffffffff
+
+/// <summary>
+/// Parameters for a single sort dispatch
+/// </summary>
+cbuffer SortParams : register(b0)
+{
+    float4 spCameraPosition; //Camera position xyz
+    float4 spCameraForward;  //Camera forward xyz
+    uint   spAlive;          //Number of alive particles
+    uint   spCount;          //Power of two number of slots being sorted
+    uint   spK;              //Bitonic sequence size for merge steps
+    uint   spJ;              //Compare distance for MergeGlobal
+    uint   spOffset;         //First element for SortLocal windows
+    uint   spUsePrevious;    //BuildKeys reuses last frames order
+    uint   spAscending;      //SortLocal sorts each window ascending instead of bitonic
+    uint   spPad;
+};
+
+/// <summary>
+/// Only the position of a particle is read, the rest of the layout must
+/// match BehaviorData in CSParticleBehaviorsDefault.hlsl
+/// </summary>
+struct BehaviorData
+{
+    float4 pos;
+    float4 vel;
+    float4 accel;
+    float4 physicsPieces;
+    float4 color;
+    float2 imageRotation;
+    float2 lifetime;
+    float2 scale;
+    float4 seed;
+};
+
+StructuredBuffer<BehaviorData> Particles : register(t0);
+
+RWStructuredBuffer<uint> Keys   : register(u0);
+RWStructuredBuffer<uint> Values : register(u1); //Particle indices, read by the renderer
+
+groupshared uint2 sharedData[SORT_BLOCK];
+
+//Maps a float to a uint that sorts in the same order
+uint FloatToSortable(float value)
+{
+    uint bits = asuint(value);
+    uint mask = (bits & 0x80000000) ? 0xffffffff : 0x80000000;
+    return bits ^ mask;
+}
+
+[numthreads(GLOBAL_THREADS, 1, 1)]
+void BuildKeys(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= spCount)
+        return;
+
+    //Last frames order is nearly sorted when the particles barely moved
+    uint index = spUsePrevious ? Values[id.x] : id.x;
+
+    uint key = DEAD_KEY;
+    if (index < spAlive)
+    {
+        float depth = dot(Particles[index].pos.xyz - spCameraPosition.xyz, spCameraForward.xyz);
+
+        //Back to front, larger depth sorts first
+        key = min(~FloatToSortable(depth), DEAD_KEY - 1);
+    }
+
+    Keys[id.x] = key;
+    Values[id.x] = index;
+}
+
+//Compares two shared elements and swaps them into the requested order
+void CompareSwap(uint a, uint b, bool ascending)
+{
+    uint2 first = sharedData[a];
+    uint2 second = sharedData[b];
+
+    if ((first.x > second.x) == ascending)
+    {
+        sharedData[a] = second;
+        sharedData[b] = first;
+    }
+}
+
+void LoadBlock(uint base, uint GI)
+{
+    uint a = base + GI;
+    uint b = base + GI + SORT_THREADS;
+
+    sharedData[GI]                = a < spCount ? uint2(Keys[a], Values[a]) : uint2(DEAD_KEY, a);
+    sharedData[GI + SORT_THREADS] = b < spCount ? uint2(Keys[b], Values[b]) : uint2(DEAD_KEY, b);
+
+    GroupMemoryBarrierWithGroupSync();
+}
+
+void StoreBlock(uint base, uint GI)
+{
+    GroupMemoryBarrierWithGroupSync();
+
+    uint a = base + GI;
+    uint b = base + GI + SORT_THREADS;
+
+    if (a < spCount)
+    {
+        Keys[a] = sharedData[GI].x;
+        Values[a] = sharedData[GI].y;
+    }
+
+    if (b < spCount)
+    {
+        Keys[b] = sharedData[GI + SORT_THREADS].x;
+        Values[b] = sharedData[GI + SORT_THREADS].y;
+    }
+}
+
+[numthreads(SORT_THREADS, 1, 1)]
+void SortLocal(uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex)
+{
+    uint base = spOffset + Gid.x * SORT_BLOCK;
+    LoadBlock(base, GI);
+
+    for (uint k = 2; k <= SORT_BLOCK; k <<= 1)
+    {
+        for (uint j = k >> 1; j > 0; j >>= 1)
+        {
+            //Each thread owns one pair
+            uint i = 2 * GI - (GI & (j - 1));
+
+            //Windows are sorted ascending, a full sort alternates by global index
+            uint index = spAscending ? i : base + i;
+            CompareSwap(i, i + j, (index & k) == 0);
+
+            GroupMemoryBarrierWithGroupSync();
+        }
+    }
+
+    StoreBlock(base, GI);
+}
+
+[numthreads(SORT_THREADS, 1, 1)]
+void MergeLocal(uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex)
+{
+    uint base = Gid.x * SORT_BLOCK;
+    LoadBlock(base, GI);
+
+    for (uint j = SORT_BLOCK >> 1; j > 0; j >>= 1)
+    {
+        uint i = 2 * GI - (GI & (j - 1));
+        CompareSwap(i, i + j, ((base + i) & spK) == 0);
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    StoreBlock(base, GI);
+}
+
+[numthreads(GLOBAL_THREADS, 1, 1)]
+void MergeGlobal(uint3 id : SV_DispatchThreadID)
+{
+    uint i = 2 * id.x - (id.x & (spJ - 1));
+    uint partner = i + spJ;
+
+    if (partner >= spCount)
+        return;
+
+    uint keyA = Keys[i];
+    uint keyB = Keys[partner];
+    bool ascending = (i & spK) == 0;
+
+    if ((keyA > keyB) == ascending)
+    {
+        uint valueA = Values[i];
+        Keys[i] = keyB;
+        Keys[partner] = keyA;
+        Values[i] = Values[partner];
+        Values[partner] = valueA;
+    }
+}
@@ -0,0 +1,170 @@
+/*******************************************************************************
+
+    @file       CSParticleSpawn.hlsl
+
+    @date       01/09/2021
+
+    @authors    West Foulks (WestFoulks@gmail.com)
+
+    @brief      Spawns a burst of particles into the dead slots of an emitter.
+                The CPU uploads one small record per burst with the ranges of
+                the emitter and every particle attribute is rolled here, so
+                the update kernel only ever updates.
+
+*******************************************************************************/
+
+#ifndef FEATURE_SHAPE_TEXTURE
+#define FEATURE_SHAPE_TEXTURE 1 //Spawn inside a shape texture instead of a box
+#endif
+
+/// <summary>
+/// Must match BehaviorData in CSParticleBehaviorsDefault.hlsl
+/// </summary>
+struct BehaviorData
+{
+    float4 pos;
+    float4 vel;
+    float4 accel;
+    float4 physicsPieces;   // [0] speed        [1] friction     [3] Direction Radians [4] Mass
+    float4 color;
+    float2 imageRotation;   // [0] radians		[1] nothing
+    float2 lifetime;        // [0] timeAlive    [1] max life
+    float2 scale;
+    float4 seed;
+};
+
+struct Color
+{
+    float4 color;
+    float location;
+};
+
+//Must match SpawnRecord in CSParticleBehaviorsDefault.hlsl
+struct SpawnRecord
+{
+    float4 pos; //xyz position w trigger 1 death 2 birth
+    float4 vel;
+};
+
+#define SUB_EMIT_BIRTH 2
+
+/// <summary>
+/// One burst, must match cbSpawnParams on the CPU
+/// </summary>
+cbuffer SpawnParams : register(b3)
+{
+    float4 spPosition;          //Emitter position xyzw when the burst was emitted
+    float4 spScale;             //[0] [1] emitter scale     [2] [3] particle scale min max
+    float4 spLifetimeSpeed;     //[0] [1] lifetime min max  [2] [3] speed min max
+    float4 spDirectionRotation; //[0] [1] direction min max [2] [3] image rotation min max, degrees
+    float4 spPhysics;           //[0] [1] acceleration      [2] [3] friction min max
+    uint4  spSlots;             //[0] first free slot [1] particles [2] sub emitter triggers [3] use direction for rotation
+    float4 spSeed;              //[0] changes every burst
+    float4 spAge;               //[0] seconds the particles already lived, set by prewarms
+};
+
+SamplerState sam; // Sampler
+Texture2D tex;    // Texture used to determine spawn location
+
+StructuredBuffer<Color>             ColorGradient : register(t24);
+RWStructuredBuffer<BehaviorData>    Particles     : register(u0);
+AppendStructuredBuffer<SpawnRecord> SubEmitRecords: register(u1); //Only bound when spSlots[2] has births
+
+//Same hash as Rand in CSParticleBehaviorsDefault.hlsl
+float Rand(float seed)
+{
+    return frac(sin(dot(float2(-seed, seed), float2(12.9898, 78.233))) * 43758.5453);
+}
+
+float RandomRange(float Min, float Max, float seed)
+{
+    return lerp(Min, Max, Rand(seed));
+}
+
+float Fit(float value, float oldMin, float oldMax, float newMin, float newMax)
+{
+    //(value - omin) / (omax - omin) * (nmax - nmin) + nmin
+    return ((value - oldMin) / (oldMax - oldMin) * (newMax - newMin) + newMin);
+}
+
+//Offset from the emitter inside its box or shape texture
+float2 SpawnOffset(float2 seed)
+{
+    float2 offset = 0;
+
+#if FEATURE_SHAPE_TEXTURE
+    //Rejection samples the shape, only spawning threads pay for the loop now
+    float2 sampleLocation = 0;
+    float alpha = 0;
+
+    while (alpha < .7f)
+    {
+        //zero to one is uv coords
+        sampleLocation.x = RandomRange(0.f, 1.f, seed.x);
+        sampleLocation.y = RandomRange(0.f, 1.f, seed.y);
+
+        alpha = tex.SampleLevel(sam, sampleLocation, 0).a;
+
+        //alters the seed so I dont get dupes
+        seed.x++;
+        seed.y++;
+    }
+
+    //Fit from old range of uv coords to new range half scale
+    offset.x = Fit(sampleLocation.x, 0.0f, 1.0f, -spScale.x / 2.f, spScale.x / 2.f);
+    offset.y = Fit(sampleLocation.y, 1.0f, 0.0f, -spScale.y / 2.f, spScale.y / 2.f);
+#else
+    offset.x = RandomRange(-spScale.x / 2.f, spScale.x / 2.f, seed.x);
+    offset.y = RandomRange(-spScale.y / 2.f, spScale.y / 2.f, seed.y);
+#endif
+
+    return offset;
+}
+
+[numthreads(64, 1, 1)]
+void SpawnBurst(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= spSlots[1])
+        return;
+
+    float seed = spSeed.x + id.x * 1.61803f;
+
+    float direction = radians(RandomRange(spDirectionRotation[0], spDirectionRotation[1], seed + 1.f));
+    float speed = RandomRange(spLifetimeSpeed[2], spLifetimeSpeed[3], seed + 2.f);
+    float rotation = radians(RandomRange(spDirectionRotation[2], spDirectionRotation[3], seed + 3.f));
+
+    if (spSlots[3])
+        rotation += direction;
+
+    BehaviorData p;
+    p.seed = float4(seed + 4.f, seed + 5.f, seed + 6.f, seed + 7.f);
+    p.pos = float4(spPosition.xyz + float3(SpawnOffset(p.seed.xy), 0.f), spPosition.w);
+    p.vel = float4(cos(direction) * speed, sin(direction) * speed, 0.f, 0.f);
+    p.accel = float4(spPhysics.xy, 0.f, 0.f);
+    p.physicsPieces = float4(speed, 0.f, RandomRange(spPhysics[2], spPhysics[3], seed + 8.f), direction);
+    p.color = ColorGradient[0].color;
+    p.imageRotation = float2(rotation, 0.f);
+
+    //Zero so the update kernel moves it this frame like any other particle
+    p.lifetime = float2(0.f, RandomRange(spLifetimeSpeed[0], spLifetimeSpeed[1], seed + 9.f));
+    p.scale = float2(RandomRange(spScale[2], spScale[3], seed + 10.f), 0.f);
+
+    //Prewarm emissions are moved along as one step of the update would, too old starts dead
+    if (spAge.x > 0.f)
+    {
+        float age = spAge.x;
+        p.pos.xy += p.vel.xy * age + .5f * p.accel.xy * (age * age);
+        p.vel.xy = (p.vel.xy + p.accel.xy * age) * max(0.f, 1.f - p.physicsPieces[2] * age);
+        p.lifetime.x = age;
+    }
+
+    Particles[spSlots[0] + id.x] = p;
+
+    if (spSlots[2] & SUB_EMIT_BIRTH)
+    {
+        SpawnRecord record;
+        record.pos = float4(p.pos.xyz, SUB_EMIT_BIRTH);
+        record.vel = p.vel;
+        SubEmitRecords.Append(record);
+    }
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+
+    @file       CSParticleSubEmit.hlsl
+
+    @date       01/09/2021
+
+    @authors    West Foulks (WestFoulks@gmail.com)
+
+    @brief      Spawns particles of a child emitter from the spawn records its
+                parent appended during the update, so chained effects need no
+                CPU round trip. New particles claim the dead slots after the
+                alive front of the child pool with an atomic counter.
+                BuildArgs        - sizes the spawn dispatch from the record count
+                SpawnFromRecords - writes one child particle per thread
+
+*******************************************************************************/
+
+//Threads per group of SpawnFromRecords, BuildArgs sizes the dispatch with it
+#define SPAWN_THREADS 64
+
+/// <summary>
+/// Must match BehaviorData in CSParticleBehaviorsDefault.hlsl
+/// </summary>
+struct BehaviorData
+{
+    float4 pos;
+    float4 vel;
+    float4 accel;
+    float4 physicsPieces;   // [0] speed        [1] friction     [3] Direction Radians [4] Mass
+    float4 color;
+    float2 imageRotation;
+    float2 lifetime;        // [0] timeAlive    [1] max life
+    float2 scale;
+    float4 seed;
+};
+
+struct Color
+{
+    float4 color;
+    float location;
+};
+
+//Must match SpawnRecord in CSParticleBehaviorsDefault.hlsl
+struct SpawnRecord
+{
+    float4 pos; //xyz position w trigger 1 death 2 birth
+    float4 vel;
+};
+
+/// <summary>
+/// How the child spawns, must match cbSubEmitParams on the CPU
+/// </summary>
+cbuffer SubEmitParams : register(b3)
+{
+    float4 seLifetimeSpeed;  //[0] [1] lifetime min max [2] [3] speed min max
+    float4 seScaleDirection; //[0] [1] scale min max    [2] [3] direction min max degrees
+    float4 sePhysics;        //[0] [1] acceleration     [2] friction [3] inherited velocity
+    uint4  seSlots;          //[0] trigger [1] particles per record [2] first slot to claim [3] capacity
+    float4 seSeed;           //[0] changes every frame
+};
+
+/// <summary>
+/// Number of records the parent appended, copied in with CopyStructureCount
+/// </summary>
+cbuffer SubEmitCount : register(b4)
+{
+    uint seRecordCount;
+};
+
+StructuredBuffer<SpawnRecord>    Records      : register(t0);
+StructuredBuffer<Color>          ColorGradient: register(t24);
+RWStructuredBuffer<BehaviorData> Particles    : register(u0);
+RWStructuredBuffer<uint>         Claimed      : register(u1); //Only its hidden counter is used
+RWByteAddressBuffer              DispatchArgs : register(u2);
+
+//Same hash as Rand in CSParticleBehaviorsDefault.hlsl
+float Rand(float seed)
+{
+    return frac(sin(dot(float2(-seed, seed), float2(12.9898, 78.233))) * 43758.5453);
+}
+
+float RandomRange(float Min, float Max, float seed)
+{
+    return lerp(Min, Max, Rand(seed));
+}
+
+[numthreads(1, 1, 1)]
+void BuildArgs()
+{
+    //Every record asks for the same number of particles, no more than fit in the pool
+    uint spawns = min(seRecordCount * seSlots[1], seSlots[3] - seSlots[2]);
+    DispatchArgs.Store3(0, uint3((spawns + SPAWN_THREADS - 1) / SPAWN_THREADS, 1, 1));
+}
+
+[numthreads(SPAWN_THREADS, 1, 1)]
+void SpawnFromRecords(uint3 id : SV_DispatchThreadID)
+{
+    uint record = id.x / seSlots[1];
+    if (record >= seRecordCount)
+        return;
+
+    SpawnRecord source = Records[record];
+    if (uint(source.pos.w) != seSlots[0])
+        return;
+
+    //Only records of this trigger take a slot so the new particles stay packed
+    uint slot = seSlots[2] + Claimed.IncrementCounter();
+    if (slot >= seSlots[3])
+        return;
+
+    float seed = seSeed.x + id.x * 1.61803f;
+
+    float direction = radians(RandomRange(seScaleDirection[2], seScaleDirection[3], seed + 1.f));
+    float speed = RandomRange(seLifetimeSpeed[2], seLifetimeSpeed[3], seed + 2.f);
+
+    BehaviorData p;
+    p.pos = float4(source.pos.xyz, 1.f);
+    p.vel = float4(cos(direction) * speed, sin(direction) * speed, 0.f, 0.f) + source.vel * sePhysics[3];
+    p.accel = float4(sePhysics.xy, 0.f, 0.f);
+    p.physicsPieces = float4(speed, 0.f, sePhysics[2], direction);
+    p.color = ColorGradient[0].color;
+    p.imageRotation = 0.f;
+
+    //Starts at zero so the next update moves it instead of placing it in the emitter shape
+    p.lifetime = float2(0.f, RandomRange(seLifetimeSpeed[0], seLifetimeSpeed[1], seed + 3.f));
+    p.scale = float2(RandomRange(seScaleDirection[0], seScaleDirection[1], seed + 4.f), 0.f);
+    p.seed = float4(seed + 5.f, seed + 6.f, seed + 7.f, seed + 8.f);
+
+    Particles[slot] = p;
+}
@@ -14,10 +14,20 @@
 #include "stdafx.h"						//Header included in all files.
 #include "ParticleEmitterComponent.h"   //This Files Header
 #include "ParticleEngine.h"				//Contains the Particle Engine namepspace
+#include "ParticleEngineEmitterSettings.h" //Per emitter settings read by the behavior
+#include "ParticleEnginePreset.h"		//Binary emitter presets
+#include "ParticleEngineBudget.h"		//Frame level particle budget
+#include "ParticleEngineTransforms.h"	//Transforms of emitters that follow their object
+#include "ParticleEngineEmitterPool.h"	//Storage reclaimed from idle emitters
+#include <unordered_map>				//Texture handle cache while loading presets
+#include <algorithm>					//std::max std::min
+#include <cmath>						//std::abs std::ceil std::floor
+#include <random>						//Snapshot ids
+#include <atomic>						//Snapshot ids
 #include "GameObject.h"					//Class Definition for GameObjects
 #include "Component.h"					//Class Definition for Component
 #include "TransformComponent.h"			//Class Definition for a transforme Component
-#include "Clock.h"						//Contains Delta Time
+#include "ParticleEngineWorld.h"		//Tables of the world the emitter lives in
 #include "ImGuiUtil.h"					//ImGui Utility Library
 #include "imgui\imgui_color_gradient.h" //ImGui Color Gradient
 
@@ -50,6 +60,24 @@ RTTR_REGISTRATION
 	.property("ParticleImageRotation",	 &ParticleEmitterComponent::particleImageRotation_)
 	.property("UseDirectionForRotation", &ParticleEmitterComponent::useDirectionForRotation_)
 	.property("EmitterOffset",			 &ParticleEmitterComponent::emitterPositionOffset_)
+	.property("SortByDepth",			 &ParticleEmitterComponent::sortByDepth_)
+	.property("NeighborCellSize",		 &ParticleEmitterComponent::neighborCellSize_)
+	.property("NeighborSeparation",		 &ParticleEmitterComponent::neighborSeparation_)
+	.property("BudgetCategory",			 &ParticleEmitterComponent::budgetCategory_)
+	.property("BudgetPriority",			 &ParticleEmitterComponent::budgetPriority_)
+	.property("BudgetFalloff",			 &ParticleEmitterComponent::budgetFalloff_)
+	.property("InPlaceUpdate",			 &ParticleEmitterComponent::inPlaceUpdate_)
+	.property("InheritVelocity",		 &ParticleEmitterComponent::inheritVelocity_)
+	.property("FollowTransform",		 &ParticleEmitterComponent::followTransform_)
+	.property("ReclaimAfter",			 &ParticleEmitterComponent::reclaimAfter_)
+	.property("CollisionResponse",		 &ParticleEmitterComponent::collisionResponse_)
+	.property("CollisionRestitution",	 &ParticleEmitterComponent::collisionRestitution_)
+	.property("CollisionFriction",		 &ParticleEmitterComponent::collisionFriction_)
+	.property("CollisionRadius",		 &ParticleEmitterComponent::collisionRadius_)
+	.property("SnapshotId",				 &ParticleEmitterComponent::snapshotId_)
+	.method("EmitBatch",				 select_overload<uint32_t(const std::vector<std::weak_ptr<ParticleEngine::EmitterData>>&,
+		const std::vector<Vector3>&, const std::vector<int>&, const std::vector<float>&)>(&ParticleEmitterComponent::EmitBatch))
+	.method("SetEmitOnTimerBatch",		 &ParticleEmitterComponent::SetEmitOnTimerBatch)
 	.constructor();
 }
 
@@ -97,19 +125,49 @@ bool ParticleEmitterComponent::EmissionsMenu()
 		ImGuiUtil::Tooltip(tooltip.c_str());
 	}
 
-	if (changed |= ImGuiUtil::DrawInt("Max Particles", ownedParticles_))
+	if (ImGuiUtil::DrawInt("Max Particles", ownedParticles_))
 	{
+		changed = true;
+
 		if (ownedParticles_ < 2)
 			ownedParticles_ = 2;
 
-		//Recreate emitter object
+		//Resizes the current emitter, its particles stay alive
 		SetOwnedParticles(ownedParticles_);
 	}
 	ImGuiUtil::Tooltip("The max amount of particles this emitter has alive at one time. Please only use what is necessary!!!");
 
+	//Turning it off gives the emitter its second buffer back on the next update
+	changed |= ImGuiUtil::DrawBool("In Place Update", inPlaceUpdate_);
+	ImGuiUtil::Tooltip("Simulates the particles in a single buffer, halving the memory this emitter uses");
+
+	changed |= ImGuiUtil::DrawFloat("Reclaim after seconds", reclaimAfter_);
+	ImGuiUtil::Tooltip("Once every particle has been dead this long the emitter gives its memory back until it emits again. Zero keeps it");
+
 	changed |= ImGuiUtil::DrawInt("Amount of Emissions", emissionAmount_);
 	ImGuiUtil::Tooltip("The number of particles to emit every emission");
 
+	//---------------------------------------
+	//Particle Budget menu
+	if (changed |= ImGuiUtil::DrawInt("Budget Category", budgetCategory_))
+	{
+		if (budgetCategory_ < 0)
+			budgetCategory_ = 0;
+		if (budgetCategory_ >= (int)ParticleEngine::ParticleBudget::MaxCategories)
+			budgetCategory_ = ParticleEngine::ParticleBudget::MaxCategories - 1;
+	}
+	ImGuiUtil::Tooltip("The particle budget category this emitter spends from");
+
+	changed |= ImGuiUtil::DrawFloat("Budget Priority", budgetPriority_);
+	ImGuiUtil::Tooltip("When the particle budget is tight emitters with a higher priority keep spawning");
+
+	if (changed |= ImGuiUtil::DrawFloat("Budget Falloff", budgetFalloff_))
+	{
+		if (budgetFalloff_ < 0.f)
+			budgetFalloff_ = 0.f;
+	}
+	ImGuiUtil::Tooltip("Distance from the viewer where the priority is halved. Zero keeps the priority at any distance.");
+
 	//---------------------------------------
 	//LifeTime start menu
 	//makes sure static var is set correctly
@@ -145,13 +203,14 @@ bool ParticleEmitterComponent::EmissionsMenu()
 
 	if (changed |= ImGuiUtil::DrawString("Shape Texture", emitterShape_, StringFieldType::Texture))
 	{
-		if (!Window::Instance().Gfx().market.ResourceExists(emitterShape_))
+		ParticleEngine::TextureHandle handle = GetWorld().GetTextures().Intern(emitterShape_);
+		if (!handle.IsValid())
 		{
 			LOG_INFO("ParticleEmitter", "tried to set a texture that does not exist")
 		}
 		else
 		{
-			SetShapeTexture(emitterShape_);
+			SetShapeTexture(handle);
 		}
 	}
 	ImGuiUtil::Tooltip("The texture to assigned to an emitter that dictates where particles can spawn");
@@ -166,13 +225,14 @@ bool ParticleEmitterComponent::VisualsOnSpawnMenu()
 
 	if (changed |= ImGuiUtil::DrawString("Particle Texture", pTexture_, StringFieldType::Texture))
 	{
-		if (!Window::Instance().Gfx().market.ResourceExists(pTexture_))
+		ParticleEngine::TextureHandle handle = GetWorld().GetTextures().Intern(pTexture_);
+		if (!handle.IsValid())
 		{
 			LOG_INFO("ParticleEmitter", "tried to set a texture that does not exist")
 		}
 		else
 		{
-			SetParticleTexture(pTexture_);
+			SetParticleTexture(handle);
 		}
 	}
 	ImGuiUtil::Tooltip("The texture to assign to each particle visually.");
@@ -230,6 +290,11 @@ bool ParticleEmitterComponent::VisualsOnSpawnMenu()
 
 	ImGuiUtil::Tooltip(tooltip);
 
+	//---------------------------------------
+	//Depth Sorting
+	changed |= ImGuiUtil::DrawBool("Sort By Depth", sortByDepth_);
+	ImGuiUtil::Tooltip("Draws particles back to front so alpha blending is correct. Costs a sort every frame.");
+
 	return changed;
 
 }
@@ -302,6 +367,54 @@ bool ParticleEmitterComponent::MotionOnSpawnMenu()
 		+ std::to_string(friction_.y);
 	ImGuiUtil::Tooltip(tooltip);
 
+	//---------------------------------------
+	//Neighbor Grid Menu
+	if (changed |= ImGuiUtil::DrawFloat("Neighbor Cell Size", neighborCellSize_))
+	{
+		if (neighborCellSize_ < 0.f)
+			neighborCellSize_ = 0.f;
+	}
+	ImGuiUtil::Tooltip("Bins particles into a grid of this cell size so behaviors can find neighbors. Zero disables the grid.");
+
+	if (changed |= ImGuiUtil::DrawFloat("Neighbor Separation", neighborSeparation_))
+	{
+		if (neighborSeparation_ < 0.f)
+			neighborSeparation_ = 0.f;
+	}
+	ImGuiUtil::Tooltip("How hard particles push away from others closer than one cell. Zero disables the grid.");
+
+	//---------------------------------------
+	//Follow Menu
+	changed |= ImGuiUtil::DrawFloat("Follow Transform", followTransform_);
+	ImGuiUtil::Tooltip("How much alive particles move with the object, 0 stays in world space and 1 moves fully with it");
+
+	//---------------------------------------
+	//Collision Menu
+	const char* responses[] = { "None", "Bounce", "Slide", "Kill" };
+	changed |= ImGui::Combo("Collision", &collisionResponse_, responses, IM_ARRAYSIZE(responses));
+	ImGuiUtil::Tooltip("What particles do when they touch the level colliders baked into the collision field");
+
+	if (collisionResponse_ != ParticleEngine::Collision_None)
+	{
+		changed |= ImGuiUtil::DrawFloat("Collision Restitution", collisionRestitution_);
+		ImGuiUtil::Tooltip("Fraction of the velocity into the surface kept on a bounce");
+
+		changed |= ImGuiUtil::DrawFloat("Collision Friction", collisionFriction_);
+		ImGuiUtil::Tooltip("Fraction of the velocity along the surface lost on each contact, 0 to 1");
+
+		if (changed |= ImGuiUtil::DrawFloat("Collision Radius", collisionRadius_))
+		{
+			if (collisionRadius_ < 0.f)
+				collisionRadius_ = 0.f;
+		}
+		ImGuiUtil::Tooltip("How far from the surface particles are kept");
+	}
+
+	//---------------------------------------
+	//Sub Emitter Menu
+	changed |= ImGuiUtil::DrawFloat("Inherit Velocity", inheritVelocity_);
+	ImGuiUtil::Tooltip("How much of the parent particles velocity is kept when this emitter is used as a sub emitter");
+
 	return changed;
 }
 
@@ -341,8 +454,8 @@ bool ParticleEmitterComponent::VisualsOverTimeMenu()
 			ColorGradient_.push_back(colors);
 		}
 
-		//Send color gradient to the emitter
-		emitter_->ColorsGradient(ColorGradient_);
+		//Sent to the emitter once this frame in LateUpdate
+		colorsDirty_ = true;
 
 	}
 	tooltip = "The ramp represents the entire lifetime of a particle.";
@@ -351,6 +464,41 @@ bool ParticleEmitterComponent::VisualsOverTimeMenu()
 	return changed;
 }
 
+//Zero is shown for unlimited so the field can be cleared
+static bool DrawLimit(const char* label, uint32_t& limit)
+{
+	int value = limit == ParticleEngine::ParticleBudget::Unlimited ? 0 : (int)limit;
+	if (!ImGuiUtil::DrawInt(label, value))
+		return false;
+
+	limit = value > 0 ? (uint32_t)value : ParticleEngine::ParticleBudget::Unlimited;
+	return true;
+}
+
+void ParticleEmitterComponent::BudgetLimitsMenu()
+{
+	ParticleEngine::ParticleBudget& budget = GetWorld().GetBudget();
+
+	ParticleEngine::ParticleBudget::Limits global = budget.GlobalLimits();
+	bool globalChanged = DrawLimit("Scene Max Live", global.maxLive);
+	globalChanged |= DrawLimit("Scene Max Spawns Per Frame", global.maxSpawnsPerFrame);
+	if (globalChanged)
+		budget.SetGlobalLimits(global);
+	ImGuiUtil::Tooltip("Caps every emitter in this world. Zero is unlimited.");
+
+	//Only the category of this emitter is shown
+	ParticleEngine::ParticleBudget::Limits category = budget.CategoryLimits(budgetCategory_);
+	bool categoryChanged = DrawLimit("Category Max Live", category.maxLive);
+	categoryChanged |= DrawLimit("Category Max Spawns Per Frame", category.maxSpawnsPerFrame);
+	if (categoryChanged)
+		budget.SetCategoryLimits(budgetCategory_, category);
+	ImGuiUtil::Tooltip("Caps every emitter in the budget category of this emitter. Zero is unlimited.");
+
+	const ParticleEngine::ParticleBudget::FrameStats& stats = budget.LastFrameStats();
+	ImGui::Text("Live %u  Granted %u of %u  Deferred %u  Dropped %u",
+		stats.live, stats.granted, stats.requested, stats.deferred, stats.dropped);
+}
+
 #pragma endregion
 
 bool ParticleEmitterComponent::DrawCustomInspector()
@@ -398,10 +546,23 @@ bool ParticleEmitterComponent::DrawCustomInspector()
 	ImGui::Separator();
 	if (ImGuiUtil::LowImportanceMenuItem("Visuals Over Time"))
 	{
-		changed = VisualsOverTimeMenu();
+		changed |= VisualsOverTimeMenu();
 		ImGui::TreePop();//Ends the tree node
 	}
 
+	//---------------------------------------------------------
+	//Budget limits of the world, shared by every emitter in it
+	ImGuiUtil::MultiSpaceing(3);
+	ImGui::Separator();
+	if (ImGuiUtil::LowImportanceMenuItem("Particle Budget"))
+	{
+		BudgetLimitsMenu();
+		ImGui::TreePop();//Ends the tree node
+	}
+
+	//Every edit this frame reaches the settings table once in LateUpdate
+	settingsDirty_ |= changed;
+
 	return changed;
 
 }
@@ -410,6 +571,22 @@ bool ParticleEmitterComponent::DrawCustomInspector()
 
 #pragma region Constructor
 
+//Saved with the scene so snapshots of one run restore into the next.
+//Components are built on every world thread, so ids count up from a
+//random start instead of sharing a generator.
+static uint32_t NewSnapshotId()
+{
+	static std::atomic<uint32_t> next{ std::random_device{}() };
+
+	uint32_t id;
+	do
+	{
+		id = next.fetch_add(1, std::memory_order_relaxed);
+	} while (id == 0);
+
+	return id;
+}
+
 ParticleEmitterComponent::ParticleEmitterComponent() noexcept :
 	Component("ParticleEmitterComponent"),
 	emitterPositionOffset_(0,0,0),
@@ -432,14 +609,37 @@ ParticleEmitterComponent::ParticleEmitterComponent() noexcept :
 	emitter_(),
 	ColorGradient_(1),
 	particleImageRotation_(0,0),
-	useDirectionForRotation_(false)
+	useDirectionForRotation_(false),
+	sortByDepth_(false),
+	neighborCellSize_(0.f),
+	neighborSeparation_(0.f),
+	budgetCategory_(0),
+	budgetPriority_(1.f),
+	budgetFalloff_(0.f),
+	deferredFrames_(0),
+	inPlaceUpdate_(false),
+	inheritVelocity_(0.f),
+	transform_(nullptr),
+	world_(nullptr),
+	followTransform_(0.f),
+	transformSlot_(ParticleEngine::TransformTable::NoSlot),
+	collisionResponse_(ParticleEngine::Collision_None),
+	collisionRestitution_(.5f),
+	collisionFriction_(0.f),
+	collisionRadius_(0.f),
+	reclaimAfter_(10.f),
+	idleTime_(0.f),
+	snapshotId_(NewSnapshotId()),
+	pinned_(false),
+	settingsDirty_(false),
+	colorsDirty_(false)
 {
 
 #ifdef _DEBUG
 	//For Imgui Menu
 	gradient_ = new ImGradient;
 #endif
-	SetOwnedParticles(ownedParticles_);
+	//The emitter is taken from the emitter pool on the first emission
 }
 
 ParticleEmitterComponent::ParticleEmitterComponent(const ParticleEmitterComponent& tocopy, bool isExact) noexcept :
@@ -459,12 +659,37 @@ friction_(tocopy.friction_),
 accel_(tocopy.accel_),
 ownedParticles_(tocopy.ownedParticles_),
 pTexture_(tocopy.pTexture_),
+pTextureHandle_(tocopy.pTextureHandle_),
 emitterScale_(tocopy.emitterScale_),
 emitterShape_(tocopy.emitterShape_),
+emitterShapeHandle_(tocopy.emitterShapeHandle_),
 emitter_(),
 ColorGradient_(tocopy.ColorGradient_),
 particleImageRotation_(tocopy.particleImageRotation_),
-useDirectionForRotation_(tocopy.useDirectionForRotation_)
+useDirectionForRotation_(tocopy.useDirectionForRotation_),
+sortByDepth_(tocopy.sortByDepth_),
+neighborCellSize_(tocopy.neighborCellSize_),
+neighborSeparation_(tocopy.neighborSeparation_),
+budgetCategory_(tocopy.budgetCategory_),
+budgetPriority_(tocopy.budgetPriority_),
+budgetFalloff_(tocopy.budgetFalloff_),
+deferredFrames_(0),
+inPlaceUpdate_(tocopy.inPlaceUpdate_),
+inheritVelocity_(tocopy.inheritVelocity_),
+transform_(nullptr),
+world_(tocopy.world_),
+followTransform_(tocopy.followTransform_),
+transformSlot_(ParticleEngine::TransformTable::NoSlot),
+collisionResponse_(tocopy.collisionResponse_),
+collisionRestitution_(tocopy.collisionRestitution_),
+collisionFriction_(tocopy.collisionFriction_),
+collisionRadius_(tocopy.collisionRadius_),
+reclaimAfter_(tocopy.reclaimAfter_),
+idleTime_(0.f),
+snapshotId_(isExact ? tocopy.snapshotId_ : NewSnapshotId()),
+pinned_(false),
+settingsDirty_(false),
+colorsDirty_(false)
 {
 
 
@@ -472,11 +697,13 @@ useDirectionForRotation_(tocopy.useDirectionForRotation_)
 	//For Imgui color Menu
 	gradient_ = new ImGradient;
 #endif
-	SetOwnedParticles(ownedParticles_);
+	//Copies in prefabs and the editor only create an emitter if they emit
 }
 
 ParticleEmitterComponent::~ParticleEmitterComponent() noexcept
 {
+	ReleaseEmitter();
+
 #ifdef _DEBUG
 	delete gradient_;
 #endif
@@ -492,9 +719,51 @@ void ParticleEmitterComponent::Init() noexcept
 
 void ParticleEmitterComponent::LateUpdate() noexcept
 {
+	auto& settingsTable = GetWorld().GetSettings();
+
+	//A particle snapshot was restored into this emitter
+	ParticleEngine::EmitterSettings* restored = emitter_.get() ? &settingsTable.Get(emitter_.get()) : nullptr;
+	if (restored && restored->emissionTimerRestored)
+	{
+		lastEmission_ = restored->emissionTimer;
+		restored->emissionTimerRestored = false;
+		idleTime_ = -std::max(lifetime_.x, lifetime_.y);
+	}
+
+	//Queued emissions fire once their delay runs out
+	for (size_t i = 0; i < delayedRequests_.size();)
+	{
+		delayedRequests_[i].delay -= GetWorld().DeltaTime();
+		if (delayedRequests_[i].delay <= 0.f)
+		{
+			ParticleEngine::EmissionRequest request = std::move(delayedRequests_[i]);
+			delayedRequests_.erase(delayedRequests_.begin() + i);
+			EmitRequest(request);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	//Emissions the particle budget deferred are asked for again
+	if (!deferredRequests_.empty())
+	{
+		deferredFrames_++;
+
+		//Each keeps its own position and overrides, those deferred again are added back
+		std::vector<ParticleEngine::EmissionRequest> deferred;
+		deferred.swap(deferredRequests_);
+		for (const ParticleEngine::EmissionRequest& request : deferred)
+			Emit(request);
+
+		if (deferredRequests_.empty())
+			deferredFrames_ = 0;
+	}
+
 	if (emitOnTimer_)
 	{
-		lastEmission_ += Clock::DeltaTime();
+		lastEmission_ += GetWorld().DeltaTime();
 		if(lastEmission_ >= emitTime_)
 		{
 			lastEmission_ = 0.f;
@@ -505,13 +774,67 @@ void ParticleEmitterComponent::LateUpdate() noexcept
 	{
 		if (lastEmission_ > 0.f)
 		{
-			lastEmission_ -= Clock::DeltaTime();
+			lastEmission_ -= GetWorld().DeltaTime();
 			if (lastEmission_ <= 0.f)
 			{
 				EmitInstant();
 			}
 		}
 	}
+
+	//Nothing emitted yet so there is nothing to update
+	if (!emitter_.get())
+		return;
+
+	//Inspector and script edits since the last frame go out together
+	if (settingsDirty_)
+		UpdateEmitterSettings();
+
+	if (colorsDirty_)
+		PushColors();
+
+	auto& settings = settingsTable.Get(emitter_.get());
+
+	//Saved by particle snapshots
+	settings.emissionTimer = lastEmission_;
+
+	UpdateFollowTransform(settings);
+
+	//Every particle has been dead for a while, the storage goes back to the
+	//pool and the next emission takes it again
+	idleTime_ += GetWorld().DeltaTime();
+	bool waiting = !delayedRequests_.empty() || !deferredRequests_.empty() || (!emitOnTimer_ && lastEmission_ > 0.f);
+	if (reclaimAfter_ > 0.f && idleTime_ >= reclaimAfter_ && !pinned_ && !waiting)
+		ReleaseEmitter();
+}
+
+void ParticleEmitterComponent::UpdateFollowTransform(ParticleEngine::EmitterSettings& settings)
+{
+	auto& table = GetWorld().GetTransforms();
+
+	if (followTransform_ <= 0.f)
+	{
+		if (transformSlot_ != ParticleEngine::TransformTable::NoSlot)
+			table.Free(transformSlot_);
+
+		transformSlot_ = ParticleEngine::TransformTable::NoSlot;
+		settings.transformSlot = transformSlot_;
+		return;
+	}
+
+	if (transformSlot_ == ParticleEngine::TransformTable::NoSlot)
+		transformSlot_ = table.Allocate();
+
+	//Emitters taken again from the pool get fresh settings so the slot is written every frame
+	settings.transformSlot = transformSlot_;
+
+	//The transform is looked up once, every frame after is a plain copy into the table
+	if (!transform_)
+		transform_ = GetGameObject()->GetComponent<TransformComponent>();
+
+	Vector3 position = transform_->Position() + emitterPositionOffset_;
+	float world[3] = { position.x, position.y, position.z };
+	table.Set(transformSlot_, world, transform_->Rot(), std::min(followTransform_, 1.f));
 }
 
 #pragma endregion
@@ -544,45 +867,266 @@ void ParticleEmitterComponent::EmitDelayByFloat(float delay)
 
 void ParticleEmitterComponent::EmitInstant()
 {
-	//TODO: Clean Up this funtion and Spawn particles so that its split into seperate functions
+	Emit(ParticleEngine::EmissionRequest());
+}
+
+void ParticleEmitterComponent::Emit(const ParticleEngine::EmissionRequest& emission)
+{
+	//Deferred emissions that wait this long are dropped
+	constexpr int MaxDeferredFrames = 30;
+
+	int amount = emission.count < 0 ? emissionAmount_ : emission.count;
+
+	//Overrides only apply to this emission, the settings of the component are left alone
+	Vector3 worldPosition(emission.position[0], emission.position[1], emission.position[2]);
+	bool hasPosition = (emission.overrides & ParticleEngine::Override_Position) != 0;
+
+	Vector2 directionOverride(emission.direction[0], emission.direction[1]);
+	bool hasDirection = (emission.overrides & ParticleEngine::Override_Direction) != 0;
+
+	Vector2 speed = (emission.overrides & ParticleEngine::Override_Speed)
+		? Vector2(emission.speed[0], emission.speed[1]) : speed_;
+	Vector2 lifetime = (emission.overrides & ParticleEngine::Override_Lifetime)
+		? Vector2(emission.lifetime[0], emission.lifetime[1]) : lifetime_;
+
+	Vector2 direction = PrepareEmission(hasPosition ? &worldPosition : nullptr, hasDirection ? &directionOverride : nullptr);
+	Vector4 position = emitter_->Position();
+
+	//Scales or defers the emission to keep the scene inside the particle budget
+	ParticleEngine::ParticleBudget::Request request;
+	request.source = this;
+	request.category = budgetCategory_;
+	request.count = amount > 0 ? amount : 0;
+	request.priority = budgetPriority_;
+	request.falloffDistance = budgetFalloff_;
+	request.position[0] = position.x;
+	request.position[1] = position.y;
+	request.position[2] = position.z;
+	request.canDefer = deferredFrames_ < MaxDeferredFrames;
+
+	int granted = (int)GetWorld().GetBudget().Submit(request);
+
+	if (granted == 0 && request.count > 0 && request.canDefer)
+	{
+		deferredRequests_.push_back(emission);
+		return;
+	}
+
+	if (granted == 0)
+		return;
+
+	Spawn(granted, direction, speed, lifetime);
+}
+
+uint32_t ParticleEmitterComponent::EmitBatch(const std::vector<std::weak_ptr<ParticleEngine::EmitterData>>& handles,
+	const std::vector<Vector3>& positions, const std::vector<int>& counts, const std::vector<float>& delays)
+{
+	return EmitBatch(ParticleEngine::World::Default(), handles, positions, counts, delays);
+}
+
+uint32_t ParticleEmitterComponent::EmitBatch(ParticleEngine::World& world, const std::vector<std::weak_ptr<ParticleEngine::EmitterData>>& handles,
+	const std::vector<Vector3>& positions, const std::vector<int>& counts, const std::vector<float>& delays)
+{
+	//Optional arrays are either empty or one entry per handle
+	size_t count = handles.size();
+	if ((!positions.empty() && positions.size() != count) || (!counts.empty() && counts.size() != count)
+		|| (!delays.empty() && delays.size() != count))
+	{
+		LOG_ERROR("ParticleEmitter", "EmitBatch arrays must be empty or match the number of handles");
+		return 0;
+	}
+
+	std::vector<ParticleEngine::EmissionRequest> requests(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		ParticleEngine::EmissionRequest& request = requests[i];
+		request.emitter = handles[i];
+
+		if (!positions.empty())
+		{
+			request.overrides |= ParticleEngine::Override_Position;
+			request.position[0] = positions[i].x;
+			request.position[1] = positions[i].y;
+			request.position[2] = positions[i].z;
+		}
+
+		if (!counts.empty())
+			request.count = counts[i];
+
+		if (!delays.empty())
+			request.delay = delays[i];
+	}
+
+	//One claim on the queue for the whole batch
+	return world.GetEmissionQueue().PushBatch(requests.data(), (uint32_t)count);
+}
+
+void ParticleEmitterComponent::SetEmitOnTimerBatch(const std::vector<ParticleEmitterComponent*>& components, bool emit)
+{
+	for (ParticleEmitterComponent* component : components)
+	{
+		if (component)
+			component->emitOnTimer_ = emit;
+	}
+}
+
+void ParticleEmitterComponent::EmitRequest(const ParticleEngine::EmissionRequest& request)
+{
+	if (request.delay > 0.f)
+	{
+		delayedRequests_.push_back(request);
+		return;
+	}
+
+	Emit(request);
+}
 
-	//TODO: figure out init issue on compoennt add
-	transform_ = GetGameObject()->GetComponent<TransformComponent>();
-	Vector4 position(transform_->Position());
+DirectX::SimpleMath::Vector2 ParticleEmitterComponent::PrepareEmission(const Vector3* worldPosition, const Vector2* directionOverride)
+{
+	EnsureEmitter();
+
+	//An overridden direction is used as given, the object rotation is not added
+	bool useObjectRotation = useObjectRotation_ && !directionOverride;
+
+	//A given position skips the transform lookup unless the rotation is needed
+	if (!worldPosition || useObjectRotation)
+	{
+		//TODO: figure out init issue on compoennt add
+		transform_ = GetGameObject()->GetComponent<TransformComponent>();
+	}
+
+	Vector4 position(worldPosition ? *worldPosition : transform_->Position());
 	position.w = 1.f;
 
 	//Adjust if UseObject Rotation is true
 	Vector2 direction;
-	if (useObjectRotation_)
+	if (useObjectRotation)
 	{
 		direction.x = direction_.x + (transform_->Rot() * 180.f / 3.14f);
 		direction.y = direction_.y + (transform_->Rot() * 180.f / 3.14f);
 	}
 	else
 	{
-		direction = direction_;
+		direction = directionOverride ? *directionOverride : direction_;
 	}
 
 	emitter_->Position(position + emitterPositionOffset_);
 	emitter_->Scale(emitterScale_);
 
-	emitter_->SpawnParticles(
-	emissionAmount_,
-	lifetime_,			// Lifetime		[0] Min		[1] Max  
-	scale_,				// Scale		[0] Min		[1] Max
-	direction,			// Direction	[0] Min		[1] Max
-	speed_,				// speed		[0] Min		[1] Max
-	friction_,
-	accel_,
-	particleImageRotation_,
-	useDirectionForRotation_
-	);
+	//Script writes to reflected settings reach the settings table with this frames other edits
+	settingsDirty_ = true;
+
+	return direction;
+}
+
+void ParticleEmitterComponent::Spawn(int amount, const Vector2& direction, const Vector2& speed, const Vector2& lifetime, float age)
+{
+	if (amount <= 0)
+		return;
+
+	//Idle again once the longest lived particle of this burst dies
+	idleTime_ = std::min(idleTime_, -std::max(lifetime.x, lifetime.y));
+
+	//One record per emission, the spawn pass rolls every particle on the GPU
+	ParticleEngine::SpawnBurst burst;
+	burst.count = static_cast<uint32_t>(amount);
+	burst.lifetime[0] = lifetime.x;					burst.lifetime[1] = lifetime.y;
+	burst.scale[0] = scale_.x;						burst.scale[1] = scale_.y;
+	burst.direction[0] = direction.x;				burst.direction[1] = direction.y;
+	burst.speed[0] = speed.x;						burst.speed[1] = speed.y;
+	burst.friction[0] = friction_.x;				burst.friction[1] = friction_.y;
+	burst.accel[0] = accel_.x;						burst.accel[1] = accel_.y;
+	burst.rotation[0] = particleImageRotation_.x;	burst.rotation[1] = particleImageRotation_.y;
+	burst.useDirectionForRotation = useDirectionForRotation_;
+	burst.age = age;
+
+	//Emissions batched in one frame each spawn where the emitter was moved for them
+	DirectX::XMFLOAT4 position = emitter_->Position();
+	burst.position[0] = position.x;	burst.position[1] = position.y;
+	burst.position[2] = position.z;	burst.position[3] = position.w;
+
+	GetWorld().GetSettings().Get(emitter_.get()).pendingBursts.push_back(burst);
+}
+
+void ParticleEmitterComponent::Prewarm(float seconds)
+{
+	//Enough steps to keep the motion smooth without a visible hitch
+	constexpr int MaxPrewarmSteps = 16;
+
+	//Particles older than the longest lifetime are dead so only that window matters
+	float life = std::max(lifetime_.x, lifetime_.y);
+	float window = std::min(seconds, life);
+	if (window <= 0.f)
+		return;
+
+	//Without friction one large step is exact, x = x0 + (v * t) + (.5f * a * t^2).
+	//Friction and color ramps are integrated per step so those limit the step size.
+	float maxStep = window;
+
+	float friction = std::max(friction_.x, friction_.y);
+	if (friction > 0.f)
+		maxStep = std::min(maxStep, .1f / friction);
+
+	float minLife = std::min(lifetime_.x, lifetime_.y);
+	for (size_t i = 1; i < ColorGradient_.size(); ++i)
+	{
+		float span = (ColorGradient_[i].location - ColorGradient_[i - 1].location) * minLife;
+		if (span > 0.f)
+			maxStep = std::min(maxStep, span);
+	}
+
+	int stepCount = std::min(MaxPrewarmSteps, std::max(1, (int)std::ceil(window / maxStep)));
+	float stepTime = window / stepCount;
+
+	//Timed emitters spawn the emissions that fall inside each step at the
+	//time they happened, other emitters only advance what is alive
+	std::vector<ParticleEngine::PrewarmStep> steps(stepCount);
+	int emitted = 0;
+	for (int i = 0; i < stepCount; ++i)
+	{
+		float stepEnd = (i + 1) * stepTime;
+		steps[i].deltaTime = stepTime;
+
+		if (!emitOnTimer_ || emitTime_ <= 0.f || emissionAmount_ <= 0)
+			continue;
+
+		int due = (int)std::floor(stepEnd / emitTime_) - emitted;
+		for (int e = 1; e <= due; ++e)
+			steps[i].emissionAges.push_back(stepEnd - (emitted + e) * emitTime_);
+
+		emitted += due;
+	}
+
+	//Picks up the timer where the prewarm left it
+	if (emitOnTimer_ && emitTime_ > 0.f)
+		lastEmission_ = window - emitted * emitTime_;
+
+	Vector2 direction = PrepareEmission();
+	idleTime_ = std::min(idleTime_, -life);
+
+	auto& settings = GetWorld().GetSettings().Get(emitter_.get());
+	settings.prewarmSteps = std::move(steps);
+	settings.prewarmSpawn = [this, direction](float age) { Spawn(emissionAmount_, direction, speed_, lifetime_, age); };
 }
 
 #pragma endregion
 
 #pragma region Getters Setters
 
+//Interns a texture name, falling back to the default particle texture
+static ParticleEngine::TextureHandle ResolveTexture(ParticleEngine::TextureRegistry& registry, const std::string& name)
+{
+	ParticleEngine::TextureHandle handle = registry.Intern(name);
+
+	if (!handle.IsValid())
+	{
+		LOG_INFO("ParticleEmitter", "tried to set a texture that does not exist, Default set")
+		handle = registry.Intern("WhiteParticle");
+	}
+
+	return handle;
+}
+
 const std::string &ParticleEmitterComponent::GetParticleTexture() const
 {
 	return pTexture_;
@@ -590,20 +1134,24 @@ const std::string &ParticleEmitterComponent::GetParticleTexture() const
 
 void ParticleEmitterComponent::SetParticleTexture(const std::string& name)
 {
+	SetParticleTexture(ResolveTexture(GetWorld().GetTextures(), name));
+}
 
-	if (name.size() > 0 && Window::Instance().Gfx().market.ResourceExists(pTexture_))
-	{
-		pTexture_ = name;
-	}
-	else
-	{
-		LOG_INFO("ParticleEmitter", "tried to set a texture that does not exist, Default set")
-		pTexture_ = "WhiteParticle";
+void ParticleEmitterComponent::SetParticleTexture(ParticleEngine::TextureHandle handle)
+{
+	//Handles are interned so equal ids mean the same texture
+	if (handle == pTextureHandle_)
+		return;
 
-	}
+	pTextureHandle_ = handle;
+	pTexture_ = GetWorld().GetTextures().Name(handle);
 
+	//The renderer draws the texture the emitter carries, it is only pushed when the handle changes
 	if (emitter_.get())
+	{
 		emitter_->SetMainTexture(pTexture_);
+		GetWorld().GetSettings().Get(emitter_.get()).particleTexture = pTextureHandle_;
+	}
 }
 
 const std::string& ParticleEmitterComponent::GetShapeTexture() const
@@ -613,28 +1161,184 @@ const std::string& ParticleEmitterComponent::GetShapeTexture() const
 
 void ParticleEmitterComponent::SetShapeTexture(const std::string& name)
 {
-	if (name.size() > 0 && Window::Instance().Gfx().market.ResourceExists(emitterShape_))
+	SetShapeTexture(ResolveTexture(GetWorld().GetTextures(), name));
+}
+
+void ParticleEmitterComponent::SetShapeTexture(ParticleEngine::TextureHandle handle)
+{
+	if (handle == emitterShapeHandle_)
+		return;
+
+	emitterShapeHandle_ = handle;
+	emitterShape_ = GetWorld().GetTextures().Name(handle);
+
+	if (emitter_.get())
+		GetWorld().GetSettings().Get(emitter_.get()).shapeTexture = emitterShapeHandle_;
+}
+
+void ParticleEmitterComponent::UpdateEmitterSettings()
+{
+	settingsDirty_ = false;
+
+	if (!emitter_.get())
+		return;
+
+	auto& settings = GetWorld().GetSettings().Get(emitter_.get());
+
+	//Emitters without acceleration or friction use the cheaper kernel variant
+	settings.usesPhysics = accel_ != Vector2::Zero || friction_ != Vector2::Zero;
+	settings.sortByDepth = sortByDepth_;
+	settings.useDirectionForRotation = useDirectionForRotation_;
+	settings.neighborCellSize = neighborCellSize_;
+	settings.neighborSeparation = neighborSeparation_;
+	settings.budgetCategory = budgetCategory_;
+	settings.inPlaceUpdate = inPlaceUpdate_;
+	settings.capacity = static_cast<uint32_t>(ownedParticles_);
+	settings.transformSlot = transformSlot_;
+	settings.snapshotId = snapshotId_;
+
+	//Unknown responses from old files do not collide
+	bool validResponse = collisionResponse_ >= 0 && collisionResponse_ <= ParticleEngine::Collision_Kill;
+	settings.collision.response = validResponse ? static_cast<uint32_t>(collisionResponse_) : ParticleEngine::Collision_None;
+	settings.collision.restitution = collisionRestitution_;
+	settings.collision.friction = collisionFriction_;
+	settings.collision.radius = collisionRadius_;
+
+	//Farthest a particle can get from the emitter, x = x0 + (v * t) + (.5f * a * t^2)
+	float life = std::max(lifetime_.x, lifetime_.y);
+	float speed = std::max(std::abs(speed_.x), std::abs(speed_.y));
+	settings.boundsRadius = emitterScale_.Length() * .5f + speed * life + .5f * accel_.Length() * life * life;
+
+	settings.subEmitters = subEmitters_;
+	settings.queuedEmit = [this](const ParticleEngine::EmissionRequest& request) { EmitRequest(request); };
+
+	//How this emitter spawns when a parent fires it
+	ParticleEngine::SubEmitterSpawn& spawn = settings.spawnTemplate;
+	spawn.lifetime[0] = lifetime_.x;	spawn.lifetime[1] = lifetime_.y;
+	spawn.speed[0] = speed_.x;			spawn.speed[1] = speed_.y;
+	spawn.scale[0] = scale_.x;			spawn.scale[1] = scale_.y;
+	spawn.direction[0] = direction_.x;	spawn.direction[1] = direction_.y;
+	spawn.accel[0] = accel_.x;			spawn.accel[1] = accel_.y;
+	spawn.friction = std::max(friction_.x, friction_.y);
+	spawn.inheritVelocity = inheritVelocity_;
+}
+
+void ParticleEmitterComponent::AddSubEmitter(ParticleEmitterComponent& child, ParticleEngine::SubEmitTrigger trigger, int particlesPerEvent)
+{
+	if (&child == this || particlesPerEvent <= 0)
+		return;
+
+	//Links hold the child emitter so it can not be reclaimed under them
+	EnsureEmitter();
+	child.EnsureEmitter();
+	child.pinned_ = true;
+
+	ParticleEngine::SubEmitterLink link;
+	link.child = child.emitter_;
+	link.trigger = trigger;
+	link.particlesPerEvent = static_cast<uint32_t>(particlesPerEvent);
+	subEmitters_.push_back(link);
+
+	//The child needs a spawn template before the first event reaches it
+	child.UpdateEmitterSettings();
+	UpdateEmitterSettings();
+}
+
+void ParticleEmitterComponent::ClearSubEmitters()
+{
+	subEmitters_.clear();
+	UpdateEmitterSettings();
+}
+
+void ParticleEmitterComponent::ApplyTextures()
+{
+	auto& registry = GetWorld().GetTextures();
+
+	//Names are only resolved here the first time a component is loaded
+	if (!registry.IsCurrent(pTextureHandle_))
 	{
-		emitterShape_ = name;
+		pTextureHandle_ = ResolveTexture(registry, pTexture_);
+		pTexture_ = registry.Name(pTextureHandle_);
 	}
-	else
-	{
-		LOG_INFO("ParticleEmitter", "tried to set a texture that does not exist, Default set")
-			emitterShape_ = "WhiteParticle";
 
+	if (!registry.IsCurrent(emitterShapeHandle_))
+	{
+		emitterShapeHandle_ = ResolveTexture(registry, emitterShape_);
+		emitterShape_ = registry.Name(emitterShapeHandle_);
 	}
 
-	if (emitter_.get())
-		emitter_->SetEmitterShapeTexture(emitterShape_);
+	if (!emitter_.get())
+		return;
+
+	//Pooled storage may still carry the texture of its last owner.
+	//The shape texture is only read through its handle by the spawn pass.
+	emitter_->SetMainTexture(pTexture_);
+
+	auto& settings = GetWorld().GetSettings().Get(emitter_.get());
+	settings.particleTexture = pTextureHandle_;
+	settings.shapeTexture = emitterShapeHandle_;
 }
 
 void ParticleEmitterComponent::SetOwnedParticles(int amount)
 {
 	ownedParticles_ = amount;
-	emitter_ = ParticleEngine::Engine::Instance().GetEmitterManager().CreateEmitter(ownedParticles_);
-	SetParticleTexture(pTexture_);
-	SetShapeTexture(emitterShape_);
-	SetColors(ColorGradient_);
+
+	//The behavior resizes the emitter before its next update and copies the
+	//live particles across, handles and parent links stay valid
+	settingsDirty_ = true;
+}
+
+ParticleEngine::World& ParticleEmitterComponent::GetWorld() const
+{
+	return world_ ? *world_ : ParticleEngine::World::Default();
+}
+
+void ParticleEmitterComponent::SetWorld(ParticleEngine::World& world)
+{
+	if (&GetWorld() == &world)
+		return;
+
+	//Slots, settings and storage belong to the old world
+	ReleaseEmitter();
+	pinned_ = false;
+	world_ = &world;
+
+	//Handles are only valid in the registry that interned them
+	pTextureHandle_ = ParticleEngine::TextureHandle();
+	emitterShapeHandle_ = ParticleEngine::TextureHandle();
+}
+
+std::weak_ptr<ParticleEngine::EmitterData> ParticleEmitterComponent::GetEmissionHandle()
+{
+	EnsureEmitter();
+	pinned_ = true;
+	return emitter_;
+}
+
+void ParticleEmitterComponent::EnsureEmitter()
+{
+	if (emitter_.get())
+		return;
+
+	emitter_ = GetWorld().GetPool().Acquire(static_cast<uint32_t>(ownedParticles_), inPlaceUpdate_);
+
+	idleTime_ = 0.f;
+	ApplyTextures();
+	PushColors();
+	UpdateEmitterSettings();
+}
+
+void ParticleEmitterComponent::ReleaseEmitter()
+{
+	if (transformSlot_ != ParticleEngine::TransformTable::NoSlot)
+		GetWorld().GetTransforms().Free(transformSlot_);
+	transformSlot_ = ParticleEngine::TransformTable::NoSlot;
+
+	if (!emitter_.get())
+		return;
+
+	GetWorld().GetSettings().Remove(emitter_.get());
+	emitter_.reset();
 }
 
 void ParticleEmitterComponent::SetColors(const std::vector<ParticleEngine::ColorGradientCPU>& colors)
@@ -660,8 +1364,192 @@ void ParticleEmitterComponent::SetColors(const std::vector<ParticleEngine::Color
 
 #endif // DEBUG
 
+	//Sent to the emitter once this frame in LateUpdate
+	colorsDirty_ = true;
+}
+
+void ParticleEmitterComponent::PushColors()
+{
+	colorsDirty_ = false;
+
+	if (!emitter_.get())
+		return;
 
 	emitter_->ColorsGradient(ColorGradient_);
+
+	//The CPU simulation path reads the ramp from the settings
+	auto& colorKeys = GetWorld().GetSettings().Get(emitter_.get()).colorKeys;
+	colorKeys.resize(ColorGradient_.size());
+	for (size_t i = 0; i < ColorGradient_.size(); ++i)
+	{
+		colorKeys[i].color[0] = ColorGradient_[i].color.x;
+		colorKeys[i].color[1] = ColorGradient_[i].color.y;
+		colorKeys[i].color[2] = ColorGradient_[i].color.z;
+		colorKeys[i].color[3] = ColorGradient_[i].color.w;
+		colorKeys[i].location = ColorGradient_[i].location;
+	}
 }
 
-#pragma endregion
\ No newline at end of file
+#pragma endregion
+
+#pragma region Presets
+
+void ParticleEmitterComponent::ExportPreset(ParticleEngine::PresetWriter& writer) const
+{
+	ParticleEngine::PresetEmitter preset = {};
+
+	preset.positionOffset[0] = emitterPositionOffset_.x;
+	preset.positionOffset[1] = emitterPositionOffset_.y;
+	preset.positionOffset[2] = emitterPositionOffset_.z;
+	preset.emitTime = emitTime_;
+
+	preset.albedo[0] = albedo_.x;
+	preset.albedo[1] = albedo_.y;
+	preset.albedo[2] = albedo_.z;
+	preset.albedo[3] = albedo_.w;
+
+	auto copy2 = [](float* out, const Vector2& in) { out[0] = in.x; out[1] = in.y; };
+	copy2(preset.lifetime, lifetime_);
+	copy2(preset.scale, scale_);
+	copy2(preset.imageRotation, particleImageRotation_);
+	copy2(preset.direction, direction_);
+	copy2(preset.speed, speed_);
+	copy2(preset.friction, friction_);
+	copy2(preset.accel, accel_);
+	copy2(preset.emitterScale, emitterScale_);
+	preset.neighborCellSize = neighborCellSize_;
+	preset.neighborSeparation = neighborSeparation_;
+	preset.budgetPriority = budgetPriority_;
+	preset.budgetFalloff = budgetFalloff_;
+	preset.inheritVelocity = inheritVelocity_;
+	preset.followTransform = followTransform_;
+	preset.reclaimAfter = reclaimAfter_;
+	preset.collision[0] = collisionRestitution_;
+	preset.collision[1] = collisionFriction_;
+	preset.collision[2] = collisionRadius_;
+	preset.collisionResponse = collisionResponse_;
+	preset.budgetCategory = budgetCategory_;
+
+	preset.emissionAmount = emissionAmount_;
+	preset.ownedParticles = ownedParticles_;
+
+	preset.flags = 0;
+	if (emitOnTimer_)			  preset.flags |= ParticleEngine::Preset::FlagEmitOnTimer;
+	if (useObjectRotation_)		  preset.flags |= ParticleEngine::Preset::FlagUseObjectRotation;
+	if (useDirectionForRotation_) preset.flags |= ParticleEngine::Preset::FlagUseDirectionForRotation;
+	if (sortByDepth_)			  preset.flags |= ParticleEngine::Preset::FlagSortByDepth;
+	if (inPlaceUpdate_)			  preset.flags |= ParticleEngine::Preset::FlagInPlaceUpdate;
+
+	std::vector<ParticleEngine::PresetColorKey> colors;
+	colors.reserve(ColorGradient_.size());
+	for (const auto& gradient : ColorGradient_)
+	{
+		ParticleEngine::PresetColorKey key;
+		key.color[0] = gradient.color.x;
+		key.color[1] = gradient.color.y;
+		key.color[2] = gradient.color.z;
+		key.color[3] = gradient.color.w;
+		key.location = gradient.location;
+		colors.push_back(key);
+	}
+
+	writer.AddEmitter(preset, colors, pTexture_, emitterShape_);
+}
+
+void ParticleEmitterComponent::LoadPresets(const ParticleEngine::PresetFile& file,
+	ParticleEmitterComponent* const* components, uint32_t count, uint32_t first)
+{
+	if (!file.IsOpen() || first + count > file.EmitterCount())
+	{
+		LOG_ERROR("ParticleEmitter", "Preset file does not contain enough emitters");
+		return;
+	}
+
+	//Each unique name in the string table is interned once per world for the whole batch
+	std::unordered_map<uint32_t, ParticleEngine::TextureHandle> handles;
+	ParticleEngine::TextureRegistry* registry = nullptr;
+	auto resolve = [&](uint32_t offset)
+	{
+		auto found = handles.find(offset);
+		if (found != handles.end())
+			return found->second;
+
+		ParticleEngine::TextureHandle handle = ResolveTexture(*registry, file.String(offset));
+		handles.emplace(offset, handle);
+		return handle;
+	};
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		//Handles only resolve in the registry they came from
+		ParticleEngine::TextureRegistry& textures = components[i]->GetWorld().GetTextures();
+		if (registry != &textures)
+		{
+			registry = &textures;
+			handles.clear();
+		}
+
+		const ParticleEngine::PresetEmitter& preset = file.Emitter(first + i);
+		components[i]->ApplyPreset(file, preset, resolve(preset.particleTexture), resolve(preset.shapeTexture));
+	}
+}
+
+void ParticleEmitterComponent::ApplyPreset(const ParticleEngine::PresetFile& file, const ParticleEngine::PresetEmitter& preset,
+	ParticleEngine::TextureHandle particleTexture, ParticleEngine::TextureHandle shapeTexture)
+{
+	emitterPositionOffset_ = Vector3(preset.positionOffset[0], preset.positionOffset[1], preset.positionOffset[2]);
+	emitTime_ = preset.emitTime;
+	albedo_ = Vector4(preset.albedo[0], preset.albedo[1], preset.albedo[2], preset.albedo[3]);
+
+	lifetime_				= Vector2(preset.lifetime[0], preset.lifetime[1]);
+	scale_					= Vector2(preset.scale[0], preset.scale[1]);
+	particleImageRotation_	= Vector2(preset.imageRotation[0], preset.imageRotation[1]);
+	direction_				= Vector2(preset.direction[0], preset.direction[1]);
+	speed_					= Vector2(preset.speed[0], preset.speed[1]);
+	friction_				= Vector2(preset.friction[0], preset.friction[1]);
+	accel_					= Vector2(preset.accel[0], preset.accel[1]);
+	emitterScale_			= Vector2(preset.emitterScale[0], preset.emitterScale[1]);
+	neighborCellSize_		= preset.neighborCellSize;
+	neighborSeparation_		= preset.neighborSeparation;
+	budgetPriority_			= preset.budgetPriority;
+	budgetFalloff_			= preset.budgetFalloff;
+	inheritVelocity_		= preset.inheritVelocity;
+	followTransform_		= preset.followTransform;
+	reclaimAfter_			= preset.reclaimAfter;
+	collisionRestitution_	= preset.collision[0];
+	collisionFriction_		= preset.collision[1];
+	collisionRadius_		= preset.collision[2];
+	collisionResponse_		= preset.collisionResponse;
+	budgetCategory_			= preset.budgetCategory;
+
+	emissionAmount_ = preset.emissionAmount;
+
+	emitOnTimer_			 = (preset.flags & ParticleEngine::Preset::FlagEmitOnTimer) != 0;
+	useObjectRotation_		 = (preset.flags & ParticleEngine::Preset::FlagUseObjectRotation) != 0;
+	useDirectionForRotation_ = (preset.flags & ParticleEngine::Preset::FlagUseDirectionForRotation) != 0;
+	sortByDepth_			 = (preset.flags & ParticleEngine::Preset::FlagSortByDepth) != 0;
+	inPlaceUpdate_			 = (preset.flags & ParticleEngine::Preset::FlagInPlaceUpdate) != 0;
+
+	//Handles are already resolved so ApplyTextures does no lookups
+	pTextureHandle_ = particleTexture;
+	pTexture_ = GetWorld().GetTextures().Name(particleTexture);
+	emitterShapeHandle_ = shapeTexture;
+	emitterShape_ = GetWorld().GetTextures().Name(shapeTexture);
+
+	const ParticleEngine::PresetColorKey* keys = file.ColorKeys(preset);
+	ColorGradient_.clear();
+	ColorGradient_.reserve(preset.colorKeyCount);
+	for (uint32_t i = 0; i < preset.colorKeyCount; ++i)
+	{
+		Vector4 color(keys[i].color[0], keys[i].color[1], keys[i].color[2], keys[i].color[3]);
+		ColorGradient_.push_back(ParticleEngine::ColorGradientCPU(color, keys[i].location));
+	}
+
+	//A different effect starts from an empty emitter, it is created with
+	//every setting in place on its first emission
+	ownedParticles_ = preset.ownedParticles;
+	ReleaseEmitter();
+	pinned_ = false;
+}
+
+#pragma endregion
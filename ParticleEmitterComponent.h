@@ -14,8 +14,17 @@
 *******************************************************************************/
 #include "Component.h"				//Class Definition for Components
 #include "ParticleEngineEmitter.h"	//Used to Communicate with the particle engine
+#include "ParticleEngineTextureHandle.h"	//Interned texture handles
+#include "ParticleEngineEmitterSettings.h"	//Sub emitter links and emission requests
 
 class TransformComponent;
+namespace ParticleEngine
+{
+	class PresetFile;
+	class PresetWriter;
+	struct PresetEmitter;
+	class World;
+}
 typedef struct ImGradientMark ImGradientMark;
 class ImGradient;
 
@@ -83,6 +92,69 @@ public:
 	/// </summary>
 	void EmitInstant();
 
+	/// <summary>
+	/// Fast forwards the emitter by seconds so it looks like it has been
+	/// running for a while, use when a level loads. The work is done in a
+	/// few large steps on the next engine update.
+	/// </summary>
+	void Prewarm(float seconds);
+
+	/// <summary>
+	/// Makes child spawn particlesPerEvent particles wherever a particle of
+	/// this emitter dies or is born. Spawning stays on the GPU. Resizing
+	/// either emitter keeps the link.
+	/// </summary>
+	void AddSubEmitter(ParticleEmitterComponent& child, ParticleEngine::SubEmitTrigger trigger, int particlesPerEvent);
+
+	/// <summary>
+	/// Removes every child added with AddSubEmitter
+	/// </summary>
+	void ClearSubEmitters();
+
+	/// <summary>
+	/// Returns the handle emission requests use to reach this emitter. Fetch it
+	/// on the main thread, then requests can be pushed to the emission queue
+	/// of its world from any thread. Fetching a handle creates
+	/// the emitter and keeps it from being reclaimed, resizing the emitter
+	/// keeps the handle valid.
+	/// </summary>
+	std::weak_ptr<ParticleEngine::EmitterData> GetEmissionHandle();
+
+	/// <summary>
+	/// Queues an emission for every handle in one call, safe from any thread.
+	/// positions, counts and delays are either empty, which uses the settings
+	/// of each emitter, or hold one entry per handle. A position skips the
+	/// transform lookup of the emitter. Returns the emissions queued.
+	/// Handles must come from components in the default world.
+	/// </summary>
+	static uint32_t EmitBatch(const std::vector<std::weak_ptr<ParticleEngine::EmitterData>>& handles,
+		const std::vector<DirectX::SimpleMath::Vector3>& positions, const std::vector<int>& counts,
+		const std::vector<float>& delays);
+
+	/// <summary>
+	/// EmitBatch for handles from components in world
+	/// </summary>
+	static uint32_t EmitBatch(ParticleEngine::World& world, const std::vector<std::weak_ptr<ParticleEngine::EmitterData>>& handles,
+		const std::vector<DirectX::SimpleMath::Vector3>& positions, const std::vector<int>& counts,
+		const std::vector<float>& delays);
+
+	/// <summary>
+	/// SetEmitOnTimer for many components at once, main thread only
+	/// </summary>
+	static void SetEmitOnTimerBatch(const std::vector<ParticleEmitterComponent*>& components, bool emit);
+
+	/// <summary>
+	/// Returns the particle world this component emits into
+	/// </summary>
+	ParticleEngine::World& GetWorld() const;
+
+	/// <summary>
+	/// Moves the component to another particle world, such as an editor
+	/// preview. Its emitter is released and handles to it expire, the next
+	/// emission takes an emitter from the new world.
+	/// </summary>
+	void SetWorld(ParticleEngine::World& world);
+
 	/// <summary>
 	/// Returns the timer used to determine emission rate
 	/// </summary>
@@ -98,9 +170,11 @@ public:
 	//set these directly WILL result in bugs and possibly crashes
 	const std::string& GetParticleTexture() const;
 	void SetParticleTexture(const std::string& name);
+	void SetParticleTexture(ParticleEngine::TextureHandle handle);
 
 	const std::string& GetShapeTexture()const;
 	void SetShapeTexture(const std::string& name);
+	void SetShapeTexture(ParticleEngine::TextureHandle handle);
 
 	int GetOwnedParticles() const { return ownedParticles_; }
 	void SetOwnedParticles(int amount);
@@ -108,6 +182,19 @@ public:
 	const std::vector<ParticleEngine::ColorGradientCPU> & GetColors() const { return ColorGradient_; }
 	void SetColors(const std::vector<ParticleEngine::ColorGradientCPU>& colors);
 
+	/// <summary>
+	/// Converts the reflected settings of this component into a preset record
+	/// </summary>
+	void ExportPreset(ParticleEngine::PresetWriter& writer) const;
+
+	/// <summary>
+	/// Loads a batch of components from a preset file. Component i uses record
+	/// first + i, texture names are interned once for the whole batch and each
+	/// emitter is created at most once, on its first emission.
+	/// </summary>
+	static void LoadPresets(const ParticleEngine::PresetFile& file,
+		ParticleEmitterComponent* const* components, uint32_t count, uint32_t first = 0);
+
 
 
 private:
@@ -118,18 +205,34 @@ private:
 
 	TransformComponent* transform_;
 
+	//World the emitter lives in, nullptr is the default world of the engine
+	ParticleEngine::World* world_;
+
 	//This share pointer is the owner
-	//if it goes out of scope the emitter is destroyed
+	//if it goes out of scope the emitter goes back to the emitter pool.
+	//It is created on the first emission so components that never emit cost nothing.
 	std::shared_ptr<ParticleEngine::EmitterData> emitter_;
 
+	//Idle Emitters
+	float reclaimAfter_; //Seconds every particle has to be dead before the emitter is reclaimed, zero never reclaims
+	float idleTime_;	 //Seconds since the last particle died, negative while particles may be alive
+	uint32_t snapshotId_; //Saved with the scene, snapshot restores find this emitter by it
+	bool  pinned_;		 //Handles or parent emitters point at the emitter so it is never reclaimed
+
+	//Live Editing, edits wait for LateUpdate so a frame of changes is sent once
+	bool settingsDirty_; //Settings changed since they were last copied into the settings table
+	bool colorsDirty_;	 //Color ramp changed since it was last sent to the emitter
+
 	//The position of the emitter reltive to the game object its attqached to.
 	Vector3 emitterPositionOffset_;
 
 	//Standard Texture assigned to a particle on draw
 	std::string pTexture_;
+	ParticleEngine::TextureHandle pTextureHandle_;
 
 	//Particle Emitter Shape
 	std::string emitterShape_; // a texture with alpha
+	ParticleEngine::TextureHandle emitterShapeHandle_;
 	Vector2		emitterScale_; // Scale of the emitter
 
 	//Emmission behavior 
@@ -146,6 +249,7 @@ private:
 	Vector2 scale_;	   // [0]min [1]max
 
 	bool	useDirectionForRotation_; //determains if you want to use the direction of movement as 0
+	bool	sortByDepth_;			  //sorts particles back to front for alpha blending
 	Vector2 particleImageRotation_;  // [0]min [1]max degrees
 
 	//Physics
@@ -155,9 +259,75 @@ private:
 	Vector2 speed_;    // [0]min	[1]max
 	Vector2 friction_; // [0]min	[1]max
 	Vector2 accel_;    // [0]X direction [1] y direction 
+
+	float neighborCellSize_; //Cell size of the neighbor grid, zero disables it
+	float neighborSeparation_; //How hard particles push apart within a cell, zero disables the grid
+
+	//Particle Budget
+	int	  budgetCategory_;	  //Category of the particle budget this emitter spends from
+	float budgetPriority_;	  //Higher priorities keep spawning when the budget is tight
+	float budgetFalloff_;	  //Distance to the viewer where the priority halves, zero never falls off
+	int	  deferredFrames_;	  //Frames the oldest deferred emission has waited
+	std::vector<ParticleEngine::EmissionRequest> deferredRequests_; //Emissions the budget deferred, asked for again next frame
+
+	bool inPlaceUpdate_; //Simulates in one particle buffer, halves the memory of the emitter
+
+	//Requests from the emission queue that are still waiting on their delay
+	std::vector<ParticleEngine::EmissionRequest> delayedRequests_;
+
+	//Attached Emitters
+	float	 followTransform_; //How much alive particles follow the game object, 0 world space 1 local space
+	uint32_t transformSlot_;   //Slot in the transform table while following
+
+	//Collision
+	int	  collisionResponse_;	 //ParticleEngine::CollisionResponse against the baked level colliders
+	float collisionRestitution_; //Fraction of the velocity into the surface kept on a bounce
+	float collisionFriction_;	 //Fraction of the velocity along the surface lost per contact
+	float collisionRadius_;		 //Distance particles are kept from the surface
+
+	//Sub Emitters
+	float inheritVelocity_; //Amount of the parent velocity kept when this emitter is a sub emitter
+	std::vector<ParticleEngine::SubEmitterLink> subEmitters_; //Children spawned by this emitter
 	
 	std::vector<ParticleEngine::ColorGradientCPU> ColorGradient_;
 
+	//Copies a preset record into this component and creates the emitter
+	void ApplyPreset(const ParticleEngine::PresetFile& file, const ParticleEngine::PresetEmitter& preset,
+		ParticleEngine::TextureHandle particleTexture, ParticleEngine::TextureHandle shapeTexture);
+
+	//Copies settings the behavior stage reads into the emitter settings table
+	void UpdateEmitterSettings();
+
+	//Sends the color ramp to the emitter and its settings
+	void PushColors();
+
+	//Takes an emitter from the emitter pool if this component does not have one
+	void EnsureEmitter();
+
+	//Hands the emitter back to the emitter pool, the next emission takes a new one
+	void ReleaseEmitter();
+
+	//Writes this frames transform for emitters that follow their game object
+	void UpdateFollowTransform(ParticleEngine::EmitterSettings& settings);
+
+	//Asks the particle budget for the particles of an emission and spawns what it grants.
+	//A negative count emits the emission amount, overrides only apply to this emission.
+	void Emit(const ParticleEngine::EmissionRequest& emission);
+
+	//Emits a request drained from the emission queue, main thread only
+	void EmitRequest(const ParticleEngine::EmissionRequest& request);
+
+	//Moves the emitter to the game object and returns the emission direction
+	//A world position replaces the position of the game object, a direction replaces the settings
+	Vector2 PrepareEmission(const Vector3* worldPosition = nullptr, const Vector2* directionOverride = nullptr);
+
+	//Spawns particles with the current settings and the given motion, age fast forwards them for prewarms
+	void Spawn(int amount, const Vector2& direction, const Vector2& speed, const Vector2& lifetime, float age = 0.f);
+
+	//Resolves texture names that have not been interned yet
+	//and pushes the handles to the current emitter
+	void ApplyTextures();
+
 #ifdef _DEBUG	
 	/// <summary>
 	/// A helper functions for imgui menu
@@ -168,6 +338,9 @@ private:
 	bool MotionOnSpawnMenu();
 	bool VisualsOverTimeMenu();
 
+	//Edits the limits of the world budget, not saved with the component
+	void BudgetLimitsMenu();
+
 	//For Imgui Color Editor
 	ImGradient* gradient_;
 	ImGradientMark* draggingMark_ = nullptr;
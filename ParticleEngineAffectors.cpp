@@ -0,0 +1,201 @@
+/*******************************************************************************
+
+	@file       ParticleEngineAffectors.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      World placed force fields that bend particle motion. Every
+				affector lives in one structured buffer and each emitter only
+				gets the indices of the affectors that reach its bounds, so a
+				particle evaluates a handful of fields instead of all of them.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineAffectors.h"	//This files header
+#include "ParticleEngineShaders.h"		//Structured buffer helpers
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+
+namespace ParticleEngine
+{
+AffectorManager::AffectorManager(ID3D11Device* device) noexcept :
+	device_(device)
+{
+}
+
+AffectorManager::~AffectorManager() noexcept
+{
+	RELEASE(bAffectors_);
+	RELEASE(rvAffectors_);
+	RELEASE(bIndices_);
+	RELEASE(rvIndices_);
+}
+
+UINT AffectorManager::Add(const Affector& affector)
+{
+	UINT id;
+	if (!freeSlots_.empty())
+	{
+		id = freeSlots_.back();
+		freeSlots_.pop_back();
+		affectors_[id] = affector;
+		inUse_[id] = true;
+	}
+	else
+	{
+		id = static_cast<UINT>(affectors_.size());
+		affectors_.push_back(affector);
+		inUse_.push_back(true);
+	}
+
+	dirty_ = true;
+	return id;
+}
+
+void AffectorManager::Set(UINT id, const Affector& affector)
+{
+	if (id >= affectors_.size() || !inUse_[id])
+		return;
+
+	affectors_[id] = affector;
+	dirty_ = true;
+}
+
+void AffectorManager::Remove(UINT id)
+{
+	if (id >= affectors_.size() || !inUse_[id])
+		return;
+
+	inUse_[id] = false;
+	freeSlots_.push_back(id);
+}
+
+const Affector* AffectorManager::Get(UINT id) const
+{
+	if (id >= affectors_.size() || !inUse_[id])
+		return nullptr;
+
+	return &affectors_[id];
+}
+
+void AffectorManager::BeginFrame()
+{
+	indices_.clear();
+}
+
+bool AffectorManager::Overlaps(const Affector& affector, const float center[3], float radius)
+{
+	if (affector.radius <= 0.f)
+		return true;
+
+	float dx = affector.position[0] - center[0];
+	float dy = affector.position[1] - center[1];
+	float dz = affector.position[2] - center[2];
+	float reach = affector.radius + radius;
+
+	return dx * dx + dy * dy + dz * dz < reach * reach;
+}
+
+AffectorRange AffectorManager::Cull(const float center[3], float radius)
+{
+	AffectorRange range;
+	range.first = static_cast<UINT>(indices_.size());
+
+	for (UINT i = 0; i < affectors_.size() && range.count < MaxAffectorsPerEmitter; ++i)
+	{
+		if (inUse_[i] && Overlaps(affectors_[i], center, radius))
+		{
+			indices_.push_back(i);
+			range.count++;
+		}
+	}
+
+	return range;
+}
+
+void AffectorManager::Gather(AffectorRange range, std::vector<Affector>& out) const
+{
+	for (UINT i = 0; i < range.count; ++i)
+		out.push_back(affectors_[indices_[range.first + i]]);
+}
+
+void AffectorManager::Upload(ID3D11DeviceContext* deviceContext)
+{
+	UINT affectorCount = static_cast<UINT>(affectors_.size());
+	UINT indexCount = static_cast<UINT>(indices_.size());
+
+	if (indexCount == 0)
+		return;
+
+	try
+	{
+		//Buffers grow by doubling and are rewritten in place
+		if (affectorCapacity_ < affectorCount)
+		{
+			RELEASE(bAffectors_);
+			RELEASE(rvAffectors_);
+
+			UINT capacity = affectorCapacity_ ? affectorCapacity_ : 16;
+			while (capacity < affectorCount)
+				capacity *= 2;
+
+			CreateStructuredBuffer(device_, sizeof(Affector), capacity, nullptr, &bAffectors_, &rvAffectors_, nullptr);
+			affectorCapacity_ = capacity;
+			dirty_ = true;
+		}
+
+		if (indexCapacity_ < indexCount)
+		{
+			RELEASE(bIndices_);
+			RELEASE(rvIndices_);
+
+			UINT capacity = indexCapacity_ ? indexCapacity_ : 64;
+			while (capacity < indexCount)
+				capacity *= 2;
+
+			CreateStructuredBuffer(device_, sizeof(UINT), capacity, nullptr, &bIndices_, &rvIndices_, nullptr);
+			indexCapacity_ = capacity;
+		}
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle affectors failed to create their buffers");
+		RELEASE(bAffectors_);
+		RELEASE(rvAffectors_);
+		RELEASE(bIndices_);
+		RELEASE(rvIndices_);
+		affectorCapacity_ = 0;
+		indexCapacity_ = 0;
+		indices_.clear();
+		return;
+	}
+
+	D3D11_BOX box = { 0, 0, 0, 0, 1, 1 };
+
+	//Affectors only change when gameplay moves them
+	if (dirty_)
+	{
+		box.right = affectorCount * sizeof(Affector);
+		deviceContext->UpdateSubresource(bAffectors_, 0, &box, affectors_.data(), 0, 0);
+		dirty_ = false;
+	}
+
+	box.right = indexCount * sizeof(UINT);
+	deviceContext->UpdateSubresource(bIndices_, 0, &box, indices_.data(), 0, 0);
+}
+
+void AffectorManager::Bind(ID3D11DeviceContext* deviceContext) const
+{
+	ID3D11ShaderResourceView* rvIN[2] = { rvAffectors_, rvIndices_ };
+	deviceContext->CSSetShaderResources(28, 2, rvIN);
+}
+
+void AffectorManager::Unbind(ID3D11DeviceContext* deviceContext)
+{
+	ID3D11ShaderResourceView* rvNULL[2] = { nullptr, nullptr };
+	deviceContext->CSSetShaderResources(28, 2, rvNULL);
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,119 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineAffectors.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      World placed force fields that bend particle motion. Every
+				affector lives in one structured buffer and each emitter only
+				gets the indices of the affectors that reach its bounds, so a
+				particle evaluates a handful of fields instead of all of them.
+
+*******************************************************************************/
+#include <d3d11.h>					//DirectX header
+#include <vector>					//Affector storage
+#include "ParticleEngineKernels.h"	//Affector
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Slice of the culled index list that belongs to one emitter
+	/// </summary>
+	struct AffectorRange
+	{
+		UINT first = 0;
+		UINT count = 0;
+	};
+
+	class AffectorManager
+	{
+
+	public:
+
+		//Most affectors a single emitter evaluates, extra ones are dropped
+		static constexpr UINT MaxAffectorsPerEmitter = 16;
+
+		//Constructors
+		AffectorManager(ID3D11Device* device) noexcept;
+		~AffectorManager() noexcept;
+		AffectorManager(const AffectorManager&) = delete;
+		AffectorManager& operator=(const AffectorManager&) = delete;
+
+		/// <summary>
+		/// Adds an affector and returns its id
+		/// </summary>
+		UINT Add(const Affector& affector);
+
+		/// <summary>
+		/// Replaces an affector, used to move or retune it
+		/// </summary>
+		void Set(UINT id, const Affector& affector);
+
+		/// <summary>
+		/// Removes an affector, its id can be handed out again
+		/// </summary>
+		void Remove(UINT id);
+
+		/// <summary>
+		/// Returns an affector or nullptr if the id is not in use
+		/// </summary>
+		const Affector* Get(UINT id) const;
+
+		/// <summary>
+		/// Call once per frame before culling, forgets last frames ranges
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		/// Collects the affectors that overlap a sphere around an emitter.
+		/// Global affectors always overlap.
+		/// </summary>
+		AffectorRange Cull(const float center[3], float radius);
+
+		/// <summary>
+		/// Appends the affectors of a culled range to out, used by the CPU path
+		/// </summary>
+		void Gather(AffectorRange range, std::vector<Affector>& out) const;
+
+		/// <summary>
+		/// Uploads changed affectors and this frames culled indices.
+		/// Call after culling every emitter and before dispatching.
+		/// </summary>
+		void Upload(ID3D11DeviceContext* deviceContext);
+
+		/// <summary>
+		/// Binds the affectors to t28 and the culled indices to t29
+		/// </summary>
+		void Bind(ID3D11DeviceContext* deviceContext) const;
+
+		/// <summary>
+		/// Unbinds what Bind set
+		/// </summary>
+		static void Unbind(ID3D11DeviceContext* deviceContext);
+
+	private:
+
+		ID3D11Device* device_;
+
+		std::vector<Affector> affectors_; //Slots, removed ones are never culled
+		std::vector<bool>	  inUse_;
+		std::vector<UINT>	  freeSlots_;
+		std::vector<UINT>	  indices_;	  //This frames culled indices for every emitter
+		bool dirty_ = false;
+
+		ID3D11Buffer*			  bAffectors_ = nullptr;
+		ID3D11ShaderResourceView* rvAffectors_ = nullptr;
+		UINT affectorCapacity_ = 0;
+
+		ID3D11Buffer*			  bIndices_ = nullptr;
+		ID3D11ShaderResourceView* rvIndices_ = nullptr;
+		UINT indexCapacity_ = 0;
+
+		//Returns true if an affector reaches a sphere
+		static bool Overlaps(const Affector& affector, const float center[3], float radius);
+	};
+
+}
@@ -0,0 +1,157 @@
+/*******************************************************************************
+
+	@file       ParticleEngineAtlas.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Packs particle textures into the pages of one texture array the
+				first time an emitter uses them. Emitters then only differ by
+				a page and a uv transform, so a renderer can draw every
+				emitter that shares a blend mode with one texture binding.
+
+*******************************************************************************/
+#include "stdafx.h"					//Header included in all files.
+#include "ParticleEngineAtlas.h"	//This files header
+#include "Bindable.h"				//Part of our graphics engine
+#include "Graphics.h"				//Part of our graphics engine
+#include "Texture.h"				//Class Definition for The Texture Object
+#include "ParticleEngineShaders.h"	//RELEASE
+
+namespace ParticleEngine
+{
+TextureAtlas::TextureAtlas(ID3D11Device* device, TextureRegistry& textures) noexcept :
+	device_(device), textures_(textures), packer_(PageSize, PageSize, 1, MaxPages)
+{
+}
+
+TextureAtlas::~TextureAtlas() noexcept
+{
+	RELEASE(tPages_);
+	RELEASE(rvPages_);
+}
+
+bool TextureAtlas::ReservePages(ID3D11DeviceContext* deviceContext, UINT pages)
+{
+	if (pageCapacity_ >= pages)
+		return true;
+
+	UINT capacity = pageCapacity_ ? pageCapacity_ : 1;
+	while (capacity < pages)
+		capacity *= 2;
+	capacity = capacity < MaxPages ? capacity : MaxPages;
+
+	ID3D11Texture2D* tPages = nullptr;
+	ID3D11ShaderResourceView* rvPages = nullptr;
+
+	try
+	{
+		HRESULT hr = S_OK;
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = PageSize;
+		desc.Height = PageSize;
+		desc.MipLevels = 1;
+		desc.ArraySize = capacity;
+		desc.Format = PageFormat;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		INFO_SET device_->CreateTexture2D(&desc, nullptr, &tPages);
+		DX_EXCEPT(hr);
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+		viewDesc.Format = PageFormat;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		viewDesc.Texture2DArray.MipLevels = 1;
+		viewDesc.Texture2DArray.ArraySize = capacity;
+
+		INFO_SET device_->CreateShaderResourceView(tPages, &viewDesc, &rvPages);
+		DX_EXCEPT(hr);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle texture atlas failed to create its pages");
+		RELEASE(tPages);
+		RELEASE(rvPages);
+		return false;
+	}
+
+	//Pages already packed move over slice by slice
+	for (UINT page = 0; page < pageCapacity_; ++page)
+		deviceContext->CopySubresourceRegion(tPages, D3D11CalcSubresource(0, page, 1), 0, 0, 0,
+			tPages_, D3D11CalcSubresource(0, page, 1), nullptr);
+
+	RELEASE(tPages_);
+	RELEASE(rvPages_);
+	tPages_ = tPages;
+	rvPages_ = rvPages;
+	pageCapacity_ = capacity;
+
+	return true;
+}
+
+UINT TextureAtlas::Acquire(ID3D11DeviceContext* deviceContext, TextureHandle texture)
+{
+	auto found = lookup_.find(texture.id);
+	if (found != lookup_.end())
+		return found->second;
+
+	Texture* source = textures_.Resolve(texture);
+	if (!source)
+		return NoSlot;
+
+	//Textures bind their view to slot 0, borrow it to reach the resource
+	source->SetWithStage(Bindable::Stage::ComputeShader);
+
+	ID3D11ShaderResourceView* rvSource = nullptr;
+	deviceContext->CSGetShaderResources(0, 1, &rvSource);
+
+	ID3D11ShaderResourceView* rvNULL[1] = { nullptr };
+	deviceContext->CSSetShaderResources(0, 1, rvNULL);
+
+	ID3D11Resource* resource = nullptr;
+	ID3D11Texture2D* tSource = nullptr;
+	if (rvSource)
+	{
+		rvSource->GetResource(&resource);
+		resource->QueryInterface(__uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&tSource));
+	}
+
+	RELEASE(resource);
+	RELEASE(rvSource);
+
+	UINT slot = NoSlot;
+	D3D11_TEXTURE2D_DESC desc = {};
+	if (tSource)
+		tSource->GetDesc(&desc);
+
+	//Only textures a plain copy can move are packed
+	AtlasRect rect;
+	if (tSource && desc.Format == PageFormat && desc.SampleDesc.Count == 1
+		&& packer_.Insert(desc.Width, desc.Height, rect)
+		&& ReservePages(deviceContext, rect.page + 1))
+	{
+		deviceContext->CopySubresourceRegion(tPages_, D3D11CalcSubresource(0, rect.page, 1), rect.x, rect.y, 0,
+			tSource, 0, nullptr);
+
+		AtlasSlot atlasSlot;
+		atlasSlot.page = rect.page;
+		atlasSlot.uv = DirectX::XMFLOAT4(
+			float(rect.x) / PageSize, float(rect.y) / PageSize,
+			float(rect.width) / PageSize, float(rect.height) / PageSize);
+
+		slot = static_cast<UINT>(slots_.size());
+		slots_.push_back(atlasSlot);
+	}
+
+	RELEASE(tSource);
+
+	//Misses are remembered so a texture is only tried once
+	lookup_.emplace(texture.id, slot);
+	return slot;
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,83 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineAtlas.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Packs particle textures into the pages of one texture array the
+				first time an emitter uses them. Emitters then only differ by
+				a page and a uv transform, so a renderer can draw every
+				emitter that shares a blend mode with one texture binding.
+
+*******************************************************************************/
+#include <d3d11.h>							//DirectX header
+#include <DirectXMath.h>					//XMFLOAT4
+#include <vector>							//Slots
+#include <unordered_map>					//Handle to slot lookup
+#include "ParticleEngineAtlasPacker.h"		//Rectangle packer
+#include "ParticleEngineTextureHandle.h"	//Interned texture handles
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Where a texture lives in the atlas
+	/// </summary>
+	struct AtlasSlot
+	{
+		UINT page = 0;								//Slice of the page array
+		DirectX::XMFLOAT4 uv = { 0.f, 0.f, 1.f, 1.f }; //xy offset zw scale, uv' = uv * zw + xy
+	};
+
+	class TextureAtlas
+	{
+
+	public:
+
+		static constexpr UINT NoSlot = 0xFFFFFFFFu;
+		static constexpr UINT PageSize = 1024;
+		static constexpr UINT MaxPages = 16;
+		static constexpr DXGI_FORMAT PageFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+		//Constructors
+		TextureAtlas(ID3D11Device* device, TextureRegistry& textures) noexcept;
+		~TextureAtlas() noexcept;
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		/// <summary>
+		/// Returns the slot of a texture, packing it on first use. Returns
+		/// NoSlot if it can not be atlased, such as a texture in another
+		/// format or larger than a page, it is then drawn on its own.
+		/// </summary>
+		UINT Acquire(ID3D11DeviceContext* deviceContext, TextureHandle texture);
+
+		const AtlasSlot& GetSlot(UINT slot) const { return slots_[slot]; }
+
+		/// <summary>
+		/// Every page as one Texture2DArray
+		/// </summary>
+		ID3D11ShaderResourceView* GetPages() const { return rvPages_; }
+
+		const AtlasPacker::Stats& GetStats() const { return packer_.GetStats(); }
+
+	private:
+
+		ID3D11Device* device_;
+		TextureRegistry& textures_; //Resolves the handles packed into the atlas
+		AtlasPacker packer_;
+
+		ID3D11Texture2D*		  tPages_ = nullptr;
+		ID3D11ShaderResourceView* rvPages_ = nullptr;
+		UINT pageCapacity_ = 0;
+
+		std::vector<AtlasSlot> slots_;
+		std::unordered_map<uint32_t, UINT> lookup_; //Handle id to slot, failures map to NoSlot
+
+		//Makes room for at least pages slices, copying the ones already packed
+		bool ReservePages(ID3D11DeviceContext* deviceContext, UINT pages);
+	};
+
+}
@@ -0,0 +1,172 @@
+/*******************************************************************************
+
+	@file       ParticleEngineAtlasPacker.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Skyline rectangle packer used to place particle textures into
+				shared atlas pages. Opens a new page when a rectangle does not
+				fit and keeps occupancy statistics.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineAtlasPacker.h"	//This files header
+
+namespace ParticleEngine
+{
+
+AtlasPacker::AtlasPacker(uint32_t pageWidth, uint32_t pageHeight, uint32_t padding, uint32_t maxPages) :
+	pageWidth_(pageWidth), pageHeight_(pageHeight), padding_(padding), maxPages_(maxPages)
+{
+}
+
+void AtlasPacker::Reset()
+{
+	pages_.clear();
+	stats_ = Stats();
+}
+
+void AtlasPacker::OpenPage()
+{
+	pages_.push_back(Skyline{ Segment{ 0, 0, pageWidth_ } });
+
+	stats_.pages++;
+	stats_.pageArea += uint64_t(pageWidth_) * pageHeight_;
+}
+
+bool AtlasPacker::FindPosition(const Skyline& skyline, uint32_t width, uint32_t height,
+	size_t& segment, uint32_t& x, uint32_t& y) const
+{
+	bool found = false;
+	uint32_t bestY = 0;
+	uint32_t bestWidth = 0;
+
+	for (size_t i = 0; i < skyline.size(); ++i)
+	{
+		uint32_t left = skyline[i].x;
+		if (left + width > pageWidth_)
+			break;
+
+		//The rectangle rests on the highest segment it spans
+		uint32_t top = 0;
+		uint32_t covered = 0;
+		for (size_t j = i; covered < width; ++j)
+		{
+			top = skyline[j].y > top ? skyline[j].y : top;
+			covered += skyline[j].width;
+		}
+
+		if (top + height > pageHeight_)
+			continue;
+
+		//Lowest spot wins, ties go to the narrowest segment to leave wide runs open
+		if (!found || top < bestY || (top == bestY && skyline[i].width < bestWidth))
+		{
+			found = true;
+			bestY = top;
+			bestWidth = skyline[i].width;
+			segment = i;
+		}
+	}
+
+	if (found)
+	{
+		x = skyline[segment].x;
+		y = bestY;
+	}
+
+	return found;
+}
+
+void AtlasPacker::Place(Skyline& skyline, size_t segment, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	skyline.insert(skyline.begin() + segment, Segment{ x, y + height, width });
+
+	//Shrinks or removes the segments the new one covers
+	for (size_t i = segment + 1; i < skyline.size();)
+	{
+		Segment& next = skyline[i];
+		uint32_t end = x + width;
+
+		if (next.x >= end)
+			break;
+
+		uint32_t overlap = end - next.x;
+		if (overlap >= next.width)
+		{
+			skyline.erase(skyline.begin() + i);
+			continue;
+		}
+
+		next.x += overlap;
+		next.width -= overlap;
+		break;
+	}
+
+	//Merges neighbors at the same height
+	for (size_t i = 0; i + 1 < skyline.size();)
+	{
+		if (skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+bool AtlasPacker::Insert(uint32_t width, uint32_t height, AtlasRect& rect)
+{
+	uint32_t paddedWidth = width + padding_ * 2;
+	uint32_t paddedHeight = height + padding_ * 2;
+
+	if (width == 0 || height == 0 || paddedWidth > pageWidth_ || paddedHeight > pageHeight_)
+	{
+		stats_.rejected++;
+		return false;
+	}
+
+	size_t segment = 0;
+	uint32_t x = 0;
+	uint32_t y = 0;
+
+	uint32_t page = 0;
+	for (; page < pages_.size(); ++page)
+	{
+		if (FindPosition(pages_[page], paddedWidth, paddedHeight, segment, x, y))
+			break;
+	}
+
+	if (page == pages_.size())
+	{
+		if (maxPages_ != 0 && pages_.size() >= maxPages_)
+		{
+			stats_.rejected++;
+			return false;
+		}
+
+		OpenPage();
+		FindPosition(pages_[page], paddedWidth, paddedHeight, segment, x, y);
+	}
+
+	Place(pages_[page], segment, x, y, paddedWidth, paddedHeight);
+
+	rect.page = page;
+	rect.x = x + padding_;
+	rect.y = y + padding_;
+	rect.width = width;
+	rect.height = height;
+
+	stats_.rects++;
+	stats_.usedArea += uint64_t(paddedWidth) * paddedHeight;
+	stats_.occupancy = float(double(stats_.usedArea) / double(stats_.pageArea));
+
+	return true;
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,105 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineAtlasPacker.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Skyline rectangle packer used to place particle textures into
+				shared atlas pages. Opens a new page when a rectangle does not
+				fit and keeps occupancy statistics.
+
+				This header only depends on the standard library so it can be
+				used by tools that run without a graphics device.
+
+*******************************************************************************/
+#include <cstdint>	//Fixed width integers
+#include <cstddef>	//size_t
+#include <vector>	//Skylines of every page
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Where a rectangle was placed, in texels of its page
+	/// </summary>
+	struct AtlasRect
+	{
+		uint32_t page = 0;
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	class AtlasPacker
+	{
+
+	public:
+
+		/// <summary>
+		/// How full the atlas is
+		/// </summary>
+		struct Stats
+		{
+			uint32_t pages = 0;
+			uint32_t rects = 0;
+			uint32_t rejected = 0;	  //Rectangles larger than a page or past the page limit
+			uint64_t usedArea = 0;	  //Texels covered by rectangles, padding included
+			uint64_t pageArea = 0;	  //Texels of every open page
+			float	 occupancy = 0.f; //usedArea / pageArea
+		};
+
+		/// <summary>
+		/// padding texels are kept around every rectangle so filtering does
+		/// not bleed between neighbors. maxPages zero is unlimited.
+		/// </summary>
+		AtlasPacker(uint32_t pageWidth, uint32_t pageHeight, uint32_t padding = 1, uint32_t maxPages = 0);
+
+		/// <summary>
+		/// Places a rectangle on the first page with room, opening a page if
+		/// needed. Returns false if it can never fit.
+		/// </summary>
+		bool Insert(uint32_t width, uint32_t height, AtlasRect& rect);
+
+		/// <summary>
+		/// Forgets every rectangle and page
+		/// </summary>
+		void Reset();
+
+		const Stats& GetStats() const { return stats_; }
+		uint32_t PageWidth() const { return pageWidth_; }
+		uint32_t PageHeight() const { return pageHeight_; }
+
+	private:
+
+		//A horizontal run of the top edge of the packed area
+		struct Segment
+		{
+			uint32_t x;
+			uint32_t y;
+			uint32_t width;
+		};
+
+		typedef std::vector<Segment> Skyline;
+
+		uint32_t pageWidth_;
+		uint32_t pageHeight_;
+		uint32_t padding_;
+		uint32_t maxPages_;
+
+		std::vector<Skyline> pages_;
+		Stats stats_;
+
+		//Finds the lowest spot for a rectangle, returns false if the page has none
+		bool FindPosition(const Skyline& skyline, uint32_t width, uint32_t height,
+			size_t& segment, uint32_t& x, uint32_t& y) const;
+
+		//Raises the skyline over a placed rectangle
+		static void Place(Skyline& skyline, size_t segment, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+		void OpenPage();
+	};
+
+}
@@ -19,16 +19,19 @@
 #include "Clock.h"					//Contains Delta Time
 #include "Camera.h"					//To fetch Camera Location
 #include "ResourceManager.h"		//Used to store resources. Textures, Meshs, Samplers
-#include "Window.h"					//Contains a class that stores window Information
 #include "Texture.h"				//Class Definition for The Texture Object
 #include "Sampler.h"				//Class Definition for Sampler
+#include "ParticleEngineShaders.h"	//Compute shader loading helpers
+#include "ParticleEngineBudget.h"	//Frame level particle budget
+#include "ParticleEngineEmissionQueue.h"	//Emissions pushed from any thread
+#include "ParticleEngineWorld.h"			//Tables of the world this behavior updates
+#include <chrono>					//Measures the cost of each route
+#include <algorithm>				//std::stable_sort
+#include <cassert>					//Graphics of the default world
 
 
 namespace ParticleEngine
 {
-//Allows easier relase of Direct X Buffers
-#define RELEASE(ptr){ if (ptr) { (ptr)->Release(); ptr = nullptr; } }
-
 //Shortes the length of some lines
 using XMFLOAT4 = DirectX::XMFLOAT4;
 using XMFLOAT2 = DirectX::XMFLOAT2;
@@ -52,6 +55,15 @@ struct cbEmitterParams
 	XMFLOAT4 position;  //Emitter position xyzw
 	XMFLOAT2 scale;	    //[0] x scale of the emitter [1] y scale of the emitter
 	XMFLOAT2 colorData; //[0] # of colors [1]nothing
+	UINT affectors[2];	//[0] first index into AffectorIndices [1] # of affectors
+	UINT subEmit;		//Sub emitter triggers
+	UINT transform;		//Slot in the transform table plus one, zero does not follow
+	UINT atlasPage;		//Atlas page copied into instances
+	float separation;	//Neighbor push strength, radius is the grid cell size
+	UINT directionRotation; //Instances rotate with the velocity
+	UINT pad;
+	XMFLOAT4 collisionField; //[0,1] field origin [2] 1 / cell size [3] cell size
+	XMFLOAT4 collision;		 //[0] response, zero does not collide [1] restitution [2] friction [3] radius
 };
 
 /// <summary>
@@ -71,33 +83,174 @@ struct DispatchInput
 	ID3D11Buffer* bParticleData_OUT_ = nullptr;
 };
 
-Behavior::Behavior(Graphics& gfx) noexcept :
-	gfx(gfx), resourceManager_(gfx.market)
+//Number of particles a pool holds
+static UINT PoolCapacity(ID3D11Buffer* buffer)
+{
+	D3D11_BUFFER_DESC desc;
+	buffer->GetDesc(&desc);
+	return desc.StructureByteStride ? desc.ByteWidth / desc.StructureByteStride : 0;
+}
+
+//Returns the triggers of every child of an emitter
+static UINT SubEmitTriggers(const EmitterSettings* settings)
+{
+	UINT triggers = 0;
+	if (settings)
+	{
+		for (const SubEmitterLink& link : settings->subEmitters)
+			triggers |= link.trigger;
+	}
+	return triggers;
+}
+
+//Records an emitter can append in one frame, one per particle and trigger
+static UINT RecordCapacity(EmitterData* emitter, UINT triggers)
+{
+	UINT triggerCount = ((triggers & SubEmit_Death) ? 1 : 0) + ((triggers & SubEmit_Birth) ? 1 : 0);
+	return PoolCapacity(emitter->bParticleData_IN_) * triggerCount;
+}
+
+//Copies the buffers of an emitter into a dispatch
+static void FillDispatchInput(DispatchInput& input, const EmitterData& emitter)
+{
+	input.aliveParticles_ = emitter.aliveParticles_;
+	input.rvParticleData_IN_ = emitter.rvParticleData_IN_;
+	input.rvParticleData_OUT_ = emitter.rvParticleData_OUT_;
+	input.uavParticleData_OUT_ = emitter.uavParticleData_OUT_;
+	input.uavParticleData_IN_ = emitter.uavParticleData_IN_;
+	input.bParticleData_OUT_ = emitter.bParticleData_OUT_;
+	input.bParticleData_IN_ = emitter.bParticleData_IN_;
+}
+
+Behavior::Behavior(World& world) noexcept :
+	world_(world), gfx(world.Gfx()), resourceManager_(world.Gfx().market)
 {
 	ID3D11Device* device = gfx.GetDevice();
 
-	//Adds the needed compute shaderst to operate this calss
-	AddComputeShaders(device);
+	//Every variant is created up front so no shader is compiled mid frame
+	LoadComputeShaders(device);
 
 	sampler_ = resourceManager_.FindResource<Sampler>("Sampler");
 
 	CreateBuffers(device);
+
+	depthSorter_ = std::make_unique<DepthSorter>(device);
+	gridPass_ = std::make_unique<GridPass>(device);
+	affectors_ = std::make_unique<AffectorManager>(device);
+	snapshots_ = std::make_unique<SnapshotCapture>(device);
+	subEmitterPass_ = std::make_unique<SubEmitterPass>(device);
+	spawnPass_ = std::make_unique<SpawnPass>(device);
+	atlas_ = std::make_unique<TextureAtlas>(device, world.GetTextures());
+	instances_ = std::make_unique<InstancePass>(device);
+	cpuPass_ = std::make_unique<CPUPass>(device, world.GetWorkers());
+	compactPass_ = std::make_unique<CompactPass>(device);
+}
+
+Behavior::Behavior(Graphics& gfx) noexcept :
+	Behavior(World::Default())
+{
+	//The default world draws with the graphics of the window, other graphics need their own world
+	assert(&gfx == &World::Default().Gfx());
+
+	//The engine owns this one, the default world updates through it
+	world_.Adopt(*this);
 }
 
 Behavior::~Behavior() noexcept
 {
+	world_.Release(*this);
+
 	RELEASE(cbGParameters_);
 	RELEASE(cbEmitterParameters_);
-	RELEASE(csParticleShader_);
+	RELEASE(bTransforms_);
+	RELEASE(rvTransforms_);
+	RELEASE(tCollision_);
+	RELEASE(rvCollision_);
+	for (auto& shader : csParticleShaders_)
+		RELEASE(shader);
+}
+
+void Behavior::Update(EmitterManager&)
+{
+	//The world is the clock components read, so it is stepped instead of this
+	world_.Update(Clock::DeltaTime());
 }
 
-void Behavior::Update(EmitterManager& emitterManager)
+void Behavior::Update(EmitterManager& emitterManager, float deltaTime)
 {
-	ID3D11DeviceContext* deviceContext = Window::Instance().Gfx().GetContext();
+	ID3D11DeviceContext* deviceContext = gfx.GetContext();
 
 	totalAliveParticles_ = 0;
 	DispatchInput input;
 
+	//Particles sort against the camera the world was given this frame
+	const float* cameraPosition = world_.CameraPosition();
+	const float* cameraForward = world_.CameraForward();
+	depthSorter_->SetCamera(XMFLOAT4(cameraPosition[0], cameraPosition[1], cameraPosition[2], 1.f),
+		XMFLOAT4(cameraForward[0], cameraForward[1], cameraForward[2], 0.f));
+
+	//Emission priorities fall off with distance to the same camera
+	world_.GetBudget().SetViewer(cameraPosition);
+
+	depthSorter_->BeginFrame();
+	gridPass_->BeginFrame();
+	snapshots_->Poll(deviceContext);
+	subEmitterPass_->BeginFrame();
+	instances_->BeginFrame();
+	compactPass_->BeginFrame();
+	auto& settingsTable = world_.GetSettings();
+
+	if (workload_.IsOpen())
+		workload_.BeginFrame(deltaTime);
+
+	//Storage reclaimed from idle components is emptied before it can be handed out again
+	world_.GetPool().Recycle([this](EmitterData& emitter, uint32_t& capacity)
+	{
+		cpuPass_->Release(&emitter);
+		ForgetPoolState(&emitter);
+		emitter.aliveParticles_ = 0;
+		capacity = PoolCapacity(emitter.bParticleData_IN_);
+		return emitter.bParticleData_OUT_ == emitter.bParticleData_IN_;
+	});
+
+	//Emissions pushed from any thread since the last frame spawn before this update
+	EmissionQueue& emissionQueue = world_.GetEmissionQueue();
+	emissionQueue.Drain([&settingsTable](const EmissionRequest& request)
+	{
+		auto emitter = request.emitter.lock();
+		const EmitterSettings* settings = emitter ? settingsTable.Find(emitter.get()) : nullptr;
+		if (settings && settings->queuedEmit)
+			settings->queuedEmit(request);
+	});
+
+	if (uint32_t dropped = emissionQueue.TakeDropped())
+		LOG_INFO("ParticleEngine", "Emission queue was full, dropped " + std::to_string(dropped) + " requests")
+
+	//Every emitters affectors go up in one upload before the dispatches
+	CullAffectors(emitterManager);
+	affectors_->Upload(deviceContext);
+	affectors_->Bind(deviceContext);
+	UploadTransforms(deviceContext);
+	deviceContext->CSSetShaderResources(31, 1, &rvCollision_);
+
+	//Children are spawned into on the GPU so they stay there
+	router_.BeginFrame();
+	cpuReadbacks_ = 0;
+	subEmitterChildren_.clear();
+	for (auto& emitterPtr : emitterManager.GetEmitters())
+	{
+		auto emitter = emitterPtr.lock();
+		const EmitterSettings* settings = emitter ? settingsTable.Find(emitter.get()) : nullptr;
+		if (!settings)
+			continue;
+
+		for (const SubEmitterLink& link : settings->subEmitters)
+			subEmitterChildren_.insert(link.child.lock().get());
+	}
+
+	//Live particles per budget category after this update
+	UINT liveByCategory[ParticleBudget::MaxCategories] = {};
+
 	auto& manager = emitterManager.GetEmitters();
 	auto emitterPtr = manager.begin();
 
@@ -113,33 +266,716 @@ void Behavior::Update(EmitterManager& emitterManager)
 		{
 			auto& emitter = *emitterPtr->lock().get();
 
+			const EmitterSettings* inPlaceSettings = settingsTable.Find(&emitter);
+
+			//Capacity edits grow or shrink the pool and keep the live particles,
+			//in place emitters that were turned off get their second buffer back
+			if (inPlaceSettings && ((inPlaceSettings->capacity != 0 && inPlaceSettings->capacity != PoolCapacity(emitter.bParticleData_IN_))
+				|| (!inPlaceSettings->inPlaceUpdate && emitter.bParticleData_OUT_ == emitter.bParticleData_IN_)))
+				ResizeEmitter(deviceContext, emitter, settingsTable.Get(&emitter));
+
+			//In place emitters drop their second buffer before it is bound,
+			//only if they can be compacted without it
+			if (inPlaceSettings && inPlaceSettings->inPlaceUpdate && compactPass_->IsReady())
+				UseSingleBuffer(emitter);
+
+			//Textures are packed into the atlas the first time an emitter draws them
+			if (inPlaceSettings && inPlaceSettings->atlasTexture != inPlaceSettings->particleTexture)
+			{
+				EmitterSettings& atlasSettings = settingsTable.Get(&emitter);
+				atlasSettings.atlasTexture = atlasSettings.particleTexture;
+				atlasSettings.atlasSlot = atlasSettings.particleTexture.IsValid()
+					? atlas_->Acquire(deviceContext, atlasSettings.particleTexture) : TextureAtlas::NoSlot;
+			}
+
+			if (workload_.IsOpen())
+				TrackWorkload(emitter, inPlaceSettings);
+
+			//Fast forwards emitters that asked for it before their normal update
+			if (inPlaceSettings && !inPlaceSettings->prewarmSteps.empty())
+				RunPrewarm(deviceContext, emitter, settingsTable.Get(&emitter));
+
+			//Small emitters are simulated together on worker threads after the dispatches
+			if (RouteEmitter(deviceContext, *emitterPtr, emitter, inPlaceSettings))
+			{
+				QueueCPUUpdate(emitter, settingsTable.Get(&emitter), deltaTime);
+				emitterPtr++;
+				continue;
+			}
+
+			//Children drop the slots their parents reserved but did not claim
+			if (subEmitterChildren_.count(&emitter))
+				emitter.aliveParticles_ = subEmitterPass_->Resolve(deviceContext, &emitter, emitter.aliveParticles_);
+
+			//Particles emitted since the last update are written into dead slots
+			if (inPlaceSettings && !inPlaceSettings->pendingBursts.empty())
+				FlushSpawnBursts(deviceContext, emitter, settingsTable.Get(&emitter));
+
 			//Behavior manager has friend access to emitters
-			input.aliveParticles_ = emitter.aliveParticles_;
+			FillDispatchInput(input, emitter);
 			if (input.aliveParticles_ > 0)
 			{
 				//Keeps tracks of all alive particles
 				totalAliveParticles_ += input.aliveParticles_;
-				input.rvParticleData_IN_ = emitter.rvParticleData_IN_;
-				input.rvParticleData_OUT_ = emitter.rvParticleData_OUT_;
-				input.uavParticleData_OUT_ = emitter.uavParticleData_OUT_;
-				input.uavParticleData_IN_ = emitter.uavParticleData_IN_;
-				input.bParticleData_OUT_ = emitter.bParticleData_OUT_;
-				input.bParticleData_IN_ = emitter.bParticleData_IN_;
 
 				//Can change the render route here with checks on the emitter
 				try
 				{
-					DispatchDefaultCompute(deviceContext, &input, &emitter);
+					//Issuing the dispatch is what the router weighs against the CPU
+					auto start = std::chrono::steady_clock::now();
+					DispatchDefaultCompute(deviceContext, &input, &emitter, deltaTime);
+					std::chrono::duration<double> issued = std::chrono::steady_clock::now() - start;
+					router_.RecordGPU(&emitter, input.aliveParticles_, issued.count());
+
+					//Sorts the partitioned data the renderer reads
+					const EmitterSettings* settings = settingsTable.Find(&emitter);
+
+					//Children spawn this frame from the births and deaths just recorded
+					if (settings && !settings->subEmitters.empty())
+						RunSubEmitters(deviceContext, emitter, *settings, input.aliveParticles_);
+
+					if (sortAllEmitters_ || (settings && settings->sortByDepth))
+					{
+						depthSorter_->Sort(deviceContext, &emitter, emitter.rvParticleData_IN_, emitter.aliveParticles_);
+					}
+
+					//Next frames update pushes particles apart with this grid
+					if (settings && settings->UsesNeighbors())
+					{
+						gridPass_->Build(deviceContext, &emitter, emitter.rvParticleData_IN_, emitter.aliveParticles_, settings->neighborCellSize);
+					}
 				}
 				catch (const Bindable::DirectXException)
 				{
 					LOG_ERROR("DirectX Exception", "Particle Engine Update Dispatch Failed");
 				}
+
+				const EmitterSettings* settings = settingsTable.Find(&emitter);
+				UINT category = settings ? settings->budgetCategory : 0;
+				if (category < ParticleBudget::MaxCategories)
+					liveByCategory[category] += emitter.aliveParticles_;
 			}
 			emitterPtr++;
 		}
 	}
 
+	AffectorManager::Unbind(deviceContext);
+
+	ID3D11ShaderResourceView* rvNULL[2] = { nullptr, nullptr };
+	deviceContext->CSSetShaderResources(30, 2, rvNULL);
+
+	//Reads this frames transforms so it runs before they become the previous ones
+	FlushCPUUpdates(deviceContext, liveByCategory);
+
+	//Particles have followed this frames motion
+	world_.GetTransforms().EndFrame();
+
+	//Emissions next frame are budgeted against what is alive now
+	UINT liveTotal = 0;
+	for (UINT live : liveByCategory)
+		liveTotal += live;
+
+	world_.GetBudget().BeginFrame(liveTotal, liveByCategory);
+
+	GatherRenderInfo(emitterManager);
+
+	if (captureRequested_)
+	{
+		captureRequested_ = false;
+		CopySnapshot(deviceContext, emitterManager);
+	}
+
+	if (workload_.IsOpen())
+		workload_.EndFrame();
+}
+
+bool Behavior::CaptureSnapshot()
+{
+	if (snapshots_->IsBusy())
+		return false;
+
+	captureRequested_ = true;
+	return true;
+}
+
+void Behavior::CopySnapshot(ID3D11DeviceContext* deviceContext, EmitterManager& emitterManager)
+{
+	auto& settingsTable = world_.GetSettings();
+
+	try
+	{
+		for (auto& emitterPtr : emitterManager.GetEmitters())
+		{
+			auto emitter = emitterPtr.lock();
+			if (!emitter)
+				continue;
+
+			const EmitterSettings* settings = settingsTable.Find(emitter.get());
+			float timer = settings ? settings->emissionTimer : 0.f;
+			uint32_t id = settings ? settings->snapshotId : 0;
+
+			//Partitioned data, alive particles are at the front
+			snapshots_->Copy(deviceContext, emitter->bParticleData_IN_, emitter->aliveParticles_,
+				PoolCapacity(emitter->bParticleData_IN_), id, timer);
+		}
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle snapshot failed to create its staging buffers");
+	}
+
+	snapshots_->Submit(spawnPass_->GetSeed(), cpuPass_->GetSeed());
+}
+
+bool Behavior::RestoreSnapshot(EmitterManager& emitterManager, const std::string& path, UINT frameIndex)
+{
+	SnapshotReader reader;
+	if (!reader.Open(path))
+	{
+		LOG_ERROR("ParticleSnapshot", "Could not open " + path)
+		return false;
+	}
+
+	//Deltas build on each other so every frame up to the requested one is read
+	SnapshotFrame frame;
+	for (UINT i = 0; i <= frameIndex; ++i)
+	{
+		if (!reader.Next(frame))
+		{
+			LOG_ERROR("ParticleSnapshot", "Snapshot frame " + std::to_string(frameIndex) + " could not be read from " + path)
+			return false;
+		}
+	}
+
+	ID3D11DeviceContext* deviceContext = gfx.GetContext();
+	auto& settingsTable = world_.GetSettings();
+
+	//Saved emitters by the id of their owner, the rest keep their order
+	std::unordered_map<uint32_t, const SnapshotEmitter*> savedById;
+	std::vector<const SnapshotEmitter*> savedWithoutId;
+	for (const SnapshotEmitter& saved : frame.emitters)
+	{
+		if (saved.id != 0)
+			savedById[saved.id] = &saved;
+		else
+			savedWithoutId.push_back(&saved);
+	}
+
+	size_t nextWithoutId = 0;
+	for (auto& emitterPtr : emitterManager.GetEmitters())
+	{
+		auto emitter = emitterPtr.lock();
+		if (!emitter)
+			continue;
+
+		EmitterSettings& settings = settingsTable.Get(emitter.get());
+
+		const SnapshotEmitter* found = nullptr;
+		if (settings.snapshotId != 0)
+		{
+			auto match = savedById.find(settings.snapshotId);
+			if (match != savedById.end())
+				found = match->second;
+		}
+		else if (nextWithoutId < savedWithoutId.size())
+		{
+			found = savedWithoutId[nextWithoutId++];
+		}
+
+		//Emitters created after the snapshot was taken are left alone
+		if (!found)
+			continue;
+
+		const SnapshotEmitter& saved = *found;
+
+		//Written into the existing pool, nothing is spawned
+		if (PoolCapacity(emitter->bParticleData_IN_) != saved.capacity)
+			continue;
+
+		//The pool is overwritten so a CPU copy of it and its claimed slots are stale
+		cpuPass_->Release(emitter.get());
+		subEmitterPass_->Forget(emitter.get());
+
+		UINT alive = static_cast<UINT>(saved.particles.size());
+		if (alive > 0)
+		{
+			D3D11_BOX box = { 0, 0, 0, alive * (UINT)sizeof(BehaviorDataCPU), 1, 1 };
+			deviceContext->UpdateSubresource(emitter->bParticleData_IN_, 0, &box, saved.particles.data(), 0, 0);
+		}
+		emitter->aliveParticles_ = alive;
+
+		settings.emissionTimer = saved.emissionTimer;
+		settings.emissionTimerRestored = true;
+	}
+
+	//Bursts after the restore roll the same particles they did after the capture
+	spawnPass_->SetSeed(frame.spawnSeed);
+	cpuPass_->SetSeed(frame.cpuSeed);
+
+	return true;
+}
+
+void Behavior::UploadTransforms(ID3D11DeviceContext* deviceContext)
+{
+	const TransformTable& table = world_.GetTransforms();
+	UINT count = table.Size();
+	if (count == 0)
+		return;
+
+	try
+	{
+		//Grows by doubling and is rewritten in place
+		if (transformCapacity_ < count)
+		{
+			RELEASE(bTransforms_);
+			RELEASE(rvTransforms_);
+
+			UINT capacity = transformCapacity_ ? transformCapacity_ : 64;
+			while (capacity < count)
+				capacity *= 2;
+
+			CreateStructuredBuffer(gfx.GetDevice(), sizeof(EmitterTransform), capacity, nullptr, &bTransforms_, &rvTransforms_, nullptr);
+			transformCapacity_ = capacity;
+		}
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle emitter transforms failed to create their buffer");
+		RELEASE(bTransforms_);
+		RELEASE(rvTransforms_);
+		transformCapacity_ = 0;
+		return;
+	}
+
+	//One copy for every emitter that follows its object
+	D3D11_BOX box = { 0, 0, 0, count * (UINT)sizeof(EmitterTransform), 1, 1 };
+	deviceContext->UpdateSubresource(bTransforms_, 0, &box, table.Data(), 0, 0);
+
+	deviceContext->CSSetShaderResources(30, 1, &rvTransforms_);
+}
+
+bool Behavior::SetCollisionField(std::shared_ptr<const CollisionField> field)
+{
+	RELEASE(tCollision_);
+	RELEASE(rvCollision_);
+	collisionField_.reset();
+
+	if (!field || field->Empty())
+		return true;
+
+	HRESULT hr = S_OK;
+
+	try
+	{
+		//Static for the life of the level so the texture never changes
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = field->Width();
+		desc.Height = field->Height();
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		D3D11_SUBRESOURCE_DATA init = {};
+		init.pSysMem = field->Texels().data();
+		init.SysMemPitch = field->Width() * sizeof(CollisionTexel);
+
+		INFO_SET gfx.GetDevice()->CreateTexture2D(&desc, &init, &tCollision_);
+		DX_EXCEPT(hr);
+
+		INFO_SET gfx.GetDevice()->CreateShaderResourceView(tCollision_, nullptr, &rvCollision_);
+		DX_EXCEPT(hr);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle collision field failed to create its texture");
+		RELEASE(tCollision_);
+		RELEASE(rvCollision_);
+		return false;
+	}
+
+	//The CPU path reads the same texels
+	collisionField_ = std::move(field);
+	return true;
+}
+
+void Behavior::CullAffectors(EmitterManager& emitterManager)
+{
+	affectors_->BeginFrame();
+	affectorRanges_.clear();
+
+	auto& settingsTable = world_.GetSettings();
+
+	for (auto& emitterPtr : emitterManager.GetEmitters())
+	{
+		auto emitter = emitterPtr.lock();
+		if (!emitter || emitter->aliveParticles_ == 0)
+			continue;
+
+		const EmitterSettings* settings = settingsTable.Find(emitter.get());
+		float radius = settings ? settings->boundsRadius : 0.f;
+
+		XMFLOAT4 position = emitter->Position();
+		float center[3] = { position.x, position.y, position.z };
+
+		AffectorRange range = affectors_->Cull(center, radius);
+		if (range.count > 0)
+			affectorRanges_[emitter.get()] = range;
+	}
+}
+
+bool Behavior::RouteEmitter(ID3D11DeviceContext* deviceContext, const std::weak_ptr<EmitterData>& owner,
+	EmitterData& emitter, const EmitterSettings* settings)
+{
+	//Most emitters with live particles read back to move to the CPU in one frame
+	constexpr UINT MaxReadbacksPerFrame = 1;
+
+	//The CPU kernels have no shape texture, neighbor grid or spawn records,
+	//and prewarm steps are dispatched
+	UINT features = SelectFeatures(&emitter);
+	bool cpuCapable = settings && settings->subEmitters.empty() && !settings->UsesNeighbors()
+		&& settings->prewarmSteps.empty() && (features & Kernel_ShapeTexture) == 0
+		&& subEmitterChildren_.count(&emitter) == 0;
+
+	UINT particles = emitter.aliveParticles_;
+	if (settings)
+	{
+		for (const SpawnBurst& burst : settings->pendingBursts)
+			particles += burst.count;
+	}
+
+	bool owned = cpuPass_->Owns(&emitter);
+	if (router_.Route(&emitter, particles, cpuCapable) == SimulationRoute::GPU)
+	{
+		//The pool already holds the last upload
+		if (owned)
+			cpuPass_->Release(&emitter);
+		return false;
+	}
+
+	if (owned)
+		return true;
+
+	//Empty emitters move for free, others wait on a readback
+	if (emitter.aliveParticles_ > 0 && cpuReadbacks_ >= MaxReadbacksPerFrame)
+		return false;
+
+	try
+	{
+		cpuPass_->Adopt(deviceContext, owner, emitter.bParticleData_IN_, emitter.aliveParticles_,
+			PoolCapacity(emitter.bParticleData_IN_));
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle emitter could not be read back for the CPU path");
+		return false;
+	}
+
+	if (emitter.aliveParticles_ > 0)
+		cpuReadbacks_++;
+
+	return true;
+}
+
+void Behavior::QueueCPUUpdate(EmitterData& emitter, EmitterSettings& settings, float deltaTime)
+{
+	XMFLOAT4 position = emitter.Position();
+	XMFLOAT2 scale = emitter.Scale();
+
+	KernelParams params;
+	params.deltaTime = deltaTime;
+	params.position[0] = position.x;
+	params.position[1] = position.y;
+	params.position[2] = position.z;
+	params.position[3] = position.w;
+	params.scale[0] = scale.x;
+	params.scale[1] = scale.y;
+	params.colors = settings.colorKeys.data();
+	params.numColors = static_cast<uint32_t>(settings.colorKeys.size());
+
+	if (settings.transformSlot != TransformTable::NoSlot && settings.transformSlot < world_.GetTransforms().Size())
+		params.transform = &world_.GetTransforms().Data()[settings.transformSlot];
+
+	if (collisionField_)
+	{
+		params.collisionField = &collisionField_->View();
+		params.collision = settings.collision;
+	}
+
+	//The ramp the CPU reads decides the variant, shapes never reach here
+	UINT features = SelectKernelFeatures(false, scale.x, scale.y, params.numColors, settings.usesPhysics);
+
+	//Bursts roll the same particles the spawn pass would
+	std::vector<SpawnBurst> bursts = std::move(settings.pendingBursts);
+	settings.pendingBursts.clear();
+	for (const SpawnBurst& burst : bursts)
+	{
+		if (workload_.IsOpen())
+			workload_.Spawn(&emitter, burst);
+
+		emitter.aliveParticles_ = cpuPass_->Spawn(&emitter, burst, params, features);
+	}
+
+	if (emitter.aliveParticles_ == 0)
+		return;
+
+	std::vector<Affector> affectors;
+	auto range = affectorRanges_.find(&emitter);
+	if (range != affectorRanges_.end())
+		affectors_->Gather(range->second, affectors);
+
+	cpuPass_->Queue(&emitter, emitter.bParticleData_IN_, params, features, std::move(affectors));
+}
+
+void Behavior::FlushCPUUpdates(ID3D11DeviceContext* deviceContext, UINT* liveByCategory)
+{
+	auto& settingsTable = world_.GetSettings();
+
+	UINT simulated = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	try
+	{
+		simulated = cpuPass_->Flush(deviceContext);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle CPU path failed to create its upload buffer");
+		return;
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	router_.RecordCPU(static_cast<uint32_t>(cpuPass_->GetResults().size()), simulated, elapsed.count());
+
+	for (const CPUPass::Result& result : cpuPass_->GetResults())
+	{
+		EmitterData& emitter = *result.emitter;
+		emitter.aliveParticles_ = result.alive;
+		totalAliveParticles_ += result.alive;
+
+		const EmitterSettings* settings = settingsTable.Find(&emitter);
+		UINT category = settings ? settings->budgetCategory : 0;
+		if (category < ParticleBudget::MaxCategories)
+			liveByCategory[category] += result.alive;
+
+		if (result.alive > 0 && (sortAllEmitters_ || (settings && settings->sortByDepth)))
+		{
+			try
+			{
+				depthSorter_->Sort(deviceContext, &emitter, emitter.rvParticleData_IN_, emitter.aliveParticles_);
+			}
+			catch (const Bindable::DirectXException)
+			{
+				LOG_ERROR("DirectX Exception", "Particle Engine Update Dispatch Failed");
+			}
+		}
+	}
+}
+
+void Behavior::FlushSpawnBursts(ID3D11DeviceContext* deviceContext, EmitterData& emitter, EmitterSettings& settings)
+{
+	std::vector<SpawnBurst> bursts = std::move(settings.pendingBursts);
+	settings.pendingBursts.clear();
+
+	bool hasShape = (SelectFeatures(&emitter) & Kernel_ShapeTexture) != 0;
+
+	sampler_->SetWithStage(Bindable::Stage::ComputeShader);
+
+	//Handles are resolved by index so no name lookup happens per burst
+	if (hasShape)
+		world_.GetTextures().Resolve(settings.shapeTexture)->SetWithStage(Bindable::Stage::ComputeShader);
+
+	//Births go into the same records the update appends deaths to
+	UINT subEmitTriggers = SubEmitTriggers(&settings);
+	if ((subEmitTriggers & SubEmit_Birth) == 0 || !subEmitterPass_->BindRecords(deviceContext, &emitter, RecordCapacity(&emitter, subEmitTriggers)))
+		subEmitTriggers = 0;
+
+	UINT capacity = PoolCapacity(emitter.bParticleData_IN_);
+	XMFLOAT2 scale = emitter.Scale();
+
+	for (const SpawnBurst& burst : bursts)
+	{
+		if (workload_.IsOpen())
+			workload_.Spawn(&emitter, burst);
+
+		emitter.aliveParticles_ = spawnPass_->Spawn(deviceContext, burst, hasShape, scale,
+			emitter.uavParticleData_IN_, emitter.rvColors_, subEmitTriggers, emitter.aliveParticles_, capacity);
+	}
+
+	if (subEmitTriggers)
+		SubEmitterPass::UnbindRecords(deviceContext);
+}
+
+void Behavior::RunSubEmitters(ID3D11DeviceContext* deviceContext, const EmitterData& parent,
+	const EmitterSettings& settings, UINT parentAlive)
+{
+	auto& settingsTable = world_.GetSettings();
+
+	for (const SubEmitterLink& link : settings.subEmitters)
+	{
+		auto child = link.child.lock();
+		if (!child)
+			continue;
+
+		const EmitterSettings* childSettings = settingsTable.Find(child.get());
+		SubEmitterSpawn spawn = childSettings ? childSettings->spawnTemplate : SubEmitterSpawn();
+
+		//Every particle is born or dies at most once per update
+		child->aliveParticles_ = subEmitterPass_->Spawn(deviceContext, &parent, child.get(), link.trigger, link.particlesPerEvent,
+			spawn, child->uavParticleData_IN_, child->rvColors_, child->aliveParticles_,
+			PoolCapacity(child->bParticleData_IN_), parentAlive);
+	}
+}
+
+void Behavior::RunPrewarm(ID3D11DeviceContext* deviceContext, EmitterData& emitter, EmitterSettings& settings)
+{
+	//Taken out first so a failed step does not run again next frame
+	std::vector<PrewarmStep> steps = std::move(settings.prewarmSteps);
+	std::function<void(float)> spawn = std::move(settings.prewarmSpawn);
+	settings.prewarmSteps.clear();
+
+	DispatchInput input;
+
+	try
+	{
+		//Each step is one large dispatch instead of a frame worth of small ones
+		for (const PrewarmStep& step : steps)
+		{
+			if (workload_.IsOpen())
+				workload_.Step(&emitter, step.deltaTime);
+
+			FillDispatchInput(input, emitter);
+			if (input.aliveParticles_ > 0)
+				DispatchDefaultCompute(deviceContext, &input, &emitter, step.deltaTime, false);
+
+			//Emissions inside the step start as old as they would be at its end,
+			//so they do not band together at the step boundaries
+			if (!step.emissionAges.empty() && spawn)
+			{
+				for (float age : step.emissionAges)
+					spawn(age);
+
+				FlushSpawnBursts(deviceContext, emitter, settings);
+			}
+		}
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle Engine Prewarm Dispatch Failed");
+	}
+}
+
+void Behavior::TrackWorkload(EmitterData& emitter, const EmitterSettings* settings)
+{
+	XMFLOAT4 position = emitter.Position();
+	XMFLOAT2 scale = emitter.Scale();
+
+	WorkloadSettings tracked;
+	tracked.position[0] = position.x;
+	tracked.position[1] = position.y;
+	tracked.position[2] = position.z;
+	tracked.position[3] = position.w;
+	tracked.scale[0] = scale.x;
+	tracked.scale[1] = scale.y;
+
+	if (settings)
+	{
+		tracked.colors = settings->colorKeys;
+		if (settings->usesPhysics)
+			tracked.flags |= Workload::FlagPhysics;
+		if (settings->inPlaceUpdate)
+			tracked.flags |= Workload::FlagInPlace;
+		if (settings->sortByDepth)
+			tracked.flags |= Workload::FlagSortByDepth;
+	}
+	else
+	{
+		//Same default SelectFeatures uses without settings
+		tracked.flags |= Workload::FlagPhysics;
+	}
+
+	if (SelectFeatures(&emitter) & Kernel_ShapeTexture)
+		tracked.flags |= Workload::FlagShape;
+
+	workload_.Track(&emitter, PoolCapacity(emitter.bParticleData_IN_), tracked);
+}
+
+ID3D11ShaderResourceView* Behavior::GetSortedIndices(const EmitterData* emitter) const
+{
+	return depthSorter_->GetSortedIndices(emitter);
+}
+
+bool Behavior::GetAtlasSlot(const EmitterData* emitter, AtlasSlot& slot) const
+{
+	const EmitterSettings* settings = world_.GetSettings().Find(emitter);
+	if (!settings || settings->atlasSlot == TextureAtlas::NoSlot || settings->atlasTexture != settings->particleTexture)
+		return false;
+
+	slot = atlas_->GetSlot(settings->atlasSlot);
+	return true;
+}
+
+Texture* Behavior::GetTexture(const EmitterData* emitter) const
+{
+	const EmitterSettings* settings = world_.GetSettings().Find(emitter);
+	return settings ? world_.GetTextures().Resolve(settings->particleTexture) : nullptr;
+}
+
+void Behavior::GatherRenderInfo(EmitterManager& emitterManager)
+{
+	renderInfo_.clear();
+	auto& settingsTable = world_.GetSettings();
+
+	for (auto& emitterPtr : emitterManager.GetEmitters())
+	{
+		auto emitter = emitterPtr.lock();
+		if (!emitter || emitter->aliveParticles_ == 0)
+			continue;
+
+		const EmitterSettings* settings = settingsTable.Find(emitter.get());
+
+		//Updated particles are always in the in buffer
+		RenderInfo info = {};
+		info.particles = emitter->rvParticleData_IN_;
+		info.AliveParticles = emitter->aliveParticles_;
+		info.emitter = emitter.get();
+		info.texture = settings ? settings->particleTexture : TextureHandle();
+		info.sortedIndices = depthSorter_->GetSortedIndices(emitter.get());
+
+		AtlasSlot slot;
+		if (GetAtlasSlot(emitter.get(), slot))
+		{
+			info.atlasPage = slot.page;
+			info.atlasUV = slot.uv;
+		}
+		else
+		{
+			info.atlasPage = TextureAtlas::NoSlot;
+			info.atlasUV = XMFLOAT4(0.f, 0.f, 1.f, 1.f);
+		}
+
+		if (!instances_->Get(emitter.get(), info.instances, info.instanceArgs))
+		{
+			info.instances = nullptr;
+			info.instanceArgs = nullptr;
+		}
+
+		renderInfo_.push_back(info);
+	}
+
+	//Atlased emitters share one binding, the rest are grouped by their own texture
+	std::stable_sort(renderInfo_.begin(), renderInfo_.end(), [](const RenderInfo& a, const RenderInfo& b)
+	{
+		bool aAtlased = a.atlasPage != TextureAtlas::NoSlot;
+		bool bAtlased = b.atlasPage != TextureAtlas::NoSlot;
+
+		if (aAtlased != bAtlased)
+			return aAtlased;
+
+		return !aAtlased && a.texture < b.texture;
+	});
 }
 
 void Behavior::CreateBuffers(ID3D11Device* device)
@@ -171,70 +1007,291 @@ void Behavior::CreateBuffers(ID3D11Device* device)
 
 }
 
-void Behavior::AddComputeShaders(ID3D11Device* device)
+void Behavior::LoadComputeShaders(ID3D11Device* device)
+{
+	for (UINT features = 0; features < Kernel_VariantCount; ++features)
+	{
+		//The shape texture belongs to the spawn pass, the update never samples it
+		if (features & Kernel_ShapeTexture)
+			continue;
+
+		csParticleShaders_[features] = AddComputeShader(device, features);
+	}
+}
+
+ID3D11ComputeShader* Behavior::GetComputeShader(UINT features) const
+{
+	return csParticleShaders_[features & Kernel_GPUAll];
+}
+
+ID3D11ComputeShader* Behavior::AddComputeShader(ID3D11Device* device, UINT features)
+{
+	//Precompiled permutations are named by their feature mask
+	//The full variant keeps the original name
+	std::wstring cso = L"./shaders/CSParticleBehaviorsDefault";
+	if (features != Kernel_All)
+		cso += L"_" + std::to_wstring(features);
+	cso += L".cso";
+
+	//Shipped builds should carry every blob, compiling here stalls the load
+	if (GetFileAttributesW(cso.c_str()) == INVALID_FILE_ATTRIBUTES)
+		LOG_ERROR("ParticleEngine", "Missing precompiled particle kernel " + std::to_string(features) + ", compiling from source");
+
+	std::string shape	 = (features & Kernel_ShapeTexture)	 ? "1" : "0";
+	std::string gradient = (features & Kernel_ColorGradient) ? "1" : "0";
+	std::string physics	 = (features & Kernel_Physics)		 ? "1" : "0";
+	std::string inPlace	 = (features & Kernel_InPlace)		 ? "1" : "0";
+	std::string instance = (features & Kernel_Instances)	 ? "1" : "0";
+	std::string neighbor = (features & Kernel_Neighbors)	 ? "1" : "0";
+
+	D3D_SHADER_MACRO defines[] =
+	{
+		{ "FEATURE_SHAPE_TEXTURE",	shape.c_str() },
+		{ "FEATURE_COLOR_GRADIENT", gradient.c_str() },
+		{ "FEATURE_PHYSICS",		physics.c_str() },
+		{ "IN_PLACE",				inPlace.c_str() },
+		{ "WRITE_INSTANCES",		instance.c_str() },
+		{ "NEIGHBOR_SEPARATION",	neighbor.c_str() },
+		{ nullptr, nullptr }
+	};
+
+	return LoadComputeShader(device, cso.c_str(), L"./shaders/CSParticleBehaviorsDefault.hlsl", "main", defines);
+}
+
+UINT Behavior::SelectFeatures(EmitterData* emitter) const
+{
+	const EmitterSettings* settings = world_.GetSettings().Find(emitter);
+	Texture* shapeTexture = settings ? world_.GetTextures().Resolve(settings->shapeTexture) : nullptr;
+
+	bool hasShape = shapeTexture && shapeTexture->IsLoaded();
+	bool usesPhysics = settings ? settings->usesPhysics : true;
+
+	UINT features = SelectKernelFeatures(hasShape, emitter->Scale().x, emitter->Scale().y, emitter->NumColors(), usesPhysics);
+
+	//Once the buffers are shared the ping pong kernel can no longer be used
+	if (emitter->bParticleData_OUT_ == emitter->bParticleData_IN_)
+		features |= Kernel_InPlace;
+
+	return features;
+}
+
+void Behavior::UseSingleBuffer(EmitterData& emitter)
+{
+	if (emitter.bParticleData_OUT_ == emitter.bParticleData_IN_)
+		return;
+
+	RELEASE(emitter.bParticleData_OUT_);
+	RELEASE(emitter.rvParticleData_OUT_);
+	RELEASE(emitter.uavParticleData_OUT_);
+
+	//Both names hold a reference so the emitter releases them as usual
+	emitter.bParticleData_OUT_ = emitter.bParticleData_IN_;
+	emitter.rvParticleData_OUT_ = emitter.rvParticleData_IN_;
+	emitter.uavParticleData_OUT_ = emitter.uavParticleData_IN_;
+
+	emitter.bParticleData_OUT_->AddRef();
+	emitter.rvParticleData_OUT_->AddRef();
+	emitter.uavParticleData_OUT_->AddRef();
+}
+
+void Behavior::ResizeEmitter(ID3D11DeviceContext* deviceContext, EmitterData& emitter, EmitterSettings& settings)
 {
+	UINT oldCapacity = PoolCapacity(emitter.bParticleData_IN_);
+	UINT capacity = settings.capacity ? settings.capacity : oldCapacity;
+	bool singleBuffer = settings.inPlaceUpdate && emitter.bParticleData_OUT_ == emitter.bParticleData_IN_;
+
+	ID3D11Buffer*			   buffers[2] = { nullptr, nullptr };
+	ID3D11ShaderResourceView*  srvs[2] = { nullptr, nullptr };
+	ID3D11UnorderedAccessView* uavs[2] = { nullptr, nullptr };
+	HRESULT hr = S_OK;
 
-	//Adds the nessisary compute shaders to this class.
 	try
 	{
+		//Same layout and views as the current pool, only the element count changes
+		D3D11_BUFFER_DESC bufferDesc;
+		emitter.bParticleData_IN_->GetDesc(&bufferDesc);
+		bufferDesc.ByteWidth = capacity * bufferDesc.StructureByteStride;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		emitter.rvParticleData_IN_->GetDesc(&srvDesc);
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = capacity;
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+		emitter.uavParticleData_IN_->GetDesc(&uavDesc);
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements = capacity;
+
+		//Zeroed particles have no lifetime left so the new slots start dead
+		std::vector<BehaviorDataCPU> dead(capacity);
+		D3D11_SUBRESOURCE_DATA init = {};
+		init.pSysMem = dead.data();
+
+		for (int i = 0; i < (singleBuffer ? 1 : 2); ++i)
+		{
+			INFO_SET gfx.GetDevice()->CreateBuffer(&bufferDesc, &init, &buffers[i]);
+			DX_EXCEPT(hr);
+
+			INFO_SET gfx.GetDevice()->CreateShaderResourceView(buffers[i], &srvDesc, &srvs[i]);
+			DX_EXCEPT(hr);
+
+			INFO_SET gfx.GetDevice()->CreateUnorderedAccessView(buffers[i], &uavDesc, &uavs[i]);
+			DX_EXCEPT(hr);
+		}
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle emitter failed to resize to " + std::to_string(capacity) + " particles");
+		for (int i = 0; i < 2; ++i)
+		{
+			RELEASE(buffers[i]);
+			RELEASE(srvs[i]);
+			RELEASE(uavs[i]);
+		}
 
-		// Create Compute Shader Shader
-		HRESULT hr = NULL;
+		//Keeps the current pool instead of trying again every frame
+		settings.capacity = oldCapacity;
+		settings.inPlaceUpdate = emitter.bParticleData_OUT_ == emitter.bParticleData_IN_;
+		return;
+	}
 
-		ID3DBlob* pBlob;
+	//Live particles are packed at the front of the pool after every update
+	UINT kept = std::min(emitter.aliveParticles_, capacity);
+	if (kept > 0)
+	{
+		D3D11_BOX box = { 0, 0, 0, kept * (UINT)sizeof(BehaviorDataCPU), 1, 1 };
+		deviceContext->CopySubresourceRegion(buffers[0], 0, 0, 0, 0, emitter.bParticleData_IN_, 0, &box);
+	}
 
-		//Finds the correct Compute Shader
-		hr = D3DReadFileToBlob(L"./shaders/CSParticleBehaviorsDefault.cso", &pBlob);
-		HR_EXCEPT(hr);
+	//Shared buffers hold a reference under both names so each name is released once
+	RELEASE(emitter.bParticleData_IN_);
+	RELEASE(emitter.rvParticleData_IN_);
+	RELEASE(emitter.uavParticleData_IN_);
+	RELEASE(emitter.bParticleData_OUT_);
+	RELEASE(emitter.rvParticleData_OUT_);
+	RELEASE(emitter.uavParticleData_OUT_);
 
-		// Create the Pixel shader from the buffer.
-		hr = device->CreateComputeShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), NULL, &csParticleShader_);
-		HR_EXCEPT(hr);
+	emitter.bParticleData_IN_ = buffers[0];
+	emitter.rvParticleData_IN_ = srvs[0];
+	emitter.uavParticleData_IN_ = uavs[0];
+	emitter.aliveParticles_ = kept;
 
-		pBlob->Release();
+	if (singleBuffer)
+	{
+		emitter.bParticleData_OUT_ = buffers[0];
+		emitter.rvParticleData_OUT_ = srvs[0];
+		emitter.uavParticleData_OUT_ = uavs[0];
 
+		emitter.bParticleData_OUT_->AddRef();
+		emitter.rvParticleData_OUT_->AddRef();
+		emitter.uavParticleData_OUT_->AddRef();
 	}
-	catch (const HResultException&)
+	else
 	{
-		LOG_ERROR("Failed DirectX", "failed to load particle behavior compute shader");
+		emitter.bParticleData_OUT_ = buffers[1];
+		emitter.rvParticleData_OUT_ = srvs[1];
+		emitter.uavParticleData_OUT_ = uavs[1];
 	}
+
+	settings.capacity = capacity;
+
+	//Everything else sized to the old pool is resized with it. The CPU copy
+	//keeps its particles, the passes rebuild their buffers on next use.
+	cpuPass_->Resize(&emitter, capacity);
+	ForgetPoolState(&emitter);
 }
 
-void Behavior::DispatchDefaultCompute(ID3D11DeviceContext* deviceContext, DispatchInput* input, EmitterData* emitter)
+void Behavior::ForgetPoolState(const EmitterData* emitter)
 {
-	//Set the Compute shader
-	deviceContext->CSSetShader(csParticleShader_, nullptr, 0u);
+	depthSorter_->Forget(emitter);
+	gridPass_->Forget(emitter);
+	instances_->Forget(emitter);
+	compactPass_->Forget(emitter);
+	subEmitterPass_->Forget(emitter);
+}
+
+void Behavior::DispatchDefaultCompute(ID3D11DeviceContext* deviceContext, DispatchInput* input, EmitterData* emitter, float deltaTime,
+	bool followTransform)
+{
+	//Set the Compute shader variant that matches this emitters features.
+	//The shape texture is only sampled by the spawn pass.
+	UINT features = SelectFeatures(emitter) & ~Kernel_ShapeTexture;
+
+	//Sorted indices point into the particles so sorted emitters are drawn from them
+	const EmitterSettings* settings = world_.GetSettings().Find(emitter);
+	bool sorted = sortAllEmitters_ || (settings && settings->sortByDepth);
+	bool writeInstances = fusedInstances_ && !sorted
+		&& instances_->Bind(deviceContext, emitter, PoolCapacity(emitter->bParticleData_IN_));
+	if (writeInstances)
+		features |= Kernel_Instances;
+
+	//Binds the neighbor grid built after the last update if this emitter has one
+	bool hasGrid = settings && settings->UsesNeighbors() && gridPass_->Bind(deviceContext, emitter);
+	if (hasGrid)
+		features |= Kernel_Neighbors;
+
+	ID3D11ComputeShader* shader = GetComputeShader(features);
+
+	//A variant that failed to build falls back to drawing from the particles
+	if (!shader && writeInstances)
+	{
+		InstancePass::Unbind(deviceContext);
+		writeInstances = false;
+		features &= ~Kernel_Instances;
+		shader = GetComputeShader(features);
+	}
+
+	if (!shader)
+	{
+		if (hasGrid)
+			GridPass::Unbind(deviceContext);
+		return;
+	}
+
+	deviceContext->CSSetShader(shader, nullptr, 0u);
+
+	//In place kernels read and write the in buffer through its UAV
+	bool inPlace = (features & Kernel_InPlace) != 0;
 
 	// Binds particle data for the Compute Shader   
-	ID3D11ShaderResourceView* rvIN[2] = { input->rvParticleData_IN_, emitter->rvColors_ };
+	ID3D11ShaderResourceView* rvIN[2] = { inPlace ? nullptr : input->rvParticleData_IN_, emitter->rvColors_ };
 	deviceContext->CSSetShaderResources(23, 2, rvIN);
 
 	//For a output buffer for the compute shader
-	ID3D11UnorderedAccessView* uavOut[1] = { input->uavParticleData_OUT_ };
+	ID3D11UnorderedAccessView* uavOut[1] = { inPlace ? input->uavParticleData_IN_ : input->uavParticleData_OUT_ };
 	deviceContext->CSSetUnorderedAccessViews(0, 1, uavOut, (UINT*)(&uavOut));
 
+	//Births and deaths are recorded for child emitters, one record per particle and trigger
+	//Births were already recorded by the spawn pass
+	UINT subEmitTriggers = SubEmitTriggers(settings);
+	if (subEmitTriggers && !subEmitterPass_->BindRecords(deviceContext, emitter, RecordCapacity(emitter, subEmitTriggers)))
+		subEmitTriggers = 0;
+
 	// Map Global Parameters
-	MapGlobalParams();
+	MapGlobalParams(deltaTime);
 
 	// Map Emitter Parameters
-	MapEmitterParams(emitter);
+	MapEmitterParams(emitter, subEmitTriggers, followTransform && rvTransforms_ != nullptr);
 
 	//Set Emitter and Global Params for the compute Shader
 	ID3D11Buffer* cbIN[2] = { cbGParameters_, cbEmitterParameters_};
 	deviceContext->CSSetConstantBuffers(0, 2, cbIN);
 
-	//Set the sampler to for the compute shader
-	sampler_->SetWithStage(Bindable::Stage::ComputeShader);
+	// Run the Computer Shader
+	deviceContext->Dispatch(input->aliveParticles_, 1, 1);
+
+	if (hasGrid)
+		GridPass::Unbind(deviceContext);
+
+	if (subEmitTriggers)
+		SubEmitterPass::UnbindRecords(deviceContext);
 
-	//If the emitter contains a shape texture then set the texture
-	if (emitter->GetEmitterShapeTexture() && emitter->GetEmitterShapeTexture()->IsLoaded())
+	if (writeInstances)
 	{
-		emitter->GetEmitterShapeTexture()->SetWithStage(Bindable::Stage::ComputeShader);
+		InstancePass::Unbind(deviceContext);
+		instances_->Finish(deviceContext, emitter);
 	}
 
-	// Run the Computer Shader
-	deviceContext->Dispatch(input->aliveParticles_, 1, 1);
-
 	// Ensures all buffers are unset
 	ID3D11UnorderedAccessView* uavNULL[1] = { nullptr }; //Must be a pointer to a pointer
 	deviceContext->CSSetUnorderedAccessViews(0, 1, uavNULL, (UINT*)(&uavOut));
@@ -247,19 +1304,26 @@ void Behavior::DispatchDefaultCompute(ID3D11DeviceContext* deviceContext, Dispat
 
 	deviceContext->CSSetShader(nullptr, nullptr, 0);
 	
-	//Swaps in and out buffers
-	std::swap(input->rvParticleData_IN_, input->rvParticleData_OUT_);
-	std::swap(input->uavParticleData_IN_, input->uavParticleData_OUT_);
-	std::swap(input->bParticleData_IN_, input->bParticleData_OUT_);
+	//Swaps in and out buffers, in place updates have nothing to swap
+	if (!inPlace)
+	{
+		std::swap(input->rvParticleData_IN_, input->rvParticleData_OUT_);
+		std::swap(input->uavParticleData_IN_, input->uavParticleData_OUT_);
+		std::swap(input->bParticleData_IN_, input->bParticleData_OUT_);
+	}
 
-	//Sorts the pool of particles in this emitter
-	emitter->PartitionAliveDead(deviceContext);
+	//Sorts the pool of particles in this emitter. The partition of the emitter
+	//reads one buffer and writes the other, a single buffer is compacted instead.
+	if (inPlace)
+		emitter->aliveParticles_ = compactPass_->Compact(deviceContext, emitter, emitter->uavParticleData_IN_, emitter->aliveParticles_);
+	else
+		emitter->PartitionAliveDead(deviceContext);
 
 }
 
-void Behavior::MapGlobalParams()
+void Behavior::MapGlobalParams(float deltaTime)
 {
-	auto deviceContext = Window::Instance().Gfx().GetContext();
+	auto deviceContext = gfx.GetContext();
 	D3D11_MAPPED_SUBRESOURCE MappedResource;
 	ZeroMemory(&MappedResource, sizeof(D3D11_MAPPED_SUBRESOURCE));
 	deviceContext->Map(cbGParameters_, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource);
@@ -269,7 +1333,7 @@ void Behavior::MapGlobalParams()
 		auto globalParams = reinterpret_cast<cbGlobalParams*>(MappedResource.pData);
 
 		//These Are temparary and may change
-		globalParams->paramf[0] = Clock::DeltaTime();	//Time Since Last Frame
+		globalParams->paramf[0] = deltaTime;			//Time Since Last Frame
 		globalParams->paramf[1] = 0;					//Space for additional parameters
 		globalParams->param[0] = 0;						//Space for additional parameters
 		globalParams->param[1] = 0;						//Space for additional parameters
@@ -278,10 +1342,10 @@ void Behavior::MapGlobalParams()
 	deviceContext->Unmap(cbGParameters_, 0);
 }
 
-void Behavior::MapEmitterParams(EmitterData* emitter)
+void Behavior::MapEmitterParams(EmitterData* emitter, UINT subEmitTriggers, bool followTransform)
 {
 
-	auto deviceContext = Window::Instance().Gfx().GetContext();
+	auto deviceContext = gfx.GetContext();
 	D3D11_MAPPED_SUBRESOURCE MappedResource;
 	ZeroMemory(&MappedResource, sizeof(D3D11_MAPPED_SUBRESOURCE));
 
@@ -296,6 +1360,30 @@ void Behavior::MapEmitterParams(EmitterData* emitter)
 		emitterParams->scale = emitter->Scale();
 		emitterParams->colorData.x = (float) emitter->NumColors();
 
+		//Slice of the culled affectors this emitter evaluates
+		auto range = affectorRanges_.find(emitter);
+		emitterParams->affectors[0] = range != affectorRanges_.end() ? range->second.first : 0;
+		emitterParams->affectors[1] = range != affectorRanges_.end() ? range->second.count : 0;
+
+		emitterParams->subEmit = subEmitTriggers;
+
+		const EmitterSettings* settings = world_.GetSettings().Find(emitter);
+		bool follows = followTransform && settings && settings->transformSlot != TransformTable::NoSlot;
+		emitterParams->transform = follows ? settings->transformSlot + 1 : 0;
+
+		//Emitters that are not atlased draw their own texture, the page is unused
+		bool atlased = settings && settings->atlasSlot != TextureAtlas::NoSlot && settings->atlasTexture == settings->particleTexture;
+		emitterParams->atlasPage = atlased ? atlas_->GetSlot(settings->atlasSlot).page : 0;
+
+		emitterParams->separation = settings && settings->UsesNeighbors() ? settings->neighborSeparation : 0.f;
+		emitterParams->directionRotation = settings && settings->useDirectionForRotation ? 1 : 0;
+
+		//Without a field nothing collides, the texture slot is empty
+		CollisionSettings collision = settings && collisionField_ ? settings->collision : CollisionSettings();
+		CollisionFieldView field = collisionField_ ? collisionField_->View() : CollisionFieldView();
+		emitterParams->collisionField = XMFLOAT4(field.origin[0], field.origin[1], 1.f / field.cellSize, field.cellSize);
+		emitterParams->collision = XMFLOAT4((float)collision.response, collision.restitution, collision.friction, collision.radius);
+
 	//Finish Mapping parameters
 	deviceContext->Unmap(cbEmitterParameters_, 0);
 
@@ -12,6 +12,27 @@
 
 *******************************************************************************/
 #include "ParticleEngineEmitter.h"		//Class Definition for A Particle Emitter
+#include "ParticleEngineEmitterSettings.h"	//Per emitter settings and texture handles
+#include "ParticleEngineKernels.h"			//Kernel feature masks
+#include "ParticleEngineDepthSort.h"		//Back to front particle sorting
+#include "ParticleEngineGridPass.h"			//Neighbor grid
+#include "ParticleEngineAffectors.h"		//World placed force fields
+#include "ParticleEngineSnapshotCapture.h"	//Asynchronous particle snapshots
+#include "ParticleEngineSubEmitters.h"		//Children spawned from births and deaths
+#include "ParticleEngineSpawnPass.h"		//Bursts spawned on the GPU
+#include "ParticleEngineTransforms.h"		//Transforms of emitters that follow their object
+#include "ParticleEngineAtlas.h"			//Shared pages of particle textures
+#include "ParticleEngineEmitterPool.h"		//Storage reclaimed from idle emitters
+#include "ParticleEngineRouter.h"			//Picks the CPU or GPU simulation per emitter
+#include "ParticleEngineCPUPass.h"			//Simulates small emitters on worker threads
+#include "ParticleEngineWorkload.h"			//Logs each frames work for offline replay
+#include "ParticleEngineInstances.h"		//Render ready records written by the update
+#include "ParticleEngineCollision.h"		//Static colliders baked into a distance field
+#include "ParticleEngineCompactPass.h"		//Alive and dead partition of single buffer emitters
+#include <memory>							//std::unique_ptr
+#include <vector>							//Render records
+#include <unordered_map>					//Per emitter affector ranges
+#include <unordered_set>					//Sub emitter children
 #include "Bindable.h"					//Part of our graphics engine
 #include "Graphics.h"					//Part of our graphics engine
 #include "Camera.h"						//To fetch Camera Location
@@ -24,6 +45,7 @@ namespace ParticleEngine
 {
 	struct PARTICLE;
 	struct cbGlobalParams;
+	class World;
 
 	/// <summary>
 	/// Info Required by the rendering portion
@@ -33,6 +55,13 @@ namespace ParticleEngine
 	{
 		ID3D11ShaderResourceView* particles;
 		UINT AliveParticles;
+		const EmitterData* emitter; //Emitter the record was built from
+		TextureHandle texture; //Interned texture, batched renderers sort by this id
+		ID3D11ShaderResourceView* sortedIndices; //Back to front particle indices, nullptr draws unsorted
+		UINT atlasPage;				//Page of the atlas the texture was packed into, TextureAtlas::NoSlot binds texture
+		DirectX::XMFLOAT4 atlasUV;	//xy offset zw scale into that page, unused when texture is not atlased
+		ID3D11ShaderResourceView* instances; //ParticleInstance records from the fused pass, nullptr draws from particles
+		ID3D11Buffer* instanceArgs;			 //DrawInstancedIndirect arguments for instances
 	};
 
 	class Behavior
@@ -41,6 +70,12 @@ namespace ParticleEngine
 	public:
 
 		//Constructors
+		Behavior(World& world) noexcept;
+
+		/// <summary>
+		/// Kept for the engine loop. Builds the behavior of World::Default(),
+		/// which draws with the graphics of the window, so gfx must be those.
+		/// </summary>
 		Behavior(Graphics& gfx) noexcept;
 		~Behavior() noexcept;
 		Behavior(const Behavior&) = default;
@@ -48,14 +83,140 @@ namespace ParticleEngine
 		Behavior(Behavior&&) = default;
 		Behavior& operator=(Behavior&&) = delete;
 
+		/// <summary>
+		/// Updates every emitter by deltaTime, called by the world that owns this behavior
+		/// </summary>
+		void Update(EmitterManager& emitterManager, float deltaTime);
+
+		/// <summary>
+		/// Kept for the engine loop. Steps the world of this behavior, World::Default()
+		/// when it was built from Graphics, by the global clock. The world updates
+		/// its own emitter manager, for the default world that is the engines.
+		/// </summary>
 		void Update(EmitterManager& emitterManager);
 
+		/// <summary>
+		/// A record for every emitter with live particles, rebuilt by each update.
+		/// Atlased emitters come first since they all draw from GetAtlasPages,
+		/// the rest are grouped by texture, so a renderer can merge each run
+		/// into one draw.
+		/// </summary>
+		const std::vector<RenderInfo>& GetRenderInfo() const { return renderInfo_; }
+
+		/// <summary>
+		/// Sorts every emitter by depth, not only emitters that ask for it
+		/// </summary>
+		void SetSortAllEmitters(bool sortAll) { sortAllEmitters_ = sortAll; }
+
+		/// <summary>
+		/// Returns this frames back to front indices for an emitter, nullptr if it was not sorted
+		/// </summary>
+		ID3D11ShaderResourceView* GetSortedIndices(const EmitterData* emitter) const;
+
+		/// <summary>
+		/// The update also writes a compact ParticleInstance per alive particle
+		/// that the vertex stage draws directly. Depth sorted emitters and
+		/// emitters simulated on the CPU keep drawing from their particles.
+		/// </summary>
+		void SetFusedInstances(bool fused) { fusedInstances_ = fused; }
+
+		/// <summary>
+		/// Returns this frames instances of an emitter and the indirect
+		/// arguments that draw them, false if it has to be drawn from its particles
+		/// </summary>
+		bool GetInstances(const EmitterData* emitter, ID3D11ShaderResourceView*& instances, ID3D11Buffer*& drawArgs) const
+		{
+			return instances_->Get(emitter, instances, drawArgs);
+		}
+
+		/// <summary>
+		/// Static colliders every emitter with a collision response reacts to.
+		/// The field is uploaded once and shared with the CPU path, nullptr
+		/// removes it. Returns false if the texture could not be created.
+		/// </summary>
+		bool SetCollisionField(std::shared_ptr<const CollisionField> field);
+
+		const std::shared_ptr<const CollisionField>& GetCollisionField() const { return collisionField_; }
+
+		/// <summary>
+		/// Returns where the texture of an emitter was packed. Returns false if
+		/// it is not in the atlas and the emitter has to bind its own texture.
+		/// </summary>
+		bool GetAtlasSlot(const EmitterData* emitter, AtlasSlot& slot) const;
+
+		/// <summary>
+		/// Resolves the particle texture of an emitter through its handle,
+		/// nullptr if it has none. Emitters without an atlas slot bind this.
+		/// </summary>
+		Texture* GetTexture(const EmitterData* emitter) const;
+
+		/// <summary>
+		/// Every atlas page as one Texture2DArray, emitters with an atlas
+		/// slot and the same blend mode can be drawn with this one binding
+		/// </summary>
+		ID3D11ShaderResourceView* GetAtlasPages() const { return atlas_->GetPages(); }
+
+		const AtlasPacker::Stats& GetAtlasStats() const { return atlas_->GetStats(); }
+
+		/// <summary>
+		/// Routes small emitters to the CPU and large ones to the compute shader
+		/// </summary>
+		EmitterRouter& GetRouter() { return router_; }
+
+		/// <summary>
+		/// How last frames emitters were routed and what each route cost
+		/// </summary>
+		const EmitterRouter::Stats& GetRouteStats() const { return router_.GetStats(); }
+
+		/// <summary>
+		/// Force fields that act on every emitter they overlap
+		/// </summary>
+		AffectorManager& GetAffectors() { return *affectors_; }
+
+		/// <summary>
+		/// Starts a snapshot stream that CaptureSnapshot appends to
+		/// </summary>
+		bool OpenSnapshotStream(const std::string& path) { return snapshots_->Open(path); }
+
+		/// <summary>
+		/// Finishes the last capture and closes the stream
+		/// </summary>
+		void CloseSnapshotStream() { snapshots_->Close(); }
+
+		/// <summary>
+		/// Captures every emitter at the end of the next update. The data is
+		/// read back and written over the following frames, returns false
+		/// while the last capture is still in flight.
+		/// </summary>
+		bool CaptureSnapshot();
+
+		/// <summary>
+		/// Restores frame frameIndex of a snapshot stream into the current
+		/// emitters, matched by the snapshot id of their settings. Emitters
+		/// without one are matched in emitter manager order. Emitters whose
+		/// pool size differs from the snapshot are skipped.
+		/// </summary>
+		bool RestoreSnapshot(EmitterManager& emitterManager, const std::string& path, UINT frameIndex);
+
+		/// <summary>
+		/// Logs every following update to a workload file until stopped. The
+		/// log can be replayed without a device by Tools/ParticleReplay.
+		/// </summary>
+		bool StartWorkloadCapture(const std::string& path) { return workload_.Open(path); }
+
+		void StopWorkloadCapture() { workload_.Close(); }
+
 	private:
 		//Forward Refernce
 		typedef struct DispatchInput DispatchInput;
 
 		UINT totalAliveParticles_;
 
+		/// <summary>
+		/// Settings, transforms, budget and textures of the emitters updated here
+		/// </summary>
+		World& world_;
+
 		/// <summary>
 		/// Allows use of graphics functions 
 		/// </summary>
@@ -66,12 +227,66 @@ namespace ParticleEngine
 		/// </summary>
 		ResourceManager& resourceManager_;
 
-		//The Compute Shader ran across all particles
-		ID3D11ComputeShader* csParticleShader_;
+		//Compute Shader variants ran across all particles, indexed by KernelFeature mask.
+		//Created at startup, nullptr when a variant failed to build.
+		ID3D11ComputeShader* csParticleShaders_[Kernel_VariantCount] = {};
 		
 		//allows for sampling of textures
 		Sampler* sampler_;
 		
+		//Sorts particles back to front after the update
+		std::unique_ptr<DepthSorter> depthSorter_;
+		bool sortAllEmitters_ = false;
+
+		//Bins particles into a grid for neighbor queries after the update
+		std::unique_ptr<GridPass> gridPass_;
+
+		//Force fields and the slice of them each emitter evaluates this frame
+		std::unique_ptr<AffectorManager> affectors_;
+		std::unordered_map<const EmitterData*, AffectorRange> affectorRanges_;
+
+		//Writes new particles from bursts before the update
+		std::unique_ptr<SpawnPass> spawnPass_;
+
+		//Spawns child emitters from the births and deaths of their parents
+		std::unique_ptr<SubEmitterPass> subEmitterPass_;
+
+		//Simulates emitters the router sends to the CPU
+		EmitterRouter router_;
+		std::unique_ptr<CPUPass> cpuPass_;
+		std::unordered_set<const EmitterData*> subEmitterChildren_; //Spawned into on the GPU, never routed to the CPU
+		UINT cpuReadbacks_ = 0; //Emitters with live particles moved to the CPU this frame
+
+		//Particle textures packed into shared pages
+		std::unique_ptr<TextureAtlas> atlas_;
+
+		//Partitions emitters that were moved to a single buffer
+		std::unique_ptr<CompactPass> compactPass_;
+
+		//Render ready records appended by the update
+		std::unique_ptr<InstancePass> instances_;
+		bool fusedInstances_ = false;
+
+		//What the renderer draws this frame, in draw order
+		std::vector<RenderInfo> renderInfo_;
+
+		//Reads particle pools back for snapshots
+		std::unique_ptr<SnapshotCapture> snapshots_;
+		bool captureRequested_ = false;
+
+		//Records creations, settings, bursts and steps while a workload capture is open
+		WorkloadRecorder workload_;
+
+		//Every followed emitter transform, uploaded once per frame
+		ID3D11Buffer*			  bTransforms_ = nullptr;
+		ID3D11ShaderResourceView* rvTransforms_ = nullptr;
+		UINT transformCapacity_ = 0;
+
+		//Baked static colliders, bound for the whole frame
+		std::shared_ptr<const CollisionField> collisionField_;
+		ID3D11Texture2D*		  tCollision_ = nullptr;
+		ID3D11ShaderResourceView* rvCollision_ = nullptr;
+
 		//GlobalParameters Direct X buffers
 		ID3D11Buffer* cbGParameters_ = nullptr;
 		ID3D11Buffer* cbEmitterParameters_ = nullptr;
@@ -82,17 +297,75 @@ namespace ParticleEngine
 		//Creates Buffers for compute Shader
 		void CreateBuffers(ID3D11Device* device); 
 
-		//Add Shaders to the file
-		void AddComputeShaders(ID3D11Device* device);
+		//Loads every compute shader variant the update can dispatch
+		void LoadComputeShaders(ID3D11Device* device);
+
+		//Returns the compute shader variant for a feature mask
+		ID3D11ComputeShader* GetComputeShader(UINT features) const;
+
+		//Loads or compiles a single compute shader variant
+		ID3D11ComputeShader* AddComputeShader(ID3D11Device* device, UINT features);
+
+		//Picks the kernel variant for an emitter
+		UINT SelectFeatures(EmitterData* emitter) const;
+
+		//Points the out buffer of an emitter at its in buffer so it only keeps one
+		void UseSingleBuffer(EmitterData& emitter);
+
+		//Moves the particles of an emitter into a pool of settings.capacity,
+		//also gives in place emitters that were turned off their second buffer back
+		void ResizeEmitter(ID3D11DeviceContext* deviceContext, EmitterData& emitter, EmitterSettings& settings);
+
+		//Releases what the passes keep per emitter for a pool that was resized or recycled
+		void ForgetPoolState(const EmitterData* emitter);
 
 		//Dispatches the default compute shader for the behaviors
-		void DispatchDefaultCompute(ID3D11DeviceContext* deviceContex, DispatchInput* input, EmitterData* emitter);
+		//followTransform is off for prewarm steps so a frames motion is only applied once
+		void DispatchDefaultCompute(ID3D11DeviceContext* deviceContex, DispatchInput* input, EmitterData* emitter, float deltaTime,
+			bool followTransform = true);
+
+		//Runs the pending prewarm steps of an emitter
+		void RunPrewarm(ID3D11DeviceContext* deviceContext, EmitterData& emitter, EmitterSettings& settings);
+
+		/// <summary>
+		/// Logs the pool size and kernel inputs of an emitter to the workload capture
+		/// </summary>
+		void TrackWorkload(EmitterData& emitter, const EmitterSettings* settings);
+
+		//Builds this frames render records once every emitter is updated
+		void GatherRenderInfo(EmitterManager& emitterManager);
 
 		//Map Global Params
-		void MapGlobalParams();
+		void MapGlobalParams(float deltaTime);
+
+		//Uploads the transform table and binds it to t30
+		void UploadTransforms(ID3D11DeviceContext* deviceContext);
+
+		//Culls the affectors for every emitter that will be dispatched
+		void CullAffectors(EmitterManager& emitterManager);
+
+		//Picks the route of an emitter and moves it between the CPU and GPU, returns true for the CPU
+		bool RouteEmitter(ID3D11DeviceContext* deviceContext, const std::weak_ptr<EmitterData>& owner,
+			EmitterData& emitter, const EmitterSettings* settings);
+
+		//Spawns the bursts of an emitter on the CPU and queues its update
+		void QueueCPUUpdate(EmitterData& emitter, EmitterSettings& settings, float deltaTime);
+
+		//Simulates and uploads the CPU emitters, then counts and sorts them like dispatched ones
+		void FlushCPUUpdates(ID3D11DeviceContext* deviceContext, UINT* liveByCategory);
+
+		//Spawns the bursts an emitter queued since its last update
+		void FlushSpawnBursts(ID3D11DeviceContext* deviceContext, EmitterData& emitter, EmitterSettings& settings);
+
+		//Spawns the children of an emitter from the records its last dispatch appended
+		void RunSubEmitters(ID3D11DeviceContext* deviceContext, const EmitterData& parent,
+			const EmitterSettings& settings, UINT parentAlive);
+
+		//Copies every emitter to the snapshot capture
+		void CopySnapshot(ID3D11DeviceContext* deviceContext, EmitterManager& emitterManager);
 
 		//Maps Params from a emitter object
-		void MapEmitterParams(EmitterData* emitter);
+		void MapEmitterParams(EmitterData* emitter, UINT subEmitTriggers, bool followTransform);
 	};
 
 }
@@ -0,0 +1,175 @@
+/*******************************************************************************
+
+	@file       ParticleEngineBudget.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Frame level particle budget. Caps live particles and spawns
+				per frame globally and per category. Emitters ask for spawns
+				with a priority that falls off with distance to the viewer and
+				are granted, scaled, deferred or dropped so the scene stays
+				inside the budget. Every decision is recorded.
+
+*******************************************************************************/
+#include "stdafx.h"					//Header included in all files.
+#include "ParticleEngineBudget.h"	//This files header
+#include <algorithm>				//std::sort std::min
+#include <cmath>					//std::ceil
+#include <string>					//std::to_string
+
+namespace ParticleEngine
+{
+
+ParticleBudget::ParticleBudget() noexcept :
+	viewer_{ 0.f, 0.f, 0.f }, hasViewer_(false)
+{
+}
+
+void ParticleBudget::SetCategoryLimits(uint32_t category, const Limits& limits)
+{
+	if (category < MaxCategories)
+		categories_[category].limits = limits;
+}
+
+void ParticleBudget::SetViewer(const float position[3])
+{
+	viewer_[0] = position[0];
+	viewer_[1] = position[1];
+	viewer_[2] = position[2];
+	hasViewer_ = true;
+}
+
+uint32_t ParticleBudget::Scope::Remaining() const
+{
+	uint32_t spawnRoom = limits.maxSpawnsPerFrame == Unlimited ? Unlimited
+		: (spawned < limits.maxSpawnsPerFrame ? limits.maxSpawnsPerFrame - spawned : 0);
+
+	uint32_t used = live + spawned;
+	uint32_t liveRoom = limits.maxLive == Unlimited ? Unlimited
+		: (used < limits.maxLive ? limits.maxLive - used : 0);
+
+	return std::min(spawnRoom, liveRoom);
+}
+
+void ParticleBudget::Scope::BeginFrame(uint32_t liveCount)
+{
+	//Walks last frames demand from most to least important until the
+	//budget runs out, everything less important than that is deferred
+	threshold = 0.f;
+	fraction = 1.f;
+	live = liveCount;
+	spawned = 0;
+
+	uint32_t room = Remaining();
+	if (room != Unlimited)
+	{
+		std::sort(demand.begin(), demand.end(),
+			[](const Demand& a, const Demand& b) { return a.importance > b.importance; });
+
+		uint64_t total = 0;
+		for (const Demand& d : demand)
+		{
+			total += d.count;
+			if (total > room)
+			{
+				//The request that crossed the budget gets what was left
+				threshold = d.importance;
+				fraction = float(room - (total - d.count)) / float(d.count);
+				break;
+			}
+		}
+	}
+
+	demand.clear();
+}
+
+uint32_t ParticleBudget::Scope::Want(float importance, uint32_t count) const
+{
+	if (importance > threshold)
+		return count;
+
+	if (importance < threshold)
+		return 0;
+
+	return static_cast<uint32_t>(std::ceil(count * fraction));
+}
+
+void ParticleBudget::BeginFrame(uint32_t liveTotal, const uint32_t* liveByCategory)
+{
+	//Reports the last frame once instead of every request
+	if (stats_.scaled + stats_.deferred + stats_.dropped > 0)
+	{
+		LOG_INFO("ParticleBudget", "Throttled " + std::to_string(stats_.requested - stats_.granted) + " of "
+			+ std::to_string(stats_.requested) + " particles: " + std::to_string(stats_.scaled) + " scaled, "
+			+ std::to_string(stats_.deferred) + " deferred, " + std::to_string(stats_.dropped) + " dropped")
+	}
+
+	lastStats_ = stats_;
+	stats_ = FrameStats();
+	stats_.live = liveTotal;
+	reports_.clear();
+
+	global_.BeginFrame(liveTotal);
+	for (uint32_t i = 0; i < MaxCategories; ++i)
+		categories_[i].BeginFrame(liveByCategory ? liveByCategory[i] : 0);
+}
+
+float ParticleBudget::Importance(const Request& request) const
+{
+	if (!hasViewer_ || request.falloffDistance <= 0.f)
+		return request.priority;
+
+	float dx = request.position[0] - viewer_[0];
+	float dy = request.position[1] - viewer_[1];
+	float dz = request.position[2] - viewer_[2];
+	float distanceSq = (dx * dx + dy * dy + dz * dz) / (request.falloffDistance * request.falloffDistance);
+
+	//Halves at the falloff distance
+	return request.priority / (1.f + distanceSq);
+}
+
+uint32_t ParticleBudget::Submit(const Request& request)
+{
+	Scope& category = categories_[request.category < MaxCategories ? request.category : 0];
+	float importance = Importance(request);
+
+	global_.demand.push_back({ importance, request.count });
+	category.demand.push_back({ importance, request.count });
+
+	//Ordered by last frames demand, then capped by what is actually left
+	uint32_t granted = std::min(global_.Want(importance, request.count), category.Want(importance, request.count));
+	granted = std::min(granted, std::min(global_.Remaining(), category.Remaining()));
+
+	global_.spawned += granted;
+	category.spawned += granted;
+
+	stats_.requested += request.count;
+	stats_.granted += granted;
+
+	if (granted == request.count)
+		return granted;
+
+	Decision decision;
+	if (granted > 0)
+	{
+		decision = Decision::Scaled;
+		stats_.scaled++;
+	}
+	else if (request.canDefer)
+	{
+		decision = Decision::Deferred;
+		stats_.deferred++;
+	}
+	else
+	{
+		decision = Decision::Dropped;
+		stats_.dropped++;
+	}
+
+	reports_.push_back({ request.source, request.category, request.count, granted, importance, decision });
+	return granted;
+}
+
+}//End of Particle Engine NameSpace
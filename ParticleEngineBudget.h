@@ -0,0 +1,168 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineBudget.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Frame level particle budget. Caps live particles and spawns
+				per frame globally and per category. Emitters ask for spawns
+				with a priority that falls off with distance to the viewer and
+				are granted, scaled, deferred or dropped so the scene stays
+				inside the budget. Every decision is recorded.
+
+*******************************************************************************/
+#include <cstdint>	//Fixed width integers
+#include <vector>	//Decisions and demand
+
+namespace ParticleEngine
+{
+	class ParticleBudget
+	{
+
+	public:
+
+		static constexpr uint32_t MaxCategories = 8;
+		static constexpr uint32_t Unlimited = 0xFFFFFFFFu;
+
+		/// <summary>
+		/// Caps for the whole scene or a single category
+		/// </summary>
+		struct Limits
+		{
+			uint32_t maxLive = Unlimited;		  //Particles alive at once
+			uint32_t maxSpawnsPerFrame = Unlimited; //Particles spawned in one frame
+		};
+
+		/// <summary>
+		/// A request to spawn particles from one emission
+		/// </summary>
+		struct Request
+		{
+			const void* source = nullptr;	//Who is asking, only used for reports
+			uint32_t category = 0;
+			uint32_t count = 0;
+			float priority = 1.f;
+			float falloffDistance = 0.f;	//Distance where importance halves, zero never falls off
+			float position[3] = { 0.f, 0.f, 0.f };
+			bool canDefer = true;			//Deferred requests are expected to be asked again
+		};
+
+		enum class Decision : uint8_t
+		{
+			Granted,  //Every particle was granted
+			Scaled,	  //Only part of the particles were granted
+			Deferred, //Nothing was granted, ask again next frame
+			Dropped,  //Nothing was granted and the request is gone
+		};
+
+		/// <summary>
+		/// What happened to one request
+		/// </summary>
+		struct Report
+		{
+			const void* source;
+			uint32_t category;
+			uint32_t requested;
+			uint32_t granted;
+			float importance;
+			Decision decision;
+		};
+
+		/// <summary>
+		/// Totals of one frame
+		/// </summary>
+		struct FrameStats
+		{
+			uint32_t live = 0;
+			uint32_t requested = 0;
+			uint32_t granted = 0;
+			uint32_t scaled = 0;
+			uint32_t deferred = 0;
+			uint32_t dropped = 0;
+		};
+
+		ParticleBudget() noexcept;
+		ParticleBudget(const ParticleBudget&) = delete;
+		ParticleBudget& operator=(const ParticleBudget&) = delete;
+
+		void SetGlobalLimits(const Limits& limits) { global_.limits = limits; }
+		void SetCategoryLimits(uint32_t category, const Limits& limits);
+
+		const Limits& GlobalLimits() const { return global_.limits; }
+		const Limits& CategoryLimits(uint32_t category) const { return categories_[category < MaxCategories ? category : 0].limits; }
+
+		/// <summary>
+		/// Position importance falls off from, usually the camera
+		/// </summary>
+		void SetViewer(const float position[3]);
+
+		/// <summary>
+		/// Starts a frame with the live counts from the last update.
+		/// liveByCategory may be nullptr. Reports the last frames throttling.
+		/// </summary>
+		void BeginFrame(uint32_t liveTotal, const uint32_t* liveByCategory);
+
+		/// <summary>
+		/// Returns how many of the requested particles may spawn this frame
+		/// </summary>
+		uint32_t Submit(const Request& request);
+
+		/// <summary>
+		/// Requests that were not fully granted this frame
+		/// </summary>
+		const std::vector<Report>& ThrottledReports() const { return reports_; }
+
+		/// <summary>
+		/// Totals of the last finished frame
+		/// </summary>
+		const FrameStats& LastFrameStats() const { return lastStats_; }
+
+		/// <summary>
+		/// Returns the importance of a request, priority scaled by distance
+		/// </summary>
+		float Importance(const Request& request) const;
+
+	private:
+
+		struct Demand
+		{
+			float importance;
+			uint32_t count;
+		};
+
+		//Budget state for the scene or one category
+		struct Scope
+		{
+			Limits limits;
+			uint32_t live = 0;
+			uint32_t spawned = 0;
+
+			//Requests below this importance are deferred and requests at it
+			//are scaled by fraction. Computed from last frames demand so the
+			//most important requests get the budget even when they arrive last.
+			float threshold = 0.f;
+			float fraction = 1.f;
+			std::vector<Demand> demand;
+
+			uint32_t Remaining() const;
+
+			//Particles of a request this scope would grant before capacity
+			uint32_t Want(float importance, uint32_t count) const;
+			void BeginFrame(uint32_t liveCount);
+		};
+
+		Scope global_;
+		Scope categories_[MaxCategories];
+
+		float viewer_[3];
+		bool hasViewer_;
+
+		std::vector<Report> reports_;
+		FrameStats stats_;
+		FrameStats lastStats_;
+	};
+
+}
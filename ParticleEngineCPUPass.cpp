@@ -0,0 +1,235 @@
+/*******************************************************************************
+
+	@file       ParticleEngineCPUPass.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Simulates small emitters with the CPU kernels. Each emitter
+				routed here keeps its particles in memory, the frames emitters
+				are simulated together on worker threads and every result is
+				uploaded with one copy before being split into the pools the
+				renderer reads.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineCPUPass.h"		//This files header
+#include "ParticleEngineEmitter.h"		//Class Definition for A Particle Emitter
+#include "ParticleEngineShaders.h"		//Structured buffer helpers
+#include "ParticleEngineParallel.h"		//ParallelFor
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+#include <algorithm>					//std::min std::remove_if
+#include <cstring>						//memcpy
+
+namespace ParticleEngine
+{
+//Emitters per worker thread, fewer run on the calling thread
+static constexpr uint32_t EmittersPerThread = 8;
+
+CPUPass::CPUPass(ID3D11Device* device, WorkerPool& workers) noexcept :
+	device_(device), workers_(workers)
+{
+}
+
+CPUPass::~CPUPass() noexcept
+{
+	RELEASE(bUpload_);
+}
+
+CPUPass::Mirror* CPUPass::Find(const EmitterData* emitter)
+{
+	auto found = mirrors_.find(emitter);
+	if (found == mirrors_.end())
+		return nullptr;
+
+	//The emitter it belonged to is gone
+	if (found->second.owner.expired())
+	{
+		mirrors_.erase(found);
+		return nullptr;
+	}
+
+	return &found->second;
+}
+
+bool CPUPass::Owns(const EmitterData* emitter) const
+{
+	auto found = mirrors_.find(emitter);
+	return found != mirrors_.end() && !found->second.owner.expired();
+}
+
+void CPUPass::Adopt(ID3D11DeviceContext* deviceContext, const std::weak_ptr<EmitterData>& owner,
+	ID3D11Buffer* particles, UINT alive, UINT capacity)
+{
+	Mirror mirror;
+	mirror.owner = owner;
+	mirror.capacity = capacity;
+	mirror.particles.resize(std::min(alive, capacity));
+
+	if (!mirror.particles.empty())
+	{
+		HRESULT hr = S_OK;
+		ID3D11Buffer* staging = nullptr;
+		UINT bytes = static_cast<UINT>(mirror.particles.size() * sizeof(BehaviorDataCPU));
+
+		D3D11_BUFFER_DESC Desc = {};
+		Desc.Usage			= D3D11_USAGE_STAGING;
+		Desc.BindFlags		= 0;
+		Desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		Desc.ByteWidth		= bytes;
+
+		INFO_SET device_->CreateBuffer(&Desc, nullptr, &staging);
+		DX_EXCEPT(hr);
+
+		//Only the alive front of the pool is read back
+		D3D11_BOX box = { 0, 0, 0, bytes, 1, 1 };
+		deviceContext->CopySubresourceRegion(staging, 0, 0, 0, 0, particles, 0, &box);
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		hr = deviceContext->Map(staging, 0, D3D11_MAP_READ, 0, &mapped);
+		if (FAILED(hr))
+		{
+			RELEASE(staging);
+			DX_EXCEPT(hr);
+		}
+
+		memcpy(mirror.particles.data(), mapped.pData, bytes);
+		deviceContext->Unmap(staging, 0);
+		RELEASE(staging);
+	}
+
+	mirrors_[owner.lock().get()] = std::move(mirror);
+}
+
+void CPUPass::Resize(const EmitterData* emitter, UINT capacity)
+{
+	Mirror* mirror = Find(emitter);
+	if (!mirror)
+		return;
+
+	mirror->capacity = capacity;
+	if (mirror->particles.size() > capacity)
+		mirror->particles.resize(capacity);
+}
+
+UINT CPUPass::Spawn(const EmitterData* emitter, const SpawnBurst& burst, const KernelParams& params, uint32_t features)
+{
+	Mirror* mirror = Find(emitter);
+	if (!mirror)
+		return 0;
+
+	UINT alive = static_cast<UINT>(mirror->particles.size());
+	UINT count = std::min(burst.count, mirror->capacity > alive ? mirror->capacity - alive : 0u);
+	if (count == 0)
+		return alive;
+
+	mirror->particles.resize(alive + count);
+	GetCPUSpawnKernel(features)(burst, params, seed_, mirror->particles.data(), alive, alive + count);
+
+	//Same stride as the spawn pass, kept small so the sin hash stays precise
+	seed_ += 97.31f;
+	if (seed_ > 8192.f)
+		seed_ -= 8192.f;
+
+	return alive + count;
+}
+
+void CPUPass::Queue(EmitterData* emitter, ID3D11Buffer* particles, const KernelParams& params, uint32_t features,
+	std::vector<Affector>&& affectors)
+{
+	Mirror* mirror = Find(emitter);
+	if (!mirror)
+		return;
+
+	jobs_.push_back({ emitter, particles, params, features, std::move(affectors), mirror, 0 });
+}
+
+UINT CPUPass::Flush(ID3D11DeviceContext* deviceContext)
+{
+	results_.clear();
+
+	//Taken out first so a failed upload does not leave jobs for next frame
+	std::vector<Job> jobs = std::move(jobs_);
+	jobs_.clear();
+	if (jobs.empty())
+		return 0;
+
+	UINT simulated = 0;
+	for (Job& job : jobs)
+	{
+		job.params.affectors = job.affectors.data();
+		job.params.numAffectors = static_cast<uint32_t>(job.affectors.size());
+		simulated += static_cast<UINT>(job.mirror->particles.size());
+	}
+
+	//Each emitter is simulated and compacted by one thread
+	ParallelFor(workers_, static_cast<uint32_t>(jobs.size()), [&jobs](unsigned, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			Job& job = jobs[i];
+			std::vector<BehaviorDataCPU>& particles = job.mirror->particles;
+
+			GetCPUKernel(job.features)(particles.data(), static_cast<uint32_t>(particles.size()), job.params);
+
+			//Same result as PartitionAliveDead, the live particles move to the front
+			particles.erase(std::remove_if(particles.begin(), particles.end(),
+				[](const BehaviorDataCPU& p) { return !(p.lifetime[0] < p.lifetime[1]); }), particles.end());
+		}
+	}, EmittersPerThread);
+
+	//Packs every survivor into one upload
+	UINT total = 0;
+	for (Job& job : jobs)
+	{
+		job.offset = total;
+		total += static_cast<UINT>(job.mirror->particles.size());
+	}
+
+	staging_.resize(total);
+	for (const Job& job : jobs)
+	{
+		if (!job.mirror->particles.empty())
+			memcpy(&staging_[job.offset], job.mirror->particles.data(), job.mirror->particles.size() * sizeof(BehaviorDataCPU));
+	}
+
+	if (total > 0)
+	{
+		//Grows by doubling and is rewritten every frame
+		if (uploadCapacity_ < total)
+		{
+			RELEASE(bUpload_);
+			uploadCapacity_ = 0;
+
+			UINT capacity = 1024;
+			while (capacity < total)
+				capacity *= 2;
+
+			CreateStructuredBuffer(device_, sizeof(BehaviorDataCPU), capacity, nullptr, &bUpload_, nullptr, nullptr);
+			uploadCapacity_ = capacity;
+		}
+
+		D3D11_BOX box = { 0, 0, 0, total * (UINT)sizeof(BehaviorDataCPU), 1, 1 };
+		deviceContext->UpdateSubresource(bUpload_, 0, &box, staging_.data(), 0, 0);
+	}
+
+	//Splits the upload into the pool of each emitter on the GPU
+	for (const Job& job : jobs)
+	{
+		UINT alive = static_cast<UINT>(job.mirror->particles.size());
+		if (alive > 0)
+		{
+			UINT stride = (UINT)sizeof(BehaviorDataCPU);
+			D3D11_BOX box = { job.offset * stride, 0, 0, (job.offset + alive) * stride, 1, 1 };
+			deviceContext->CopySubresourceRegion(job.particles, 0, 0, 0, 0, bUpload_, 0, &box);
+		}
+
+		results_.push_back({ job.emitter, alive });
+	}
+
+	return simulated;
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,139 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineCPUPass.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Simulates small emitters with the CPU kernels. Each emitter
+				routed here keeps its particles in memory, the frames emitters
+				are simulated together on worker threads and every result is
+				uploaded with one copy before being split into the pools the
+				renderer reads.
+
+*******************************************************************************/
+#include <d3d11.h>					//DirectX header
+#include <memory>					//std::weak_ptr
+#include <unordered_map>			//Particles per emitter
+#include <vector>					//Particles and jobs
+#include "ParticleEngineKernels.h"	//CPU kernels
+
+namespace ParticleEngine
+{
+	struct EmitterData;
+	class WorkerPool;
+
+	class CPUPass
+	{
+
+	public:
+
+		/// <summary>
+		/// An emitter simulated this frame and its live count after the update
+		/// </summary>
+		struct Result
+		{
+			EmitterData* emitter;
+			UINT alive;
+		};
+
+		//Constructors
+		CPUPass(ID3D11Device* device, WorkerPool& workers) noexcept;
+		~CPUPass() noexcept;
+		CPUPass(const CPUPass&) = delete;
+		CPUPass& operator=(const CPUPass&) = delete;
+
+		/// <summary>
+		/// Returns true if the particles of an emitter live on the CPU
+		/// </summary>
+		bool Owns(const EmitterData* emitter) const;
+
+		/// <summary>
+		/// Moves an emitter to the CPU. Live particles are read back from the
+		/// front of its pool, which waits on the GPU, so only small emitters
+		/// should be moved while they have particles. Throws on failure.
+		/// </summary>
+		void Adopt(ID3D11DeviceContext* deviceContext, const std::weak_ptr<EmitterData>& owner,
+			ID3D11Buffer* particles, UINT alive, UINT capacity);
+
+		/// <summary>
+		/// Moves an emitter back to the GPU. Its pool already holds the last upload.
+		/// </summary>
+		void Release(const EmitterData* emitter) { mirrors_.erase(emitter); }
+
+		/// <summary>
+		/// Changes the pool size of an owned emitter, live particles past it are dropped
+		/// </summary>
+		void Resize(const EmitterData* emitter, UINT capacity);
+
+		/// <summary>
+		/// Writes a burst after the live particles of an owned emitter, returns the new live count
+		/// </summary>
+		UINT Spawn(const EmitterData* emitter, const SpawnBurst& burst, const KernelParams& params, uint32_t features);
+
+		/// <summary>
+		/// Queues an owned emitter for this frames update. params.affectors is
+		/// replaced by affectors, which the pass keeps until Flush.
+		/// </summary>
+		void Queue(EmitterData* emitter, ID3D11Buffer* particles, const KernelParams& params, uint32_t features,
+			std::vector<Affector>&& affectors);
+
+		/// <summary>
+		/// Simulates every queued emitter on the worker threads, drops dead
+		/// particles and uploads the survivors into their pools. Returns the
+		/// particles simulated. Throws if the upload buffer can not grow.
+		/// </summary>
+		UINT Flush(ID3D11DeviceContext* deviceContext);
+
+		/// <summary>
+		/// Emitters simulated by the last Flush
+		/// </summary>
+		const std::vector<Result>& GetResults() const { return results_; }
+
+		/// <summary>
+		/// Seed of the next burst of an owned emitter, kept in snapshots
+		/// </summary>
+		float GetSeed() const { return seed_; }
+		void SetSeed(float seed) { seed_ = seed; }
+
+	private:
+
+		struct Mirror
+		{
+			std::weak_ptr<EmitterData> owner; //Detects a new emitter at the address of a destroyed one
+			std::vector<BehaviorDataCPU> particles; //Live particles only
+			UINT capacity;
+		};
+
+		struct Job
+		{
+			EmitterData* emitter;
+			ID3D11Buffer* particles;
+			KernelParams params;
+			uint32_t features;
+			std::vector<Affector> affectors;
+			Mirror* mirror;
+			UINT offset; //First particle in the upload
+		};
+
+		ID3D11Device* device_;
+		WorkerPool& workers_;
+
+		std::unordered_map<const EmitterData*, Mirror> mirrors_;
+		std::vector<Job> jobs_;
+		std::vector<Result> results_;
+
+		//Every live particle of the frame, copied to the GPU at once
+		std::vector<BehaviorDataCPU> staging_;
+		ID3D11Buffer* bUpload_ = nullptr;
+		UINT uploadCapacity_ = 0;
+
+		//Moves every burst so two bursts never roll the same particles
+		float seed_ = 0.f;
+
+		Mirror* Find(const EmitterData* emitter);
+	};
+
+}
@@ -0,0 +1,260 @@
+/*******************************************************************************
+
+	@file       ParticleEngineCollision.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Static level colliders baked into a signed distance field.
+				Each texel holds the distance to the nearest collider and the
+				direction away from it, so the behavior kernels resolve a
+				collision with a single fetch per particle.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineCollision.h"	//This files header
+#include "ParticleEngineParallel.h"		//ParallelFor
+#include <cmath>						//std::sqrt std::cos
+#include <cfloat>						//FLT_MAX
+#include <fstream>						//Field files
+
+namespace ParticleEngine
+{
+
+namespace
+{
+	const uint32_t FileMagic = 0x44534550; //"PESD"
+	const uint32_t FileVersion = 1;
+
+	//Field files only hold the description and texels
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		float origin[2];
+		float cellSize;
+	};
+
+	float Length(float x, float y) { return std::sqrt(x * x + y * y); }
+
+	//Normal of a point sitting exactly on a center
+	void Normalize(float x, float y, float length, float normal[2])
+	{
+		if (length > 1e-6f)
+		{
+			normal[0] = x / length;
+			normal[1] = y / length;
+		}
+		else
+		{
+			normal[0] = 0.f;
+			normal[1] = 1.f;
+		}
+	}
+}
+
+CollisionField::CollisionField() noexcept
+{
+}
+
+void CollisionField::Reset(float originX, float originY, float cellSize, uint32_t width, uint32_t height)
+{
+	shapes_.clear();
+	texels_.clear();
+
+	view_ = CollisionFieldView();
+	view_.width = width;
+	view_.height = height;
+	view_.origin[0] = originX;
+	view_.origin[1] = originY;
+	view_.cellSize = cellSize > 0.f ? cellSize : 1.f;
+}
+
+void CollisionField::AddBox(float centerX, float centerY, float halfWidth, float halfHeight, float rotation)
+{
+	Shape shape = { Shape_Box, { centerX, centerY }, { std::abs(halfWidth), std::abs(halfHeight) }, 0.f,
+		std::cos(rotation), std::sin(rotation) };
+	shapes_.push_back(shape);
+}
+
+void CollisionField::AddCircle(float centerX, float centerY, float radius)
+{
+	Shape shape = { Shape_Circle, { centerX, centerY }, { 0.f, 0.f }, std::abs(radius), 1.f, 0.f };
+	shapes_.push_back(shape);
+}
+
+void CollisionField::AddCapsule(float ax, float ay, float bx, float by, float radius)
+{
+	Shape shape = { Shape_Capsule, { ax, ay }, { bx, by }, std::abs(radius), 1.f, 0.f };
+	shapes_.push_back(shape);
+}
+
+float CollisionField::Distance(const Shape& shape, float x, float y, float normal[2])
+{
+	switch (shape.type)
+	{
+	case Shape_Box:
+	{
+		//Into the space of the box
+		float dx = x - shape.a[0];
+		float dy = y - shape.a[1];
+		float localX = dx * shape.cos + dy * shape.sin;
+		float localY = -dx * shape.sin + dy * shape.cos;
+
+		float qx = std::abs(localX) - shape.b[0];
+		float qy = std::abs(localY) - shape.b[1];
+		float signX = localX < 0.f ? -1.f : 1.f;
+		float signY = localY < 0.f ? -1.f : 1.f;
+
+		float localNormal[2];
+		float distance;
+
+		if (qx > 0.f || qy > 0.f)
+		{
+			float ox = qx > 0.f ? qx : 0.f;
+			float oy = qy > 0.f ? qy : 0.f;
+			distance = Length(ox, oy);
+			Normalize(ox * signX, oy * signY, distance, localNormal);
+		}
+		else
+		{
+			//Inside, the nearest face is the one with the least penetration
+			distance = qx > qy ? qx : qy;
+			localNormal[0] = qx > qy ? signX : 0.f;
+			localNormal[1] = qx > qy ? 0.f : signY;
+		}
+
+		//Back to world space
+		normal[0] = localNormal[0] * shape.cos - localNormal[1] * shape.sin;
+		normal[1] = localNormal[0] * shape.sin + localNormal[1] * shape.cos;
+		return distance;
+	}
+	case Shape_Circle:
+	{
+		float dx = x - shape.a[0];
+		float dy = y - shape.a[1];
+		float length = Length(dx, dy);
+		Normalize(dx, dy, length, normal);
+		return length - shape.radius;
+	}
+	case Shape_Capsule:
+	{
+		//Closest point on the segment
+		float sx = shape.b[0] - shape.a[0];
+		float sy = shape.b[1] - shape.a[1];
+		float lengthSq = sx * sx + sy * sy;
+		float t = lengthSq > 0.f ? ((x - shape.a[0]) * sx + (y - shape.a[1]) * sy) / lengthSq : 0.f;
+		t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+
+		float dx = x - (shape.a[0] + sx * t);
+		float dy = y - (shape.a[1] + sy * t);
+		float length = Length(dx, dy);
+		Normalize(dx, dy, length, normal);
+		return length - shape.radius;
+	}
+	default:
+		normal[0] = 0.f;
+		normal[1] = 1.f;
+		return FLT_MAX;
+	}
+}
+
+void CollisionField::Bake(WorkerPool& workers)
+{
+	texels_.assign(static_cast<size_t>(view_.width) * view_.height, CollisionTexel{ FLT_MAX, { 0.f, 1.f }, 0.f });
+
+	//Rows are independent, a few rows per thread is plenty of work
+	ParallelFor(workers, view_.height, [&](unsigned, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t y = begin; y < end; ++y)
+		for (uint32_t x = 0; x < view_.width; ++x)
+		{
+			float worldX = view_.origin[0] + (x + .5f) * view_.cellSize;
+			float worldY = view_.origin[1] + (y + .5f) * view_.cellSize;
+			CollisionTexel& texel = texels_[static_cast<size_t>(y) * view_.width + x];
+
+			//The union of every collider is the nearest one
+			for (const Shape& shape : shapes_)
+			{
+				float normal[2];
+				float distance = Distance(shape, worldX, worldY, normal);
+
+				if (distance < texel.distance)
+				{
+					texel.distance = distance;
+					texel.normal[0] = normal[0];
+					texel.normal[1] = normal[1];
+				}
+			}
+		}
+	}, 16);
+
+	view_.texels = texels_.data();
+}
+
+bool CollisionField::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	FileHeader header = { FileMagic, FileVersion, view_.width, view_.height,
+		{ view_.origin[0], view_.origin[1] }, view_.cellSize };
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(texels_.data()), texels_.size() * sizeof(CollisionTexel));
+	return static_cast<bool>(file);
+}
+
+bool CollisionField::Load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	FileHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| header.magic != FileMagic || header.version != FileVersion)
+		return false;
+
+	std::vector<CollisionTexel> texels(static_cast<size_t>(header.width) * header.height);
+	if (!file.read(reinterpret_cast<char*>(texels.data()), texels.size() * sizeof(CollisionTexel)))
+		return false;
+
+	Reset(header.origin[0], header.origin[1], header.cellSize, header.width, header.height);
+	texels_.swap(texels);
+	view_.texels = texels_.data();
+	return true;
+}
+
+float CollisionField::Sample(float x, float y, float normal[2]) const
+{
+	normal[0] = 0.f;
+	normal[1] = 1.f;
+
+	if (texels_.empty())
+		return FLT_MAX;
+
+	//Same lookup as Kernels::Collide
+	float cellX = (x - view_.origin[0]) / view_.cellSize;
+	float cellY = (y - view_.origin[1]) / view_.cellSize;
+
+	if (!(cellX >= 0.f && cellY >= 0.f && cellX < view_.width && cellY < view_.height))
+		return FLT_MAX;
+
+	uint32_t tx = static_cast<uint32_t>(cellX);
+	uint32_t ty = static_cast<uint32_t>(cellY);
+	const CollisionTexel& texel = texels_[static_cast<size_t>(ty) * view_.width + tx];
+
+	normal[0] = texel.normal[0];
+	normal[1] = texel.normal[1];
+
+	float centerX = view_.origin[0] + (tx + .5f) * view_.cellSize;
+	float centerY = view_.origin[1] + (ty + .5f) * view_.cellSize;
+	return texel.distance + normal[0] * (x - centerX) + normal[1] * (y - centerY);
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,105 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineCollision.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Static level colliders baked into a signed distance field.
+				Each texel holds the distance to the nearest collider and the
+				direction away from it, so the behavior kernels resolve a
+				collision with a single fetch per particle.
+
+				This header only depends on the standard library so fields can
+				be baked offline by tools.
+
+*******************************************************************************/
+#include <cstdint>					//Fixed width integers
+#include <vector>					//Colliders and texels
+#include <string>					//File paths
+#include "ParticleEngineKernels.h"	//CollisionTexel CollisionFieldView
+
+namespace ParticleEngine
+{
+	class WorkerPool;
+
+	class CollisionField
+	{
+
+	public:
+
+		CollisionField() noexcept;
+
+		/// <summary>
+		/// Clears every collider and sizes the field. The field covers
+		/// width * cellSize by height * cellSize world units from the origin.
+		/// </summary>
+		void Reset(float originX, float originY, float cellSize, uint32_t width, uint32_t height);
+
+		/// <summary>
+		/// Adds a box rotated by rotation radians around its center
+		/// </summary>
+		void AddBox(float centerX, float centerY, float halfWidth, float halfHeight, float rotation = 0.f);
+
+		void AddCircle(float centerX, float centerY, float radius);
+
+		/// <summary>
+		/// Adds a segment from a to b with rounded ends, for walls and slopes
+		/// </summary>
+		void AddCapsule(float ax, float ay, float bx, float by, float radius);
+
+		/// <summary>
+		/// Computes every texel from the colliders added since Reset, rows are split across workers
+		/// </summary>
+		void Bake(WorkerPool& workers);
+
+		/// <summary>
+		/// Writes or reads a baked field so levels do not bake at load
+		/// </summary>
+		bool Save(const std::string& path) const;
+		bool Load(const std::string& path);
+
+		/// <summary>
+		/// Distance and normal at a world position, the same value the kernels use
+		/// </summary>
+		float Sample(float x, float y, float normal[2]) const;
+
+		bool Empty() const { return texels_.empty(); }
+		uint32_t Width() const { return view_.width; }
+		uint32_t Height() const { return view_.height; }
+		const std::vector<CollisionTexel>& Texels() const { return texels_; }
+
+		/// <summary>
+		/// View for KernelParams, valid until the field is reset, baked or loaded
+		/// </summary>
+		const CollisionFieldView& View() const { return view_; }
+
+	private:
+
+		enum ShapeType : uint32_t
+		{
+			Shape_Box,
+			Shape_Circle,
+			Shape_Capsule,
+		};
+
+		struct Shape
+		{
+			ShapeType type;
+			float a[2];	 //Box and circle center, capsule start
+			float b[2];	 //Box half extents, capsule end
+			float radius;
+			float cos;	 //Box rotation
+			float sin;
+		};
+
+		static float Distance(const Shape& shape, float x, float y, float normal[2]);
+
+		std::vector<Shape> shapes_;
+		std::vector<CollisionTexel> texels_;
+		CollisionFieldView view_;
+	};
+
+}
@@ -0,0 +1,256 @@
+/*******************************************************************************
+
+	@file       ParticleEngineCompactPass.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Moves the alive particles of an in place emitter to the front
+				of its pool. Survivors are appended to a shared scratch buffer
+				and copied back, the count never stalls the frame.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineCompactPass.h"	//This files header
+#include "ParticleEngineShaders.h"		//Compute shader loading helpers
+#include "ParticleEngineKernels.h"		//BehaviorDataCPU
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+#include <algorithm>					//std::min
+
+namespace ParticleEngine
+{
+//Must match CSParticleCompact.hlsl
+static constexpr UINT CompactThreads = 256;
+
+//Readbacks of emitters that did not compact for this many frames are released
+static constexpr UINT CompactStateLifetime = 120;
+
+CompactPass::CompactPass(ID3D11Device* device) noexcept :
+	device_(device)
+{
+	csAppendAlive_ = LoadComputeShader(device, L"./shaders/CSParticleCompact_AppendAlive.cso",
+		L"./shaders/CSParticleCompact.hlsl", "AppendAlive");
+	csCopyBack_ = LoadComputeShader(device, L"./shaders/CSParticleCompact_CopyBack.cso",
+		L"./shaders/CSParticleCompact.hlsl", "CopyBack");
+
+	try
+	{
+		HRESULT hr = S_OK;
+
+		CreateConstantBuffer(device, sizeof(cbCompactParams), &cbCompactParams_);
+
+		//CopyStructureCount writes here so it lives on the GPU
+		D3D11_BUFFER_DESC Desc = {};
+		Desc.Usage		= D3D11_USAGE_DEFAULT;
+		Desc.BindFlags	= D3D11_BIND_CONSTANT_BUFFER;
+		Desc.ByteWidth	= 16;
+
+		INFO_SET device->CreateBuffer(&Desc, nullptr, &cbCompactCount_);
+		DX_EXCEPT(hr);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle compaction failed to create its constant buffers");
+		RELEASE(cbCompactParams_);
+		RELEASE(cbCompactCount_);
+	}
+}
+
+CompactPass::~CompactPass() noexcept
+{
+	for (auto& state : states_)
+		Release(state.second);
+
+	RELEASE(csAppendAlive_);
+	RELEASE(csCopyBack_);
+	RELEASE(cbCompactParams_);
+	RELEASE(cbCompactCount_);
+	RELEASE(bScratch_);
+	RELEASE(rvScratch_);
+	RELEASE(uavScratch_);
+}
+
+void CompactPass::Release(CompactState& state)
+{
+	for (Readback& readback : state.readbacks)
+	{
+		RELEASE(readback.staging);
+		readback.pending = false;
+	}
+}
+
+bool CompactPass::Reserve(UINT count)
+{
+	if (scratchCapacity_ >= count)
+		return true;
+
+	RELEASE(bScratch_);
+	RELEASE(rvScratch_);
+	RELEASE(uavScratch_);
+	scratchCapacity_ = 0;
+
+	try
+	{
+		CreateStructuredBuffer(device_, sizeof(BehaviorDataCPU), count, nullptr,
+			&bScratch_, &rvScratch_, &uavScratch_, D3D11_BUFFER_UAV_FLAG_APPEND);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle compaction failed to create its scratch buffer");
+		RELEASE(bScratch_);
+		RELEASE(rvScratch_);
+		RELEASE(uavScratch_);
+		return false;
+	}
+
+	scratchCapacity_ = count;
+	return true;
+}
+
+UINT CompactPass::Compact(ID3D11DeviceContext* deviceContext, const EmitterData* emitter,
+	ID3D11UnorderedAccessView* particles, UINT alive)
+{
+	CompactState& state = states_[emitter];
+	state.lastUsedFrame = frame_;
+
+	//Growth since the last compact was spawned. Anything smaller means the
+	//emitter was emptied or restored and older counts no longer apply.
+	if (alive >= state.lastAlive)
+	{
+		state.spawned += alive - state.lastAlive;
+	}
+	else
+	{
+		for (Readback& readback : state.readbacks)
+			readback.pending = false;
+	}
+
+	state.lastAlive = alive;
+
+	if (!IsReady() || alive == 0 || !Reserve(alive))
+		return alive;
+
+	//Slots past the alive count are dead, only the front is scanned
+	cbCompactParams params = {};
+	params.count = alive;
+	UpdateConstantBuffer(deviceContext, cbCompactParams_, &params, sizeof(params));
+
+	UINT groups = (alive + CompactThreads - 1) / CompactThreads;
+
+	ID3D11Buffer* cbIN[2] = { cbCompactParams_, cbCompactCount_ };
+	deviceContext->CSSetConstantBuffers(3, 2, cbIN);
+
+	//Survivors are appended to the empty scratch buffer
+	UINT initialCounts[2] = { 0, 0 };
+	ID3D11UnorderedAccessView* uavAppend[2] = { particles, uavScratch_ };
+	deviceContext->CSSetUnorderedAccessViews(0, 2, uavAppend, initialCounts);
+	deviceContext->CSSetShader(csAppendAlive_, nullptr, 0u);
+	deviceContext->Dispatch(groups, 1, 1);
+
+	ID3D11UnorderedAccessView* uavNULL[1] = { nullptr };
+	deviceContext->CSSetUnorderedAccessViews(1, 1, uavNULL, nullptr);
+
+	//Then copied back over the front of the pool, the rest is marked dead
+	deviceContext->CopyStructureCount(cbCompactCount_, 0, uavScratch_);
+
+	ID3D11ShaderResourceView* rvScratch[1] = { rvScratch_ };
+	deviceContext->CSSetShaderResources(0, 1, rvScratch);
+	deviceContext->CSSetShader(csCopyBack_, nullptr, 0u);
+	deviceContext->Dispatch(groups, 1, 1);
+
+	// Ensures all buffers are unset
+	deviceContext->CSSetUnorderedAccessViews(0, 1, uavNULL, nullptr);
+
+	ID3D11ShaderResourceView* rvNULL[1] = { nullptr };
+	deviceContext->CSSetShaderResources(0, 1, rvNULL);
+
+	ID3D11Buffer* bNULL[2] = { nullptr, nullptr };
+	deviceContext->CSSetConstantBuffers(3, 2, bNULL);
+
+	deviceContext->CSSetShader(nullptr, nullptr, 0);
+
+	Poll(deviceContext, state, alive);
+	Issue(deviceContext, state);
+
+	state.lastAlive = alive;
+	return alive;
+}
+
+void CompactPass::Poll(ID3D11DeviceContext* deviceContext, CompactState& state, UINT& alive)
+{
+	for (Readback& readback : state.readbacks)
+	{
+		if (!readback.pending)
+			continue;
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(deviceContext->Map(readback.staging, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+			continue;
+
+		UINT survivors = *static_cast<const UINT*>(mapped.pData);
+		deviceContext->Unmap(readback.staging, 0);
+		readback.pending = false;
+
+		//Every compact since then packed the pool again, so the particles alive
+		//now are at most the survivors then plus everything spawned after
+		alive = std::min(alive, survivors + (state.spawned - readback.spawnedAtIssue));
+	}
+}
+
+void CompactPass::Issue(ID3D11DeviceContext* deviceContext, CompactState& state)
+{
+	Readback& readback = state.readbacks[state.next];
+
+	//A count that has not come back yet keeps its slot, this frame goes without
+	if (readback.pending)
+		return;
+
+	if (!readback.staging)
+	{
+		D3D11_BUFFER_DESC Desc = {};
+		Desc.Usage			= D3D11_USAGE_STAGING;
+		Desc.BindFlags		= 0;
+		Desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		Desc.ByteWidth		= 16;
+
+		if (FAILED(device_->CreateBuffer(&Desc, nullptr, &readback.staging)))
+			return;
+	}
+
+	deviceContext->CopyStructureCount(readback.staging, 0, uavScratch_);
+	readback.spawnedAtIssue = state.spawned;
+	readback.pending = true;
+	state.next = (state.next + 1) % ReadbackLatency;
+}
+
+void CompactPass::Forget(const EmitterData* emitter)
+{
+	auto found = states_.find(emitter);
+	if (found == states_.end())
+		return;
+
+	Release(found->second);
+	states_.erase(found);
+}
+
+void CompactPass::BeginFrame()
+{
+	frame_++;
+
+	for (auto it = states_.begin(); it != states_.end();)
+	{
+		if (frame_ - it->second.lastUsedFrame > CompactStateLifetime)
+		{
+			Release(it->second);
+			it = states_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+}//End of Particle Engine NameSpace
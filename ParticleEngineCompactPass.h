@@ -0,0 +1,115 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineCompactPass.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Moves the alive particles of an in place emitter to the front
+				of its pool. In place emitters have a single particle buffer so
+				the alive and dead partition of the emitter, which reads one
+				buffer and writes the other, can not be used on them. Survivors
+				are appended to a shared scratch buffer and copied back.
+
+*******************************************************************************/
+#include <d3d11.h>			//DirectX header
+#include <unordered_map>	//Per emitter alive count readbacks
+
+namespace ParticleEngine
+{
+	class EmitterData;
+
+	class CompactPass
+	{
+
+	public:
+
+		//Constructors
+		CompactPass(ID3D11Device* device) noexcept;
+		~CompactPass() noexcept;
+		CompactPass(const CompactPass&) = delete;
+		CompactPass& operator=(const CompactPass&) = delete;
+
+		/// <summary>
+		/// False if the kernels failed to load, emitters must then keep two buffers
+		/// </summary>
+		bool IsReady() const { return csAppendAlive_ && csCopyBack_ && cbCompactCount_; }
+
+		/// <summary>
+		/// Packs the alive particles among the first alive slots of the pool
+		/// to its front and marks every slot behind them dead. Returns the new
+		/// alive count. The exact count is read back a few frames late without
+		/// stalling, until then the result is an upper bound that only covers
+		/// dead slots behind the survivors.
+		/// </summary>
+		UINT Compact(ID3D11DeviceContext* deviceContext, const EmitterData* emitter,
+			ID3D11UnorderedAccessView* particles, UINT alive);
+
+		/// <summary>
+		/// Call once per frame, releases readbacks of emitters that stopped compacting
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		/// Drops the counts of an emitter whose pool was resized, readbacks in flight no longer apply
+		/// </summary>
+		void Forget(const EmitterData* emitter);
+
+	private:
+
+		//Frames a count may take to come back before its slot is reused
+		static constexpr UINT ReadbackLatency = 3;
+
+		struct Readback
+		{
+			ID3D11Buffer* staging = nullptr;
+			UINT spawnedAtIssue = 0; //spawned of the state when the count was copied
+			bool pending = false;
+		};
+
+		struct CompactState
+		{
+			Readback readbacks[ReadbackLatency];
+			UINT next = 0;
+			UINT lastAlive = 0;	//What the last compact returned
+			UINT spawned = 0;	//Particles added between compacts, wraps
+			UINT lastUsedFrame = 0;
+		};
+
+		//Matches CompactParams in CSParticleCompact.hlsl
+		struct cbCompactParams
+		{
+			UINT count;
+			UINT pad[3];
+		};
+
+		ID3D11Device* device_;
+		ID3D11ComputeShader* csAppendAlive_ = nullptr;
+		ID3D11ComputeShader* csCopyBack_ = nullptr;
+		ID3D11Buffer* cbCompactParams_ = nullptr;
+		ID3D11Buffer* cbCompactCount_ = nullptr;
+
+		//Survivors of one emitter at a time, grown to the largest pool compacted
+		ID3D11Buffer*			   bScratch_ = nullptr;
+		ID3D11ShaderResourceView*  rvScratch_ = nullptr;
+		ID3D11UnorderedAccessView* uavScratch_ = nullptr;
+		UINT scratchCapacity_ = 0;
+
+		std::unordered_map<const EmitterData*, CompactState> states_;
+		UINT frame_ = 0;
+
+		//Grows the scratch buffer, false if it could not be created
+		bool Reserve(UINT count);
+
+		//Lowers alive with any counts that came back
+		void Poll(ID3D11DeviceContext* deviceContext, CompactState& state, UINT& alive);
+
+		//Copies the survivor count of this compact into a free readback
+		void Issue(ID3D11DeviceContext* deviceContext, CompactState& state);
+
+		static void Release(CompactState& state);
+	};
+
+}
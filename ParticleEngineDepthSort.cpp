@@ -0,0 +1,232 @@
+/*******************************************************************************
+
+	@file       ParticleEngineDepthSort.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Sorts the alive particles of an emitter back to front on the
+				GPU so alpha blended effects draw in the right order. The
+				renderer reads particles through the sorted index buffer.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineDepthSort.h"	//This files header
+#include "ParticleEngineShaders.h"		//Compute shader loading helpers
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+
+namespace ParticleEngine
+{
+//Must match CSParticleSort.hlsl. SortThreads is GLOBAL_THREADS, the group size
+//of BuildKeys and MergeGlobal, the block sorts run SORT_THREADS = SortBlock / 2
+static constexpr UINT SortBlock = 1024;
+static constexpr UINT SortThreads = 256;
+
+//Sort buffers of emitters that were not sorted for this many frames are released
+static constexpr UINT SortStateLifetime = 120;
+
+DepthSorter::DepthSorter(ID3D11Device* device) noexcept :
+	device_(device), params_{}
+{
+	const wchar_t* source = L"./shaders/CSParticleSort.hlsl";
+	csBuildKeys_   = LoadComputeShader(device, L"./shaders/CSParticleSort_BuildKeys.cso",	source, "BuildKeys");
+	csSortLocal_   = LoadComputeShader(device, L"./shaders/CSParticleSort_SortLocal.cso",	source, "SortLocal");
+	csMergeLocal_  = LoadComputeShader(device, L"./shaders/CSParticleSort_MergeLocal.cso",	source, "MergeLocal");
+	csMergeGlobal_ = LoadComputeShader(device, L"./shaders/CSParticleSort_MergeGlobal.cso", source, "MergeGlobal");
+
+	try
+	{
+		CreateConstantBuffer(device, sizeof(cbSortParams), &cbSortParams_);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle depth sort failed to create its buffers");
+	}
+
+	params_.cameraForward = DirectX::XMFLOAT4(0.f, 0.f, 1.f, 0.f);
+}
+
+DepthSorter::~DepthSorter() noexcept
+{
+	for (auto& state : states_)
+		Release(state.second);
+
+	RELEASE(csBuildKeys_);
+	RELEASE(csSortLocal_);
+	RELEASE(csMergeLocal_);
+	RELEASE(csMergeGlobal_);
+	RELEASE(cbSortParams_);
+}
+
+void DepthSorter::SetCamera(const DirectX::XMFLOAT4& position, const DirectX::XMFLOAT4& forward)
+{
+	params_.cameraPosition = position;
+	params_.cameraForward = forward;
+}
+
+void DepthSorter::Release(SortState& state)
+{
+	RELEASE(state.bKeys);
+	RELEASE(state.bValues);
+	RELEASE(state.uavKeys);
+	RELEASE(state.uavValues);
+	RELEASE(state.rvValues);
+	state.capacity = 0;
+	state.count = 0;
+}
+
+void DepthSorter::Reserve(SortState& state, UINT capacity)
+{
+	if (state.capacity >= capacity)
+		return;
+
+	Release(state);
+
+	CreateStructuredBuffer(device_, sizeof(UINT), capacity, nullptr, &state.bKeys, nullptr, &state.uavKeys);
+	CreateStructuredBuffer(device_, sizeof(UINT), capacity, nullptr, &state.bValues, &state.rvValues, &state.uavValues);
+
+	state.capacity = capacity;
+}
+
+void DepthSorter::Dispatch(ID3D11DeviceContext* deviceContext, ID3D11ComputeShader* shader, UINT groups)
+{
+	if (groups == 0)
+		return;
+
+	UpdateConstantBuffer(deviceContext, cbSortParams_, &params_, sizeof(params_));
+	deviceContext->CSSetShader(shader, nullptr, 0u);
+	deviceContext->Dispatch(groups, 1, 1);
+}
+
+ID3D11ShaderResourceView* DepthSorter::Sort(ID3D11DeviceContext* deviceContext, const EmitterData* emitter,
+	ID3D11ShaderResourceView* particles, UINT aliveParticles)
+{
+	if (!csBuildKeys_ || !csSortLocal_ || !csMergeLocal_ || !csMergeGlobal_ || !cbSortParams_ || aliveParticles == 0)
+		return nullptr;
+
+	SortState& state = states_[emitter];
+	state.lastUsedFrame = frame_;
+
+	//Bitonic sort works on a power of two, at least one shared memory block
+	UINT count = SortBlock;
+	while (count < aliveParticles)
+		count <<= 1;
+
+	try
+	{
+		Reserve(state, count);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle depth sort failed to create its buffers");
+		Release(state);
+		return nullptr;
+	}
+
+	//Last frames order is a permutation of the same slots only if the alive count is unchanged
+	bool incremental = state.count == count
+		&& state.aliveParticles == aliveParticles
+		&& state.framesSinceFull < fullSortInterval;
+
+	ID3D11ShaderResourceView* rvIN[1] = { particles };
+	deviceContext->CSSetShaderResources(0, 1, rvIN);
+
+	ID3D11UnorderedAccessView* uavOut[2] = { state.uavKeys, state.uavValues };
+	deviceContext->CSSetUnorderedAccessViews(0, 2, uavOut, nullptr);
+
+	deviceContext->CSSetConstantBuffers(0, 1, &cbSortParams_);
+
+	params_.alive = aliveParticles;
+	params_.count = count;
+	params_.k = 0;
+	params_.j = 0;
+	params_.offset = 0;
+	params_.usePrevious = incremental ? 1 : 0;
+	params_.ascending = incremental ? 1 : 0;
+
+	Dispatch(deviceContext, csBuildKeys_, (count + SortThreads - 1) / SortThreads);
+
+	if (incremental)
+	{
+		//Particles barely move between frames so the last order is nearly sorted.
+		//Sorting overlapping windows lets every particle move up to half a block a frame.
+		Dispatch(deviceContext, csSortLocal_, count / SortBlock);
+
+		params_.offset = SortBlock / 2;
+		Dispatch(deviceContext, csSortLocal_, count / SortBlock - 1);
+
+		state.framesSinceFull++;
+	}
+	else
+	{
+		//Full bitonic sort, stages that fit a block run in shared memory
+		Dispatch(deviceContext, csSortLocal_, count / SortBlock);
+
+		for (UINT k = SortBlock * 2; k <= count; k <<= 1)
+		{
+			params_.k = k;
+
+			for (UINT j = k >> 1; j >= SortBlock; j >>= 1)
+			{
+				params_.j = j;
+				Dispatch(deviceContext, csMergeGlobal_, (count / 2 + SortThreads - 1) / SortThreads);
+			}
+
+			Dispatch(deviceContext, csMergeLocal_, count / SortBlock);
+		}
+
+		state.framesSinceFull = 0;
+	}
+
+	state.count = count;
+	state.aliveParticles = aliveParticles;
+
+	// Ensures all buffers are unset
+	ID3D11UnorderedAccessView* uavNULL[2] = { nullptr, nullptr };
+	deviceContext->CSSetUnorderedAccessViews(0, 2, uavNULL, nullptr);
+
+	ID3D11ShaderResourceView* rvNULL[1] = { nullptr };
+	deviceContext->CSSetShaderResources(0, 1, rvNULL);
+
+	deviceContext->CSSetShader(nullptr, nullptr, 0);
+
+	return state.rvValues;
+}
+
+ID3D11ShaderResourceView* DepthSorter::GetSortedIndices(const EmitterData* emitter) const
+{
+	auto found = states_.find(emitter);
+	return found != states_.end() && found->second.lastUsedFrame == frame_ ? found->second.rvValues : nullptr;
+}
+
+void DepthSorter::Forget(const EmitterData* emitter)
+{
+	auto found = states_.find(emitter);
+	if (found == states_.end())
+		return;
+
+	Release(found->second);
+	states_.erase(found);
+}
+
+void DepthSorter::BeginFrame()
+{
+	for (auto it = states_.begin(); it != states_.end();)
+	{
+		if (frame_ - it->second.lastUsedFrame > SortStateLifetime)
+		{
+			Release(it->second);
+			it = states_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	frame_++;
+}
+
+}//End of Particle Engine NameSpace
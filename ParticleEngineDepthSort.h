@@ -0,0 +1,123 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineDepthSort.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Sorts the alive particles of an emitter back to front on the
+				GPU so alpha blended effects draw in the right order. The
+				renderer reads particles through the sorted index buffer.
+
+*******************************************************************************/
+#include <d3d11.h>			//DirectX header
+#include <DirectXMath.h>	//XMFLOAT4
+#include <unordered_map>	//Per emitter sort state
+
+namespace ParticleEngine
+{
+	class EmitterData;
+
+	class DepthSorter
+	{
+
+	public:
+
+		//Constructors
+		DepthSorter(ID3D11Device* device) noexcept;
+		~DepthSorter() noexcept;
+		DepthSorter(const DepthSorter&) = delete;
+		DepthSorter& operator=(const DepthSorter&) = delete;
+
+		/// <summary>
+		/// Sets the camera used for depth, forward does not need to be normalized
+		/// </summary>
+		void SetCamera(const DirectX::XMFLOAT4& position, const DirectX::XMFLOAT4& forward);
+
+		/// <summary>
+		/// Sorts the alive particles of an emitter. particles is a view of its
+		/// BehaviorData buffer after the alive and dead partition. Returns the
+		/// sorted index buffer, the first alive entries are back to front.
+		/// </summary>
+		ID3D11ShaderResourceView* Sort(ID3D11DeviceContext* deviceContext, const EmitterData* emitter,
+			ID3D11ShaderResourceView* particles, UINT aliveParticles);
+
+		/// <summary>
+		/// Returns the sorted indices from the last sort of an emitter or nullptr
+		/// </summary>
+		ID3D11ShaderResourceView* GetSortedIndices(const EmitterData* emitter) const;
+
+		/// <summary>
+		/// Call once per frame before sorting, releases buffers of emitters that
+		/// were not sorted for a while
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		/// Releases the sort buffers of an emitter whose pool was resized, its next sort starts over
+		/// </summary>
+		void Forget(const EmitterData* emitter);
+
+		/// <summary>
+		/// While the alive count is unchanged only windows of the last order are
+		/// re-sorted, every this many frames a full sort is done regardless.
+		/// </summary>
+		UINT fullSortInterval = 8;
+
+	private:
+
+		struct SortState
+		{
+			ID3D11Buffer*			   bKeys = nullptr;
+			ID3D11Buffer*			   bValues = nullptr;
+			ID3D11UnorderedAccessView* uavKeys = nullptr;
+			ID3D11UnorderedAccessView* uavValues = nullptr;
+			ID3D11ShaderResourceView*  rvValues = nullptr;
+
+			UINT capacity = 0;		  //Slots in the buffers, power of two
+			UINT count = 0;			  //Slots sorted last frame
+			UINT aliveParticles = 0;  //Alive count sorted last frame
+			UINT framesSinceFull = 0;
+			UINT lastUsedFrame = 0;
+		};
+
+		//Parameters for a single sort dispatch, matches SortParams in CSParticleSort.hlsl
+		struct cbSortParams
+		{
+			DirectX::XMFLOAT4 cameraPosition;
+			DirectX::XMFLOAT4 cameraForward;
+			UINT alive;
+			UINT count;
+			UINT k;
+			UINT j;
+			UINT offset;
+			UINT usePrevious;
+			UINT ascending;
+			UINT pad;
+		};
+
+		ID3D11Device* device_;
+
+		ID3D11ComputeShader* csBuildKeys_ = nullptr;
+		ID3D11ComputeShader* csSortLocal_ = nullptr;
+		ID3D11ComputeShader* csMergeLocal_ = nullptr;
+		ID3D11ComputeShader* csMergeGlobal_ = nullptr;
+
+		ID3D11Buffer* cbSortParams_ = nullptr;
+		cbSortParams params_;
+
+		std::unordered_map<const EmitterData*, SortState> states_;
+		UINT frame_ = 0;
+
+		//Grows the buffers of a sort state
+		void Reserve(SortState& state, UINT capacity);
+
+		static void Release(SortState& state);
+
+		//Uploads params_ and runs one shader
+		void Dispatch(ID3D11DeviceContext* deviceContext, ID3D11ComputeShader* shader, UINT groups);
+	};
+
+}
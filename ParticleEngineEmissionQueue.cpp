@@ -0,0 +1,161 @@
+/*******************************************************************************
+
+	@file       ParticleEngineEmissionQueue.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Bounded lock free queue of emission requests. Any thread, such
+				as a gameplay script or a job, can push a request while the
+				engine drains the queue once per frame on the main thread and
+				hands each request to the spawn path of its emitter.
+
+*******************************************************************************/
+#include "stdafx.h"							//Header included in all files.
+#include "ParticleEngineEmissionQueue.h"	//This files header
+#include <utility>							//std::move
+
+namespace ParticleEngine
+{
+
+EmissionQueue::EmissionQueue(uint32_t capacity) :
+	capacity_(2), pushPosition_(0), popPosition_(0), dropped_(0)
+{
+	while (capacity_ < capacity)
+		capacity_ <<= 1;
+
+	mask_ = capacity_ - 1;
+	slots_ = std::make_unique<Slot[]>(capacity_);
+
+	//A slot is free for the producer whose position matches its sequence
+	for (uint32_t i = 0; i < capacity_; ++i)
+		slots_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+EmissionQueue::Slot* EmissionQueue::Claim(size_t& position)
+{
+	position = pushPosition_.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		Slot& slot = slots_[position & mask_];
+		size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+		if (difference == 0)
+		{
+			//Another producer may take the slot first, then position is reloaded
+			if (pushPosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				return &slot;
+		}
+		else if (difference < 0)
+		{
+			//The consumer has not freed this slot yet
+			return nullptr;
+		}
+		else
+		{
+			position = pushPosition_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool EmissionQueue::ClaimRange(uint32_t count, size_t& position)
+{
+	position = pushPosition_.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		//Slots are freed in order, so if the last one is free the rest are too
+		Slot& last = slots_[(position + count - 1) & mask_];
+		size_t sequence = last.sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)(position + count - 1);
+
+		if (difference == 0)
+		{
+			if (pushPosition_.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+				return true;
+		}
+		else if (difference < 0)
+		{
+			return false;
+		}
+		else
+		{
+			position = pushPosition_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+uint32_t EmissionQueue::PushBatch(EmissionRequest* requests, uint32_t count)
+{
+	if (count == 0)
+		return 0;
+
+	size_t position;
+	if (count <= capacity_ && ClaimRange(count, position))
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Slot& slot = slots_[(position + i) & mask_];
+			slot.request = std::move(requests[i]);
+			slot.sequence.store(position + i + 1, std::memory_order_release);
+		}
+
+		return count;
+	}
+
+	//Not enough room for the whole batch, keep what fits
+	uint32_t pushed = 0;
+	while (pushed < count && Push(std::move(requests[pushed])))
+		pushed++;
+
+	if (pushed < count)
+		dropped_.fetch_add(count - pushed - 1, std::memory_order_relaxed);
+
+	return pushed;
+}
+
+bool EmissionQueue::Push(const EmissionRequest& request)
+{
+	return Push(EmissionRequest(request));
+}
+
+bool EmissionQueue::Push(EmissionRequest&& request)
+{
+	size_t position;
+	Slot* slot = Claim(position);
+
+	if (!slot)
+	{
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	slot->request = std::move(request);
+
+	//Publishes the request to the consumer
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+bool EmissionQueue::Pop(EmissionRequest& request)
+{
+	Slot& slot = slots_[popPosition_ & mask_];
+	size_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+	//Empty, or the producer of the next slot has not finished writing
+	if (sequence != popPosition_ + 1)
+		return false;
+
+	request = std::move(slot.request);
+	slot.request.emitter.reset();
+
+	//Frees the slot for the producer one lap ahead
+	slot.sequence.store(popPosition_ + capacity_, std::memory_order_release);
+	popPosition_++;
+	return true;
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,133 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineEmissionQueue.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Bounded lock free queue of emission requests. Any thread, such
+				as a gameplay script or a job, can push a request while the
+				engine drains the queue once per frame on the main thread and
+				hands each request to the spawn path of its emitter.
+
+*******************************************************************************/
+#include <cstdint>	//Fixed width integers
+#include <cstddef>	//size_t
+#include <atomic>	//Slot sequences and positions
+#include <memory>	//std::weak_ptr std::unique_ptr
+
+namespace ParticleEngine
+{
+	class EmitterData;
+
+	/// <summary>
+	/// Settings an emission request replaces for its emission only
+	/// </summary>
+	enum EmissionOverride : uint32_t
+	{
+		Override_None	   = 0,
+		Override_Position  = 1 << 0,	//position is the world position of the emitter
+		Override_Direction = 1 << 1,	//direction is [0]min [1]max degrees
+		Override_Speed	   = 1 << 2,	//speed is [0]min [1]max
+		Override_Lifetime  = 1 << 3,	//lifetime is [0]min [1]max
+	};
+
+	/// <summary>
+	/// One emission asked for by any thread
+	/// </summary>
+	struct EmissionRequest
+	{
+		std::weak_ptr<EmitterData> emitter;	//Expired emitters are skipped
+		int count = -1;						//Particles to emit, negative uses the emission amount
+		float delay = 0.f;					//Seconds to wait, zero emits when drained
+		uint32_t overrides = Override_None;	//EmissionOverride flags
+		float position[3] = { 0.f, 0.f, 0.f };
+		float direction[2] = { 0.f, 0.f };
+		float speed[2] = { 0.f, 0.f };
+		float lifetime[2] = { 0.f, 0.f };
+	};
+
+	class EmissionQueue
+	{
+
+	public:
+
+		static constexpr uint32_t DefaultCapacity = 4096;
+
+		//Capacity is rounded up to a power of two
+		explicit EmissionQueue(uint32_t capacity = DefaultCapacity);
+		EmissionQueue(const EmissionQueue&) = delete;
+		EmissionQueue& operator=(const EmissionQueue&) = delete;
+
+		/// <summary>
+		/// Adds a request, safe from any thread. Returns false and counts the
+		/// request as dropped if the queue is full.
+		/// </summary>
+		bool Push(const EmissionRequest& request);
+		bool Push(EmissionRequest&& request);
+
+		/// <summary>
+		/// Adds count requests with a single claim when there is room for all
+		/// of them, otherwise one at a time until the queue is full. Requests
+		/// are moved from. Returns how many were added.
+		/// </summary>
+		uint32_t PushBatch(EmissionRequest* requests, uint32_t count);
+
+		/// <summary>
+		/// Calls func(EmissionRequest&) for every request pushed before the
+		/// call. Only one thread may drain. Returns the requests drained.
+		/// </summary>
+		template <typename Func>
+		uint32_t Drain(Func&& func)
+		{
+			//Requests pushed while draining wait for the next frame so one producer can not starve it
+			uint32_t limit = capacity_;
+			uint32_t drained = 0;
+
+			EmissionRequest request;
+			while (drained < limit && Pop(request))
+			{
+				func(request);
+				drained++;
+			}
+
+			return drained;
+		}
+
+		/// <summary>
+		/// Returns and resets the requests dropped since the last call
+		/// </summary>
+		uint32_t TakeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+		uint32_t Capacity() const { return capacity_; }
+
+	private:
+
+		struct Slot
+		{
+			std::atomic<size_t> sequence;
+			EmissionRequest request;
+		};
+
+		std::unique_ptr<Slot[]> slots_;
+		uint32_t capacity_;
+		size_t mask_;
+
+		//Producers and the consumer touch different lines
+		alignas(64) std::atomic<size_t> pushPosition_;
+		alignas(64) size_t popPosition_;
+		alignas(64) std::atomic<uint32_t> dropped_;
+
+		//Claims a slot for a producer, nullptr if the queue is full
+		Slot* Claim(size_t& position);
+
+		//Claims count slots in a row, false if they are not all free
+		bool ClaimRange(uint32_t count, size_t& position);
+
+		//Takes the oldest request, single consumer
+		bool Pop(EmissionRequest& request);
+	};
+
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+
+	@file       ParticleEngineEmitterPool.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Pool of emitter storage. Components take an emitter the first
+				time they emit and drop it once every particle has been dead
+				for a while, the buffers go back here and the next component
+				that needs the same pool size reuses them instead of creating
+				new GPU resources.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineEmitterPool.h"	//This files header
+#include "ParticleEngine.h"				//Contains the Particle Engine namepspace
+
+namespace ParticleEngine
+{
+
+EmitterPool::EmitterPool(EmitterManager& emitterManager) noexcept :
+	emitterManager_(emitterManager), self_(std::make_shared<EmitterPool*>(this))
+{
+}
+
+std::shared_ptr<EmitterData> EmitterPool::Acquire(uint32_t capacity, bool singleBuffer)
+{
+	//An exact match first, single buffer emitters can also take a double buffered one
+	auto found = free_.end();
+	for (auto entry = free_.begin(); entry != free_.end(); ++entry)
+	{
+		if (entry->capacity != capacity || (entry->singleBuffer && !singleBuffer))
+			continue;
+
+		found = entry;
+		if (entry->singleBuffer == singleBuffer)
+			break;
+	}
+
+	std::shared_ptr<EmitterData> storage;
+	if (found != free_.end())
+	{
+		storage = std::move(found->storage);
+		*found = std::move(free_.back());
+		free_.pop_back();
+
+		stats_.reused++;
+		stats_.pooled--;
+		stats_.pooledParticles -= capacity;
+	}
+	else
+	{
+		//The emitter manager keeps updating the storage for as long as the pool holds it
+		storage = emitterManager_.CreateEmitter(capacity);
+		stats_.created++;
+	}
+
+	if (!storage)
+		return nullptr;
+
+	//A new owner over the same storage, its last reference returns the storage
+	EmitterData* emitter = storage.get();
+	std::weak_ptr<EmitterPool*> pool = self_;
+	return std::shared_ptr<EmitterData>(emitter, [storage, capacity, pool](EmitterData*)
+	{
+		if (auto owner = pool.lock())
+			(*owner)->Return(storage, capacity);
+	});
+}
+
+void EmitterPool::Return(std::shared_ptr<EmitterData> storage, uint32_t capacity)
+{
+	returned_.push_back({ std::move(storage), capacity, false });
+}
+
+void EmitterPool::Recycle(const std::function<bool(EmitterData&, uint32_t& capacity)>& reset)
+{
+	for (Entry& entry : returned_)
+	{
+		//Particles of the last owner must not show up for the next one. Storage
+		//that is destroyed is reset too, a new emitter may get its address.
+		entry.singleBuffer = reset(*entry.storage, entry.capacity);
+
+		if (stats_.pooledParticles + entry.capacity > maxPooledParticles_)
+			continue;
+
+		stats_.pooled++;
+		stats_.pooledParticles += entry.capacity;
+		free_.push_back(std::move(entry));
+	}
+
+	//What did not fit is released here, the emitter manager drops it on its next update
+	returned_.clear();
+}
+
+}//End of Particle Engine NameSpace
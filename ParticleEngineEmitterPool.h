@@ -0,0 +1,92 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineEmitterPool.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Pool of emitter storage. Components take an emitter the first
+				time they emit and drop it once every particle has been dead
+				for a while, the buffers go back here and the next component
+				that needs the same pool size reuses them instead of creating
+				new GPU resources.
+
+*******************************************************************************/
+#include "ParticleEngineEmitter.h"	//Class Definition for A Particle Emitter
+#include <cstdint>					//Fixed width integers
+#include <functional>				//Reset callback
+#include <memory>					//std::shared_ptr
+#include <vector>					//Pooled storage
+
+namespace ParticleEngine
+{
+	class EmitterPool
+	{
+
+	public:
+
+		struct Stats
+		{
+			uint32_t created = 0;		 //Emitters created because nothing fit
+			uint32_t reused = 0;		 //Emitters handed out from the pool
+			uint32_t pooled = 0;		 //Emitters waiting in the pool
+			uint32_t pooledParticles = 0; //Particles the waiting emitters hold
+		};
+
+		//Constructors
+		explicit EmitterPool(EmitterManager& emitterManager) noexcept;
+		EmitterPool(const EmitterPool&) = delete;
+		EmitterPool& operator=(const EmitterPool&) = delete;
+
+		/// <summary>
+		/// Returns an emitter that holds capacity particles, reusing pooled
+		/// storage when one fits. Every call returns a new owner so handles
+		/// taken from a previous owner expire, dropping the last reference
+		/// hands the storage back to the pool while it still exists.
+		/// singleBuffer emitters can reuse storage that already shares its
+		/// in and out buffers, other emitters need both buffers.
+		/// </summary>
+		std::shared_ptr<EmitterData> Acquire(uint32_t capacity, bool singleBuffer);
+
+		/// <summary>
+		/// Called by the behavior once per frame. Storage handed back since the
+		/// last call is cleared by reset and becomes available, reset returns
+		/// true if the emitter only has a single buffer. Owners can resize
+		/// their storage so reset also sets the capacity it holds now.
+		/// Storage past the pool limit is reset as well and then destroyed.
+		/// </summary>
+		void Recycle(const std::function<bool(EmitterData&, uint32_t& capacity)>& reset);
+
+		/// <summary>
+		/// Most particles the pool keeps alive for reuse, zero pools nothing
+		/// </summary>
+		void SetMaxPooledParticles(uint32_t particles) { maxPooledParticles_ = particles; }
+
+		const Stats& GetStats() const { return stats_; }
+
+	private:
+
+		struct Entry
+		{
+			std::shared_ptr<EmitterData> storage;
+			uint32_t capacity;
+			bool singleBuffer;
+		};
+
+		EmitterManager& emitterManager_;
+
+		//Owners outlive the pool when a world shuts down, they only hand storage back while this is alive
+		std::shared_ptr<EmitterPool*> self_;
+
+		std::vector<Entry> returned_; //Handed back, not cleared yet
+		std::vector<Entry> free_;	  //Cleared and ready to reuse
+
+		uint32_t maxPooledParticles_ = 1u << 16;
+		Stats stats_;
+
+		void Return(std::shared_ptr<EmitterData> storage, uint32_t capacity);
+	};
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineEmitterSettings.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Per emitter settings that the behavior stage needs but that
+				are owned by the component side. Keyed by emitter so the
+				behavior can look them up while walking the emitter manager.
+
+*******************************************************************************/
+#include <unordered_map>					//Emitter to settings lookup
+#include <vector>							//Prewarm steps
+#include <functional>						//Prewarm spawn callback
+#include <memory>							//std::weak_ptr
+#include "ParticleEngineTextureHandle.h"	//Interned texture handles
+#include "ParticleEngineKernels.h"			//SubEmitterSpawn CollisionSettings
+#include "ParticleEngineEmissionQueue.h"	//EmissionRequest
+
+namespace ParticleEngine
+{
+	class EmitterData;
+
+	/// <summary>
+	/// One batched step of a prewarm, advance then spawn the emissions
+	/// that happened during the step already aged to its end
+	/// </summary>
+	struct PrewarmStep
+	{
+		float deltaTime;				 //Seconds the step advances the emitter
+		std::vector<float> emissionAges; //Seconds each emission of the step lived by its end
+	};
+
+	/// <summary>
+	/// A child emitter that spawns from the births or deaths of a parent
+	/// </summary>
+	struct SubEmitterLink
+	{
+		std::weak_ptr<EmitterData> child;
+		uint32_t trigger;			//SubEmitTrigger
+		uint32_t particlesPerEvent;
+	};
+
+	/// <summary>
+	/// Settings the behavior and render stages read per emitter
+	/// </summary>
+	struct EmitterSettings
+	{
+		TextureHandle particleTexture; //Texture drawn on each particle
+		TextureHandle shapeTexture;	   //Texture that dictates the spawn area
+		bool usesPhysics = true;	   //Acceleration or friction is used, selects the kernel variant
+		bool sortByDepth = false;	   //Sort particles back to front after the update
+		bool useDirectionForRotation = false; //Instances turn with the velocity instead of the spawn direction
+		float neighborCellSize = 0.f;  //Cell size of the neighbor grid, zero builds no grid
+		float neighborSeparation = 0.f; //How hard particles push apart from neighbors in the grid
+		float boundsRadius = 0.f;	   //How far particles can travel from the emitter, used to cull affectors
+		uint32_t budgetCategory = 0;   //Particle budget category its live particles count against
+		bool inPlaceUpdate = false;	   //Simulate in a single particle buffer instead of ping ponging
+		uint32_t capacity = 0;		   //Particles the owner wants, the behavior resizes the pool in place when it differs
+		uint32_t transformSlot = 0xFFFFFFFFu; //Slot in the TransformTable, particles follow it when set
+		CollisionSettings collision;   //Response to the collision field of the behavior
+
+		//Texture the atlas slot was acquired for, the behavior acquires a new
+		//slot when particleTexture no longer matches it
+		TextureHandle atlasTexture;
+		uint32_t atlasSlot = 0xFFFFFFFFu;
+
+		//Color ramp of the owner, read by the CPU simulation path
+		std::vector<ColorKeyCPU> colorKeys;
+
+		//Steps the behavior runs on its next update to fast forward the emitter.
+		//prewarmSpawn spawns one emission with the settings of the owner, aged by its argument.
+		std::vector<PrewarmStep> prewarmSteps;
+		std::function<void(float)> prewarmSpawn;
+
+		//Emissions of the owner, the spawn pass writes them before the next update
+		std::vector<SpawnBurst> pendingBursts;
+
+		//Identifies the owner across runs, snapshot restores match emitters by it.
+		//Zero if the owner has none, those match by their order instead.
+		uint32_t snapshotId = 0;
+
+		//Emission timer of the owner, saved in snapshots. A restore sets
+		//emissionTimerRestored so the owner picks the value back up.
+		float emissionTimer = 0.f;
+		bool emissionTimerRestored = false;
+
+		//Children fired by this emitter, and how this emitter spawns when it is a child
+		std::vector<SubEmitterLink> subEmitters;
+		SubEmitterSpawn spawnTemplate;
+
+		//Emits a request from the emission queue with the settings of the owner
+		std::function<void(const EmissionRequest&)> queuedEmit;
+
+		//The grid is only built when the update reads it
+		bool UsesNeighbors() const { return neighborCellSize > 0.f && neighborSeparation > 0.f; }
+	};
+
+	class EmitterSettingsTable
+	{
+
+	public:
+
+		/// <summary>
+		/// Returns the settings for an emitter, creating defaults if needed
+		/// </summary>
+		EmitterSettings& Get(const EmitterData* emitter) { return settings_[emitter]; }
+
+		/// <summary>
+		/// Returns the settings for an emitter or nullptr if it has none
+		/// </summary>
+		const EmitterSettings* Find(const EmitterData* emitter) const
+		{
+			auto found = settings_.find(emitter);
+			return found != settings_.end() ? &found->second : nullptr;
+		}
+
+		/// <summary>
+		/// Must be called before an emitter is destroyed
+		/// </summary>
+		void Remove(const EmitterData* emitter) { settings_.erase(emitter); }
+
+	private:
+		std::unordered_map<const EmitterData*, EmitterSettings> settings_;
+	};
+
+}
@@ -0,0 +1,252 @@
+/*******************************************************************************
+
+	@file       ParticleEngineGridPass.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Builds a uniform neighbor grid over the particles of an emitter
+				on the GPU after the update. Behavior kernels that include
+				ParticleGrid.hlsli can then query neighbors in O(k).
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineGridPass.h"		//This files header
+#include "ParticleEngineShaders.h"		//Compute shader loading helpers
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+
+namespace ParticleEngine
+{
+//Must match CSParticleGrid.hlsl
+static constexpr UINT ScanBlock = 1024;
+static constexpr UINT GridThreads = 256;
+
+//Largest bucket table, enough for a million particles at one per bucket
+static constexpr UINT MaxTableSize = 1u << 20;
+
+//Grids of emitters that were not built for this many frames are released
+static constexpr UINT GridStateLifetime = 120;
+
+GridPass::GridPass(ID3D11Device* device) noexcept :
+	device_(device)
+{
+	const wchar_t* source = L"./shaders/CSParticleGrid.hlsl";
+	csClearCounts_ = LoadComputeShader(device, L"./shaders/CSParticleGrid_ClearCounts.cso", source, "ClearCounts");
+	csCountCells_  = LoadComputeShader(device, L"./shaders/CSParticleGrid_CountCells.cso",	source, "CountCells");
+	csScanBlocks_  = LoadComputeShader(device, L"./shaders/CSParticleGrid_ScanBlocks.cso",	source, "ScanBlocks");
+	csScanSums_	   = LoadComputeShader(device, L"./shaders/CSParticleGrid_ScanSums.cso",	source, "ScanSums");
+	csAddOffsets_  = LoadComputeShader(device, L"./shaders/CSParticleGrid_AddOffsets.cso",	source, "AddOffsets");
+	csScatter_	   = LoadComputeShader(device, L"./shaders/CSParticleGrid_Scatter.cso",		source, "Scatter");
+}
+
+GridPass::~GridPass() noexcept
+{
+	for (auto& state : states_)
+		Release(state.second);
+
+	RELEASE(csClearCounts_);
+	RELEASE(csCountCells_);
+	RELEASE(csScanBlocks_);
+	RELEASE(csScanSums_);
+	RELEASE(csAddOffsets_);
+	RELEASE(csScatter_);
+}
+
+void GridPass::Release(GridState& state)
+{
+	RELEASE(state.bCellStart);
+	RELEASE(state.bCellCount);
+	RELEASE(state.bCellCursor);
+	RELEASE(state.bBlockSums);
+	RELEASE(state.bSortedIndex);
+	RELEASE(state.bParticleCell);
+
+	RELEASE(state.uavCellStart);
+	RELEASE(state.uavCellCount);
+	RELEASE(state.uavCellCursor);
+	RELEASE(state.uavBlockSums);
+	RELEASE(state.uavSortedIndex);
+	RELEASE(state.uavParticleCell);
+
+	RELEASE(state.rvCellStart);
+	RELEASE(state.rvCellCount);
+	RELEASE(state.rvSortedIndex);
+
+	RELEASE(state.cbGridParams);
+
+	state.tableCapacity = 0;
+	state.particleCapacity = 0;
+}
+
+void GridPass::Reserve(GridState& state, UINT tableSize, UINT particles)
+{
+	if (!state.cbGridParams)
+		CreateConstantBuffer(device_, sizeof(cbGridParams), &state.cbGridParams);
+
+	if (state.tableCapacity < tableSize)
+	{
+		RELEASE(state.bCellStart);	RELEASE(state.uavCellStart);  RELEASE(state.rvCellStart);
+		RELEASE(state.bCellCount);	RELEASE(state.uavCellCount);  RELEASE(state.rvCellCount);
+		RELEASE(state.bCellCursor); RELEASE(state.uavCellCursor);
+		RELEASE(state.bBlockSums);	RELEASE(state.uavBlockSums);
+
+		UINT blocks = (tableSize + ScanBlock - 1) / ScanBlock;
+
+		CreateStructuredBuffer(device_, sizeof(UINT), tableSize, nullptr, &state.bCellStart, &state.rvCellStart, &state.uavCellStart);
+		CreateStructuredBuffer(device_, sizeof(UINT), tableSize, nullptr, &state.bCellCount, &state.rvCellCount, &state.uavCellCount);
+		CreateStructuredBuffer(device_, sizeof(UINT), tableSize, nullptr, &state.bCellCursor, nullptr, &state.uavCellCursor);
+		CreateStructuredBuffer(device_, sizeof(UINT), blocks, nullptr, &state.bBlockSums, nullptr, &state.uavBlockSums);
+
+		state.tableCapacity = tableSize;
+	}
+
+	if (state.particleCapacity < particles)
+	{
+		RELEASE(state.bSortedIndex);  RELEASE(state.uavSortedIndex); RELEASE(state.rvSortedIndex);
+		RELEASE(state.bParticleCell); RELEASE(state.uavParticleCell);
+
+		CreateStructuredBuffer(device_, sizeof(UINT), particles, nullptr, &state.bSortedIndex, &state.rvSortedIndex, &state.uavSortedIndex);
+		CreateStructuredBuffer(device_, sizeof(UINT), particles, nullptr, &state.bParticleCell, nullptr, &state.uavParticleCell);
+
+		state.particleCapacity = particles;
+	}
+}
+
+void GridPass::Build(ID3D11DeviceContext* deviceContext, const EmitterData* emitter,
+	ID3D11ShaderResourceView* particles, UINT aliveParticles, float cellSize)
+{
+	if (!csClearCounts_ || !csCountCells_ || !csScanBlocks_ || !csScanSums_ || !csAddOffsets_ || !csScatter_
+		|| aliveParticles == 0 || cellSize <= 0.f)
+	{
+		return;
+	}
+
+	GridState& state = states_[emitter];
+	state.lastUsedFrame = frame_;
+
+	//About one bucket per particle keeps collisions between cells rare
+	UINT tableSize = 1;
+	while (tableSize < aliveParticles && tableSize < MaxTableSize)
+		tableSize <<= 1;
+
+	try
+	{
+		Reserve(state, tableSize, aliveParticles);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Particle grid failed to create its buffers");
+		Release(state);
+		states_.erase(emitter);
+		return;
+	}
+
+	cbGridParams params;
+	params.cellSize = cellSize;
+	params.tableSize = tableSize;
+	params.count = aliveParticles;
+	params.blockCount = (tableSize + ScanBlock - 1) / ScanBlock;
+	UpdateConstantBuffer(deviceContext, state.cbGridParams, &params, sizeof(params));
+
+	ID3D11ShaderResourceView* rvIN[1] = { particles };
+	deviceContext->CSSetShaderResources(0, 1, rvIN);
+
+	ID3D11UnorderedAccessView* uavOut[6] =
+	{
+		state.uavCellStart, state.uavCellCount, state.uavSortedIndex,
+		state.uavParticleCell, state.uavBlockSums, state.uavCellCursor
+	};
+	deviceContext->CSSetUnorderedAccessViews(0, 6, uavOut, nullptr);
+
+	deviceContext->CSSetConstantBuffers(2, 1, &state.cbGridParams);
+
+	UINT tableGroups = (tableSize + GridThreads - 1) / GridThreads;
+	UINT particleGroups = (aliveParticles + GridThreads - 1) / GridThreads;
+
+	//Counting sort, count then prefix sum then scatter
+	deviceContext->CSSetShader(csClearCounts_, nullptr, 0u);
+	deviceContext->Dispatch(tableGroups, 1, 1);
+
+	deviceContext->CSSetShader(csCountCells_, nullptr, 0u);
+	deviceContext->Dispatch(particleGroups, 1, 1);
+
+	deviceContext->CSSetShader(csScanBlocks_, nullptr, 0u);
+	deviceContext->Dispatch(params.blockCount, 1, 1);
+
+	deviceContext->CSSetShader(csScanSums_, nullptr, 0u);
+	deviceContext->Dispatch(1, 1, 1);
+
+	deviceContext->CSSetShader(csAddOffsets_, nullptr, 0u);
+	deviceContext->Dispatch(tableGroups, 1, 1);
+
+	deviceContext->CSSetShader(csScatter_, nullptr, 0u);
+	deviceContext->Dispatch(particleGroups, 1, 1);
+
+	// Ensures all buffers are unset
+	ID3D11UnorderedAccessView* uavNULL[6] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+	deviceContext->CSSetUnorderedAccessViews(0, 6, uavNULL, nullptr);
+
+	ID3D11ShaderResourceView* rvNULL[1] = { nullptr };
+	deviceContext->CSSetShaderResources(0, 1, rvNULL);
+
+	ID3D11Buffer* bNULL[1] = { nullptr };
+	deviceContext->CSSetConstantBuffers(2, 1, bNULL);
+
+	deviceContext->CSSetShader(nullptr, nullptr, 0);
+}
+
+bool GridPass::Bind(ID3D11DeviceContext* deviceContext, const EmitterData* emitter) const
+{
+	auto found = states_.find(emitter);
+	if (found == states_.end() || !found->second.rvSortedIndex)
+		return false;
+
+	const GridState& state = found->second;
+
+	ID3D11ShaderResourceView* rvGrid[3] = { state.rvCellStart, state.rvCellCount, state.rvSortedIndex };
+	deviceContext->CSSetShaderResources(25, 3, rvGrid);
+	deviceContext->CSSetConstantBuffers(2, 1, &state.cbGridParams);
+
+	return true;
+}
+
+void GridPass::Unbind(ID3D11DeviceContext* deviceContext)
+{
+	ID3D11ShaderResourceView* rvNULL[3] = { nullptr, nullptr, nullptr };
+	deviceContext->CSSetShaderResources(25, 3, rvNULL);
+
+	ID3D11Buffer* bNULL[1] = { nullptr };
+	deviceContext->CSSetConstantBuffers(2, 1, bNULL);
+}
+
+void GridPass::Forget(const EmitterData* emitter)
+{
+	auto found = states_.find(emitter);
+	if (found == states_.end())
+		return;
+
+	Release(found->second);
+	states_.erase(found);
+}
+
+void GridPass::BeginFrame()
+{
+	for (auto it = states_.begin(); it != states_.end();)
+	{
+		if (frame_ - it->second.lastUsedFrame > GridStateLifetime)
+		{
+			Release(it->second);
+			it = states_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	frame_++;
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,120 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineGridPass.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Builds a uniform neighbor grid over the particles of an emitter
+				on the GPU after the update. Behavior kernels that include
+				ParticleGrid.hlsli can then query neighbors in O(k), the
+				update kernel pushes particles apart with it.
+
+*******************************************************************************/
+#include <d3d11.h>			//DirectX header
+#include <unordered_map>	//Per emitter grid state
+
+namespace ParticleEngine
+{
+	class EmitterData;
+
+	class GridPass
+	{
+
+	public:
+
+		//Constructors
+		GridPass(ID3D11Device* device) noexcept;
+		~GridPass() noexcept;
+		GridPass(const GridPass&) = delete;
+		GridPass& operator=(const GridPass&) = delete;
+
+		/// <summary>
+		/// Bins the alive particles of an emitter by cell. particles is a view
+		/// of its BehaviorData buffer after the alive and dead partition.
+		/// </summary>
+		void Build(ID3D11DeviceContext* deviceContext, const EmitterData* emitter,
+			ID3D11ShaderResourceView* particles, UINT aliveParticles, float cellSize);
+
+		/// <summary>
+		/// Binds the last grid of an emitter to t25 - t27 and b2 for a compute
+		/// shader. Returns false if the emitter has no grid.
+		/// </summary>
+		bool Bind(ID3D11DeviceContext* deviceContext, const EmitterData* emitter) const;
+
+		/// <summary>
+		/// Unbinds what Bind set
+		/// </summary>
+		static void Unbind(ID3D11DeviceContext* deviceContext);
+
+		/// <summary>
+		/// Call once per frame before building, releases grids of emitters
+		/// that were not built for a while
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		/// Releases the grid of an emitter whose pool was resized, its cells index the old particles
+		/// </summary>
+		void Forget(const EmitterData* emitter);
+
+	private:
+
+		struct GridState
+		{
+			ID3D11Buffer*			   bCellStart = nullptr;
+			ID3D11Buffer*			   bCellCount = nullptr;
+			ID3D11Buffer*			   bCellCursor = nullptr;
+			ID3D11Buffer*			   bBlockSums = nullptr;
+			ID3D11Buffer*			   bSortedIndex = nullptr;
+			ID3D11Buffer*			   bParticleCell = nullptr;
+
+			ID3D11UnorderedAccessView* uavCellStart = nullptr;
+			ID3D11UnorderedAccessView* uavCellCount = nullptr;
+			ID3D11UnorderedAccessView* uavCellCursor = nullptr;
+			ID3D11UnorderedAccessView* uavBlockSums = nullptr;
+			ID3D11UnorderedAccessView* uavSortedIndex = nullptr;
+			ID3D11UnorderedAccessView* uavParticleCell = nullptr;
+
+			ID3D11ShaderResourceView*  rvCellStart = nullptr;
+			ID3D11ShaderResourceView*  rvCellCount = nullptr;
+			ID3D11ShaderResourceView*  rvSortedIndex = nullptr;
+
+			//Each grid keeps its own parameters so Bind does not re-upload them
+			ID3D11Buffer*			   cbGridParams = nullptr;
+
+			UINT tableCapacity = 0;
+			UINT particleCapacity = 0;
+			UINT lastUsedFrame = 0;
+		};
+
+		//Matches GridParams in ParticleGrid.hlsli
+		struct cbGridParams
+		{
+			float cellSize;
+			UINT  tableSize;
+			UINT  count;
+			UINT  blockCount;
+		};
+
+		ID3D11Device* device_;
+
+		ID3D11ComputeShader* csClearCounts_ = nullptr;
+		ID3D11ComputeShader* csCountCells_ = nullptr;
+		ID3D11ComputeShader* csScanBlocks_ = nullptr;
+		ID3D11ComputeShader* csScanSums_ = nullptr;
+		ID3D11ComputeShader* csAddOffsets_ = nullptr;
+		ID3D11ComputeShader* csScatter_ = nullptr;
+
+		std::unordered_map<const EmitterData*, GridState> states_;
+		UINT frame_ = 0;
+
+		//Grows the buffers of a grid
+		void Reserve(GridState& state, UINT tableSize, UINT particles);
+
+		static void Release(GridState& state);
+	};
+
+}
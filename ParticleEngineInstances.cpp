@@ -0,0 +1,153 @@
+/*******************************************************************************
+
+	@file       ParticleEngineInstances.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Buffers for the fused instance pass. The behavior kernel
+				appends a compact record for every particle alive after its
+				update, so the renderer expands billboards from 24 bytes per
+				particle instead of rereading the 120 byte BehaviorData and
+				recomputing rotation, scale and color.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineInstances.h"	//This files header
+#include "ParticleEngineShaders.h"		//Structured buffer helpers
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+
+namespace ParticleEngine
+{
+//Instance buffers of emitters that did not write instances for this many frames are released
+static constexpr UINT InstanceStateLifetime = 120;
+
+InstancePass::InstancePass(ID3D11Device* device) noexcept :
+	device_(device)
+{
+}
+
+InstancePass::~InstancePass() noexcept
+{
+	for (auto& state : states_)
+		Release(state.second);
+}
+
+void InstancePass::Release(InstanceState& state)
+{
+	RELEASE(state.bInstances);
+	RELEASE(state.rvInstances);
+	RELEASE(state.uavInstances);
+	RELEASE(state.bDrawArgs);
+	state.capacity = 0;
+}
+
+bool InstancePass::Bind(ID3D11DeviceContext* deviceContext, const EmitterData* emitter, UINT capacity)
+{
+	if (capacity == 0)
+		return false;
+
+	InstanceState& state = states_[emitter];
+	state.lastUsedFrame = frame_;
+
+	if (state.capacity < capacity)
+	{
+		Release(state);
+
+		try
+		{
+			HRESULT hr = S_OK;
+
+			CreateStructuredBuffer(device_, sizeof(ParticleInstanceCPU), capacity, nullptr,
+				&state.bInstances, &state.rvInstances, &state.uavInstances, D3D11_BUFFER_UAV_FLAG_APPEND);
+
+			//Only the instance count changes, CopyStructureCount writes it on the GPU
+			UINT args[4] = { VerticesPerInstance, 0, 0, 0 };
+
+			D3D11_BUFFER_DESC Desc = {};
+			Desc.Usage		= D3D11_USAGE_DEFAULT;
+			Desc.MiscFlags	= D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+			Desc.ByteWidth	= sizeof(args);
+
+			D3D11_SUBRESOURCE_DATA data = {};
+			data.pSysMem = args;
+
+			INFO_SET device_->CreateBuffer(&Desc, &data, &state.bDrawArgs);
+			DX_EXCEPT(hr);
+		}
+		catch (const Bindable::DirectXException)
+		{
+			LOG_ERROR("DirectX Exception", "Particle instance pass failed to create its buffers");
+			Release(state);
+			states_.erase(emitter);
+			return false;
+		}
+
+		state.capacity = capacity;
+	}
+
+	//Every update writes the full list so it starts empty
+	UINT initialCount = 0;
+	deviceContext->CSSetUnorderedAccessViews(2, 1, &state.uavInstances, &initialCount);
+	return true;
+}
+
+void InstancePass::Unbind(ID3D11DeviceContext* deviceContext)
+{
+	ID3D11UnorderedAccessView* uavNULL[1] = { nullptr };
+	deviceContext->CSSetUnorderedAccessViews(2, 1, uavNULL, nullptr);
+}
+
+void InstancePass::Finish(ID3D11DeviceContext* deviceContext, const EmitterData* emitter)
+{
+	auto found = states_.find(emitter);
+	if (found == states_.end() || found->second.lastUsedFrame != frame_)
+		return;
+
+	//InstanceCount is the second argument
+	deviceContext->CopyStructureCount(found->second.bDrawArgs, sizeof(UINT), found->second.uavInstances);
+	found->second.writtenFrame = frame_;
+}
+
+bool InstancePass::Get(const EmitterData* emitter, ID3D11ShaderResourceView*& instances, ID3D11Buffer*& drawArgs) const
+{
+	auto found = states_.find(emitter);
+	if (found == states_.end() || found->second.writtenFrame != frame_)
+		return false;
+
+	instances = found->second.rvInstances;
+	drawArgs = found->second.bDrawArgs;
+	return true;
+}
+
+void InstancePass::Forget(const EmitterData* emitter)
+{
+	auto found = states_.find(emitter);
+	if (found == states_.end())
+		return;
+
+	Release(found->second);
+	states_.erase(found);
+}
+
+void InstancePass::BeginFrame()
+{
+	frame_++;
+
+	for (auto it = states_.begin(); it != states_.end();)
+	{
+		if (frame_ - it->second.lastUsedFrame > InstanceStateLifetime)
+		{
+			Release(it->second);
+			it = states_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+}//End of Particle Engine NameSpace
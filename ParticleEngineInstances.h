@@ -0,0 +1,109 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineInstances.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Buffers for the fused instance pass. The behavior kernel
+				appends a compact record for every particle alive after its
+				update, so the renderer expands billboards from 24 bytes per
+				particle instead of rereading the 120 byte BehaviorData and
+				recomputing rotation, scale and color.
+
+*******************************************************************************/
+#include <d3d11.h>			//DirectX header
+#include <cstdint>			//Fixed width integers
+#include <unordered_map>	//Per emitter instance buffers
+
+namespace ParticleEngine
+{
+	class EmitterData;
+
+	/// <summary>
+	/// Mirror of ParticleInstance in ParticleInstance.hlsli
+	/// </summary>
+	struct ParticleInstanceCPU
+	{
+		float	 position[3];
+		uint32_t orientationScale; //Half floats, low image rotation radians high scale
+		uint32_t color;			   //RGBA8 unorm, red in the low byte
+		uint32_t atlasPage;		   //Slice of the atlas page array
+	};
+
+	static_assert(sizeof(ParticleInstanceCPU) == 24, "ParticleInstanceCPU must match the structured buffer stride");
+
+	class InstancePass
+	{
+
+	public:
+
+		//Instances are drawn as a four vertex triangle strip
+		static constexpr UINT VerticesPerInstance = 4;
+
+		//Constructors
+		InstancePass(ID3D11Device* device) noexcept;
+		~InstancePass() noexcept;
+		InstancePass(const InstancePass&) = delete;
+		InstancePass& operator=(const InstancePass&) = delete;
+
+		/// <summary>
+		/// Binds the empty instance buffer of an emitter to u2, growing it to
+		/// capacity. Returns false if it could not be created, the update then
+		/// runs without writing instances.
+		/// </summary>
+		bool Bind(ID3D11DeviceContext* deviceContext, const EmitterData* emitter, UINT capacity);
+
+		/// <summary>
+		/// Unbinds what Bind set
+		/// </summary>
+		static void Unbind(ID3D11DeviceContext* deviceContext);
+
+		/// <summary>
+		/// Copies the number of instances the update appended into the draw
+		/// arguments of an emitter, call after the dispatch that wrote them
+		/// </summary>
+		void Finish(ID3D11DeviceContext* deviceContext, const EmitterData* emitter);
+
+		/// <summary>
+		/// Returns the instances written for an emitter this frame and the
+		/// DrawInstancedIndirect arguments that draw them. Returns false if
+		/// the emitter has none and has to be drawn from its particles.
+		/// </summary>
+		bool Get(const EmitterData* emitter, ID3D11ShaderResourceView*& instances, ID3D11Buffer*& drawArgs) const;
+
+		/// <summary>
+		/// Call once per frame before the update, releases buffers of
+		/// emitters that stopped writing instances
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		/// Releases the instances of an emitter whose pool was resized, the next bind sizes them again
+		/// </summary>
+		void Forget(const EmitterData* emitter);
+
+	private:
+
+		struct InstanceState
+		{
+			ID3D11Buffer*			   bInstances = nullptr;
+			ID3D11ShaderResourceView*  rvInstances = nullptr;
+			ID3D11UnorderedAccessView* uavInstances = nullptr;
+			ID3D11Buffer*			   bDrawArgs = nullptr;
+			UINT capacity = 0;
+			UINT lastUsedFrame = 0;
+			UINT writtenFrame = 0xFFFFFFFFu;
+		};
+
+		ID3D11Device* device_;
+
+		std::unordered_map<const EmitterData*, InstanceState> states_;
+		UINT frame_ = 0;
+
+		static void Release(InstanceState& state);
+	};
+
+}
@@ -0,0 +1,768 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineKernels.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      CPU versions of the particle behavior kernels. Each emitter
+				feature set gets its own template instantiation so features an
+				emitter does not use are compiled out, the same way the compute
+				shader is built into permutations with defines.
+
+				This header only depends on the standard library so it can be
+				used by tools that run without a graphics device.
+
+*******************************************************************************/
+#include <cstdint>	//Fixed width integers
+#include <cmath>	//sin floor
+#include <atomic>	//Spawn record counter
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Features a behavior kernel can be specialized for.
+	/// Matches the defines in CSParticleBehaviorsDefault.hlsl
+	/// </summary>
+	enum KernelFeature : uint32_t
+	{
+		Kernel_ShapeTexture  = 1u << 0, //Spawn inside a shape texture instead of a box
+		Kernel_ColorGradient = 1u << 1, //More than one color in the color ramp
+		Kernel_Physics		 = 1u << 2, //Acceleration or friction is used
+
+		Kernel_All			 = Kernel_ShapeTexture | Kernel_ColorGradient | Kernel_Physics,
+
+		//GPU only, the update reads and writes one buffer. CPU kernels always run in place.
+		Kernel_InPlace		 = 1u << 3,
+
+		//GPU only, the update also appends render ready instances
+		Kernel_Instances	 = 1u << 4,
+
+		//GPU only, particles push apart from neighbors found in the grid
+		Kernel_Neighbors	 = 1u << 5,
+		Kernel_GPUAll		 = Kernel_All | Kernel_InPlace | Kernel_Instances | Kernel_Neighbors,
+		Kernel_VariantCount	 = Kernel_GPUAll + 1
+	};
+
+	/// <summary>
+	/// Maps the settings of an emitter to the kernel variant it needs
+	/// </summary>
+	inline uint32_t SelectKernelFeatures(bool hasShapeTexture, float scaleX, float scaleY, uint32_t numColors, bool usesPhysics)
+	{
+		uint32_t features = 0;
+
+		if (hasShapeTexture && scaleX > 0.1f && scaleY > 0.1f)
+			features |= Kernel_ShapeTexture;
+
+		if (numColors > 1)
+			features |= Kernel_ColorGradient;
+
+		if (usesPhysics)
+			features |= Kernel_Physics;
+
+		return features;
+	}
+
+	/// <summary>
+	/// Mirror of BehaviorData in CSParticleBehaviorsDefault.hlsl
+	/// </summary>
+	struct BehaviorDataCPU
+	{
+		float pos[4];			// Position
+		float vel[4];			// peices combined
+		float accel[4];			// Accleration
+		float physicsPieces[4]; // [0] speed        [1] friction     [3] Direction Radians [4] Mass
+		float color[4];			// [0] red          [1] green        [2] blue              [4] alpha
+		float imageRotation[2]; // [0] radians		[1] nothing
+		float lifetime[2];		// [0] timeAlive    [1] max life
+		float scale[2];			// [0] scale        [1] nothing
+		float seed[4];			// [0] random seed  [1] random seed
+	};
+
+	static_assert(sizeof(BehaviorDataCPU) == 120, "BehaviorDataCPU must match the structured buffer stride");
+
+	/// <summary>
+	/// Mirror of Color in CSParticleBehaviorsDefault.hlsl
+	/// </summary>
+	struct ColorKeyCPU
+	{
+		float color[4];
+		float location; //from 0 to 1;
+	};
+
+	/// <summary>
+	/// Kinds of world placed force fields
+	/// </summary>
+	enum AffectorType : uint32_t
+	{
+		Affector_Attractor = 0, //Pulls toward position, negative strength pushes away
+		Affector_Vortex	   = 1, //Spins around direction through position
+		Affector_Wind	   = 2, //Pushes along direction
+		Affector_Drag	   = 3, //Slows particles down
+	};
+
+	/// <summary>
+	/// A force field, matches Affector in CSParticleBehaviorsDefault.hlsl.
+	/// Strength fades out linearly to the radius, a radius of zero is global.
+	/// </summary>
+	struct Affector
+	{
+		float	 position[3];
+		uint32_t type;
+		float	 direction[3]; //Wind direction or vortex axis
+		float	 strength;
+		float	 radius;
+		float	 pad[3];
+	};
+
+	static_assert(sizeof(Affector) == 48, "Affector must match the structured buffer stride");
+
+	/// <summary>
+	/// Events a child emitter can spawn from
+	/// </summary>
+	enum SubEmitTrigger : uint32_t
+	{
+		SubEmit_Death = 1u << 0,
+		SubEmit_Birth = 1u << 1,
+	};
+
+	/// <summary>
+	/// A birth or death a child emitter spawns from, matches SpawnRecord in the compute shaders
+	/// </summary>
+	struct SpawnRecordCPU
+	{
+		float pos[4]; //xyz position w trigger
+		float vel[4];
+	};
+
+	/// <summary>
+	/// How a child emitter spawns particles from records
+	/// </summary>
+	struct SubEmitterSpawn
+	{
+		float lifetime[2]  = { 1.f, 1.f };	 // [0]min [1]max
+		float speed[2]	   = { 1.f, 1.f };	 // [0]min [1]max
+		float scale[2]	   = { .05f, .05f }; // [0]min [1]max
+		float direction[2] = { 0.f, 360.f }; // [0]min [1]max degrees
+		float accel[2]	   = { 0.f, 0.f };
+		float friction	   = 0.f;
+		float inheritVelocity = 0.f;		 //Amount of the parent velocity kept
+	};
+
+	/// <summary>
+	/// Returns the alpha of the shape texture at a uv coordinate
+	/// </summary>
+	typedef float (*ShapeAlphaFunc)(const void* userData, float u, float v);
+
+	/// <summary>
+	/// World transform of an emitter this frame and last frame, matches
+	/// EmitterTransform in CSParticleBehaviorsDefault.hlsl
+	/// </summary>
+	struct EmitterTransform
+	{
+		float current[4]  = { 0.f, 0.f, 0.f, 0.f }; //xyz position w rotation radians
+		float previous[4] = { 0.f, 0.f, 0.f, 0.f };
+		float follow = 0.f;							//How much of the motion particles take
+		float pad[3] = { 0.f, 0.f, 0.f };
+	};
+
+	static_assert(sizeof(EmitterTransform) == 48, "EmitterTransform must match the structured buffer stride");
+
+	/// <summary>
+	/// What a particle does when it touches the collision field
+	/// </summary>
+	enum CollisionResponse : uint32_t
+	{
+		Collision_None	 = 0,
+		Collision_Bounce = 1, //Reflects off the surface, scaled by restitution
+		Collision_Slide	 = 2, //Loses the velocity into the surface and keeps moving along it
+		Collision_Kill	 = 3, //Dies at the end of the update
+	};
+
+	/// <summary>
+	/// One texel of a baked collision field, matches the float4 the compute
+	/// shader loads. The distance is signed, negative is inside a collider.
+	/// </summary>
+	struct CollisionTexel
+	{
+		float distance;
+		float normal[2]; //Points away from the nearest collider surface
+		float pad;
+	};
+
+	static_assert(sizeof(CollisionTexel) == 16, "CollisionTexel must match the texture format");
+
+	/// <summary>
+	/// Read only view of a baked collision field. Texel (x, y) covers the
+	/// square starting at origin + (x, y) * cellSize.
+	/// </summary>
+	struct CollisionFieldView
+	{
+		const CollisionTexel* texels = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		float origin[2] = { 0.f, 0.f };
+		float cellSize = 1.f;
+	};
+
+	/// <summary>
+	/// How one emitter reacts to the collision field
+	/// </summary>
+	struct CollisionSettings
+	{
+		uint32_t response = Collision_None; //CollisionResponse
+		float restitution = .5f;			//Fraction of the velocity into the surface kept on a bounce
+		float friction = 0.f;				//Fraction of the velocity along the surface lost per contact
+		float radius = 0.f;					//Distance from the surface particles are kept at
+	};
+
+	/// <summary>
+	/// One emission, the spawn pass rolls every particle from these ranges.
+	/// Matches cbSpawnParams, angles are in degrees.
+	/// </summary>
+	struct SpawnBurst
+	{
+		uint32_t count = 0;
+		float position[4]  = { 0.f, 0.f, 0.f, 1.f }; //Emitter position xyzw when the burst was emitted
+		float lifetime[2]  = { 1.f, 1.f };	 // [0]min [1]max
+		float scale[2]	   = { .05f, .05f }; // [0]min [1]max
+		float direction[2] = { 0.f, 360.f }; // [0]min [1]max
+		float speed[2]	   = { 1.f, 1.f };	 // [0]min [1]max
+		float friction[2]  = { 0.f, 0.f };	 // [0]min [1]max
+		float accel[2]	   = { 0.f, 0.f };	 // [0]X direction [1] y direction
+		float rotation[2]  = { 0.f, 0.f };	 // [0]min [1]max image rotation
+		bool useDirectionForRotation = false;
+		float age = 0.f;					 //Seconds the particles already lived, set by prewarms
+	};
+
+	/// <summary>
+	/// Everything a CPU kernel reads besides the particles themselves
+	/// </summary>
+	struct KernelParams
+	{
+		float deltaTime = 0.f;
+		float position[4] = { 0.f, 0.f, 0.f, 1.f }; //Emitter position xyzw
+		float scale[2] = { 0.f, 0.f };				//Emitter scale
+
+		const ColorKeyCPU* colors = nullptr;
+		uint32_t numColors = 0;
+
+		ShapeAlphaFunc shapeAlpha = nullptr;
+		const void*	   shapeUserData = nullptr;
+
+		//Affectors already culled to this emitter
+		const Affector* affectors = nullptr;
+		uint32_t numAffectors = 0;
+
+		//Particles follow the motion of this transform, nullptr does not follow
+		const EmitterTransform* transform = nullptr;
+
+		//Static colliders, nullptr or Collision_None does not collide
+		const CollisionFieldView* collisionField = nullptr;
+		CollisionSettings collision;
+
+		//Births and deaths are appended here when their SubEmitTrigger bit is set
+		uint32_t subEmitTriggers = 0;
+		SpawnRecordCPU* records = nullptr;
+		uint32_t recordCapacity = 0;
+		std::atomic<uint32_t>* recordCount = nullptr;
+	};
+
+	namespace Kernels
+	{
+		inline float Frac(float value) { return value - std::floor(value); }
+
+		//Same hash as Rand in the compute shader
+		inline float Rand(float seed)
+		{
+			return Frac(std::sin(-seed * 12.9898f + seed * 78.233f) * 43758.5453f);
+		}
+
+		inline float RandomRange(float min, float max, float seed)
+		{
+			return min + (max - min) * Rand(seed);
+		}
+
+		inline float Fit(float value, float oldMin, float oldMax, float newMin, float newMax)
+		{
+			return (value - oldMin) / (oldMax - oldMin) * (newMax - newMin) + newMin;
+		}
+
+		/// <summary>
+		/// Applies one force field to a velocity, same as ApplyAffectors in the compute shader
+		/// </summary>
+		inline void ApplyAffector(const Affector& a, const float pos[4], float vel[4], float dt)
+		{
+			float d[3] = { a.position[0] - pos[0], a.position[1] - pos[1], a.position[2] - pos[2] };
+			float dist = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+			float influence = 1.f;
+			if (a.radius > 0.f)
+				influence = 1.f - dist / a.radius;
+
+			if (influence <= 0.f)
+				return;
+
+			float amount = a.strength * influence * dt;
+
+			switch (a.type)
+			{
+			case Affector_Attractor:
+			{
+				float inv = 1.f / (dist > 1e-4f ? dist : 1e-4f);
+				for (int c = 0; c < 3; ++c)
+					vel[c] += d[c] * inv * amount;
+				break;
+			}
+			case Affector_Vortex:
+			{
+				//Tangent is axis x (pos - center)
+				const float* axis = a.direction;
+				float t[3] =
+				{
+					axis[1] * -d[2] - axis[2] * -d[1],
+					axis[2] * -d[0] - axis[0] * -d[2],
+					axis[0] * -d[1] - axis[1] * -d[0]
+				};
+				float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+				if (length > 1e-4f)
+				{
+					for (int c = 0; c < 3; ++c)
+						vel[c] += t[c] / length * amount;
+				}
+				break;
+			}
+			case Affector_Wind:
+				for (int c = 0; c < 3; ++c)
+					vel[c] += a.direction[c] * amount;
+				break;
+			case Affector_Drag:
+			{
+				float keep = 1.f - amount;
+				keep = keep > 0.f ? keep : 0.f;
+				for (int c = 0; c < 3; ++c)
+					vel[c] *= keep;
+				break;
+			}
+			default:
+				break;
+			}
+		}
+
+		/// <summary>
+		/// Carries a particle along with the motion of its emitter since the
+		/// last frame, same as FollowTransform in the compute shader
+		/// </summary>
+		inline void FollowTransform(const EmitterTransform& t, float pos[4], float vel[4])
+		{
+			if (t.follow <= 0.f)
+				return;
+
+			float angle = (t.current[3] - t.previous[3]) * t.follow;
+			float c = std::cos(angle);
+			float s = std::sin(angle);
+
+			//Rotates around the old emitter position then moves to the new one
+			float x = pos[0] - t.previous[0];
+			float y = pos[1] - t.previous[1];
+			float followed[3] =
+			{
+				t.current[0] + x * c - y * s,
+				t.current[1] + x * s + y * c,
+				pos[2] + t.current[2] - t.previous[2]
+			};
+
+			for (int i = 0; i < 3; ++i)
+				pos[i] += (followed[i] - pos[i]) * t.follow;
+
+			float vx = vel[0];
+			vel[0] = vx * c - vel[1] * s;
+			vel[1] = vx * s + vel[1] * c;
+		}
+
+		/// <summary>
+		/// Pushes a particle out of the collision field and applies the response,
+		/// same as Collide in the compute shader. One texel is read, the distance
+		/// is carried from the texel center along the stored normal.
+		/// </summary>
+		inline void Collide(const CollisionFieldView& field, const CollisionSettings& settings,
+			float pos[4], float vel[4], float lifetime[2])
+		{
+			float cellX = (pos[0] - field.origin[0]) / field.cellSize;
+			float cellY = (pos[1] - field.origin[1]) / field.cellSize;
+
+			//Nothing collides outside the baked area
+			if (!(cellX >= 0.f && cellY >= 0.f && cellX < field.width && cellY < field.height))
+				return;
+
+			uint32_t x = static_cast<uint32_t>(cellX);
+			uint32_t y = static_cast<uint32_t>(cellY);
+			const CollisionTexel& texel = field.texels[y * field.width + x];
+
+			float centerX = field.origin[0] + (x + .5f) * field.cellSize;
+			float centerY = field.origin[1] + (y + .5f) * field.cellSize;
+			float nx = texel.normal[0];
+			float ny = texel.normal[1];
+			float distance = texel.distance + nx * (pos[0] - centerX) + ny * (pos[1] - centerY);
+
+			if (distance >= settings.radius)
+				return;
+
+			if (settings.response == Collision_Kill)
+			{
+				lifetime[0] = lifetime[1];
+				return;
+			}
+
+			pos[0] += nx * (settings.radius - distance);
+			pos[1] += ny * (settings.radius - distance);
+
+			//Only velocity into the surface is changed
+			float intoSurface = vel[0] * nx + vel[1] * ny;
+			if (intoSurface >= 0.f)
+				return;
+
+			float keep = 1.f - settings.friction;
+			keep = keep > 0.f ? (keep < 1.f ? keep : 1.f) : 0.f;
+
+			float bounce = settings.response == Collision_Bounce ? settings.restitution : 0.f;
+			float tangentX = (vel[0] - nx * intoSurface) * keep;
+			float tangentY = (vel[1] - ny * intoSurface) * keep;
+
+			vel[0] = tangentX - nx * intoSurface * bounce;
+			vel[1] = tangentY - ny * intoSurface * bounce;
+		}
+
+		inline void AppendSpawnRecord(const BehaviorDataCPU& p, const KernelParams& params, uint32_t trigger)
+		{
+			if ((params.subEmitTriggers & trigger) == 0 || !params.records)
+				return;
+
+			uint32_t index = params.recordCount->fetch_add(1);
+			if (index >= params.recordCapacity)
+				return;
+
+			SpawnRecordCPU& record = params.records[index];
+			for (int c = 0; c < 3; ++c)
+				record.pos[c] = p.pos[c];
+			record.pos[3] = static_cast<float>(trigger);
+
+			for (int c = 0; c < 4; ++c)
+				record.vel[c] = p.vel[c];
+		}
+
+		/// <summary>
+		/// Integrates one particle. Position function x = x0 + (v * t) + (.5f * a * t^2)
+		/// </summary>
+		template <uint32_t Features>
+		inline void Integrate(BehaviorDataCPU& p, float dt)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				if constexpr ((Features & Kernel_Physics) != 0)
+				{
+					p.pos[c] += p.vel[c] * dt + .5f * p.accel[c] * dt * dt;
+
+					//vel function v = v0 + (a * t) then friction
+					p.vel[c] = (p.vel[c] + p.accel[c] * dt) * (1.0f - p.physicsPieces[2] * dt);
+				}
+				else
+				{
+					p.pos[c] += p.vel[c] * dt;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Offset of a new particle inside the box or shape of the emitter,
+		/// same as SpawnOffset in CSParticleSpawn.hlsl
+		/// </summary>
+		template <uint32_t Features>
+		inline void SpawnOffset(const KernelParams& params, const float seedIn[2], float offset[2])
+		{
+			if constexpr ((Features & Kernel_ShapeTexture) != 0)
+			{
+				//Rejection samples the shape texture like the compute shader
+				float seed[2] = { seedIn[0], seedIn[1] };
+				float uv[2] = { 0.f, 0.f };
+				float alpha = 0.f;
+
+				while (alpha < .7f && params.shapeAlpha)
+				{
+					uv[0] = RandomRange(0.f, 1.f, seed[0]);
+					uv[1] = RandomRange(0.f, 1.f, seed[1]);
+					alpha = params.shapeAlpha(params.shapeUserData, uv[0], uv[1]);
+					seed[0]++;
+					seed[1]++;
+				}
+
+				offset[0] = Fit(uv[0], 0.0f, 1.0f, -params.scale[0] / 2.f, params.scale[0] / 2.f);
+				offset[1] = Fit(uv[1], 1.0f, 0.0f, -params.scale[1] / 2.f, params.scale[1] / 2.f);
+			}
+			else
+			{
+				offset[0] = RandomRange(-params.scale[0] / 2.f, params.scale[0] / 2.f, seedIn[0]);
+				offset[1] = RandomRange(-params.scale[1] / 2.f, params.scale[1] / 2.f, seedIn[1]);
+			}
+		}
+
+		template <uint32_t Features>
+		inline void Update(BehaviorDataCPU& p, const KernelParams& params)
+		{
+			float timeAlive = p.lifetime[0];
+
+			Integrate<Features>(p, params.deltaTime);
+			p.lifetime[0] = timeAlive + params.deltaTime;
+
+			for (uint32_t a = 0; a < params.numAffectors; ++a)
+				ApplyAffector(params.affectors[a], p.pos, p.vel, params.deltaTime);
+
+			if (params.transform)
+				FollowTransform(*params.transform, p.pos, p.vel);
+
+			if (params.collisionField && params.collision.response != Collision_None)
+				Collide(*params.collisionField, params.collision, p.pos, p.vel, p.lifetime);
+
+			//Dies at the end of this update
+			if (p.lifetime[0] >= p.lifetime[1])
+				AppendSpawnRecord(p, params, SubEmit_Death);
+
+			if constexpr ((Features & Kernel_ColorGradient) != 0)
+			{
+				float lifePercentage = timeAlive / p.lifetime[1];
+
+				if (params.colors[0].location < lifePercentage)
+				{
+					uint32_t i = 1;
+					while (i < params.numColors - 1)
+					{
+						if (params.colors[i].location >= lifePercentage)
+							break;
+						i++;
+					}
+
+					//Calculates the amount to lerp a color by.
+					float span = params.colors[i].location * p.lifetime[1] - params.colors[i - 1].location * p.lifetime[1];
+					float lerpAmount = params.deltaTime / span;
+
+					for (int c = 0; c < 4; ++c)
+						p.color[c] += (params.colors[i].color[c] - p.color[c]) * lerpAmount;
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Simulates a range of particles with the kernel specialized for Features
+	/// </summary>
+	template <uint32_t Features>
+	void SimulateParticles(BehaviorDataCPU* particles, uint32_t count, const KernelParams& params)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			BehaviorDataCPU& p = particles[i];
+
+			//On the off chance the particle is not alive skip calculations
+			if (!(p.lifetime[0] < p.lifetime[1]))
+				continue;
+
+			Kernels::Update<Features>(p, params);
+		}
+	}
+
+	/// <summary>
+	/// Writes a burst into the dead slots starting at firstFree, same as
+	/// SpawnBurst in CSParticleSpawn.hlsl. Particles start around the position
+	/// of the burst, params only gives the emitter scale. New particles have lived the age of
+	/// the burst, zero outside of prewarms, and the next update moves them.
+	/// Returns the new alive count.
+	/// </summary>
+	template <uint32_t Features>
+	uint32_t SpawnParticles(const SpawnBurst& burst, const KernelParams& params, float burstSeed,
+		BehaviorDataCPU* particles, uint32_t firstFree, uint32_t capacity)
+	{
+		using namespace Kernels;
+
+		if (firstFree >= capacity)
+			return firstFree;
+
+		uint32_t count = burst.count < capacity - firstFree ? burst.count : capacity - firstFree;
+		const float toRadians = 3.14159265f / 180.f;
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float seed = burstSeed + i * 1.61803f;
+			float direction = RandomRange(burst.direction[0], burst.direction[1], seed + 1.f) * toRadians;
+			float speed = RandomRange(burst.speed[0], burst.speed[1], seed + 2.f);
+			float rotation = RandomRange(burst.rotation[0], burst.rotation[1], seed + 3.f) * toRadians;
+
+			if (burst.useDirectionForRotation)
+				rotation += direction;
+
+			BehaviorDataCPU& p = particles[firstFree + i];
+			p = BehaviorDataCPU();
+
+			for (int c = 0; c < 4; ++c)
+				p.seed[c] = seed + 4.f + c;
+
+			float offset[2];
+			SpawnOffset<Features>(params, p.seed, offset);
+
+			//Batched emissions each keep the position they were emitted from
+			p.pos[0] = burst.position[0] + offset[0];
+			p.pos[1] = burst.position[1] + offset[1];
+			p.pos[2] = burst.position[2];
+			p.pos[3] = burst.position[3];
+
+			p.vel[0] = std::cos(direction) * speed;
+			p.vel[1] = std::sin(direction) * speed;
+			p.accel[0] = burst.accel[0];
+			p.accel[1] = burst.accel[1];
+
+			p.physicsPieces[0] = speed;
+			p.physicsPieces[2] = RandomRange(burst.friction[0], burst.friction[1], seed + 8.f);
+			p.physicsPieces[3] = direction;
+
+			if (params.numColors > 0)
+			{
+				for (int c = 0; c < 4; ++c)
+					p.color[c] = params.colors[0].color[c];
+			}
+
+			p.imageRotation[0] = rotation;
+			p.lifetime[0] = 0.f;
+			p.lifetime[1] = RandomRange(burst.lifetime[0], burst.lifetime[1], seed + 9.f);
+			p.scale[0] = RandomRange(burst.scale[0], burst.scale[1], seed + 10.f);
+
+			//Moved along as one step of the update would, particles older than their life start dead
+			if (burst.age > 0.f)
+			{
+				float age = burst.age;
+				float drag = 1.f - p.physicsPieces[2] * age;
+				drag = drag > 0.f ? drag : 0.f;
+				for (int c = 0; c < 2; ++c)
+				{
+					p.pos[c] += p.vel[c] * age + .5f * p.accel[c] * age * age;
+					p.vel[c] = (p.vel[c] + p.accel[c] * age) * drag;
+				}
+				p.lifetime[0] = age;
+			}
+
+			AppendSpawnRecord(p, params, SubEmit_Birth);
+		}
+
+		return firstFree + count;
+	}
+
+	/// <summary>
+	/// Spawns child particles from records into the dead slots starting at
+	/// firstFree, same as SpawnFromRecords in CSParticleSubEmit.hlsl.
+	/// Returns one past the last slot that may hold a new particle.
+	/// </summary>
+	inline uint32_t SpawnFromRecords(const SpawnRecordCPU* records, uint32_t recordCount, uint32_t trigger,
+		uint32_t perRecord, const SubEmitterSpawn& spawn, const ColorKeyCPU* colors, float frameSeed,
+		BehaviorDataCPU* particles, uint32_t firstFree, uint32_t capacity)
+	{
+		using namespace Kernels;
+
+		if (perRecord == 0 || firstFree >= capacity)
+			return firstFree;
+
+		uint32_t threads = recordCount * perRecord;
+		if (threads > capacity - firstFree)
+			threads = capacity - firstFree;
+
+		for (uint32_t i = 0; i < threads; ++i)
+		{
+			const SpawnRecordCPU& source = records[i / perRecord];
+			if (static_cast<uint32_t>(source.pos[3]) != trigger)
+				continue;
+
+			float seed = frameSeed + i * 1.61803f;
+			float direction = RandomRange(spawn.direction[0], spawn.direction[1], seed + 1.f) * 3.14159265f / 180.f;
+			float speed = RandomRange(spawn.speed[0], spawn.speed[1], seed + 2.f);
+
+			BehaviorDataCPU& p = particles[firstFree + i];
+			p = BehaviorDataCPU();
+
+			p.pos[0] = source.pos[0];
+			p.pos[1] = source.pos[1];
+			p.pos[2] = source.pos[2];
+			p.pos[3] = 1.f;
+
+			for (int c = 0; c < 4; ++c)
+				p.vel[c] = source.vel[c] * spawn.inheritVelocity;
+			p.vel[0] += std::cos(direction) * speed;
+			p.vel[1] += std::sin(direction) * speed;
+
+			p.accel[0] = spawn.accel[0];
+			p.accel[1] = spawn.accel[1];
+
+			p.physicsPieces[0] = speed;
+			p.physicsPieces[2] = spawn.friction;
+			p.physicsPieces[3] = direction;
+
+			if (colors)
+			{
+				for (int c = 0; c < 4; ++c)
+					p.color[c] = colors[0].color[c];
+			}
+
+			p.lifetime[0] = 0.f;
+			p.lifetime[1] = RandomRange(spawn.lifetime[0], spawn.lifetime[1], seed + 3.f);
+			p.scale[0] = RandomRange(spawn.scale[0], spawn.scale[1], seed + 4.f);
+
+			for (int c = 0; c < 4; ++c)
+				p.seed[c] = seed + 5.f + c;
+		}
+
+		return firstFree + threads;
+	}
+
+	typedef void (*SimulateParticlesFunc)(BehaviorDataCPU*, uint32_t, const KernelParams&);
+
+	/// <summary>
+	/// Returns the instantiation of SimulateParticles for a feature mask
+	/// </summary>
+	inline SimulateParticlesFunc GetCPUKernel(uint32_t features)
+	{
+		static const SimulateParticlesFunc kernels[Kernel_All + 1] =
+		{
+			&SimulateParticles<0>,
+			&SimulateParticles<1>,
+			&SimulateParticles<2>,
+			&SimulateParticles<3>,
+			&SimulateParticles<4>,
+			&SimulateParticles<5>,
+			&SimulateParticles<6>,
+			&SimulateParticles<7>,
+		};
+
+		return kernels[features & Kernel_All];
+	}
+
+	typedef uint32_t (*SpawnParticlesFunc)(const SpawnBurst&, const KernelParams&, float, BehaviorDataCPU*, uint32_t, uint32_t);
+
+	/// <summary>
+	/// Returns the instantiation of SpawnParticles for a feature mask
+	/// </summary>
+	inline SpawnParticlesFunc GetCPUSpawnKernel(uint32_t features)
+	{
+		static const SpawnParticlesFunc kernels[Kernel_All + 1] =
+		{
+			&SpawnParticles<0>,
+			&SpawnParticles<1>,
+			&SpawnParticles<2>,
+			&SpawnParticles<3>,
+			&SpawnParticles<4>,
+			&SpawnParticles<5>,
+			&SpawnParticles<6>,
+			&SpawnParticles<7>,
+		};
+
+		return kernels[features & Kernel_All];
+	}
+
+}
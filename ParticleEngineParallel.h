@@ -0,0 +1,207 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineParallel.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Small helpers for splitting particle work across a pool of
+				threads that outlives the work. Only depends on the standard
+				library.
+
+*******************************************************************************/
+#include <cstdint>				//Fixed width integers
+#include <thread>				//std::thread
+#include <vector>				//Worker list
+#include <algorithm>			//std::min
+#include <mutex>				//Batch state
+#include <condition_variable>	//Waking workers
+#include <functional>			//Type erased tasks
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Returns the number of threads particle work should be split across
+	/// </summary>
+	inline unsigned DefaultThreadCount()
+	{
+		unsigned threads = std::thread::hardware_concurrency();
+		return threads > 0 ? threads : 1;
+	}
+
+	/// <summary>
+	/// Threads that live as long as the pool, so splitting work costs a
+	/// wake up instead of creating and joining threads every call. The
+	/// calling thread works as well, a pool of Size() threads starts
+	/// Size() - 1 workers. Runs one batch at a time, a Run from inside a
+	/// task runs all of its chunks on that thread.
+	/// </summary>
+	class WorkerPool
+	{
+
+	public:
+
+		//Constructors
+		explicit WorkerPool(unsigned threads = DefaultThreadCount())
+		{
+			for (unsigned t = 1; t < threads; ++t)
+				workers_.emplace_back([this]() { Work(); });
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			wake_.notify_all();
+
+			for (auto& worker : workers_)
+				worker.join();
+		}
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		/// <summary>
+		/// Threads a batch is split across, the caller included
+		/// </summary>
+		unsigned Size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+		/// <summary>
+		/// Calls task(chunk) for every chunk in [0, chunks) and returns once all are done
+		/// </summary>
+		template <typename Task>
+		void Run(unsigned chunks, Task&& task)
+		{
+			if (chunks <= 1 || workers_.empty() || InsideTask())
+			{
+				for (unsigned c = 0; c < chunks; ++c)
+					task(c);
+				return;
+			}
+
+			std::function<void(unsigned)> call = [&task](unsigned chunk) { task(chunk); };
+			std::lock_guard<std::mutex> batch(batchMutex_);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				task_ = &call;
+				chunks_ = chunks;
+				next_ = 0;
+				finished_ = 0;
+				++generation_;
+			}
+			wake_.notify_all();
+
+			InsideTask() = true;
+			RunChunks();
+			InsideTask() = false;
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			done_.wait(lock, [this]() { return finished_ == chunks_; });
+			task_ = nullptr;
+		}
+
+	private:
+
+		std::vector<std::thread> workers_;
+
+		std::mutex batchMutex_;	//Held by the thread running a batch
+		std::mutex mutex_;		//Guards everything below
+		std::condition_variable wake_;
+		std::condition_variable done_;
+
+		const std::function<void(unsigned)>* task_ = nullptr;
+		unsigned chunks_ = 0;
+		unsigned next_ = 0;
+		unsigned finished_ = 0;
+		uint64_t generation_ = 0;
+		bool stop_ = false;
+
+		//Set on workers and on a caller while it runs chunks
+		static bool& InsideTask()
+		{
+			thread_local bool inside = false;
+			return inside;
+		}
+
+		//Takes chunks of the current batch until none are left
+		void RunChunks()
+		{
+			for (;;)
+			{
+				const std::function<void(unsigned)>* task;
+				unsigned chunk;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (!task_ || next_ >= chunks_)
+						return;
+
+					task = task_;
+					chunk = next_++;
+				}
+
+				(*task)(chunk);
+
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (++finished_ == chunks_)
+					done_.notify_one();
+			}
+		}
+
+		void Work()
+		{
+			InsideTask() = true;
+			uint64_t seen = 0;
+
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					wake_.wait(lock, [this, seen]() { return stop_ || generation_ != seen; });
+					if (stop_)
+						return;
+
+					seen = generation_;
+				}
+
+				RunChunks();
+			}
+		}
+	};
+
+	/// <summary>
+	/// The number of chunks ParallelFor will use for a range
+	/// </summary>
+	inline unsigned ParallelChunks(uint32_t count, unsigned threads, uint32_t minPerThread = 4096)
+	{
+		if (threads == 0)
+			threads = 1;
+
+		uint32_t maxThreads = (count + minPerThread - 1) / minPerThread;
+		return std::max(1u, std::min(threads, maxThreads));
+	}
+
+	/// <summary>
+	/// Splits [0, count) into ParallelChunks(count, pool.Size(), minPerThread)
+	/// contiguous chunks and calls func(chunk, begin, end) for each on the
+	/// pool. Small ranges run on the calling thread only.
+	/// </summary>
+	template <typename Func>
+	void ParallelFor(WorkerPool& pool, uint32_t count, Func&& func, uint32_t minPerThread = 4096)
+	{
+		unsigned chunks = ParallelChunks(count, pool.Size(), minPerThread);
+		uint32_t chunk = (count + chunks - 1) / chunks;
+
+		pool.Run(chunks, [&func, count, chunk](unsigned t)
+		{
+			uint32_t begin = std::min(count, t * chunk);
+			uint32_t end = std::min(count, begin + chunk);
+			func(t, begin, end);
+		});
+	}
+
+}
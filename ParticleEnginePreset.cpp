@@ -0,0 +1,242 @@
+/*******************************************************************************
+
+	@file       ParticleEnginePreset.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      A flat, versioned binary format for emitter presets. Files are
+				memory mapped and read in place, loading only fixes up table
+				pointers so thousands of emitters can be created in one batch.
+
+*******************************************************************************/
+#include "stdafx.h"					//Header included in all files.
+#include "ParticleEnginePreset.h"	//This files header
+#include <fstream>					//Writing preset files
+
+namespace ParticleEngine
+{
+
+#pragma region PresetFile
+
+PresetFile::PresetFile() noexcept :
+	file_(INVALID_HANDLE_VALUE), mapping_(nullptr), view_(nullptr),
+	header_(nullptr), emitters_(nullptr), colorKeys_(nullptr), strings_(nullptr)
+{
+}
+
+PresetFile::~PresetFile() noexcept
+{
+	Close();
+}
+
+bool PresetFile::Open(const std::string& path)
+{
+	Close();
+
+	file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		LOG_ERROR("ParticleEngine", "Failed to open emitter preset file");
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_ == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	view_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (view_ == nullptr || !FixUp(view_, static_cast<size_t>(size.QuadPart)))
+	{
+		LOG_ERROR("ParticleEngine", "Emitter preset file is invalid");
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool PresetFile::OpenFromMemory(const void* data, size_t size)
+{
+	Close();
+
+	if (!FixUp(static_cast<const uint8_t*>(data), size))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void PresetFile::Close()
+{
+	if (view_)
+		UnmapViewOfFile(view_);
+
+	if (mapping_)
+		CloseHandle(mapping_);
+
+	if (file_ != INVALID_HANDLE_VALUE)
+		CloseHandle(file_);
+
+	file_ = INVALID_HANDLE_VALUE;
+	mapping_ = nullptr;
+	view_ = nullptr;
+
+	header_ = nullptr;
+	emitters_ = nullptr;
+	colorKeys_ = nullptr;
+	strings_ = nullptr;
+}
+
+bool PresetFile::FixUp(const uint8_t* base, size_t size)
+{
+	if (base == nullptr || size < sizeof(PresetHeader))
+		return false;
+
+	auto header = reinterpret_cast<const PresetHeader*>(base);
+	if (header->magic != Preset::Magic || header->version != Preset::Version || header->fileSize != size)
+		return false;
+
+	//Every table must be inside of the file
+	auto inside = [size](uint64_t offset, uint64_t bytes) { return offset + bytes <= size; };
+
+	if (!inside(header->emitterOffset,	uint64_t(header->emitterCount) * sizeof(PresetEmitter))
+	 || !inside(header->colorKeyOffset, uint64_t(header->colorKeyCount) * sizeof(PresetColorKey))
+	 || !inside(header->stringOffset,	header->stringTableSize)
+	 || header->stringTableSize == 0
+	 || base[header->stringOffset + header->stringTableSize - 1] != '\0')
+	{
+		return false;
+	}
+
+	header_	   = header;
+	emitters_  = reinterpret_cast<const PresetEmitter*>(base + header->emitterOffset);
+	colorKeys_ = reinterpret_cast<const PresetColorKey*>(base + header->colorKeyOffset);
+	strings_   = reinterpret_cast<const char*>(base + header->stringOffset);
+
+	//Records index into the other tables, check them once here so lookups stay unchecked.
+	//Emitters need at least two particles, the same minimum the inspector enforces.
+	for (uint32_t i = 0; i < header->emitterCount; ++i)
+	{
+		const PresetEmitter& emitter = emitters_[i];
+		if (uint64_t(emitter.firstColorKey) + emitter.colorKeyCount > header->colorKeyCount
+		 || emitter.ownedParticles < 2
+		 || emitter.particleTexture >= header->stringTableSize
+		 || emitter.shapeTexture >= header->stringTableSize)
+		{
+			header_ = nullptr;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region PresetWriter
+
+uint32_t PresetWriter::AddString(const std::string& name)
+{
+	//Offset zero is always the empty string
+	if (strings_.empty())
+		strings_.push_back('\0');
+
+	if (name.empty())
+		return 0;
+
+	auto found = stringLookup_.find(name);
+	if (found != stringLookup_.end())
+		return found->second;
+
+	uint32_t offset = static_cast<uint32_t>(strings_.size());
+	strings_.insert(strings_.end(), name.begin(), name.end());
+	strings_.push_back('\0');
+	stringLookup_.emplace(name, offset);
+
+	return offset;
+}
+
+void PresetWriter::AddEmitter(PresetEmitter emitter, const std::vector<PresetColorKey>& colors,
+	const std::string& particleTexture, const std::string& shapeTexture)
+{
+	emitter.particleTexture = AddString(particleTexture);
+	emitter.shapeTexture = AddString(shapeTexture);
+	emitter.firstColorKey = static_cast<uint32_t>(colorKeys_.size());
+	emitter.colorKeyCount = static_cast<uint32_t>(colors.size());
+
+	colorKeys_.insert(colorKeys_.end(), colors.begin(), colors.end());
+	emitters_.push_back(emitter);
+}
+
+std::vector<uint8_t> PresetWriter::Build() const
+{
+	PresetHeader header = {};
+	header.magic = Preset::Magic;
+	header.version = Preset::Version;
+	header.emitterCount = static_cast<uint32_t>(emitters_.size());
+	header.colorKeyCount = static_cast<uint32_t>(colorKeys_.size());
+
+	//Always contains at least the empty string
+	std::vector<char> strings = strings_;
+	if (strings.empty())
+		strings.push_back('\0');
+
+	//Pad the string table so the file size stays a multiple of 4
+	while (strings.size() % 4 != 0)
+		strings.push_back('\0');
+
+	header.stringTableSize = static_cast<uint32_t>(strings.size());
+
+	header.emitterOffset  = sizeof(PresetHeader);
+	header.colorKeyOffset = header.emitterOffset  + header.emitterCount	 * sizeof(PresetEmitter);
+	header.stringOffset	  = header.colorKeyOffset + header.colorKeyCount * sizeof(PresetColorKey);
+	header.fileSize		  = header.stringOffset	  + header.stringTableSize;
+
+	std::vector<uint8_t> bytes(header.fileSize);
+	auto write = [&bytes](uint32_t offset, const void* data, size_t size)
+	{
+		if (size > 0)
+			memcpy(bytes.data() + offset, data, size);
+	};
+
+	write(0, &header, sizeof(header));
+	write(header.emitterOffset,	 emitters_.data(),	emitters_.size()  * sizeof(PresetEmitter));
+	write(header.colorKeyOffset, colorKeys_.data(), colorKeys_.size() * sizeof(PresetColorKey));
+	write(header.stringOffset,	 strings.data(),	strings.size());
+
+	return bytes;
+}
+
+bool PresetWriter::Save(const std::string& path) const
+{
+	std::vector<uint8_t> bytes = Build();
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		LOG_ERROR("ParticleEngine", "Failed to write emitter preset file");
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return file.good();
+}
+
+#pragma endregion
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,195 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEnginePreset.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      A flat, versioned binary format for emitter presets. Files are
+				memory mapped and read in place, loading only fixes up table
+				pointers so thousands of emitters can be created in one batch.
+
+*******************************************************************************/
+#include <cstdint>	//Fixed width integers
+#include <string>	//File paths and texture names
+#include <vector>	//Writer tables
+#include <unordered_map>	//String deduplication
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Layout of a preset file. Every table is addressed by a byte offset
+	/// from the start of the file so the file can be used without copying.
+	///
+	///		PresetHeader
+	///		PresetEmitter		[emitterCount]
+	///		PresetColorKey		[colorKeyCount]
+	///		char				[stringTableSize] (null terminated names)
+	/// </summary>
+	namespace Preset
+	{
+		constexpr uint32_t Magic	= 0x52504550; // "PEPR"
+		//2 added neighborCellSize 3 added budget settings 4 removed baked ramps
+		//5 added neighborSeparation 6 added inheritVelocity 7 added followTransform
+		//8 added reclaimAfter 9 added collision settings
+		constexpr uint32_t Version	= 9;
+
+		//PresetEmitter::flags
+		constexpr uint32_t FlagEmitOnTimer				= 1u << 0;
+		constexpr uint32_t FlagUseObjectRotation		= 1u << 1;
+		constexpr uint32_t FlagUseDirectionForRotation	= 1u << 2;
+		constexpr uint32_t FlagSortByDepth				= 1u << 3;
+		constexpr uint32_t FlagInPlaceUpdate			= 1u << 4;
+	}
+
+	struct PresetHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t emitterCount;
+		uint32_t colorKeyCount;
+		uint32_t stringTableSize;
+		uint32_t emitterOffset;
+		uint32_t colorKeyOffset;
+		uint32_t stringOffset;
+		uint32_t fileSize;
+	};
+
+	struct PresetColorKey
+	{
+		float color[4];
+		float location; //from 0 to 1
+	};
+
+	/// <summary>
+	/// All settings of a ParticleEmitterComponent in a flat record.
+	/// Texture names are offsets into the string table.
+	/// </summary>
+	struct PresetEmitter
+	{
+		float	 positionOffset[3];
+		float	 emitTime;
+		float	 albedo[4];
+		float	 lifetime[2];		 // [0]min [1]max
+		float	 scale[2];			 // [0]min [1]max
+		float	 imageRotation[2];	 // [0]min [1]max degrees
+		float	 direction[2];		 // [0]min [1]max
+		float	 speed[2];			 // [0]min [1]max
+		float	 friction[2];		 // [0]min [1]max
+		float	 accel[2];			 // [0]x   [1]y
+		float	 emitterScale[2];
+		float	 neighborCellSize;	 //Zero disables the neighbor grid
+		float	 neighborSeparation; //Push strength between neighbors
+		float	 budgetPriority;
+		float	 budgetFalloff;		 //Distance where importance halves
+		float	 inheritVelocity;	 //Parent velocity kept when spawned as a sub emitter
+		float	 followTransform;	 //0 world space 1 local space
+		float	 reclaimAfter;		 //Idle seconds before the emitter storage is reclaimed, zero keeps it
+		float	 collision[3];		 // [0]restitution [1]friction [2]radius
+		int32_t	 collisionResponse;	 //CollisionResponse, zero does not collide
+		uint32_t budgetCategory;
+		int32_t	 emissionAmount;
+		int32_t	 ownedParticles;
+		uint32_t flags;
+		uint32_t particleTexture;	 //String table offset
+		uint32_t shapeTexture;		 //String table offset
+		uint32_t firstColorKey;
+		uint32_t colorKeyCount;
+	};
+
+	static_assert(sizeof(PresetHeader) % 4 == 0, "Preset tables must stay 4 byte aligned");
+	static_assert(sizeof(PresetEmitter) % 4 == 0, "Preset tables must stay 4 byte aligned");
+
+	/// <summary>
+	/// A read only view of a preset file. Either memory maps a file
+	/// or wraps memory owned by the caller, nothing is copied.
+	/// </summary>
+	class PresetFile
+	{
+
+	public:
+
+		//Constructors
+		PresetFile() noexcept;
+		~PresetFile() noexcept;
+		PresetFile(const PresetFile&) = delete;
+		PresetFile& operator=(const PresetFile&) = delete;
+
+		/// <summary>
+		/// Maps a file from disk, returns false if the file is missing or invalid
+		/// </summary>
+		bool Open(const std::string& path);
+
+		/// <summary>
+		/// Uses a block of memory that must outlive this object
+		/// </summary>
+		bool OpenFromMemory(const void* data, size_t size);
+
+		void Close();
+
+		bool IsOpen() const { return header_ != nullptr; }
+
+		uint32_t EmitterCount() const { return header_ ? header_->emitterCount : 0; }
+
+		const PresetEmitter&  Emitter(uint32_t index) const { return emitters_[index]; }
+		const PresetColorKey* ColorKeys(const PresetEmitter& emitter) const { return colorKeys_ + emitter.firstColorKey; }
+		const char*			  String(uint32_t offset) const { return strings_ + offset; }
+
+		/// <summary>
+		/// The string table, names are null terminated and back to back
+		/// </summary>
+		const char* Strings() const { return strings_; }
+		uint32_t StringTableSize() const { return header_ ? header_->stringTableSize : 0; }
+
+	private:
+
+		//Validates the header and sets the table pointers
+		bool FixUp(const uint8_t* base, size_t size);
+
+		void* file_;
+		void* mapping_;
+		const uint8_t* view_;
+
+		const PresetHeader*	  header_;
+		const PresetEmitter*  emitters_;
+		const PresetColorKey* colorKeys_;
+		const char*			  strings_;
+	};
+
+	/// <summary>
+	/// Builds a preset file. Used by the converter from reflected component data.
+	/// </summary>
+	class PresetWriter
+	{
+
+	public:
+
+		/// <summary>
+		/// Adds an emitter, the texture names are deduplicated into the string table
+		/// </summary>
+		void AddEmitter(PresetEmitter emitter, const std::vector<PresetColorKey>& colors,
+			const std::string& particleTexture, const std::string& shapeTexture);
+
+		/// <summary>
+		/// Writes the file in one block
+		/// </summary>
+		bool Save(const std::string& path) const;
+
+		/// <summary>
+		/// Serializes into memory, used by Save and by tools
+		/// </summary>
+		std::vector<uint8_t> Build() const;
+
+	private:
+
+		uint32_t AddString(const std::string& name);
+
+		std::vector<PresetEmitter>	emitters_;
+		std::vector<PresetColorKey> colorKeys_;
+		std::vector<char>			strings_;
+		std::unordered_map<std::string, uint32_t> stringLookup_;
+	};
+
+}
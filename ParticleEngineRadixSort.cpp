@@ -0,0 +1,177 @@
+/*******************************************************************************
+
+	@file       ParticleEngineRadixSort.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Multithreaded CPU radix sort of 32 bit keys with indices and
+				a depth sorter built on it. Used as the reference for the GPU
+				sort and by the CPU simulation path.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineRadixSort.h"	//This files header
+#include "ParticleEngineParallel.h"		//ParallelFor
+#include <cstring>						//memcpy
+#include <numeric>						//std::iota
+
+namespace ParticleEngine
+{
+
+void RadixSort(uint32_t* keys, uint32_t* values, uint32_t count,
+	uint32_t* scratchKeys, uint32_t* scratchValues, WorkerPool& workers)
+{
+	constexpr uint32_t Bins = 256;
+
+	if (count < 2)
+		return;
+
+	unsigned chunks = ParallelChunks(count, workers.Size());
+	std::vector<uint32_t> histograms(size_t(chunks) * Bins);
+
+	uint32_t* srcKeys = keys;
+	uint32_t* srcValues = values;
+	uint32_t* dstKeys = scratchKeys;
+	uint32_t* dstValues = scratchValues;
+
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		std::fill(histograms.begin(), histograms.end(), 0u);
+
+		//Count digits per chunk
+		ParallelFor(workers, count, [&](unsigned t, uint32_t begin, uint32_t end)
+		{
+			uint32_t* histogram = &histograms[size_t(t) * Bins];
+			for (uint32_t i = begin; i < end; ++i)
+				histogram[(srcKeys[i] >> shift) & 0xFF]++;
+		});
+
+		//Every key has the same digit, this pass would not move anything
+		bool skip = false;
+		for (uint32_t bin = 0; bin < Bins && !skip; ++bin)
+		{
+			uint32_t total = 0;
+			for (unsigned t = 0; t < chunks; ++t)
+				total += histograms[size_t(t) * Bins + bin];
+
+			skip = total == count;
+		}
+
+		if (skip)
+			continue;
+
+		//Turns the counts into scatter offsets, ordered by digit then chunk so the sort stays stable
+		uint32_t offset = 0;
+		for (uint32_t bin = 0; bin < Bins; ++bin)
+		{
+			for (unsigned t = 0; t < chunks; ++t)
+			{
+				uint32_t& slot = histograms[size_t(t) * Bins + bin];
+				uint32_t amount = slot;
+				slot = offset;
+				offset += amount;
+			}
+		}
+
+		ParallelFor(workers, count, [&](unsigned t, uint32_t begin, uint32_t end)
+		{
+			uint32_t* offsets = &histograms[size_t(t) * Bins];
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				uint32_t dst = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+				dstKeys[dst] = srcKeys[i];
+				dstValues[dst] = srcValues[i];
+			}
+		});
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+	}
+
+	//An odd number of passes leaves the result in scratch
+	if (srcKeys != keys)
+	{
+		memcpy(keys, srcKeys, count * sizeof(uint32_t));
+		memcpy(values, srcValues, count * sizeof(uint32_t));
+	}
+}
+
+DepthSortCPU::DepthSortCPU(WorkerPool& workers) noexcept :
+	workers_(workers), incremental_(false)
+{
+}
+
+void DepthSortCPU::Sort(const BehaviorDataCPU* particles, uint32_t count, const float camera[3], const float forward[3])
+{
+	//The previous order is only a permutation of the same particles if the count is unchanged
+	incremental_ = indices_.size() == count;
+
+	if (!incremental_)
+	{
+		indices_.resize(count);
+		std::iota(indices_.begin(), indices_.end(), 0u);
+	}
+
+	keys_.resize(count);
+
+	//Keys are built in the previous order, larger depth must come first so the key is inverted
+	ParallelFor(workers_, count, [&](unsigned, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const float* pos = particles[indices_[i]].pos;
+			float depth = (pos[0] - camera[0]) * forward[0]
+						+ (pos[1] - camera[1]) * forward[1]
+						+ (pos[2] - camera[2]) * forward[2];
+
+			keys_[i] = ~FloatToSortable(depth);
+		}
+	});
+
+	//Counts neighbors that are out of order
+	uint32_t descents = 0;
+	for (uint32_t i = 1; i < count; ++i)
+		descents += keys_[i - 1] > keys_[i];
+
+	if (descents == 0)
+		return;
+
+	if (incremental_ && descents <= count / IncrementalDivisor)
+	{
+		//Nearly sorted, insertion sort is close to linear here. Few descents
+		//can still hide long moves, past the budget the radix sort finishes.
+		uint64_t moves = 0;
+		const uint64_t maxMoves = uint64_t(count) * IncrementalMoves;
+
+		uint32_t i = 1;
+		for (; i < count && moves <= maxMoves; ++i)
+		{
+			uint32_t key = keys_[i];
+			uint32_t index = indices_[i];
+			uint32_t j = i;
+
+			while (j > 0 && keys_[j - 1] > key)
+			{
+				keys_[j] = keys_[j - 1];
+				indices_[j] = indices_[j - 1];
+				--j;
+			}
+
+			keys_[j] = key;
+			indices_[j] = index;
+			moves += i - j;
+		}
+
+		if (i == count)
+			return;
+	}
+
+	incremental_ = false;
+	scratchKeys_.resize(count);
+	scratchIndices_.resize(count);
+	RadixSort(keys_.data(), indices_.data(), count, scratchKeys_.data(), scratchIndices_.data(), workers_);
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,86 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineRadixSort.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Multithreaded CPU radix sort of 32 bit keys with indices and
+				a depth sorter built on it. Used as the reference for the GPU
+				sort and by the CPU simulation path.
+
+*******************************************************************************/
+#include <cstdint>					//Fixed width integers
+#include <cstring>					//memcpy
+#include <vector>					//Sort buffers
+#include "ParticleEngineKernels.h"	//BehaviorDataCPU
+
+namespace ParticleEngine
+{
+	class WorkerPool;
+
+	/// <summary>
+	/// Stable LSD radix sort of keys with their values, ascending.
+	/// Scratch arrays must hold count elements. Passes where every key has
+	/// the same digit are skipped. Chunks of each pass run on workers.
+	/// </summary>
+	void RadixSort(uint32_t* keys, uint32_t* values, uint32_t count,
+		uint32_t* scratchKeys, uint32_t* scratchValues, WorkerPool& workers);
+
+	/// <summary>
+	/// Maps a float to a uint that sorts in the same order
+	/// </summary>
+	inline uint32_t FloatToSortable(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits ^ ((bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u);
+	}
+
+	/// <summary>
+	/// Sorts particles back to front along a camera direction. Keeps the
+	/// order between frames, when the alive count is unchanged the previous
+	/// order is nearly sorted and is fixed up with an insertion sort instead
+	/// of a full radix sort.
+	/// </summary>
+	class DepthSortCPU
+	{
+
+	public:
+
+		DepthSortCPU(WorkerPool& workers) noexcept;
+
+		/// <summary>
+		/// Sorts the first count particles. camera and forward are xyz
+		/// </summary>
+		void Sort(const BehaviorDataCPU* particles, uint32_t count, const float camera[3], const float forward[3]);
+
+		/// <summary>
+		/// Particle indices back to front, valid until the next Sort
+		/// </summary>
+		const std::vector<uint32_t>& Indices() const { return indices_; }
+
+		/// <summary>
+		/// True if the last sort reused the previous frames order
+		/// </summary>
+		bool WasIncremental() const { return incremental_; }
+
+		//Orders with more out of place neighbors than count / this do a full sort
+		static constexpr uint32_t IncrementalDivisor = 64;
+
+		//Incremental sorts that shift particles more than count * this times fall back to a full sort
+		static constexpr uint32_t IncrementalMoves = 8;
+
+	private:
+		WorkerPool& workers_;
+		bool incremental_;
+
+		std::vector<uint32_t> keys_;
+		std::vector<uint32_t> indices_;
+		std::vector<uint32_t> scratchKeys_;
+		std::vector<uint32_t> scratchIndices_;
+	};
+
+}
@@ -0,0 +1,105 @@
+/*******************************************************************************
+
+	@file       ParticleEngineRouter.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Decides per emitter whether it is simulated by the compute
+				shader or by the CPU kernels. Small emitters spend more time
+				setting up a dispatch than doing math, so they move to the CPU
+				when the measured cost of their dispatch is higher than the
+				measured cost of simulating their particles on the CPU.
+
+*******************************************************************************/
+#include "stdafx.h"					//Header included in all files.
+#include "ParticleEngineRouter.h"	//This files header
+
+namespace ParticleEngine
+{
+
+//Weight of a new measurement in the running estimates
+static constexpr float CostSmoothing = .1f;
+
+//How much cheaper the other route has to be before an emitter switches,
+//keeps emitters near the break even point from flipping every frame
+static constexpr float SwitchMargin = .25f;
+
+//Emitters not routed for this many frames are forgotten
+static constexpr uint32_t ForgetAfterFrames = 120;
+
+static float Smooth(float estimate, float measured)
+{
+	return estimate + (measured - estimate) * CostSmoothing;
+}
+
+void EmitterRouter::BeginFrame()
+{
+	frameStats_.gpuSecondsPerEmitter = gpuSecondsPerEmitter_;
+	frameStats_.cpuSecondsPerParticle = cpuSecondsPerParticle_;
+	stats_ = frameStats_;
+	frameStats_ = Stats();
+
+	frame_++;
+	for (auto it = emitters_.begin(); it != emitters_.end();)
+	{
+		if (frame_ - it->second.lastFrame > ForgetAfterFrames)
+			it = emitters_.erase(it);
+		else
+			++it;
+	}
+}
+
+SimulationRoute EmitterRouter::Route(const void* emitter, uint32_t particles, bool cpuCapable)
+{
+	EmitterState& state = emitters_[emitter];
+	state.lastFrame = frame_;
+
+	SimulationRoute route = SimulationRoute::GPU;
+	if (cpuEnabled_ && cpuCapable && particles <= maxCPUParticles_)
+	{
+		//An emitter costs one dispatch on the GPU and its particles on the CPU
+		float gpuCost = state.gpuSeconds >= 0.f ? state.gpuSeconds : gpuSecondsPerEmitter_;
+		float cpuCost = cpuSecondsPerParticle_ * particles;
+
+		if (state.route == SimulationRoute::CPU)
+			route = cpuCost <= gpuCost * (1.f + SwitchMargin) ? SimulationRoute::CPU : SimulationRoute::GPU;
+		else
+			route = cpuCost < gpuCost * (1.f - SwitchMargin) ? SimulationRoute::CPU : SimulationRoute::GPU;
+	}
+
+	if (route != state.route)
+		frameStats_.routeChanges++;
+
+	state.route = route;
+	return route;
+}
+
+void EmitterRouter::RecordGPU(const void* emitter, uint32_t particles, double seconds)
+{
+	auto found = emitters_.find(emitter);
+	if (found != emitters_.end())
+	{
+		float& cost = found->second.gpuSeconds;
+		cost = cost >= 0.f ? Smooth(cost, (float)seconds) : (float)seconds;
+	}
+
+	gpuSecondsPerEmitter_ = Smooth(gpuSecondsPerEmitter_, (float)seconds);
+
+	frameStats_.gpuEmitters++;
+	frameStats_.gpuParticles += particles;
+	frameStats_.gpuSeconds += seconds;
+}
+
+void EmitterRouter::RecordCPU(uint32_t emitters, uint32_t particles, double seconds)
+{
+	if (particles > 0)
+		cpuSecondsPerParticle_ = Smooth(cpuSecondsPerParticle_, (float)(seconds / particles));
+
+	frameStats_.cpuEmitters += emitters;
+	frameStats_.cpuParticles += particles;
+	frameStats_.cpuSeconds += seconds;
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,108 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineRouter.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Decides per emitter whether it is simulated by the compute
+				shader or by the CPU kernels. Small emitters spend more time
+				setting up a dispatch than doing math, so they move to the CPU
+				when the measured cost of their dispatch is higher than the
+				measured cost of simulating their particles on the CPU.
+
+				This header only depends on the standard library.
+
+*******************************************************************************/
+#include <cstdint>			//Fixed width integers
+#include <unordered_map>	//Per emitter costs
+
+namespace ParticleEngine
+{
+	enum class SimulationRoute : uint8_t
+	{
+		GPU,
+		CPU,
+	};
+
+	class EmitterRouter
+	{
+
+	public:
+
+		/// <summary>
+		/// Last frames routing, every cost is in seconds of main thread time
+		/// </summary>
+		struct Stats
+		{
+			uint32_t gpuEmitters = 0;
+			uint32_t cpuEmitters = 0;
+			uint32_t gpuParticles = 0;
+			uint32_t cpuParticles = 0;
+			uint32_t routeChanges = 0;		 //Emitters that switched route
+			double gpuSeconds = 0.0;		 //Spent issuing dispatches
+			double cpuSeconds = 0.0;		 //Spent waiting on the CPU batch
+			float gpuSecondsPerEmitter = 0.f; //Running estimate of one dispatch
+			float cpuSecondsPerParticle = 0.f; //Running estimate of one CPU particle
+		};
+
+		/// <summary>
+		/// Call once per frame before routing, keeps last frames stats
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		/// Returns the route of an emitter with particles live and pending
+		/// particles. Emitters that use features the CPU kernels do not have
+		/// pass cpuCapable false and always use the GPU.
+		/// </summary>
+		SimulationRoute Route(const void* emitter, uint32_t particles, bool cpuCapable);
+
+		/// <summary>
+		/// Records how long the dispatch of one emitter took to issue
+		/// </summary>
+		void RecordGPU(const void* emitter, uint32_t particles, double seconds);
+
+		/// <summary>
+		/// Records how long the CPU batch took for emitters and their particles
+		/// </summary>
+		void RecordCPU(uint32_t emitters, uint32_t particles, double seconds);
+
+		/// <summary>
+		/// Emitters above this many particles always use the GPU
+		/// </summary>
+		void SetMaxCPUParticles(uint32_t particles) { maxCPUParticles_ = particles; }
+
+		/// <summary>
+		/// Turns the CPU route off, every emitter uses the GPU
+		/// </summary>
+		void SetCPUEnabled(bool enabled) { cpuEnabled_ = enabled; }
+
+		const Stats& GetStats() const { return stats_; }
+
+	private:
+
+		struct EmitterState
+		{
+			SimulationRoute route = SimulationRoute::GPU;
+			float gpuSeconds = -1.f; //Measured dispatch cost, negative until measured
+			uint32_t lastFrame = 0;
+		};
+
+		std::unordered_map<const void*, EmitterState> emitters_;
+
+		//Starting estimates until the first measurements come in
+		float gpuSecondsPerEmitter_ = 40e-6f;
+		float cpuSecondsPerParticle_ = 50e-9f;
+
+		uint32_t maxCPUParticles_ = 2048;
+		bool	 cpuEnabled_ = true;
+		uint32_t frame_ = 0;
+
+		Stats stats_;	   //Last frame
+		Stats frameStats_; //This frame
+	};
+
+}
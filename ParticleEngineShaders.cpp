@@ -0,0 +1,138 @@
+/*******************************************************************************
+
+	@file       ParticleEngineShaders.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Helpers shared by the particle engine stages for loading
+				compute shaders and creating the buffers they work on.
+
+*******************************************************************************/
+#include "stdafx.h"					//Header included in all files.
+#include "ParticleEngineShaders.h"	//This files header
+#include <d3dcompiler.h>			//DirectX header
+#include "Bindable.h"				//Part of our graphics engine
+#include "Graphics.h"				//Part of our graphics engine
+
+namespace ParticleEngine
+{
+ID3D11ComputeShader* LoadComputeShader(ID3D11Device* device, const wchar_t* csoPath, const wchar_t* sourcePath,
+	const char* entryPoint, const D3D_SHADER_MACRO* defines)
+{
+	ID3D11ComputeShader* shader = nullptr;
+
+	try
+	{
+		HRESULT hr = NULL;
+		ID3DBlob* pBlob = nullptr;
+
+		//Finds the correct Compute Shader
+		hr = D3DReadFileToBlob(csoPath, &pBlob);
+
+		if (FAILED(hr))
+		{
+			//Compiles from source and caches the blob for the next run
+			ID3DBlob* pErrors = nullptr;
+			hr = D3DCompileFromFile(sourcePath, defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+				entryPoint, "cs_5_0", D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &pBlob, &pErrors);
+
+			if (pErrors)
+			{
+				LOG_ERROR("Failed DirectX", (const char*)pErrors->GetBufferPointer());
+				pErrors->Release();
+			}
+			HR_EXCEPT(hr);
+
+			D3DWriteBlobToFile(pBlob, csoPath, TRUE);
+		}
+
+		// Create the Compute shader from the buffer.
+		hr = device->CreateComputeShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), NULL, &shader);
+		pBlob->Release();
+		HR_EXCEPT(hr);
+	}
+	catch (const HResultException&)
+	{
+		LOG_ERROR("Failed DirectX", "failed to load particle engine compute shader");
+		RELEASE(shader);
+	}
+
+	return shader;
+}
+
+void CreateStructuredBuffer(ID3D11Device* device, UINT stride, UINT count, const void* initialData,
+	ID3D11Buffer** buffer, ID3D11ShaderResourceView** srv, ID3D11UnorderedAccessView** uav, UINT uavFlags)
+{
+	HRESULT hr = S_OK;
+
+	D3D11_BUFFER_DESC Desc = {};
+	Desc.Usage				 = D3D11_USAGE_DEFAULT;
+	Desc.BindFlags			 = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+	Desc.CPUAccessFlags		 = 0;
+	Desc.MiscFlags			 = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	Desc.StructureByteStride = stride;
+	Desc.ByteWidth			 = stride * count;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = initialData;
+
+	INFO_SET device->CreateBuffer(&Desc, initialData ? &data : nullptr, buffer);
+	DX_EXCEPT(hr);
+
+	if (srv)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format				= DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension		= D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements	= count;
+
+		INFO_SET device->CreateShaderResourceView(*buffer, &srvDesc, srv);
+		DX_EXCEPT(hr);
+	}
+
+	if (uav)
+	{
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format				= DXGI_FORMAT_UNKNOWN;
+		uavDesc.ViewDimension		= D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements	= count;
+		uavDesc.Buffer.Flags		= uavFlags;
+
+		INFO_SET device->CreateUnorderedAccessView(*buffer, &uavDesc, uav);
+		DX_EXCEPT(hr);
+	}
+}
+
+void CreateConstantBuffer(ID3D11Device* device, UINT size, ID3D11Buffer** buffer)
+{
+	HRESULT hr = S_OK;
+
+	D3D11_BUFFER_DESC Desc;
+	Desc.Usage				 = D3D11_USAGE_DYNAMIC;
+	Desc.BindFlags			 = D3D11_BIND_CONSTANT_BUFFER;
+	Desc.CPUAccessFlags		 = D3D11_CPU_ACCESS_WRITE;
+	Desc.MiscFlags			 = 0;
+	Desc.StructureByteStride = 0;
+	Desc.ByteWidth			 = (size + 15) & ~15u; //Constant buffers are multiples of 16 bytes
+
+	INFO_SET device->CreateBuffer(&Desc, nullptr, buffer);
+	DX_EXCEPT(hr);
+}
+
+void UpdateConstantBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, const void* data, UINT size)
+{
+	D3D11_MAPPED_SUBRESOURCE MappedResource;
+	ZeroMemory(&MappedResource, sizeof(D3D11_MAPPED_SUBRESOURCE));
+
+	if (SUCCEEDED(deviceContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource)))
+	{
+		memcpy(MappedResource.pData, data, size);
+		deviceContext->Unmap(buffer, 0);
+	}
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,48 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineShaders.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Helpers shared by the particle engine stages for loading
+				compute shaders and creating the buffers they work on.
+
+*******************************************************************************/
+#include <d3d11.h>		//DirectX header
+#include <d3dcommon.h>	//D3D_SHADER_MACRO
+
+//Allows easier relase of Direct X Buffers
+#define RELEASE(ptr){ if (ptr) { (ptr)->Release(); ptr = nullptr; } }
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Loads a compute shader from a precompiled .cso. If it is missing the
+	/// source is compiled with the given entry point and defines and the blob
+	/// is written to the .cso path so the next run loads it directly.
+	/// Returns nullptr and logs on failure.
+	/// </summary>
+	ID3D11ComputeShader* LoadComputeShader(ID3D11Device* device, const wchar_t* csoPath, const wchar_t* sourcePath,
+		const char* entryPoint, const D3D_SHADER_MACRO* defines = nullptr);
+
+	/// <summary>
+	/// Creates a structured buffer with a shader resource and unordered access view.
+	/// Any of the out pointers may be nullptr. Throws on failure like the rest of the engine.
+	/// </summary>
+	void CreateStructuredBuffer(ID3D11Device* device, UINT stride, UINT count, const void* initialData,
+		ID3D11Buffer** buffer, ID3D11ShaderResourceView** srv, ID3D11UnorderedAccessView** uav, UINT uavFlags = 0);
+
+	/// <summary>
+	/// Creates a dynamic constant buffer
+	/// </summary>
+	void CreateConstantBuffer(ID3D11Device* device, UINT size, ID3D11Buffer** buffer);
+
+	/// <summary>
+	/// Copies data into a dynamic constant buffer with a discard map
+	/// </summary>
+	void UpdateConstantBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, const void* data, UINT size);
+
+}
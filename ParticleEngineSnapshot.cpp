@@ -0,0 +1,321 @@
+/*******************************************************************************
+
+	@file       ParticleEngineSnapshot.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Compact stream format for particle state. Every field of the
+				particles is quantized and stored as its own column. A column
+				is delta coded against the previous snapshot, or against the
+				previous particle in a keyframe, then written as zigzag
+				varints so unchanged data costs about a byte per value.
+
+*******************************************************************************/
+#include "stdafx.h"					//Header included in all files.
+#include "ParticleEngineSnapshot.h"	//This files header
+#include <cmath>					//std::floor
+#include <cstring>					//memcpy
+
+namespace ParticleEngine
+{
+
+//Quantization step of every field in BehaviorDataCPU, zero keeps the raw bits
+static const float FieldSteps[Snapshot::FieldCount] =
+{
+	1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, //pos
+	1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, //vel
+	1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, //accel
+	1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, 1.f / 4096.f, //physicsPieces
+	1.f / 1024.f, 1.f / 1024.f, 1.f / 1024.f, 1.f / 1024.f, //color
+	1.f / 4096.f, 1.f / 4096.f,								//imageRotation
+	1.f / 8192.f, 1.f / 8192.f,								//lifetime
+	1.f / 8192.f, 1.f / 8192.f,								//scale
+	0.f, 0.f, 0.f, 0.f										//seed, kept exact so random streams match
+};
+
+static int32_t Quantize(float value, float step)
+{
+	if (step == 0.f)
+	{
+		int32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	double scaled = std::floor(double(value) / step + .5);
+	if (scaled > 2147483647.0)	scaled = 2147483647.0;
+	if (scaled < -2147483648.0) scaled = -2147483648.0;
+	return static_cast<int32_t>(scaled);
+}
+
+static float Dequantize(int32_t value, float step)
+{
+	if (step == 0.f)
+	{
+		float bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	return static_cast<float>(value * double(step));
+}
+
+static void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool ReadVarint(const uint8_t*& cursor, const uint8_t* end, uint32_t& value)
+{
+	value = 0;
+	for (uint32_t shift = 0; shift < 35; shift += 7)
+	{
+		if (cursor == end)
+			return false;
+
+		uint8_t byte = *cursor++;
+		value |= uint32_t(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+static uint32_t ZigZag(int32_t value) { return (uint32_t(value) << 1) ^ uint32_t(value >> 31); }
+static int32_t UnZigZag(uint32_t value) { return int32_t(value >> 1) ^ -int32_t(value & 1); }
+
+//Value a field is predicted from, the same particle last frame or the previous particle in this one
+static int32_t Predict(const std::vector<int32_t>& quantized, const std::vector<int32_t>* previous,
+	uint32_t particle, uint32_t field)
+{
+	size_t index = size_t(particle) * Snapshot::FieldCount + field;
+	if (previous && index < previous->size())
+		return (*previous)[index];
+
+	return particle > 0 ? quantized[index - Snapshot::FieldCount] : 0;
+}
+
+void EncodeParticles(const BehaviorDataCPU* particles, uint32_t count, const std::vector<int32_t>* previous,
+	std::vector<int32_t>& quantized, std::vector<uint8_t>& out)
+{
+	quantized.resize(size_t(count) * Snapshot::FieldCount);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const float* fields = reinterpret_cast<const float*>(&particles[i]);
+		for (uint32_t f = 0; f < Snapshot::FieldCount; ++f)
+			quantized[size_t(i) * Snapshot::FieldCount + f] = Quantize(fields[f], FieldSteps[f]);
+	}
+
+	//Columns keep similar values next to each other
+	for (uint32_t f = 0; f < Snapshot::FieldCount; ++f)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			int32_t value = quantized[size_t(i) * Snapshot::FieldCount + f];
+			int32_t delta = int32_t(uint32_t(value) - uint32_t(Predict(quantized, previous, i, f)));
+			WriteVarint(out, ZigZag(delta));
+		}
+	}
+}
+
+bool DecodeParticles(const uint8_t*& cursor, const uint8_t* end, uint32_t count, const std::vector<int32_t>* previous,
+	std::vector<int32_t>& quantized, BehaviorDataCPU* particles)
+{
+	quantized.resize(size_t(count) * Snapshot::FieldCount);
+
+	for (uint32_t f = 0; f < Snapshot::FieldCount; ++f)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t zigzag;
+			if (!ReadVarint(cursor, end, zigzag))
+				return false;
+
+			int32_t value = int32_t(uint32_t(Predict(quantized, previous, i, f)) + uint32_t(UnZigZag(zigzag)));
+			quantized[size_t(i) * Snapshot::FieldCount + f] = value;
+		}
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float* fields = reinterpret_cast<float*>(&particles[i]);
+		for (uint32_t f = 0; f < Snapshot::FieldCount; ++f)
+			fields[f] = Dequantize(quantized[size_t(i) * Snapshot::FieldCount + f], FieldSteps[f]);
+	}
+
+	return true;
+}
+
+#pragma region SnapshotWriter
+
+bool SnapshotWriter::Open(const std::string& path)
+{
+	Close();
+
+	file_.open(path, std::ios::binary | std::ios::trunc);
+	if (!file_.is_open())
+		return false;
+
+	uint32_t header[2] = { Snapshot::Magic, Snapshot::Version };
+	file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	framesSinceKeyframe_ = 0;
+	previous_.clear();
+	return file_.good();
+}
+
+void SnapshotWriter::Close()
+{
+	if (file_.is_open())
+		file_.close();
+
+	previous_.clear();
+}
+
+bool SnapshotWriter::Write(const SnapshotFrame& frame)
+{
+	if (!file_.is_open())
+		return false;
+
+	//The first frame and every KeyframeInterval after it stand on their own
+	bool keyframe = previous_.empty() || framesSinceKeyframe_ >= Snapshot::KeyframeInterval
+		|| previous_.size() != frame.emitters.size();
+	framesSinceKeyframe_ = keyframe ? 1 : framesSinceKeyframe_ + 1;
+
+	std::vector<std::vector<int32_t>> quantized(frame.emitters.size());
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> columns;
+
+	float seeds[2] = { frame.spawnSeed, frame.cpuSeed };
+	const uint8_t* seedBytes = reinterpret_cast<const uint8_t*>(seeds);
+	payload.insert(payload.end(), seedBytes, seedBytes + sizeof(seeds));
+
+	for (size_t e = 0; e < frame.emitters.size(); ++e)
+	{
+		const SnapshotEmitter& emitter = frame.emitters[e];
+		uint32_t alive = static_cast<uint32_t>(emitter.particles.size());
+
+		columns.clear();
+		EncodeParticles(emitter.particles.data(), alive, keyframe ? nullptr : &previous_[e], quantized[e], columns);
+
+		WriteVarint(payload, emitter.id);
+		WriteVarint(payload, emitter.capacity);
+		WriteVarint(payload, alive);
+
+		const uint8_t* timer = reinterpret_cast<const uint8_t*>(&emitter.emissionTimer);
+		payload.insert(payload.end(), timer, timer + sizeof(float));
+
+		WriteVarint(payload, static_cast<uint32_t>(columns.size()));
+		payload.insert(payload.end(), columns.begin(), columns.end());
+	}
+
+	uint32_t frameHeader[4] =
+	{
+		Snapshot::FrameMagic,
+		keyframe ? Snapshot::FlagKeyframe : 0u,
+		static_cast<uint32_t>(frame.emitters.size()),
+		static_cast<uint32_t>(payload.size())
+	};
+
+	file_.write(reinterpret_cast<const char*>(frameHeader), sizeof(frameHeader));
+	file_.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	file_.flush();
+
+	previous_ = std::move(quantized);
+	return file_.good();
+}
+
+#pragma endregion
+
+#pragma region SnapshotReader
+
+bool SnapshotReader::Open(const std::string& path)
+{
+	file_.close();
+	previous_.clear();
+
+	file_.open(path, std::ios::binary);
+	if (!file_.is_open())
+		return false;
+
+	uint32_t header[2] = {};
+	file_.read(reinterpret_cast<char*>(header), sizeof(header));
+
+	return file_.good() && header[0] == Snapshot::Magic && header[1] == Snapshot::Version;
+}
+
+bool SnapshotReader::Next(SnapshotFrame& frame)
+{
+	uint32_t frameHeader[4] = {};
+	file_.read(reinterpret_cast<char*>(frameHeader), sizeof(frameHeader));
+
+	if (!file_.good() || frameHeader[0] != Snapshot::FrameMagic)
+		return false;
+
+	bool keyframe = (frameHeader[1] & Snapshot::FlagKeyframe) != 0;
+	uint32_t emitterCount = frameHeader[2];
+
+	//Deltas need the frame before them
+	if (!keyframe && previous_.size() != emitterCount)
+		return false;
+
+	std::vector<uint8_t> payload(frameHeader[3]);
+	file_.read(reinterpret_cast<char*>(payload.data()), payload.size());
+	if (!file_.good())
+		return false;
+
+	const uint8_t* cursor = payload.data();
+	const uint8_t* end = cursor + payload.size();
+
+	float seeds[2];
+	if (end - cursor < (ptrdiff_t)sizeof(seeds))
+		return false;
+
+	memcpy(seeds, cursor, sizeof(seeds));
+	cursor += sizeof(seeds);
+	frame.spawnSeed = seeds[0];
+	frame.cpuSeed = seeds[1];
+
+	std::vector<std::vector<int32_t>> quantized(emitterCount);
+	frame.emitters.resize(emitterCount);
+
+	for (uint32_t e = 0; e < emitterCount; ++e)
+	{
+		SnapshotEmitter& emitter = frame.emitters[e];
+
+		uint32_t alive, size;
+		if (!ReadVarint(cursor, end, emitter.id) || !ReadVarint(cursor, end, emitter.capacity) || !ReadVarint(cursor, end, alive)
+			|| end - cursor < (ptrdiff_t)sizeof(float))
+		{
+			return false;
+		}
+
+		memcpy(&emitter.emissionTimer, cursor, sizeof(float));
+		cursor += sizeof(float);
+
+		if (!ReadVarint(cursor, end, size) || size > size_t(end - cursor) || alive > emitter.capacity)
+			return false;
+
+		const uint8_t* columnsEnd = cursor + size;
+		emitter.particles.resize(alive);
+		if (!DecodeParticles(cursor, columnsEnd, alive, keyframe ? nullptr : &previous_[e], quantized[e], emitter.particles.data()))
+			return false;
+
+		cursor = columnsEnd;
+	}
+
+	previous_ = std::move(quantized);
+	return true;
+}
+
+#pragma endregion
+
+}//End of Particle Engine NameSpace
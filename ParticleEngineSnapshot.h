@@ -0,0 +1,139 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineSnapshot.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Compact stream format for particle state. Every field of the
+				particles is quantized and stored as its own column. A column
+				is delta coded against the previous snapshot, or against the
+				previous particle in a keyframe, then written as zigzag
+				varints so unchanged data costs about a byte per value.
+
+				This file only depends on the standard library so snapshots
+				can be read by tools that run without a graphics device.
+
+*******************************************************************************/
+#include <cstdint>					//Fixed width integers
+#include <fstream>					//Snapshot streams
+#include <string>					//File paths
+#include <vector>					//Particle storage
+#include "ParticleEngineKernels.h"	//BehaviorDataCPU
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Layout of a snapshot stream
+	///		header  { magic, version }
+	///		frame   { frameMagic, flags, emitterCount, payloadSize } payload [payloadSize]
+	///		...
+	/// Every frame payload starts with float spawnSeed, float cpuSeed and holds each emitter as
+	///		varint id, varint capacity, varint alive, float emissionTimer, varint size, columns [size]
+	/// </summary>
+	namespace Snapshot
+	{
+		constexpr uint32_t Magic	  = 0x4E534550; // "PESN"
+		constexpr uint32_t FrameMagic = 0x46534550; // "PESF"
+		constexpr uint32_t Version	  = 2;
+
+		//Frames between keyframes, a reader can only start at a keyframe
+		constexpr uint32_t KeyframeInterval = 8;
+
+		constexpr uint32_t FlagKeyframe = 1u << 0;
+
+		//Number of 32 bit fields in BehaviorDataCPU
+		constexpr uint32_t FieldCount = sizeof(BehaviorDataCPU) / sizeof(float);
+	}
+
+	/// <summary>
+	/// The state of one emitter inside a snapshot
+	/// </summary>
+	struct SnapshotEmitter
+	{
+		uint32_t id = 0;			//Stable id of the owner, zero if it has none
+		uint32_t capacity = 0;		//Size of the particle pool it was taken from
+		float emissionTimer = 0.f;	//Time since the last timed emission
+		std::vector<BehaviorDataCPU> particles; //Alive particles
+	};
+
+	/// <summary>
+	/// Every emitter of the scene at one point in time
+	/// </summary>
+	struct SnapshotFrame
+	{
+		//Where the spawn passes were in their random sequence
+		float spawnSeed = 0.f;
+		float cpuSeed = 0.f;
+
+		std::vector<SnapshotEmitter> emitters;
+	};
+
+	/// <summary>
+	/// Writes frames to a stream. Not thread safe, but it may be used from
+	/// a worker thread as long as only one thread uses it at a time.
+	/// </summary>
+	class SnapshotWriter
+	{
+
+	public:
+
+		/// <summary>
+		/// Starts a new stream, replacing the file
+		/// </summary>
+		bool Open(const std::string& path);
+
+		void Close();
+
+		bool IsOpen() const { return file_.is_open(); }
+
+		/// <summary>
+		/// Appends a frame, every KeyframeInterval frames is a keyframe
+		/// </summary>
+		bool Write(const SnapshotFrame& frame);
+
+	private:
+		std::ofstream file_;
+		uint32_t framesSinceKeyframe_ = 0;
+
+		//Quantized fields of the last frame that deltas are taken against
+		std::vector<std::vector<int32_t>> previous_;
+	};
+
+	/// <summary>
+	/// Reads frames from a stream in order
+	/// </summary>
+	class SnapshotReader
+	{
+
+	public:
+
+		bool Open(const std::string& path);
+
+		/// <summary>
+		/// Reads the next frame. Returns false at the end of the stream or on bad data.
+		/// </summary>
+		bool Next(SnapshotFrame& frame);
+
+	private:
+		std::ifstream file_;
+		std::vector<std::vector<int32_t>> previous_;
+	};
+
+	/// <summary>
+	/// Quantizes particles and appends their columns to out. previous is the
+	/// quantized data of the same emitter in the last frame, nullptr for a keyframe.
+	/// quantized receives this frames quantized data for the next delta.
+	/// </summary>
+	void EncodeParticles(const BehaviorDataCPU* particles, uint32_t count, const std::vector<int32_t>* previous,
+		std::vector<int32_t>& quantized, std::vector<uint8_t>& out);
+
+	/// <summary>
+	/// Reverses EncodeParticles, returns false if the data is cut short
+	/// </summary>
+	bool DecodeParticles(const uint8_t*& cursor, const uint8_t* end, uint32_t count, const std::vector<int32_t>* previous,
+		std::vector<int32_t>& quantized, BehaviorDataCPU* particles);
+
+}
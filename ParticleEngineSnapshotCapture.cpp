@@ -0,0 +1,231 @@
+/*******************************************************************************
+
+	@file       ParticleEngineSnapshotCapture.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Captures particle pools into a snapshot stream without
+				stalling the frame. Pools are copied to pooled staging buffers
+				and mapped once the GPU is done with them on a later frame. A
+				worker thread reads the mapped copies, encodes and writes them.
+
+*******************************************************************************/
+#include "stdafx.h"							//Header included in all files.
+#include "ParticleEngineSnapshotCapture.h"	//This files header
+#include "Bindable.h"						//Part of our graphics engine
+#include "Graphics.h"						//Part of our graphics engine
+#include "ParticleEngineShaders.h"			//RELEASE
+#include <algorithm>						//std::find_if
+
+namespace ParticleEngine
+{
+SnapshotCapture::SnapshotCapture(ID3D11Device* device) noexcept :
+	device_(device)
+{
+}
+
+SnapshotCapture::~SnapshotCapture() noexcept
+{
+	Close();
+}
+
+bool SnapshotCapture::Open(const std::string& path)
+{
+	Close();
+
+	if (!writer_.Open(path))
+	{
+		LOG_ERROR("ParticleSnapshot", "Could not open " + path)
+		return false;
+	}
+
+	return true;
+}
+
+void SnapshotCapture::Close()
+{
+	if (worker_.valid())
+		worker_.wait();
+
+	ReleasePending();
+	writer_.Close();
+}
+
+bool SnapshotCapture::IsBusy() const
+{
+	if (submitted_ || !pending_.empty())
+		return true;
+
+	return worker_.valid() && worker_.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+void SnapshotCapture::RecyclePending()
+{
+	for (PendingCopy& copy : pending_)
+	{
+		if (!copy.staging.buffer)
+			continue;
+
+		if (copy.mapped && mappedContext_)
+			mappedContext_->Unmap(copy.staging.buffer, 0);
+
+		free_.push_back(copy.staging);
+	}
+
+	pending_.clear();
+	submitted_ = false;
+	mappedContext_ = nullptr;
+}
+
+void SnapshotCapture::ReleasePending()
+{
+	RecyclePending();
+
+	for (Staging& staging : free_)
+		RELEASE(staging.buffer);
+	free_.clear();
+}
+
+SnapshotCapture::Staging SnapshotCapture::Acquire(UINT size)
+{
+	//The smallest buffer that fits keeps the large ones for large pools
+	auto best = free_.end();
+	auto largest = free_.end();
+	for (auto it = free_.begin(); it != free_.end(); ++it)
+	{
+		if (it->size >= size && (best == free_.end() || it->size < best->size))
+			best = it;
+		if (largest == free_.end() || it->size > largest->size)
+			largest = it;
+	}
+
+	if (best != free_.end())
+	{
+		Staging staging = *best;
+		free_.erase(best);
+		return staging;
+	}
+
+	//Nothing fits, the largest buffer is too small for this pool from now on
+	if (largest != free_.end())
+	{
+		RELEASE(largest->buffer);
+		free_.erase(largest);
+	}
+
+	HRESULT hr = S_OK;
+
+	//Headroom so a pool that grows a little between captures keeps its buffer
+	Staging staging = { nullptr, size + size / 4 };
+
+	D3D11_BUFFER_DESC Desc = {};
+	Desc.Usage			= D3D11_USAGE_STAGING;
+	Desc.BindFlags		= 0;
+	Desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	Desc.ByteWidth		= staging.size;
+
+	INFO_SET device_->CreateBuffer(&Desc, nullptr, &staging.buffer);
+	DX_EXCEPT(hr);
+
+	return staging;
+}
+
+void SnapshotCapture::Copy(ID3D11DeviceContext* deviceContext, ID3D11Buffer* particles, UINT alive, UINT capacity,
+	uint32_t id, float emissionTimer)
+{
+	PendingCopy copy = { { nullptr, 0 }, alive, capacity, id, emissionTimer, nullptr };
+
+	if (alive > 0 && particles)
+	{
+		UINT size = alive * (UINT)sizeof(BehaviorDataCPU);
+		copy.staging = Acquire(size);
+
+		//Only the alive front of the pool is read back
+		D3D11_BOX box = { 0, 0, 0, size, 1, 1 };
+		deviceContext->CopySubresourceRegion(copy.staging.buffer, 0, 0, 0, 0, particles, 0, &box);
+	}
+
+	pending_.push_back(copy);
+}
+
+void SnapshotCapture::Submit(float spawnSeed, float cpuSeed)
+{
+	spawnSeed_ = spawnSeed;
+	cpuSeed_ = cpuSeed;
+	submitted_ = true;
+}
+
+void SnapshotCapture::Poll(ID3D11DeviceContext* deviceContext)
+{
+	//The writer is still reading the mapped copies
+	if (worker_.valid() && worker_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	//The writer finished with the last frame, its buffers go back to the pool
+	if (mappedContext_)
+	{
+		RecyclePending();
+		return;
+	}
+
+	if (!submitted_)
+		return;
+
+	//Copies finish in order so the last one tells if they all have
+	auto last = std::find_if(pending_.rbegin(), pending_.rend(), [](const PendingCopy& copy) { return copy.staging.buffer; });
+	if (last != pending_.rend())
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = deviceContext->Map(last->staging.buffer, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+			return;
+
+		if (SUCCEEDED(hr))
+			last->mapped = mapped.pData;
+	}
+
+	//The rest are done as well, mapping them does not wait
+	for (PendingCopy& copy : pending_)
+	{
+		if (!copy.staging.buffer || copy.mapped)
+			continue;
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (SUCCEEDED(deviceContext->Map(copy.staging.buffer, 0, D3D11_MAP_READ, 0, &mapped)))
+			copy.mapped = mapped.pData;
+	}
+
+	mappedContext_ = deviceContext;
+
+	//Copying out, quantizing and writing a large scene takes a while, keep
+	//it all off the frame. The copies stay mapped until the worker is done.
+	worker_ = std::async(std::launch::async, [this]()
+	{
+		SnapshotFrame frame;
+		frame.spawnSeed = spawnSeed_;
+		frame.cpuSeed = cpuSeed_;
+		frame.emitters.resize(pending_.size());
+
+		for (size_t i = 0; i < pending_.size(); ++i)
+		{
+			const PendingCopy& copy = pending_[i];
+			SnapshotEmitter& emitter = frame.emitters[i];
+
+			emitter.id = copy.id;
+			emitter.capacity = copy.capacity;
+			emitter.emissionTimer = copy.emissionTimer;
+
+			if (copy.mapped)
+			{
+				const BehaviorDataCPU* particles = static_cast<const BehaviorDataCPU*>(copy.mapped);
+				emitter.particles.assign(particles, particles + copy.alive);
+			}
+		}
+
+		return writer_.Write(frame);
+	});
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,114 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineSnapshotCapture.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Captures particle pools into a snapshot stream without
+				stalling the frame. Pools are copied to pooled staging buffers
+				and mapped once the GPU is done with them on a later frame. A
+				worker thread reads the mapped copies, encodes and writes them.
+
+*******************************************************************************/
+#include <d3d11.h>					//DirectX header
+#include <future>					//Encoding worker
+#include <string>					//File paths
+#include <vector>					//Pending copies
+#include "ParticleEngineSnapshot.h"	//Snapshot stream format
+
+namespace ParticleEngine
+{
+	class SnapshotCapture
+	{
+
+	public:
+
+		//Constructors
+		SnapshotCapture(ID3D11Device* device) noexcept;
+		~SnapshotCapture() noexcept;
+		SnapshotCapture(const SnapshotCapture&) = delete;
+		SnapshotCapture& operator=(const SnapshotCapture&) = delete;
+
+		/// <summary>
+		/// Starts a stream, captures are appended to it until it is closed
+		/// </summary>
+		bool Open(const std::string& path);
+
+		/// <summary>
+		/// Waits for the last capture and closes the stream
+		/// </summary>
+		void Close();
+
+		/// <summary>
+		/// True while a capture is being read back or written
+		/// </summary>
+		bool IsBusy() const;
+
+		/// <summary>
+		/// Queues a copy of the first alive particles of a pool. id is the
+		/// stable id of the owner that restores match it by.
+		/// Call for every emitter of a frame in order, then Submit.
+		/// </summary>
+		void Copy(ID3D11DeviceContext* deviceContext, ID3D11Buffer* particles, UINT alive, UINT capacity,
+			uint32_t id, float emissionTimer);
+
+		/// <summary>
+		/// Ends the frame of copies with the seeds of the spawn passes,
+		/// Poll finishes it once the GPU caught up
+		/// </summary>
+		void Submit(float spawnSeed, float cpuSeed);
+
+		/// <summary>
+		/// Call once per frame on the thread that owns the device context.
+		/// Maps the copies if the GPU is done with them and hands them to the
+		/// worker thread, then unmaps them once it is done. Never waits.
+		/// </summary>
+		void Poll(ID3D11DeviceContext* deviceContext);
+
+	private:
+
+		struct Staging
+		{
+			ID3D11Buffer* buffer;
+			UINT size; //Bytes
+		};
+
+		struct PendingCopy
+		{
+			Staging staging;
+			UINT alive;
+			UINT capacity;
+			uint32_t id;
+			float emissionTimer;
+			const void* mapped; //Read by the worker until the copy is unmapped
+		};
+
+		ID3D11Device* device_;
+
+		SnapshotWriter writer_;
+		std::vector<PendingCopy> pending_;
+		bool submitted_ = false;
+		float spawnSeed_ = 0.f;
+		float cpuSeed_ = 0.f;
+
+		//Staging buffers of finished captures, reused by the next ones
+		std::vector<Staging> free_;
+
+		//Set while the worker reads the mapped copies
+		ID3D11DeviceContext* mappedContext_ = nullptr;
+
+		std::future<bool> worker_;
+
+		//Returns a free staging buffer of at least size bytes, throws if one can not be created
+		Staging Acquire(UINT size);
+
+		//Unmaps the copies and returns their staging buffers to the pool
+		void RecyclePending();
+
+		void ReleasePending();
+	};
+
+}
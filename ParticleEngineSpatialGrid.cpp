@@ -0,0 +1,112 @@
+/*******************************************************************************
+
+	@file       ParticleEngineSpatialGrid.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      CPU uniform grid over particles built with a multithreaded
+				counting sort. Matches the GPU grid in CSParticleGrid.hlsl so
+				both backends answer neighbor queries the same way.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineSpatialGrid.h"	//This files header
+#include "ParticleEngineParallel.h"		//ParallelFor
+
+namespace ParticleEngine
+{
+
+SpatialGridCPU::SpatialGridCPU(WorkerPool& workers) noexcept :
+	workers_(workers), inverseCellSize_(1.f), tableSize_(1), counterCapacity_(0)
+{
+	cellStart_.assign(1, 0);
+	cellCount_.assign(1, 0);
+}
+
+void SpatialGridCPU::Build(const BehaviorDataCPU* particles, uint32_t count, float cellSize, uint32_t tableSize)
+{
+	inverseCellSize_ = cellSize > 0.f ? 1.f / cellSize : 1.f;
+
+	if (tableSize == 0)
+		tableSize = count;
+
+	tableSize_ = 1;
+	while (tableSize_ < tableSize)
+		tableSize_ <<= 1;
+
+	if (counterCapacity_ < tableSize_)
+	{
+		counters_.reset(new std::atomic<uint32_t>[tableSize_]);
+		counterCapacity_ = tableSize_;
+	}
+
+	cellStart_.resize(tableSize_);
+	cellCount_.resize(tableSize_);
+	particleCell_.resize(count);
+	sortedIndex_.resize(count);
+
+	//Clear counts
+	ParallelFor(workers_, tableSize_, [&](unsigned, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+			counters_[i].store(0, std::memory_order_relaxed);
+	});
+
+	//Hash and count every particle
+	ParallelFor(workers_, count, [&](unsigned, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const float* pos = particles[i].pos;
+			uint32_t bucket = Hash(Cell(pos[0]), Cell(pos[1]), Cell(pos[2]));
+
+			particleCell_[i] = bucket;
+			counters_[bucket].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	//Exclusive prefix sum, each chunk sums itself then adds the totals of the chunks before it
+	unsigned chunks = ParallelChunks(tableSize_, workers_.Size());
+	std::vector<uint32_t> chunkTotals(chunks + 1, 0);
+
+	ParallelFor(workers_, tableSize_, [&](unsigned t, uint32_t begin, uint32_t end)
+	{
+		uint32_t sum = 0;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			uint32_t amount = counters_[i].load(std::memory_order_relaxed);
+			cellCount_[i] = amount;
+			cellStart_[i] = sum;
+			sum += amount;
+		}
+		chunkTotals[t + 1] = sum;
+	});
+
+	for (unsigned t = 1; t <= chunks; ++t)
+		chunkTotals[t] += chunkTotals[t - 1];
+
+	ParallelFor(workers_, tableSize_, [&](unsigned t, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			cellStart_[i] += chunkTotals[t];
+
+			//Counters become the next free slot of each bucket
+			counters_[i].store(cellStart_[i], std::memory_order_relaxed);
+		}
+	});
+
+	//Scatter particle indices into their buckets
+	ParallelFor(workers_, count, [&](unsigned, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			uint32_t slot = counters_[particleCell_[i]].fetch_add(1, std::memory_order_relaxed);
+			sortedIndex_[slot] = i;
+		}
+	});
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,100 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineSpatialGrid.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      CPU uniform grid over particles built with a multithreaded
+				counting sort. Matches the GPU grid in CSParticleGrid.hlsl so
+				both backends answer neighbor queries the same way.
+
+*******************************************************************************/
+#include <cstdint>					//Fixed width integers
+#include <cmath>					//std::floor
+#include <atomic>					//Bucket counters
+#include <memory>					//std::unique_ptr
+#include <vector>					//Sorted indices
+#include "ParticleEngineKernels.h"	//BehaviorDataCPU
+
+namespace ParticleEngine
+{
+	class WorkerPool;
+
+	class SpatialGridCPU
+	{
+
+	public:
+
+		SpatialGridCPU(WorkerPool& workers) noexcept;
+
+		/// <summary>
+		/// Bins the first count particles. tableSize is rounded up to a power
+		/// of two, zero picks one bucket per particle.
+		/// </summary>
+		void Build(const BehaviorDataCPU* particles, uint32_t count, float cellSize, uint32_t tableSize = 0);
+
+		/// <summary>
+		/// Calls func(index) for every particle in the cells around pos.
+		/// Buckets can be shared by cells so func must check the distance.
+		/// </summary>
+		template <typename Func>
+		void ForEachNeighbor(const float pos[3], Func&& func) const
+		{
+			int32_t center[3] = { Cell(pos[0]), Cell(pos[1]), Cell(pos[2]) };
+
+			//Two cells can share a bucket, each bucket is only walked once
+			uint32_t visited[27];
+			uint32_t visitedCount = 0;
+
+			for (int32_t z = -1; z <= 1; ++z)
+			for (int32_t y = -1; y <= 1; ++y)
+			for (int32_t x = -1; x <= 1; ++x)
+			{
+				uint32_t bucket = Hash(center[0] + x, center[1] + y, center[2] + z);
+
+				bool seen = false;
+				for (uint32_t v = 0; v < visitedCount && !seen; ++v)
+					seen = visited[v] == bucket;
+
+				if (seen)
+					continue;
+
+				visited[visitedCount++] = bucket;
+				uint32_t end = cellStart_[bucket] + cellCount_[bucket];
+
+				for (uint32_t i = cellStart_[bucket]; i < end; ++i)
+					func(sortedIndex_[i]);
+			}
+		}
+
+		uint32_t TableSize() const { return tableSize_; }
+		const std::vector<uint32_t>& SortedIndices() const { return sortedIndex_; }
+
+	private:
+
+		int32_t Cell(float value) const { return static_cast<int32_t>(std::floor(value * inverseCellSize_)); }
+
+		//Same hash as GridHash in ParticleGrid.hlsli
+		uint32_t Hash(int32_t x, int32_t y, int32_t z) const
+		{
+			uint32_t h = (uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^ (uint32_t(z) * 83492791u);
+			return h & (tableSize_ - 1);
+		}
+
+		WorkerPool& workers_;
+		float inverseCellSize_;
+		uint32_t tableSize_;
+
+		std::unique_ptr<std::atomic<uint32_t>[]> counters_;
+		uint32_t counterCapacity_;
+
+		std::vector<uint32_t> cellStart_;
+		std::vector<uint32_t> cellCount_;
+		std::vector<uint32_t> particleCell_;
+		std::vector<uint32_t> sortedIndex_;
+	};
+
+}
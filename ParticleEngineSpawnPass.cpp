@@ -0,0 +1,130 @@
+/*******************************************************************************
+
+	@file       ParticleEngineSpawnPass.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Spawns bursts of particles on the GPU. Each burst uploads one
+				small record with the ranges of the emitter and a dedicated
+				kernel rolls every particle into the dead slots of the pool,
+				so the update kernel no longer branches on new particles.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineSpawnPass.h"	//This files header
+#include "ParticleEngineShaders.h"		//Compute shader loading helpers
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+#include <algorithm>					//std::min
+
+namespace ParticleEngine
+{
+//Must match CSParticleSpawn.hlsl
+static constexpr UINT SpawnThreads = 64;
+
+SpawnPass::SpawnPass(ID3D11Device* device) noexcept
+{
+	const wchar_t* source = L"./shaders/CSParticleSpawn.hlsl";
+
+	D3D_SHADER_MACRO box[] = { { "FEATURE_SHAPE_TEXTURE", "0" }, { nullptr, nullptr } };
+	D3D_SHADER_MACRO shape[] = { { "FEATURE_SHAPE_TEXTURE", "1" }, { nullptr, nullptr } };
+
+	csSpawn_[0] = LoadComputeShader(device, L"./shaders/CSParticleSpawn_Box.cso", source, "SpawnBurst", box);
+	csSpawn_[1] = LoadComputeShader(device, L"./shaders/CSParticleSpawn.cso", source, "SpawnBurst", shape);
+
+	try
+	{
+		CreateConstantBuffer(device, sizeof(cbSpawnParams), &cbSpawnParams_);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Spawn pass failed to create its constant buffer");
+		RELEASE(csSpawn_[0]);
+		RELEASE(csSpawn_[1]);
+	}
+}
+
+SpawnPass::~SpawnPass() noexcept
+{
+	RELEASE(csSpawn_[0]);
+	RELEASE(csSpawn_[1]);
+	RELEASE(cbSpawnParams_);
+}
+
+UINT SpawnPass::Spawn(ID3D11DeviceContext* deviceContext, const SpawnBurst& burst, bool shapeTexture,
+	const DirectX::XMFLOAT2& scale,
+	ID3D11UnorderedAccessView* particles, ID3D11ShaderResourceView* colors,
+	UINT subEmitTriggers, UINT alive, UINT capacity)
+{
+	ID3D11ComputeShader* shader = csSpawn_[shapeTexture ? 1 : 0];
+	if (!shader || burst.count == 0 || alive >= capacity)
+		return alive;
+
+	UINT count = std::min(burst.count, capacity - alive);
+
+	cbSpawnParams params;
+	params.position[0] = burst.position[0];
+	params.position[1] = burst.position[1];
+	params.position[2] = burst.position[2];
+	params.position[3] = burst.position[3];
+	params.scale[0] = scale.x;
+	params.scale[1] = scale.y;
+	params.scale[2] = burst.scale[0];
+	params.scale[3] = burst.scale[1];
+	params.lifetimeSpeed[0] = burst.lifetime[0];
+	params.lifetimeSpeed[1] = burst.lifetime[1];
+	params.lifetimeSpeed[2] = burst.speed[0];
+	params.lifetimeSpeed[3] = burst.speed[1];
+	params.directionRotation[0] = burst.direction[0];
+	params.directionRotation[1] = burst.direction[1];
+	params.directionRotation[2] = burst.rotation[0];
+	params.directionRotation[3] = burst.rotation[1];
+	params.physics[0] = burst.accel[0];
+	params.physics[1] = burst.accel[1];
+	params.physics[2] = burst.friction[0];
+	params.physics[3] = burst.friction[1];
+	params.slots[0] = alive;
+	params.slots[1] = count;
+	params.slots[2] = subEmitTriggers;
+	params.slots[3] = burst.useDirectionForRotation ? 1 : 0;
+	params.seed[0] = seed_;
+	params.seed[1] = params.seed[2] = params.seed[3] = 0.f;
+	params.age[0] = burst.age;
+	params.age[1] = params.age[2] = params.age[3] = 0.f;
+	UpdateConstantBuffer(deviceContext, cbSpawnParams_, &params, sizeof(params));
+
+	//Kept small so the sin hash stays precise
+	seed_ += 97.31f;
+	if (seed_ > 8192.f)
+		seed_ -= 8192.f;
+
+	deviceContext->CSSetShader(shader, nullptr, 0u);
+
+	ID3D11ShaderResourceView* rvColors[1] = { colors };
+	deviceContext->CSSetShaderResources(24, 1, rvColors);
+
+	ID3D11UnorderedAccessView* uavOut[1] = { particles };
+	deviceContext->CSSetUnorderedAccessViews(0, 1, uavOut, nullptr);
+
+	deviceContext->CSSetConstantBuffers(3, 1, &cbSpawnParams_);
+
+	deviceContext->Dispatch((count + SpawnThreads - 1) / SpawnThreads, 1, 1);
+
+	// Ensures all buffers are unset
+	ID3D11UnorderedAccessView* uavNULL[1] = { nullptr };
+	deviceContext->CSSetUnorderedAccessViews(0, 1, uavNULL, nullptr);
+
+	ID3D11ShaderResourceView* rvNULL[1] = { nullptr };
+	deviceContext->CSSetShaderResources(24, 1, rvNULL);
+
+	ID3D11Buffer* bNULL[1] = { nullptr };
+	deviceContext->CSSetConstantBuffers(3, 1, bNULL);
+
+	deviceContext->CSSetShader(nullptr, nullptr, 0);
+
+	return alive + count;
+}
+
+}//End of Particle Engine NameSpace
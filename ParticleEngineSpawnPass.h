@@ -0,0 +1,73 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineSpawnPass.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Spawns bursts of particles on the GPU. Each burst uploads one
+				small record with the ranges of the emitter and a dedicated
+				kernel rolls every particle into the dead slots of the pool,
+				so the update kernel no longer branches on new particles.
+
+*******************************************************************************/
+#include <d3d11.h>					//DirectX header
+#include <DirectXMath.h>			//XMFLOAT4 XMFLOAT2
+#include "ParticleEngineKernels.h"	//SpawnBurst
+
+namespace ParticleEngine
+{
+	class SpawnPass
+	{
+
+	public:
+
+		//Constructors
+		SpawnPass(ID3D11Device* device) noexcept;
+		~SpawnPass() noexcept;
+		SpawnPass(const SpawnPass&) = delete;
+		SpawnPass& operator=(const SpawnPass&) = delete;
+
+		/// <summary>
+		/// Writes a burst into the slots after alive, around the position
+		/// stored in the burst. The sampler, the shape
+		/// texture when shapeTexture is set, and the record buffer when
+		/// subEmitTriggers has births must already be bound.
+		/// Returns the new alive count.
+		/// </summary>
+		UINT Spawn(ID3D11DeviceContext* deviceContext, const SpawnBurst& burst, bool shapeTexture,
+			const DirectX::XMFLOAT2& scale,
+			ID3D11UnorderedAccessView* particles, ID3D11ShaderResourceView* colors,
+			UINT subEmitTriggers, UINT alive, UINT capacity);
+
+		/// <summary>
+		/// Where the next burst starts rolling, snapshots save it so a restore rolls the same particles
+		/// </summary>
+		float GetSeed() const { return seed_; }
+		void SetSeed(float seed) { seed_ = seed; }
+
+	private:
+
+		//Matches SpawnParams in CSParticleSpawn.hlsl
+		struct cbSpawnParams
+		{
+			float position[4];
+			float scale[4];
+			float lifetimeSpeed[4];
+			float directionRotation[4];
+			float physics[4];
+			UINT  slots[4];
+			float seed[4];
+			float age[4];
+		};
+
+		ID3D11ComputeShader* csSpawn_[2] = { nullptr, nullptr }; //[0] box [1] shape texture
+		ID3D11Buffer* cbSpawnParams_ = nullptr;
+
+		//Moves every burst so two bursts never roll the same particles
+		float seed_ = 0.f;
+	};
+
+}
@@ -0,0 +1,363 @@
+/*******************************************************************************
+
+	@file       ParticleEngineSubEmitters.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      GPU sub emitters. The update kernel of a parent appends a
+				spawn record for every particle born or killed, then a spawn
+				pass writes child particles from those records into the dead
+				slots of the child pool in the same frame. The dispatch is sized
+				on the GPU and the slots the child really got are read back
+				later without stalling.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineSubEmitters.h"	//This files header
+#include "ParticleEngineShaders.h"		//Compute shader loading helpers
+#include "Bindable.h"					//Part of our graphics engine
+#include "Graphics.h"					//Part of our graphics engine
+#include <algorithm>					//std::min
+
+namespace ParticleEngine
+{
+//Record buffers of parents that did not update for this many frames are released
+static constexpr UINT RecordStateLifetime = 120;
+
+SubEmitterPass::SubEmitterPass(ID3D11Device* device) noexcept :
+	device_(device)
+{
+	csSpawn_ = LoadComputeShader(device, L"./shaders/CSParticleSubEmit_SpawnFromRecords.cso",
+		L"./shaders/CSParticleSubEmit.hlsl", "SpawnFromRecords");
+	csBuildArgs_ = LoadComputeShader(device, L"./shaders/CSParticleSubEmit_BuildArgs.cso",
+		L"./shaders/CSParticleSubEmit.hlsl", "BuildArgs");
+
+	try
+	{
+		HRESULT hr = S_OK;
+
+		CreateConstantBuffer(device, sizeof(cbSubEmitParams), &cbSubEmitParams_);
+
+		//CopyStructureCount writes here so it lives on the GPU
+		D3D11_BUFFER_DESC Desc = {};
+		Desc.Usage		= D3D11_USAGE_DEFAULT;
+		Desc.BindFlags	= D3D11_BIND_CONSTANT_BUFFER;
+		Desc.ByteWidth	= 16;
+
+		INFO_SET device->CreateBuffer(&Desc, nullptr, &cbRecordCount_);
+		DX_EXCEPT(hr);
+
+		//BuildArgs writes the group count, y and z stay one
+		UINT args[4] = { 0, 1, 1, 0 };
+
+		D3D11_SUBRESOURCE_DATA data = {};
+		data.pSysMem = args;
+
+		Desc = {};
+		Desc.Usage		= D3D11_USAGE_DEFAULT;
+		Desc.BindFlags	= D3D11_BIND_UNORDERED_ACCESS;
+		Desc.MiscFlags	= D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		Desc.ByteWidth	= sizeof(args);
+
+		INFO_SET device->CreateBuffer(&Desc, &data, &bDispatchArgs_);
+		DX_EXCEPT(hr);
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format				= DXGI_FORMAT_R32_TYPELESS;
+		uavDesc.ViewDimension		= D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.NumElements	= 4;
+		uavDesc.Buffer.Flags		= D3D11_BUFFER_UAV_FLAG_RAW;
+
+		INFO_SET device->CreateUnorderedAccessView(bDispatchArgs_, &uavDesc, &uavDispatchArgs_);
+		DX_EXCEPT(hr);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Sub emitters failed to create their constant buffers");
+		RELEASE(csSpawn_);
+	}
+
+	//Records are never bound without both kernels
+	if (!csBuildArgs_)
+		RELEASE(csSpawn_);
+}
+
+SubEmitterPass::~SubEmitterPass() noexcept
+{
+	for (auto& state : states_)
+		Release(state.second);
+
+	for (auto& child : children_)
+		Release(child.second);
+
+	RELEASE(csSpawn_);
+	RELEASE(csBuildArgs_);
+	RELEASE(cbSubEmitParams_);
+	RELEASE(cbRecordCount_);
+	RELEASE(bDispatchArgs_);
+	RELEASE(uavDispatchArgs_);
+}
+
+void SubEmitterPass::Release(RecordState& state)
+{
+	RELEASE(state.bRecords);
+	RELEASE(state.rvRecords);
+	RELEASE(state.uavRecords);
+	state.capacity = 0;
+}
+
+void SubEmitterPass::Release(ChildState& state)
+{
+	RELEASE(state.bClaimed);
+	RELEASE(state.uavClaimed);
+	RELEASE(state.staging);
+	state.pending = false;
+}
+
+SubEmitterPass::ChildState* SubEmitterPass::FindChild(const EmitterData* child)
+{
+	ChildState& state = children_[child];
+	if (state.uavClaimed)
+		return &state;
+
+	try
+	{
+		HRESULT hr = S_OK;
+
+		CreateStructuredBuffer(device_, sizeof(UINT), 1, nullptr, &state.bClaimed, nullptr, &state.uavClaimed,
+			D3D11_BUFFER_UAV_FLAG_COUNTER);
+
+		D3D11_BUFFER_DESC Desc = {};
+		Desc.Usage			= D3D11_USAGE_STAGING;
+		Desc.BindFlags		= 0;
+		Desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		Desc.ByteWidth		= 16;
+
+		INFO_SET device_->CreateBuffer(&Desc, nullptr, &state.staging);
+		DX_EXCEPT(hr);
+	}
+	catch (const Bindable::DirectXException)
+	{
+		LOG_ERROR("DirectX Exception", "Sub emitters failed to create a slot counter");
+		Release(state);
+		children_.erase(child);
+		return nullptr;
+	}
+
+	return &state;
+}
+
+bool SubEmitterPass::BindRecords(ID3D11DeviceContext* deviceContext, const EmitterData* parent, UINT recordCapacity)
+{
+	if (!csSpawn_ || recordCapacity == 0)
+		return false;
+
+	RecordState& state = states_[parent];
+
+	//-1 keeps the records already appended this frame
+	UINT initialCount = state.lastUsedFrame == frame_ ? (UINT)-1 : 0;
+	state.lastUsedFrame = frame_;
+
+	if (state.capacity < recordCapacity)
+	{
+		Release(state);
+		initialCount = 0;
+
+		try
+		{
+			CreateStructuredBuffer(device_, sizeof(SpawnRecordCPU), recordCapacity, nullptr,
+				&state.bRecords, &state.rvRecords, &state.uavRecords, D3D11_BUFFER_UAV_FLAG_APPEND);
+		}
+		catch (const Bindable::DirectXException)
+		{
+			LOG_ERROR("DirectX Exception", "Sub emitters failed to create a record buffer");
+			Release(state);
+			states_.erase(parent);
+			return false;
+		}
+
+		state.capacity = recordCapacity;
+	}
+
+	deviceContext->CSSetUnorderedAccessViews(1, 1, &state.uavRecords, &initialCount);
+	return true;
+}
+
+void SubEmitterPass::UnbindRecords(ID3D11DeviceContext* deviceContext)
+{
+	ID3D11UnorderedAccessView* uavNULL[1] = { nullptr };
+	deviceContext->CSSetUnorderedAccessViews(1, 1, uavNULL, nullptr);
+}
+
+UINT SubEmitterPass::Spawn(ID3D11DeviceContext* deviceContext, const EmitterData* parent, const EmitterData* child,
+	UINT trigger, UINT perRecord, const SubEmitterSpawn& spawn, ID3D11UnorderedAccessView* childParticles,
+	ID3D11ShaderResourceView* childColors, UINT childAlive, UINT childCapacity, UINT maxRecords)
+{
+	auto found = states_.find(parent);
+	if (found == states_.end() || found->second.lastUsedFrame != frame_ || perRecord == 0 || childAlive >= childCapacity)
+		return childAlive;
+
+	RecordState& state = found->second;
+
+	ChildState* claims = FindChild(child);
+	if (!claims)
+		return childAlive;
+
+	//Parents that spawn into the same child this frame share one counter. It
+	//starts over if anything else moved the alive count since the last spawn.
+	bool restart = claims->lastUsedFrame != frame_ || claims->returned != childAlive;
+	if (restart)
+	{
+		claims->base = childAlive;
+		claims->maxClaims = 0;
+	}
+	claims->lastUsedFrame = frame_;
+
+	UINT slotsLeft = childCapacity - claims->base;
+	claims->maxClaims = std::min(claims->maxClaims + std::min(maxRecords, state.capacity) * perRecord, slotsLeft);
+
+	cbSubEmitParams params;
+	params.lifetimeSpeed[0] = spawn.lifetime[0];
+	params.lifetimeSpeed[1] = spawn.lifetime[1];
+	params.lifetimeSpeed[2] = spawn.speed[0];
+	params.lifetimeSpeed[3] = spawn.speed[1];
+	params.scaleDirection[0] = spawn.scale[0];
+	params.scaleDirection[1] = spawn.scale[1];
+	params.scaleDirection[2] = spawn.direction[0];
+	params.scaleDirection[3] = spawn.direction[1];
+	params.physics[0] = spawn.accel[0];
+	params.physics[1] = spawn.accel[1];
+	params.physics[2] = spawn.friction;
+	params.physics[3] = spawn.inheritVelocity;
+	params.slots[0] = trigger;
+	params.slots[1] = perRecord;
+	params.slots[2] = claims->base;
+	params.slots[3] = childCapacity;
+	params.seed[0] = static_cast<float>(frame_ % 4096) * 7.31f;
+	params.seed[1] = params.seed[2] = params.seed[3] = 0.f;
+	UpdateConstantBuffer(deviceContext, cbSubEmitParams_, &params, sizeof(params));
+
+	deviceContext->CopyStructureCount(cbRecordCount_, 0, state.uavRecords);
+
+	ID3D11Buffer* cbIN[2] = { cbSubEmitParams_, cbRecordCount_ };
+	deviceContext->CSSetConstantBuffers(3, 2, cbIN);
+
+	//The record count never leaves the GPU, the group count is built from it there
+	deviceContext->CSSetUnorderedAccessViews(2, 1, &uavDispatchArgs_, nullptr);
+	deviceContext->CSSetShader(csBuildArgs_, nullptr, 0u);
+	deviceContext->Dispatch(1, 1, 1);
+
+	ID3D11UnorderedAccessView* uavNULL[2] = { nullptr, nullptr };
+	deviceContext->CSSetUnorderedAccessViews(2, 1, uavNULL, nullptr);
+
+	deviceContext->CSSetShader(csSpawn_, nullptr, 0u);
+
+	ID3D11ShaderResourceView* rvRecords[1] = { state.rvRecords };
+	deviceContext->CSSetShaderResources(0, 1, rvRecords);
+
+	ID3D11ShaderResourceView* rvColors[1] = { childColors };
+	deviceContext->CSSetShaderResources(24, 1, rvColors);
+
+	//-1 keeps the slots claimed by earlier parents this frame
+	ID3D11UnorderedAccessView* uavOut[2] = { childParticles, claims->uavClaimed };
+	UINT initialCounts[2] = { 0, restart ? 0u : (UINT)-1 };
+	deviceContext->CSSetUnorderedAccessViews(0, 2, uavOut, initialCounts);
+
+	deviceContext->DispatchIndirect(bDispatchArgs_, 0);
+
+	// Ensures all buffers are unset
+	deviceContext->CSSetUnorderedAccessViews(0, 2, uavNULL, nullptr);
+
+	ID3D11ShaderResourceView* rvNULL[1] = { nullptr };
+	deviceContext->CSSetShaderResources(0, 1, rvNULL);
+	deviceContext->CSSetShaderResources(24, 1, rvNULL);
+
+	ID3D11Buffer* bNULL[2] = { nullptr, nullptr };
+	deviceContext->CSSetConstantBuffers(3, 2, bNULL);
+
+	deviceContext->CSSetShader(nullptr, nullptr, 0);
+
+	//Read back by Resolve once the GPU gets to it
+	deviceContext->CopyStructureCount(claims->staging, 0, claims->uavClaimed);
+	claims->pending = true;
+
+	claims->returned = claims->base + claims->maxClaims;
+	return claims->returned;
+}
+
+UINT SubEmitterPass::Resolve(ID3D11DeviceContext* deviceContext, const EmitterData* child, UINT alive)
+{
+	auto found = children_.find(child);
+	if (found == children_.end() || !found->second.pending)
+		return alive;
+
+	//The child updates after this, which makes the copy stale either way
+	ChildState& state = found->second;
+	state.pending = false;
+
+	if (alive != state.returned)
+		return alive;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(deviceContext->Map(state.staging, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+		return alive;
+
+	//The counter keeps going for spawns that found the pool full
+	UINT claimed = *static_cast<const UINT*>(mapped.pData);
+	deviceContext->Unmap(state.staging, 0);
+
+	state.returned = state.base + std::min(claimed, state.maxClaims);
+	return state.returned;
+}
+
+void SubEmitterPass::Forget(const EmitterData* emitter)
+{
+	auto child = children_.find(emitter);
+	if (child != children_.end())
+	{
+		Release(child->second);
+		children_.erase(child);
+	}
+
+	auto parent = states_.find(emitter);
+	if (parent != states_.end())
+	{
+		Release(parent->second);
+		states_.erase(parent);
+	}
+}
+
+void SubEmitterPass::BeginFrame()
+{
+	frame_++;
+
+	for (auto it = states_.begin(); it != states_.end();)
+	{
+		if (frame_ - it->second.lastUsedFrame > RecordStateLifetime)
+		{
+			Release(it->second);
+			it = states_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (auto it = children_.begin(); it != children_.end();)
+	{
+		if (frame_ - it->second.lastUsedFrame > RecordStateLifetime)
+		{
+			Release(it->second);
+			it = children_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+}//End of Particle Engine NameSpace
@@ -0,0 +1,133 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineSubEmitters.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      GPU sub emitters. The update kernel of a parent appends a
+				spawn record for every particle born or killed, then a spawn
+				pass writes child particles from those records into the dead
+				slots of the child pool in the same frame. The dispatch is sized
+				on the GPU and the slots the child really got are read back
+				later without stalling.
+
+*******************************************************************************/
+#include <d3d11.h>					//DirectX header
+#include <unordered_map>			//Per parent record buffers
+#include "ParticleEngineKernels.h"	//SpawnRecordCPU SubEmitterSpawn
+
+namespace ParticleEngine
+{
+	class EmitterData;
+
+	class SubEmitterPass
+	{
+
+	public:
+
+		//Constructors
+		SubEmitterPass(ID3D11Device* device) noexcept;
+		~SubEmitterPass() noexcept;
+		SubEmitterPass(const SubEmitterPass&) = delete;
+		SubEmitterPass& operator=(const SubEmitterPass&) = delete;
+
+		/// <summary>
+		/// Binds the record buffer of a parent to u1. The first bind in a
+		/// frame empties it, later binds append to it so the spawn pass and
+		/// the update share one list.
+		/// </summary>
+		bool BindRecords(ID3D11DeviceContext* deviceContext, const EmitterData* parent, UINT recordCapacity);
+
+		/// <summary>
+		/// Unbinds what BindRecords set
+		/// </summary>
+		static void UnbindRecords(ID3D11DeviceContext* deviceContext);
+
+		/// <summary>
+		/// Spawns child particles from the records a parent appended this frame.
+		/// The dispatch covers the records that were appended and every
+		/// spawn claims the next slot with an atomic counter, so the new
+		/// particles are packed after childAlive. maxRecords bounds how many
+		/// records the parent could have appended. Returns the new alive count
+		/// of the child, an upper bound until Resolve or its next partition.
+		/// </summary>
+		UINT Spawn(ID3D11DeviceContext* deviceContext, const EmitterData* parent, const EmitterData* child,
+			UINT trigger, UINT perRecord, const SubEmitterSpawn& spawn, ID3D11UnorderedAccessView* childParticles,
+			ID3D11ShaderResourceView* childColors, UINT childAlive, UINT childCapacity, UINT maxRecords);
+
+		/// <summary>
+		/// Call before a child updates. If the slots its last spawns claimed
+		/// have been read back and nothing changed alive since, returns the
+		/// exact alive count, otherwise alive. Never waits.
+		/// </summary>
+		UINT Resolve(ID3D11DeviceContext* deviceContext, const EmitterData* child, UINT alive);
+
+		/// <summary>
+		/// Drops what is known about an emitter whose pool was emptied, overwritten
+		/// or resized. Its claims as a child and its records as a parent are released.
+		/// </summary>
+		void Forget(const EmitterData* emitter);
+
+		/// <summary>
+		/// Call once per frame, releases record buffers of parents that stopped using them
+		/// </summary>
+		void BeginFrame();
+
+	private:
+
+		struct RecordState
+		{
+			ID3D11Buffer*			   bRecords = nullptr;
+			ID3D11ShaderResourceView*  rvRecords = nullptr;
+			ID3D11UnorderedAccessView* uavRecords = nullptr;
+			UINT capacity = 0;
+			UINT lastUsedFrame = 0;
+		};
+
+		struct ChildState
+		{
+			ID3D11Buffer*			   bClaimed = nullptr;	//Only the hidden counter of its view is used
+			ID3D11UnorderedAccessView* uavClaimed = nullptr;
+			ID3D11Buffer*			   staging = nullptr;	//Claimed count copied back for Resolve
+			UINT base = 0;			//First slot the counter hands out
+			UINT maxClaims = 0;		//Most slots the spawns since base could have claimed
+			UINT returned = 0;		//Alive count the last spawn returned
+			bool pending = false;	//The staging copy belongs to the spawns since base
+			UINT lastUsedFrame = 0;
+		};
+
+		//Matches SubEmitParams in CSParticleSubEmit.hlsl
+		struct cbSubEmitParams
+		{
+			float lifetimeSpeed[4];
+			float scaleDirection[4];
+			float physics[4];
+			UINT  slots[4];
+			float seed[4];
+		};
+
+		ID3D11Device* device_;
+		ID3D11ComputeShader* csSpawn_ = nullptr;
+		ID3D11ComputeShader* csBuildArgs_ = nullptr;
+		ID3D11Buffer* cbSubEmitParams_ = nullptr;
+		ID3D11Buffer* cbRecordCount_ = nullptr;
+
+		//Thread groups of the next spawn, written by BuildArgs
+		ID3D11Buffer* bDispatchArgs_ = nullptr;
+		ID3D11UnorderedAccessView* uavDispatchArgs_ = nullptr;
+
+		std::unordered_map<const EmitterData*, RecordState> states_;
+		std::unordered_map<const EmitterData*, ChildState> children_;
+		UINT frame_ = 0;
+
+		//Returns the claim counter of a child, nullptr if it could not be created
+		ChildState* FindChild(const EmitterData* child);
+
+		static void Release(RecordState& state);
+		static void Release(ChildState& state);
+	};
+
+}
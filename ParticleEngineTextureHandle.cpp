@@ -0,0 +1,113 @@
+/*******************************************************************************
+
+	@file       ParticleEngineTextureHandle.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Interned texture handles used by the particle engine. Texture
+				names are resolved once into a small integer handle so runtime
+				paths can compare and sort textures without string lookups.
+
+*******************************************************************************/
+#include "stdafx.h"							//Header included in all files.
+#include "ParticleEngineTextureHandle.h"	//This files header
+#include "ResourceManager.h"				//Used to store resources. Textures, Meshs, Samplers
+#include "Texture.h"						//Class Definition for The Texture Object
+
+namespace ParticleEngine
+{
+
+TextureRegistry::TextureRegistry(ResourceManager& resourceManager) noexcept :
+	resourceManager_(resourceManager), entries_(1)
+{
+}
+
+TextureHandle TextureRegistry::MakeHandle(uint32_t index, uint32_t generation)
+{
+	TextureHandle handle;
+	handle.id = (generation << TextureHandle::IndexBits) | (index & TextureHandle::IndexMask);
+	return handle;
+}
+
+TextureHandle TextureRegistry::Intern(const std::string& name)
+{
+	if (name.empty())
+		return TextureHandle();
+
+	auto found = lookup_.find(name);
+	if (found != lookup_.end())
+	{
+		Entry& entry = entries_[found->second];
+
+		//Entry was invalidated, resolve the name again
+		if (entry.texture == nullptr)
+			entry.texture = resourceManager_.FindResource<Texture>(name);
+
+		if (entry.texture == nullptr)
+			return TextureHandle();
+
+		return MakeHandle(found->second, entry.generation);
+	}
+
+	//Misses are not cached, the texture may be loaded later
+	Texture* texture = resourceManager_.FindResource<Texture>(name);
+	if (texture == nullptr)
+		return TextureHandle();
+
+	uint32_t index = static_cast<uint32_t>(entries_.size());
+	if (index > TextureHandle::IndexMask)
+	{
+		LOG_ERROR("ParticleEngine", "Texture registry is full");
+		return TextureHandle();
+	}
+
+	Entry entry;
+	entry.name = name;
+	entry.texture = texture;
+	entries_.push_back(entry);
+	lookup_.emplace(name, index);
+
+	return MakeHandle(index, entry.generation);
+}
+
+bool TextureRegistry::IsCurrent(TextureHandle handle) const
+{
+	uint32_t index = handle.Index();
+	return handle.IsValid()
+		&& index < entries_.size()
+		&& entries_[index].generation == handle.Generation()
+		&& entries_[index].texture != nullptr;
+}
+
+Texture* TextureRegistry::Resolve(TextureHandle handle) const
+{
+	return IsCurrent(handle) ? entries_[handle.Index()].texture : nullptr;
+}
+
+const std::string& TextureRegistry::Name(TextureHandle handle) const
+{
+	uint32_t index = handle.Index();
+	if (!handle.IsValid() || index >= entries_.size())
+		return entries_.front().name;
+
+	return entries_[index].name;
+}
+
+void TextureRegistry::Invalidate(const std::string& name)
+{
+	auto found = lookup_.find(name);
+	if (found == lookup_.end())
+		return;
+
+	Entry& entry = entries_[found->second];
+	entry.texture = nullptr;
+
+	//Generation lives in the top bits of the handle, wrap and skip zero
+	entry.generation = (entry.generation + 1) & (0xFFFFFFFFu >> TextureHandle::IndexBits);
+	if (entry.generation == 0)
+		entry.generation = 1;
+}
+
+}//End of Particle Engine NameSpace
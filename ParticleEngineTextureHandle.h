@@ -0,0 +1,103 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineTextureHandle.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Interned texture handles used by the particle engine. Texture
+				names are resolved once into a small integer handle so runtime
+				paths can compare and sort textures without string lookups.
+
+*******************************************************************************/
+#include <cstdint>			//Fixed width integers
+#include <string>			//Texture names
+#include <vector>			//Interned entries
+#include <unordered_map>	//Name to index lookup
+
+class Texture;
+class ResourceManager;
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// A reference to a texture interned by the TextureRegistry.
+	/// The low bits are the registry index and the high bits are the
+	/// generation of that entry, zero is never a valid handle.
+	/// </summary>
+	struct TextureHandle
+	{
+		static constexpr uint32_t IndexBits = 24;
+		static constexpr uint32_t IndexMask = (1u << IndexBits) - 1u;
+
+		uint32_t id = 0;
+
+		uint32_t Index() const { return id & IndexMask; }
+		uint32_t Generation() const { return id >> IndexBits; }
+		bool IsValid() const { return id != 0; }
+
+		bool operator==(TextureHandle other) const { return id == other.id; }
+		bool operator!=(TextureHandle other) const { return id != other.id; }
+		bool operator<(TextureHandle other) const { return id < other.id; }
+	};
+
+	/// <summary>
+	/// Interns texture names into handles. Names are only looked up in the
+	/// resource manager the first time they are seen, afterwards a handle
+	/// resolves to its texture with an index and a generation check.
+	/// </summary>
+	class TextureRegistry
+	{
+
+	public:
+
+		//Constructors
+		TextureRegistry(ResourceManager& resourceManager) noexcept;
+		TextureRegistry(const TextureRegistry&) = delete;
+		TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+		/// <summary>
+		/// Resolves a name into a handle. Returns an invalid handle
+		/// if the resource manager does not contain the texture.
+		/// </summary>
+		TextureHandle Intern(const std::string& name);
+
+		/// <summary>
+		/// Returns the texture for a handle or nullptr if the handle is stale
+		/// </summary>
+		Texture* Resolve(TextureHandle handle) const;
+
+		/// <summary>
+		/// Returns the name a handle was interned from, used for serialization
+		/// </summary>
+		const std::string& Name(TextureHandle handle) const;
+
+		bool IsCurrent(TextureHandle handle) const;
+
+		/// <summary>
+		/// Call when a texture is unloaded or reloaded. Existing handles to it
+		/// become stale and the next Intern resolves the name again.
+		/// </summary>
+		void Invalidate(const std::string& name);
+
+	private:
+
+		struct Entry
+		{
+			std::string name;
+			Texture*	texture = nullptr;
+			uint32_t	generation = 1;
+		};
+
+		ResourceManager& resourceManager_;
+
+		//Index 0 is reserved so a zeroed handle is never valid
+		std::vector<Entry> entries_;
+		std::unordered_map<std::string, uint32_t> lookup_;
+
+		static TextureHandle MakeHandle(uint32_t index, uint32_t generation);
+	};
+
+}
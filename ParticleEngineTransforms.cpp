@@ -0,0 +1,80 @@
+/*******************************************************************************
+
+	@file       ParticleEngineTransforms.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Packed world transforms of the emitters that follow their game
+				object. Components write their slot once per frame, the engine
+				uploads the whole table in one copy and the update kernel moves
+				particles by the change since the last frame.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineTransforms.h"	//This files header
+
+namespace ParticleEngine
+{
+
+uint32_t TransformTable::Allocate()
+{
+	uint32_t slot;
+	if (!freeSlots_.empty())
+	{
+		slot = freeSlots_.back();
+		freeSlots_.pop_back();
+	}
+	else
+	{
+		slot = Size();
+		transforms_.emplace_back();
+		fresh_.push_back(true);
+	}
+
+	transforms_[slot] = EmitterTransform();
+	fresh_[slot] = true;
+	return slot;
+}
+
+void TransformTable::Free(uint32_t slot)
+{
+	if (slot >= Size())
+		return;
+
+	//Freed slots stay in the table but never move anything
+	transforms_[slot].follow = 0.f;
+	freeSlots_.push_back(slot);
+}
+
+void TransformTable::Set(uint32_t slot, const float position[3], float rotation, float follow)
+{
+	if (slot >= Size())
+		return;
+
+	EmitterTransform& transform = transforms_[slot];
+	for (int c = 0; c < 3; ++c)
+		transform.current[c] = position[c];
+	transform.current[3] = rotation;
+	transform.follow = follow;
+
+	//Nothing to follow on the first frame
+	if (fresh_[slot])
+	{
+		for (int c = 0; c < 4; ++c)
+			transform.previous[c] = transform.current[c];
+		fresh_[slot] = false;
+	}
+}
+
+void TransformTable::EndFrame()
+{
+	for (EmitterTransform& transform : transforms_)
+	{
+		for (int c = 0; c < 4; ++c)
+			transform.previous[c] = transform.current[c];
+	}
+}
+
+}//End of Particle Engine NameSpace
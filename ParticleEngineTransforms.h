@@ -0,0 +1,62 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineTransforms.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Packed world transforms of the emitters that follow their game
+				object. Components write their slot once per frame, the engine
+				uploads the whole table in one copy and the update kernel moves
+				particles by the change since the last frame.
+
+				This header only depends on the standard library.
+
+*******************************************************************************/
+#include <cstdint>					//Fixed width integers
+#include <vector>					//Packed transforms
+#include "ParticleEngineKernels.h"	//EmitterTransform
+
+namespace ParticleEngine
+{
+	class TransformTable
+	{
+
+	public:
+
+		static constexpr uint32_t NoSlot = 0xFFFFFFFFu;
+
+		/// <summary>
+		/// Returns a slot for an emitter. Its first Set does not move particles.
+		/// </summary>
+		uint32_t Allocate();
+
+		/// <summary>
+		/// Releases a slot, it can be handed out again
+		/// </summary>
+		void Free(uint32_t slot);
+
+		/// <summary>
+		/// Writes this frames transform of a slot. rotation is in radians,
+		/// follow is how much of the motion particles take from 0 to 1.
+		/// </summary>
+		void Set(uint32_t slot, const float position[3], float rotation, float follow);
+
+		/// <summary>
+		/// Call once after the update, this frames transforms become the previous ones
+		/// </summary>
+		void EndFrame();
+
+		const EmitterTransform* Data() const { return transforms_.data(); }
+		uint32_t Size() const { return static_cast<uint32_t>(transforms_.size()); }
+
+	private:
+
+		std::vector<EmitterTransform> transforms_;
+		std::vector<bool>			  fresh_;	 //Set has not been called since Allocate
+		std::vector<uint32_t>		  freeSlots_;
+	};
+
+}
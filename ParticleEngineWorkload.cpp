@@ -0,0 +1,403 @@
+/*******************************************************************************
+
+	@file       ParticleEngineWorkload.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Binary log of the work a scene gives the particle engine.
+				Every frame records its delta time, the emitters created,
+				destroyed or resized, settings that changed and every burst
+				spawned, so a real scene can be replayed without the game to
+				compare engine versions.
+
+*******************************************************************************/
+#include "stdafx.h"					//Header included in all files.
+#include "ParticleEngineWorkload.h"	//This files header
+#include <cstring>					//memcpy memcmp
+
+namespace ParticleEngine
+{
+
+static void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool ReadVarint(const uint8_t*& cursor, const uint8_t* end, uint32_t& value)
+{
+	value = 0;
+	for (uint32_t shift = 0; shift < 35; shift += 7)
+	{
+		if (cursor == end)
+			return false;
+
+		uint8_t byte = *cursor++;
+		value |= uint32_t(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void WriteFloats(std::vector<uint8_t>& out, const float* values, size_t count)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+	out.insert(out.end(), bytes, bytes + count * sizeof(float));
+}
+
+static bool ReadFloats(const uint8_t*& cursor, const uint8_t* end, float* values, size_t count)
+{
+	size_t bytes = count * sizeof(float);
+	if (size_t(end - cursor) < bytes)
+		return false;
+
+	memcpy(values, cursor, bytes);
+	cursor += bytes;
+	return true;
+}
+
+//Burst ranges in the order they are written, then the age and the position
+static const size_t BurstFloats = 19;
+
+static void PackBurst(const SpawnBurst& burst, float* out)
+{
+	const float* ranges[7] = { burst.lifetime, burst.scale, burst.direction, burst.speed, burst.friction, burst.accel, burst.rotation };
+	for (size_t i = 0; i < 7; ++i)
+	{
+		out[i * 2] = ranges[i][0];
+		out[i * 2 + 1] = ranges[i][1];
+	}
+	out[14] = burst.age;
+	for (size_t c = 0; c < 4; ++c)
+		out[15 + c] = burst.position[c];
+}
+
+static void UnpackBurst(const float* in, SpawnBurst& burst)
+{
+	float* ranges[7] = { burst.lifetime, burst.scale, burst.direction, burst.speed, burst.friction, burst.accel, burst.rotation };
+	for (size_t i = 0; i < 7; ++i)
+	{
+		ranges[i][0] = in[i * 2];
+		ranges[i][1] = in[i * 2 + 1];
+	}
+	burst.age = in[14];
+	for (size_t c = 0; c < 4; ++c)
+		burst.position[c] = in[15 + c];
+}
+
+bool WorkloadSettings::operator==(const WorkloadSettings& other) const
+{
+	return memcmp(position, other.position, sizeof(position)) == 0
+		&& memcmp(scale, other.scale, sizeof(scale)) == 0
+		&& flags == other.flags
+		&& colors.size() == other.colors.size()
+		&& (colors.empty() || memcmp(colors.data(), other.colors.data(), colors.size() * sizeof(ColorKeyCPU)) == 0);
+}
+
+#pragma region WorkloadWriter
+
+bool WorkloadWriter::Open(const std::string& path)
+{
+	Close();
+
+	file_.open(path, std::ios::binary | std::ios::trunc);
+	if (!file_.is_open())
+		return false;
+
+	uint32_t header[2] = { Workload::Magic, Workload::Version };
+	file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+	return file_.good();
+}
+
+void WorkloadWriter::Close()
+{
+	if (file_.is_open())
+		file_.close();
+}
+
+bool WorkloadWriter::Write(const WorkloadFrame& frame)
+{
+	if (!file_.is_open())
+		return false;
+
+	payload_.clear();
+
+	for (const WorkloadEvent& event : frame.events)
+	{
+		payload_.push_back(event.type);
+		WriteVarint(payload_, event.emitter);
+
+		switch (event.type)
+		{
+		case Workload_Create:
+		case Workload_Resize:
+			WriteVarint(payload_, event.capacity);
+			break;
+		case Workload_Settings:
+		{
+			const WorkloadSettings& settings = event.settings;
+			WriteFloats(payload_, settings.position, 4);
+			WriteFloats(payload_, settings.scale, 2);
+			WriteVarint(payload_, settings.flags);
+			WriteVarint(payload_, static_cast<uint32_t>(settings.colors.size()));
+			for (const ColorKeyCPU& key : settings.colors)
+			{
+				WriteFloats(payload_, key.color, 4);
+				WriteFloats(payload_, &key.location, 1);
+			}
+			break;
+		}
+		case Workload_Spawn:
+		{
+			float ranges[BurstFloats];
+			PackBurst(event.burst, ranges);
+			WriteVarint(payload_, event.burst.count);
+			WriteFloats(payload_, ranges, BurstFloats);
+			payload_.push_back(event.burst.useDirectionForRotation ? 1 : 0);
+			break;
+		}
+		case Workload_Step:
+			WriteFloats(payload_, &event.deltaTime, 1);
+			break;
+		default:
+			break;
+		}
+	}
+
+	uint32_t frameHeader[4] =
+	{
+		Workload::FrameMagic,
+		static_cast<uint32_t>(frame.events.size()),
+		static_cast<uint32_t>(payload_.size()),
+		0u
+	};
+	memcpy(&frameHeader[3], &frame.deltaTime, sizeof(float));
+
+	file_.write(reinterpret_cast<const char*>(frameHeader), sizeof(frameHeader));
+	file_.write(reinterpret_cast<const char*>(payload_.data()), payload_.size());
+
+	return file_.good();
+}
+
+#pragma endregion
+
+#pragma region WorkloadReader
+
+bool WorkloadReader::Open(const std::string& path)
+{
+	file_.close();
+
+	file_.open(path, std::ios::binary);
+	if (!file_.is_open())
+		return false;
+
+	uint32_t header[2] = {};
+	file_.read(reinterpret_cast<char*>(header), sizeof(header));
+
+	return file_.good() && header[0] == Workload::Magic && header[1] == Workload::Version;
+}
+
+bool WorkloadReader::Next(WorkloadFrame& frame)
+{
+	uint32_t frameHeader[4] = {};
+	file_.read(reinterpret_cast<char*>(frameHeader), sizeof(frameHeader));
+
+	if (!file_.good() || frameHeader[0] != Workload::FrameMagic)
+		return false;
+
+	uint32_t eventCount = frameHeader[1];
+	memcpy(&frame.deltaTime, &frameHeader[3], sizeof(float));
+
+	payload_.resize(frameHeader[2]);
+	file_.read(reinterpret_cast<char*>(payload_.data()), payload_.size());
+	if (!file_.good())
+		return false;
+
+	const uint8_t* cursor = payload_.data();
+	const uint8_t* end = cursor + payload_.size();
+
+	//Every event takes at least two bytes so a bad count can not over allocate
+	if (eventCount > payload_.size() / 2)
+		return false;
+
+	frame.events.resize(eventCount);
+	for (WorkloadEvent& event : frame.events)
+	{
+		if (cursor == end)
+			return false;
+
+		event.type = static_cast<WorkloadEventType>(*cursor++);
+		if (!ReadVarint(cursor, end, event.emitter))
+			return false;
+
+		switch (event.type)
+		{
+		case Workload_Create:
+		case Workload_Resize:
+			if (!ReadVarint(cursor, end, event.capacity))
+				return false;
+			break;
+		case Workload_Destroy:
+			break;
+		case Workload_Settings:
+		{
+			WorkloadSettings& settings = event.settings;
+			uint32_t colorCount;
+			if (!ReadFloats(cursor, end, settings.position, 4) || !ReadFloats(cursor, end, settings.scale, 2)
+				|| !ReadVarint(cursor, end, settings.flags) || !ReadVarint(cursor, end, colorCount)
+				|| colorCount > size_t(end - cursor) / (5 * sizeof(float)))
+			{
+				return false;
+			}
+
+			settings.colors.resize(colorCount);
+			for (ColorKeyCPU& key : settings.colors)
+			{
+				ReadFloats(cursor, end, key.color, 4);
+				ReadFloats(cursor, end, &key.location, 1);
+			}
+			break;
+		}
+		case Workload_Spawn:
+		{
+			float ranges[BurstFloats];
+			if (!ReadVarint(cursor, end, event.burst.count) || !ReadFloats(cursor, end, ranges, BurstFloats) || cursor == end)
+				return false;
+
+			UnpackBurst(ranges, event.burst);
+			event.burst.useDirectionForRotation = *cursor++ != 0;
+			break;
+		}
+		case Workload_Step:
+			if (!ReadFloats(cursor, end, &event.deltaTime, 1))
+				return false;
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return cursor == end;
+}
+
+#pragma endregion
+
+#pragma region WorkloadRecorder
+
+bool WorkloadRecorder::Open(const std::string& path)
+{
+	emitters_.clear();
+	frame_.events.clear();
+	nextId_ = 0;
+	frameIndex_ = 0;
+	return writer_.Open(path);
+}
+
+void WorkloadRecorder::Close()
+{
+	writer_.Close();
+	emitters_.clear();
+	frame_.events.clear();
+}
+
+void WorkloadRecorder::BeginFrame(float deltaTime)
+{
+	frameIndex_++;
+	frame_.deltaTime = deltaTime;
+	frame_.events.clear();
+}
+
+void WorkloadRecorder::Push(WorkloadEventType type, const Tracked& tracked)
+{
+	WorkloadEvent event;
+	event.type = type;
+	event.emitter = tracked.id;
+	event.capacity = tracked.capacity;
+	if (type == Workload_Settings)
+		event.settings = tracked.settings;
+
+	frame_.events.push_back(std::move(event));
+}
+
+void WorkloadRecorder::Track(const void* emitter, uint32_t capacity, const WorkloadSettings& settings)
+{
+	auto found = emitters_.find(emitter);
+	if (found == emitters_.end())
+	{
+		Tracked& tracked = emitters_[emitter];
+		tracked = { nextId_++, capacity, frameIndex_, settings };
+		Push(Workload_Create, tracked);
+		Push(Workload_Settings, tracked);
+		return;
+	}
+
+	Tracked& tracked = found->second;
+	tracked.frame = frameIndex_;
+
+	if (tracked.capacity != capacity)
+	{
+		tracked.capacity = capacity;
+		Push(Workload_Resize, tracked);
+	}
+
+	if (tracked.settings != settings)
+	{
+		tracked.settings = settings;
+		Push(Workload_Settings, tracked);
+	}
+}
+
+void WorkloadRecorder::Spawn(const void* emitter, const SpawnBurst& burst)
+{
+	auto found = emitters_.find(emitter);
+	if (found == emitters_.end())
+		return;
+
+	WorkloadEvent event;
+	event.type = Workload_Spawn;
+	event.emitter = found->second.id;
+	event.burst = burst;
+	frame_.events.push_back(std::move(event));
+}
+
+void WorkloadRecorder::Step(const void* emitter, float deltaTime)
+{
+	auto found = emitters_.find(emitter);
+	if (found == emitters_.end())
+		return;
+
+	WorkloadEvent event;
+	event.type = Workload_Step;
+	event.emitter = found->second.id;
+	event.deltaTime = deltaTime;
+	frame_.events.push_back(std::move(event));
+}
+
+void WorkloadRecorder::EndFrame()
+{
+	for (auto it = emitters_.begin(); it != emitters_.end();)
+	{
+		if (it->second.frame != frameIndex_)
+		{
+			Push(Workload_Destroy, it->second);
+			it = emitters_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	writer_.Write(frame_);
+}
+
+#pragma endregion
+
+}//End of Particle Engine NameSpace
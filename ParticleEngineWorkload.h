@@ -0,0 +1,186 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineWorkload.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Binary log of the work a scene gives the particle engine.
+				Every frame records its delta time, the emitters created,
+				destroyed or resized, settings that changed and every burst
+				spawned, so a real scene can be replayed without the game to
+				compare engine versions.
+
+				This file only depends on the standard library so logs can be
+				replayed by tools that run without a graphics device.
+
+*******************************************************************************/
+#include <cstdint>					//Fixed width integers
+#include <fstream>					//Log streams
+#include <string>					//File paths
+#include <unordered_map>			//Emitter ids
+#include <vector>					//Events
+#include "ParticleEngineKernels.h"	//SpawnBurst ColorKeyCPU
+
+namespace ParticleEngine
+{
+	/// <summary>
+	/// Layout of a workload log
+	///		header  { magic, version }
+	///		frame   { frameMagic, eventCount, payloadSize, deltaTime } payload [payloadSize]
+	///		...
+	/// Every event in a payload is a type byte and a varint emitter id
+	/// followed by the fields of that type.
+	/// </summary>
+	namespace Workload
+	{
+		constexpr uint32_t Magic	  = 0x4C574550; // "PEWL"
+		constexpr uint32_t FrameMagic = 0x46574550; // "PEWF"
+		constexpr uint32_t Version	  = 3; //2 added the burst age, 3 the burst position
+
+		//WorkloadSettings::flags
+		constexpr uint32_t FlagPhysics	   = 1u << 0;
+		constexpr uint32_t FlagInPlace	   = 1u << 1;
+		constexpr uint32_t FlagSortByDepth = 1u << 2;
+		constexpr uint32_t FlagShape	   = 1u << 3; //Spawns inside a shape texture, replayed as a box
+	}
+
+	enum WorkloadEventType : uint8_t
+	{
+		Workload_Create	  = 0, //capacity
+		Workload_Destroy  = 1,
+		Workload_Resize	  = 2, //capacity, live particles that fit are kept
+		Workload_Settings = 3, //settings
+		Workload_Spawn	  = 4, //burst
+		Workload_Step	  = 5, //deltaTime, an extra update such as a prewarm step
+	};
+
+	/// <summary>
+	/// What the kernels read from an emitter besides its particles
+	/// </summary>
+	struct WorkloadSettings
+	{
+		float position[4] = { 0.f, 0.f, 0.f, 1.f };
+		float scale[2] = { 0.f, 0.f };
+		uint32_t flags = 0;
+		std::vector<ColorKeyCPU> colors;
+
+		bool operator==(const WorkloadSettings& other) const;
+		bool operator!=(const WorkloadSettings& other) const { return !(*this == other); }
+	};
+
+	struct WorkloadEvent
+	{
+		WorkloadEventType type = Workload_Create;
+		uint32_t emitter = 0;
+		uint32_t capacity = 0;
+		float deltaTime = 0.f;
+		SpawnBurst burst;
+		WorkloadSettings settings;
+	};
+
+	struct WorkloadFrame
+	{
+		float deltaTime = 0.f;
+		std::vector<WorkloadEvent> events;
+	};
+
+	/// <summary>
+	/// Writes frames to a log
+	/// </summary>
+	class WorkloadWriter
+	{
+
+	public:
+
+		/// <summary>
+		/// Starts a new log, replacing the file
+		/// </summary>
+		bool Open(const std::string& path);
+
+		void Close();
+
+		bool IsOpen() const { return file_.is_open(); }
+
+		bool Write(const WorkloadFrame& frame);
+
+	private:
+		std::ofstream file_;
+		std::vector<uint8_t> payload_;
+	};
+
+	/// <summary>
+	/// Reads frames from a log in order
+	/// </summary>
+	class WorkloadReader
+	{
+
+	public:
+
+		bool Open(const std::string& path);
+
+		/// <summary>
+		/// Reads the next frame. Returns false at the end of the log or on bad data.
+		/// </summary>
+		bool Next(WorkloadFrame& frame);
+
+	private:
+		std::ifstream file_;
+		std::vector<uint8_t> payload_;
+	};
+
+	/// <summary>
+	/// Turns what the engine does each frame into log events. Emitters are
+	/// given small ids the first time they are tracked and are destroyed in
+	/// the log the first frame they are not tracked.
+	/// </summary>
+	class WorkloadRecorder
+	{
+
+	public:
+
+		bool Open(const std::string& path);
+
+		void Close();
+
+		bool IsOpen() const { return writer_.IsOpen(); }
+
+		void BeginFrame(float deltaTime);
+
+		/// <summary>
+		/// Call once per frame for every live emitter before its spawns.
+		/// Logs its creation, a new pool size or changed settings.
+		/// </summary>
+		void Track(const void* emitter, uint32_t capacity, const WorkloadSettings& settings);
+
+		void Spawn(const void* emitter, const SpawnBurst& burst);
+
+		void Step(const void* emitter, float deltaTime);
+
+		/// <summary>
+		/// Logs emitters that were not tracked this frame as destroyed and writes the frame
+		/// </summary>
+		void EndFrame();
+
+	private:
+
+		struct Tracked
+		{
+			uint32_t id;
+			uint32_t capacity;
+			uint32_t frame;
+			WorkloadSettings settings;
+		};
+
+		WorkloadWriter writer_;
+		WorkloadFrame frame_;
+		std::unordered_map<const void*, Tracked> emitters_;
+		uint32_t nextId_ = 0;
+		uint32_t frameIndex_ = 0;
+
+		void Push(WorkloadEventType type, const Tracked& tracked);
+	};
+
+}
@@ -0,0 +1,173 @@
+/*******************************************************************************
+
+	@file       ParticleEngineWorkloadReplay.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Replays a workload log with the CPU kernels as fast as it can
+				and times every frame. Runs without a graphics device so
+				captured scenes can be benchmarked headless.
+
+*******************************************************************************/
+#include "stdafx.h"							//Header included in all files.
+#include "ParticleEngineWorkloadReplay.h"	//This files header
+#include "ParticleEngineParallel.h"			//ParallelFor
+#include <algorithm>						//std::min std::remove_if
+#include <chrono>							//Frame timings
+
+namespace ParticleEngine
+{
+
+//Emitters per worker thread, fewer run on the calling thread
+static constexpr uint32_t EmittersPerThread = 8;
+
+WorkloadReplay::WorkloadReplay(WorkerPool& workers) noexcept :
+	workers_(workers)
+{
+}
+
+void WorkloadReplay::Reset()
+{
+	emitters_.clear();
+	active_.clear();
+	seed_ = 0.f;
+}
+
+KernelParams WorkloadReplay::MakeParams(const Emitter& emitter, float deltaTime)
+{
+	KernelParams params;
+	params.deltaTime = deltaTime;
+	for (int c = 0; c < 4; ++c)
+		params.position[c] = emitter.settings.position[c];
+	params.scale[0] = emitter.settings.scale[0];
+	params.scale[1] = emitter.settings.scale[1];
+	params.colors = emitter.settings.colors.data();
+	params.numColors = static_cast<uint32_t>(emitter.settings.colors.size());
+	return params;
+}
+
+uint32_t WorkloadReplay::SelectFeatures(const Emitter& emitter)
+{
+	//Shape textures are not in the log so those emitters spawn in their box
+	const WorkloadSettings& settings = emitter.settings;
+	return SelectKernelFeatures(false, settings.scale[0], settings.scale[1],
+		static_cast<uint32_t>(settings.colors.size()), (settings.flags & Workload::FlagPhysics) != 0);
+}
+
+void WorkloadReplay::Simulate(Emitter& emitter, float deltaTime)
+{
+	std::vector<BehaviorDataCPU>& particles = emitter.particles;
+	if (particles.empty())
+		return;
+
+	KernelParams params = MakeParams(emitter, deltaTime);
+	GetCPUKernel(SelectFeatures(emitter))(particles.data(), static_cast<uint32_t>(particles.size()), params);
+
+	particles.erase(std::remove_if(particles.begin(), particles.end(),
+		[](const BehaviorDataCPU& p) { return !(p.lifetime[0] < p.lifetime[1]); }), particles.end());
+}
+
+WorkloadReplay::FrameTiming WorkloadReplay::Replay(const WorkloadFrame& frame)
+{
+	FrameTiming timing;
+	auto start = std::chrono::steady_clock::now();
+
+	//Events run in the order the engine did them
+	for (const WorkloadEvent& event : frame.events)
+	{
+		switch (event.type)
+		{
+		case Workload_Create:
+		case Workload_Resize:
+		{
+			Emitter& emitter = emitters_[event.emitter];
+			emitter.capacity = event.capacity;
+
+			//Resizes keep the live particles that still fit
+			if (emitter.particles.size() > event.capacity)
+				emitter.particles.resize(event.capacity);
+			emitter.particles.reserve(event.capacity);
+			break;
+		}
+		case Workload_Destroy:
+			emitters_.erase(event.emitter);
+			break;
+		case Workload_Settings:
+			emitters_[event.emitter].settings = event.settings;
+			break;
+		case Workload_Spawn:
+		{
+			auto found = emitters_.find(event.emitter);
+			if (found == emitters_.end())
+				break;
+
+			Emitter& emitter = found->second;
+			uint32_t alive = static_cast<uint32_t>(emitter.particles.size());
+			uint32_t count = std::min(event.burst.count, emitter.capacity > alive ? emitter.capacity - alive : 0u);
+			if (count == 0)
+				break;
+
+			emitter.particles.resize(alive + count);
+			GetCPUSpawnKernel(SelectFeatures(emitter))(event.burst, MakeParams(emitter, 0.f), seed_,
+				emitter.particles.data(), alive, alive + count);
+			timing.spawned += count;
+
+			//Same stride as the spawn pass
+			seed_ += 97.31f;
+			if (seed_ > 8192.f)
+				seed_ -= 8192.f;
+			break;
+		}
+		case Workload_Step:
+		{
+			auto found = emitters_.find(event.emitter);
+			if (found != emitters_.end())
+				Simulate(found->second, event.deltaTime);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	active_.clear();
+	for (auto& entry : emitters_)
+	{
+		if (!entry.second.particles.empty())
+			active_.push_back(&entry.second);
+	}
+
+	float deltaTime = frame.deltaTime;
+	ParallelFor(workers_, static_cast<uint32_t>(active_.size()), [this, deltaTime](unsigned, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+			Simulate(*active_[i], deltaTime);
+	}, EmittersPerThread);
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	timing.seconds = elapsed.count();
+	timing.emitters = static_cast<uint32_t>(emitters_.size());
+	for (const Emitter* emitter : active_)
+		timing.particles += static_cast<uint32_t>(emitter->particles.size());
+
+	return timing;
+}
+
+bool WorkloadReplay::Run(const std::string& path, std::vector<FrameTiming>& timings)
+{
+	WorkloadReader reader;
+	if (!reader.Open(path))
+		return false;
+
+	Reset();
+
+	WorkloadFrame frame;
+	while (reader.Next(frame))
+		timings.push_back(Replay(frame));
+
+	return true;
+}
+
+}//End of Particle Engine NameSpace
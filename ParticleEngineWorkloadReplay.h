@@ -0,0 +1,80 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineWorkloadReplay.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Replays a workload log with the CPU kernels as fast as it can
+				and times every frame. Runs without a graphics device so
+				captured scenes can be benchmarked headless.
+
+				This file only depends on the standard library.
+
+*******************************************************************************/
+#include <cstdint>					//Fixed width integers
+#include <string>					//File paths
+#include <unordered_map>			//Emitters by id
+#include <vector>					//Particles and timings
+#include "ParticleEngineWorkload.h"	//Workload log
+
+namespace ParticleEngine
+{
+	class WorkerPool;
+
+	class WorkloadReplay
+	{
+
+	public:
+
+		struct FrameTiming
+		{
+			double seconds = 0.0;	//Events and the update of every emitter
+			uint32_t emitters = 0;	//Emitters alive after the frame
+			uint32_t particles = 0;	//Particles alive after the frame
+			uint32_t spawned = 0;	//Particles written by bursts this frame
+		};
+
+		WorkloadReplay(WorkerPool& workers) noexcept;
+
+		/// <summary>
+		/// Replays every frame of a log and appends one timing per frame.
+		/// Stops at the end of the log or the first bad frame, returns false if
+		/// the log could not be opened.
+		/// </summary>
+		bool Run(const std::string& path, std::vector<FrameTiming>& timings);
+
+		/// <summary>
+		/// Applies the events of one frame then updates every emitter by its delta time
+		/// </summary>
+		FrameTiming Replay(const WorkloadFrame& frame);
+
+		/// <summary>
+		/// Forgets every emitter, call before replaying a log again
+		/// </summary>
+		void Reset();
+
+	private:
+
+		struct Emitter
+		{
+			uint32_t capacity = 0;
+			WorkloadSettings settings;
+			std::vector<BehaviorDataCPU> particles; //Live particles only
+		};
+
+		std::unordered_map<uint32_t, Emitter> emitters_;
+		std::vector<Emitter*> active_;
+		WorkerPool& workers_;
+		float seed_ = 0.f;
+
+		static KernelParams MakeParams(const Emitter& emitter, float deltaTime);
+		static uint32_t SelectFeatures(const Emitter& emitter);
+
+		//Updates one emitter and drops its dead particles
+		static void Simulate(Emitter& emitter, float deltaTime);
+	};
+
+}
@@ -0,0 +1,91 @@
+/*******************************************************************************
+
+	@file       ParticleEngineWorld.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      A particle world owns everything one simulation needs, its
+				emitters, settings, transforms, budget, emission queue,
+				texture handles, emitter pool and behavior stage.
+
+*******************************************************************************/
+#include "stdafx.h"						//Header included in all files.
+#include "ParticleEngineWorld.h"		//This files header
+#include "ParticleEngine.h"				//Contains the Particle Engine namepspace
+#include "ParticleEngineBehavior.h"		//Compute stage of the particle engine
+#include "Graphics.h"					//Part of our graphics engine
+#include "Window.h"						//Contains a class that stores window Information
+
+namespace ParticleEngine
+{
+
+World::World(Graphics& gfx) :
+	gfx_(gfx),
+	ownedEmitters_(std::make_unique<EmitterManager>()),
+	emitterManager_(*ownedEmitters_),
+	textures_(gfx.market),
+	pool_(emitterManager_)
+{
+}
+
+World::World(Graphics& gfx, EmitterManager& emitterManager) :
+	gfx_(gfx),
+	emitterManager_(emitterManager),
+	textures_(gfx.market),
+	pool_(emitterManager_)
+{
+}
+
+World::~World() noexcept
+{
+}
+
+void World::Update(float deltaTime)
+{
+	deltaTime_ = deltaTime;
+	GetBehavior().Update(emitterManager_, deltaTime);
+}
+
+Behavior& World::GetBehavior()
+{
+	//Created late so an adopted behavior is the only one the world builds
+	if (!behavior_)
+	{
+		ownedBehavior_ = std::make_unique<Behavior>(*this);
+		behavior_ = ownedBehavior_.get();
+	}
+
+	return *behavior_;
+}
+
+void World::Adopt(Behavior& behavior)
+{
+	behavior_ = &behavior;
+	ownedBehavior_.reset();
+}
+
+void World::Release(Behavior& behavior)
+{
+	if (behavior_ == &behavior)
+		behavior_ = nullptr;
+}
+
+void World::SetCamera(const float position[3], const float forward[3])
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		cameraPosition_[i] = position[i];
+		cameraForward_[i] = forward[i];
+	}
+}
+
+World& World::Default()
+{
+	//The only place the engine and window singletons are reached
+	static World world(Window::Instance().Gfx(), Engine::Instance().GetEmitterManager());
+	return world;
+}
+
+}//End of Particle Engine NameSpace
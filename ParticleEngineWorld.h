@@ -0,0 +1,139 @@
+#pragma once
+/*******************************************************************************
+
+	@file       ParticleEngineWorld.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      A particle world owns everything one simulation needs, its
+				emitters, settings, transforms, budget, emission queue,
+				texture handles, emitter pool and behavior stage. Nothing is
+				shared between worlds so several can exist in one process,
+				such as one per game instance on a server or an editor
+				preview next to the game, and each can update on its own
+				thread when it is given its own Graphics.
+
+*******************************************************************************/
+#include "ParticleEngineEmitterSettings.h"	//Per emitter settings
+#include "ParticleEngineTransforms.h"		//Transforms of emitters that follow their object
+#include "ParticleEngineBudget.h"			//Frame level particle budget
+#include "ParticleEngineEmitterPool.h"		//Storage reclaimed from idle emitters
+#include "ParticleEngineEmissionQueue.h"	//Emissions pushed from any thread
+#include "ParticleEngineTextureHandle.h"	//Interned texture handles
+#include "ParticleEngineParallel.h"			//Worker threads of the CPU passes
+#include <memory>							//std::unique_ptr
+
+class Graphics;
+
+namespace ParticleEngine
+{
+	class Behavior;
+
+	class World
+	{
+
+	public:
+
+		//Constructors
+
+		/// <summary>
+		/// Creates a world with its own emitters, used for previews and
+		/// additional game instances
+		/// </summary>
+		explicit World(Graphics& gfx);
+
+		/// <summary>
+		/// Creates a world over emitters that are already drawn elsewhere
+		/// </summary>
+		World(Graphics& gfx, EmitterManager& emitterManager);
+
+		~World() noexcept;
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		/// <summary>
+		/// Advances every emitter of this world by deltaTime. Components read
+		/// the same delta time until the next update.
+		/// </summary>
+		void Update(float deltaTime);
+
+		/// <summary>
+		/// Seconds the last update advanced, the clock of this world
+		/// </summary>
+		float DeltaTime() const { return deltaTime_; }
+
+		/// <summary>
+		/// Sets the camera of this world, read by the next update to depth
+		/// sort particles against and to weigh budget requests by distance.
+		/// Call once a frame before Update.
+		/// </summary>
+		void SetCamera(const float position[3], const float forward[3]);
+
+		const float* CameraPosition() const { return cameraPosition_; }
+		const float* CameraForward() const { return cameraForward_; }
+
+		Graphics& Gfx() const { return gfx_; }
+		EmitterManager& GetEmitterManager() { return emitterManager_; }
+
+		/// <summary>
+		/// The behavior that updates this world, created on first use unless one was adopted
+		/// </summary>
+		Behavior& GetBehavior();
+
+		/// <summary>
+		/// Updates through a behavior owned elsewhere, such as the one the engine
+		/// builds for the default world, in place of its own. Release must be
+		/// called before that behavior is destroyed.
+		/// </summary>
+		void Adopt(Behavior& behavior);
+		void Release(Behavior& behavior);
+
+		EmitterSettingsTable& GetSettings() { return settings_; }
+		TransformTable& GetTransforms() { return transforms_; }
+		ParticleBudget& GetBudget() { return budget_; }
+		EmitterPool& GetPool() { return pool_; }
+		EmissionQueue& GetEmissionQueue() { return emissionQueue_; }
+		TextureRegistry& GetTextures() { return textures_; }
+
+		/// <summary>
+		/// Threads the CPU work of this world is split across, started with
+		/// the world. Also used for baking collision fields.
+		/// </summary>
+		WorkerPool& GetWorkers() { return workers_; }
+
+		/// <summary>
+		/// The world of the engine, over its emitter manager and graphics.
+		/// Components that are never given a world emit into it.
+		/// </summary>
+		static World& Default();
+
+	private:
+
+		Graphics& gfx_;
+
+		//Only set when this world created its own emitters
+		std::unique_ptr<EmitterManager> ownedEmitters_;
+		EmitterManager& emitterManager_;
+
+		float deltaTime_ = 0.f;
+
+		//Looking down +z from the origin until a camera is set
+		float cameraPosition_[3] = { 0.f, 0.f, 0.f };
+		float cameraForward_[3] = { 0.f, 0.f, 1.f };
+
+		TextureRegistry		 textures_;
+		EmitterSettingsTable settings_;
+		TransformTable		 transforms_;
+		ParticleBudget		 budget_;
+		EmissionQueue		 emissionQueue_;
+		EmitterPool			 pool_;
+		WorkerPool			 workers_;
+
+		//Declared last so it is destroyed before the tables it reads
+		Behavior* behavior_ = nullptr;
+		std::unique_ptr<Behavior> ownedBehavior_;
+	};
+
+}
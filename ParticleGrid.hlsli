@@ -0,0 +1,87 @@
+/*******************************************************************************
+
+    @file       ParticleGrid.hlsli
+
+    @date       01/09/2021
+
+    @authors    West Foulks (WestFoulks@gmail.com)
+
+    @brief      Shared definitions for the particle neighbor grid. Included by
+                CSParticleGrid.hlsl that builds the grid and by behavior
+                kernels that query it, the update uses it for separation.
+
+                Particles are hashed by their cell into a power of two table.
+                Different cells can share a hash so queries must still check
+                the distance to each particle they visit.
+
+*******************************************************************************/
+#ifndef PARTICLE_GRID_HLSLI
+#define PARTICLE_GRID_HLSLI
+
+/// <summary>
+/// Parameters of the grid, must match cbGridParams on the CPU
+/// </summary>
+cbuffer GridParams : register(b2)
+{
+    float gpCellSize;     //World size of a cell
+    uint  gpTableSize;    //Number of hash buckets, power of two
+    uint  gpCount;        //Number of particles in the grid
+    uint  gpBlockCount;   //Number of scan blocks
+};
+
+//Maps a position to its cell coordinates
+int3 GridCell(float3 pos)
+{
+    return int3(floor(pos / gpCellSize));
+}
+
+//Maps cell coordinates to a bucket
+uint GridHash(int3 cell)
+{
+    uint h = (uint(cell.x) * 73856093u) ^ (uint(cell.y) * 19349663u) ^ (uint(cell.z) * 83492791u);
+    return h & (gpTableSize - 1);
+}
+
+#ifndef PARTICLE_GRID_BUILD
+
+//Built after the last update, bind before dispatching a kernel that queries neighbors
+StructuredBuffer<uint> GridCellStart   : register(t25); //First sorted index of every bucket
+StructuredBuffer<uint> GridCellCount   : register(t26); //Particles in every bucket
+StructuredBuffer<uint> GridSortedIndex : register(t27); //Particle indices sorted by bucket
+
+/// <summary>
+/// Visits every particle in the cells that overlap a sphere around pos.
+/// The body runs with `neighbor` set to a particle index, it must check
+/// the distance itself since buckets can be shared between cells, which
+/// also means a particle can rarely be visited twice.
+/// Only the neighboring cells are walked so a query is O(k).
+///
+///     GRID_FOR_EACH_NEIGHBOR(pos, neighbor)
+///     {
+///         float3 d = Particles[neighbor].pos.xyz - pos;
+///         ...
+///     }
+///     GRID_END_FOR_EACH
+/// </summary>
+#define GRID_FOR_EACH_NEIGHBOR(pos, neighbor)                                   \
+    {                                                                           \
+        int3 gridCenter_ = GridCell(pos);                                       \
+        for (int gz_ = -1; gz_ <= 1; ++gz_)                                     \
+        for (int gy_ = -1; gy_ <= 1; ++gy_)                                     \
+        for (int gx_ = -1; gx_ <= 1; ++gx_)                                     \
+        {                                                                       \
+            uint gridBucket_ = GridHash(gridCenter_ + int3(gx_, gy_, gz_));     \
+            uint gridStart_ = GridCellStart[gridBucket_];                       \
+            uint gridEnd_ = gridStart_ + GridCellCount[gridBucket_];            \
+            for (uint gi_ = gridStart_; gi_ < gridEnd_; ++gi_)                  \
+            {                                                                   \
+                uint neighbor = GridSortedIndex[gi_];
+
+#define GRID_END_FOR_EACH                                                       \
+            }                                                                   \
+        }                                                                       \
+    }
+
+#endif //PARTICLE_GRID_BUILD
+
+#endif //PARTICLE_GRID_HLSLI
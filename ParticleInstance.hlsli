@@ -0,0 +1,56 @@
+/*******************************************************************************
+
+    @file       ParticleInstance.hlsli
+
+    @date       01/09/2021
+
+    @authors    West Foulks (WestFoulks@gmail.com)
+
+    @brief      Render ready particle records. The behavior kernel writes one
+                for every particle alive after its update when the fused
+                instance pass is on, the vertex stage expands them into
+                billboards without reading the BehaviorData buffer.
+
+*******************************************************************************/
+#ifndef PARTICLE_INSTANCE_HLSLI
+#define PARTICLE_INSTANCE_HLSLI
+
+/// <summary>
+/// One drawn particle, must match ParticleInstanceCPU on the CPU
+/// </summary>
+struct ParticleInstance
+{
+    float3 position;
+    uint   orientationScale; //Half floats, low image rotation radians high scale
+    uint   color;            //RGBA8 unorm, red in the low byte
+    uint   atlasPage;        //Slice of the atlas page array
+};
+
+uint PackOrientationScale(float rotation, float scale)
+{
+    return f32tof16(rotation) | (f32tof16(scale) << 16);
+}
+
+float InstanceRotation(ParticleInstance instance)
+{
+    return f16tof32(instance.orientationScale & 0xFFFF);
+}
+
+float InstanceScale(ParticleInstance instance)
+{
+    return f16tof32(instance.orientationScale >> 16);
+}
+
+uint PackColor(float4 color)
+{
+    uint4 bytes = (uint4)round(saturate(color) * 255.f);
+    return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+}
+
+float4 InstanceColor(ParticleInstance instance)
+{
+    uint c = instance.color;
+    return float4(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF, c >> 24) / 255.f;
+}
+
+#endif
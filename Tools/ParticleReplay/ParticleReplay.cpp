@@ -0,0 +1,141 @@
+/*******************************************************************************
+
+	@file       ParticleReplay.cpp
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Replays a workload log captured by Behavior::StartWorkloadCapture
+				headless at full speed and reports per frame timings, so
+				engine versions can be compared on real scenes.
+
+				Build from the repository root
+				g++ -std=c++17 -O2 -pthread -ITools/ParticleReplay -I.
+					Tools/ParticleReplay/ParticleReplay.cpp
+					ParticleEngineWorkload.cpp ParticleEngineWorkloadReplay.cpp
+					-o particle_replay
+
+				Usage
+				particle_replay <log> [--threads N] [--repeat N] [--csv path]
+
+*******************************************************************************/
+#include "stdafx.h"							//Header included in all files.
+#include "ParticleEngineWorkloadReplay.h"	//Headless replay
+#include "ParticleEngineParallel.h"			//WorkerPool
+#include <algorithm>						//std::sort
+#include <cstdio>							//printf
+#include <cstdlib>							//std::atoi
+#include <cstring>							//std::strcmp
+#include <fstream>							//CSV output
+
+using namespace ParticleEngine;
+
+static void PrintUsage()
+{
+	std::printf("usage: particle_replay <log> [--threads N] [--repeat N] [--csv path]\n");
+}
+
+//Milliseconds at fraction of the sorted frame times
+static double Percentile(const std::vector<double>& sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0.0;
+
+	size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + .5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char** argv)
+{
+	const char* logPath = nullptr;
+	const char* csvPath = nullptr;
+	unsigned threads = 0;
+	int repeat = 1;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+			threads = static_cast<unsigned>(std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+			repeat = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--csv") && i + 1 < argc)
+			csvPath = argv[++i];
+		else if (argv[i][0] != '-' && !logPath)
+			logPath = argv[i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (!logPath)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	//Started before any frame is timed, like the pool of a world
+	WorkerPool workers(threads ? threads : DefaultThreadCount());
+	WorkloadReplay replay(workers);
+	std::vector<WorkloadReplay::FrameTiming> timings;
+
+	//Every pass starts from an empty scene, repeats smooth out noisy frames
+	for (int pass = 0; pass < repeat; ++pass)
+	{
+		if (!replay.Run(logPath, timings))
+		{
+			std::printf("could not open %s\n", logPath);
+			return 1;
+		}
+	}
+
+	if (timings.empty())
+	{
+		std::printf("%s has no frames\n", logPath);
+		return 1;
+	}
+
+	size_t framesPerPass = timings.size() / repeat;
+	std::vector<double> ms;
+	ms.reserve(timings.size());
+
+	double total = 0.0;
+	uint64_t spawned = 0;
+	uint32_t peakParticles = 0;
+	for (const WorkloadReplay::FrameTiming& timing : timings)
+	{
+		ms.push_back(timing.seconds * 1000.0);
+		total += timing.seconds * 1000.0;
+		spawned += timing.spawned;
+		peakParticles = std::max(peakParticles, timing.particles);
+	}
+
+	if (csvPath)
+	{
+		std::ofstream csv(csvPath);
+		csv << "pass,frame,ms,emitters,particles,spawned\n";
+		for (size_t i = 0; i < timings.size(); ++i)
+		{
+			const WorkloadReplay::FrameTiming& timing = timings[i];
+			csv << i / framesPerPass << ',' << i % framesPerPass << ',' << ms[i] << ','
+				<< timing.emitters << ',' << timing.particles << ',' << timing.spawned << '\n';
+		}
+	}
+
+	std::vector<double> sorted = ms;
+	std::sort(sorted.begin(), sorted.end());
+
+	std::printf("%s\n", logPath);
+	std::printf("  frames    %zu x %d\n", framesPerPass, repeat);
+	std::printf("  threads   %u\n", workers.Size());
+	std::printf("  spawned   %llu\n", static_cast<unsigned long long>(spawned / repeat));
+	std::printf("  peak live %u\n", peakParticles);
+	std::printf("  mean      %.4f ms\n", total / timings.size());
+	std::printf("  p50       %.4f ms\n", Percentile(sorted, .5));
+	std::printf("  p95       %.4f ms\n", Percentile(sorted, .95));
+	std::printf("  max       %.4f ms\n", sorted.back());
+
+	return 0;
+}
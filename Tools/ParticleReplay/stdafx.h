@@ -0,0 +1,13 @@
+#pragma once
+/*******************************************************************************
+
+	@file       stdafx.h
+
+	@date       01/09/2021
+
+	@authors    West Foulks (WestFoulks@gmail.com)
+
+	@brief      Stands in for the engine precompiled header. The replay only
+				builds the standard library parts of the particle engine.
+
+*******************************************************************************/